@@ -8,6 +8,11 @@ workspace "SpaceSim"
    filter "system:windows"
       buildoptions { "/EHsc", "/Zc:preprocessor", "/Zc:__cplusplus" }
 
+newoption {
+   trigger = "mpi",
+   description = "Build Core with SPACESIM_MPI and add the Cluster runner"
+}
+
 OutputDir = "%{cfg.system}-%{cfg.architecture}/%{cfg.buildcfg}"
 
 group "Dependencies"
@@ -21,4 +26,13 @@ group ""
 
 group "App"
    include "App/Build-App.lua"
+group ""
+
+group "Tools"
+   include "Ensemble/Build-Ensemble.lua"
+   include "OutOfCore/Build-OutOfCore.lua"
+   include "GasBenchmark/Build-GasBenchmark.lua"
+   if _OPTIONS["mpi"] then
+      include "Cluster/Build-Cluster.lua"
+   end
 group ""
\ No newline at end of file
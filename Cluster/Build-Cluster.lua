@@ -0,0 +1,56 @@
+project "Cluster"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++20"
+    targetdir "Binaries/%{cfg.buildcfg}"
+    staticruntime "off"
+
+    files {
+        "Source/**.h",
+        "Source/**.cpp"
+    }
+
+    includedirs
+    {
+        "Source",
+        "../Core/Source",
+        "../Core/ThirdParty/Include"
+    }
+
+    links
+    {
+        "Core"
+    }
+
+    defines { "SPACESIM_MPI" }
+
+    targetdir ("../Binaries/" .. OutputDir .. "/%{prj.name}")
+    objdir ("../Binaries/Intermediates/" .. OutputDir .. "/%{prj.name}")
+
+    filter "system:windows"
+        systemversion "latest"
+        defines { "WINDOWS" }
+        includedirs { "$(MSMPI_INC)" }
+        libdirs { "$(MSMPI_LIB64)" }
+        links { "msmpi" }
+
+    filter "system:linux"
+        buildoptions { "`mpicxx --showme:compile`" }
+        linkoptions { "`mpicxx --showme:link`" }
+
+    filter "configurations:Debug"
+        defines { "DEBUG" }
+        runtime "Debug"
+        symbols "On"
+
+    filter "configurations:Release"
+        defines { "RELEASE" }
+        runtime "Release"
+        optimize "On"
+        symbols "On"
+
+    filter "configurations:Dist"
+        defines { "DIST" }
+        runtime "Release"
+        optimize "On"
+        symbols "Off"
\ No newline at end of file
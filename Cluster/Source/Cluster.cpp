@@ -0,0 +1,229 @@
+#include "Simulation/DistributedSimulation.h"
+#include "Simulation/GravityKernels.h"
+#include "Simulation/InitialConditions.h"
+#include "Simulation/ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace SpaceSim;
+
+struct ClusterOptions {
+    uint64_t bodyCount = 100000;
+    uint32_t steps = 20;
+    float timestep = 0.001f;
+    float openingAngle = 0.5f;
+    uint32_t balanceInterval = 16;
+    uint32_t threads = 1;
+    uint64_t seed = 0x5EED5EEDull;
+    size_t verifySamples = 0;
+};
+
+static void PrintUsage()
+{
+    std::cout << "Usage: mpirun -np R Cluster [options]\n"
+                 "  --bodies N           Plummer sphere bodies over all ranks (100000)\n"
+                 "  --steps N            steps to time (20)\n"
+                 "  --timestep DT        (0.001)\n"
+                 "  --theta T            opening angle for local and exported nodes (0.5)\n"
+                 "  --balance-interval N steps between rebalances (16)\n"
+                 "  --threads N          worker threads per rank (1)\n"
+                 "  --seed S\n"
+                 "  --verify N           compare N sampled accelerations against direct summation\n";
+}
+
+static bool ParseOptions(int argc, char** argv, ClusterOptions& options)
+{
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        if (std::strcmp(option, "--help") == 0 || i + 1 >= argc)
+            return false;
+
+        const char* value = argv[++i];
+        if (std::strcmp(option, "--bodies") == 0) options.bodyCount = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(option, "--steps") == 0) options.steps = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (std::strcmp(option, "--timestep") == 0) options.timestep = static_cast<float>(std::atof(value));
+        else if (std::strcmp(option, "--theta") == 0) options.openingAngle = static_cast<float>(std::atof(value));
+        else if (std::strcmp(option, "--balance-interval") == 0) options.balanceInterval = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (std::strcmp(option, "--threads") == 0) options.threads = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (std::strcmp(option, "--seed") == 0) options.seed = std::strtoull(value, nullptr, 0);
+        else if (std::strcmp(option, "--verify") == 0) options.verifySamples = std::strtoull(value, nullptr, 10);
+        else
+            return false;
+    }
+    return true;
+}
+
+// Every rank draws its slice of the global body sequence from the same streams, so the initial
+// conditions do not depend on the rank count. The net motion is removed over all ranks.
+static void SpawnPlummerSphere(DistributedSimulation& simulation, const ClusterOptions& options)
+{
+    PlummerParams params;
+    params.count = options.bodyCount;
+    const BodyGenerator generator = PlummerSphere(params);
+
+    const uint64_t first = options.bodyCount * simulation.GetRank() / simulation.GetRankCount();
+    const uint64_t last = options.bodyCount * (simulation.GetRank() + 1) / simulation.GetRankCount();
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> velocities;
+    std::vector<float> masses;
+    std::vector<uint64_t> ids;
+    double moments[7] = {};
+    for (uint64_t i = first; i < last; i++) {
+        RandomStream random(options.seed, i);
+        CelestialBody body;
+        generator(i, random, body);
+        positions.push_back(body.position);
+        velocities.push_back(body.velocity);
+        masses.push_back(body.mass);
+        ids.push_back(i);
+        for (int axis = 0; axis < 3; axis++) {
+            moments[axis] += static_cast<double>(body.position[axis]) * body.mass;
+            moments[axis + 3] += static_cast<double>(body.velocity[axis]) * body.mass;
+        }
+        moments[6] += body.mass;
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, moments, 7, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    const glm::vec3 center(moments[0] / moments[6], moments[1] / moments[6], moments[2] / moments[6]);
+    const glm::vec3 velocity(moments[3] / moments[6], moments[4] / moments[6], moments[5] / moments[6]);
+    for (size_t i = 0; i < positions.size(); i++) {
+        positions[i] -= center;
+        velocities[i] -= velocity;
+    }
+    simulation.AddBodies(positions, velocities, masses, ids);
+}
+
+// Gathers every body on rank 0 and compares the distributed accelerations of a sample against direct
+// summation in double precision, with the solvers' minimum interaction distance.
+static void VerifyAccelerations(const DistributedSimulation& simulation, size_t samples)
+{
+    const int rankCount = simulation.GetRankCount();
+    const int localCount = static_cast<int>(simulation.GetLocalBodyCount());
+    std::vector<int> counts(rankCount);
+    MPI_Gather(&localCount, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    std::vector<int> offsets(rankCount, 0);
+    std::vector<int> floatCounts(rankCount);
+    std::vector<int> floatOffsets(rankCount);
+    int total = 0;
+    for (int r = 0; r < rankCount; r++) {
+        offsets[r] = total;
+        total += counts[r];
+        floatCounts[r] = counts[r] * 3;
+        floatOffsets[r] = offsets[r] * 3;
+    }
+
+    std::vector<glm::vec3> positions(total);
+    std::vector<glm::vec3> accelerations(total);
+    std::vector<float> masses(total);
+    MPI_Gatherv(simulation.GetPositions().data(), localCount * 3, MPI_FLOAT, positions.data(), floatCounts.data(), floatOffsets.data(), MPI_FLOAT, 0, MPI_COMM_WORLD);
+    MPI_Gatherv(simulation.GetAccelerations().data(), localCount * 3, MPI_FLOAT, accelerations.data(), floatCounts.data(), floatOffsets.data(), MPI_FLOAT, 0, MPI_COMM_WORLD);
+    MPI_Gatherv(simulation.GetMasses().data(), localCount, MPI_FLOAT, masses.data(), counts.data(), offsets.data(), MPI_FLOAT, 0, MPI_COMM_WORLD);
+    if (simulation.GetRank() != 0 || total == 0)
+        return;
+
+    // Relative errors blow up near the centre where the net pull vanishes, so the tail is also given
+    // against the RMS acceleration.
+    std::vector<double> errors;
+    std::vector<double> absoluteErrors;
+    double meanSquare = 0.0;
+    const size_t stride = std::max<size_t>(1, total / std::max<size_t>(1, samples));
+    for (size_t i = 0; i < static_cast<size_t>(total); i += stride) {
+        glm::dvec3 reference(0.0);
+        for (size_t j = 0; j < static_cast<size_t>(total); j++) {
+            const glm::dvec3 direction = glm::dvec3(positions[j]) - glm::dvec3(positions[i]);
+            const double distanceSquared = glm::dot(direction, direction);
+            if (distanceSquared < MinInteractionDistanceSquared)
+                continue;
+            reference += direction * (masses[j] / (distanceSquared * std::sqrt(distanceSquared)));
+        }
+        const double error = glm::length(glm::dvec3(accelerations[i]) - reference);
+        errors.push_back(error / std::max(glm::length(reference), 1e-30));
+        absoluteErrors.push_back(error);
+        meanSquare += glm::dot(reference, reference);
+    }
+
+    const double rms = std::sqrt(meanSquare / errors.size());
+    std::sort(errors.begin(), errors.end());
+    std::sort(absoluteErrors.begin(), absoluteErrors.end());
+    std::cout << "Force error over " << errors.size() << " bodies: median " << errors[errors.size() / 2]
+              << ", relative to RMS 99% " << absoluteErrors[errors.size() * 99 / 100] / rms
+              << ", max " << absoluteErrors.back() / rms << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+
+    ClusterOptions options;
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (!ParseOptions(argc, argv, options))
+    {
+        if (rank == 0)
+            PrintUsage();
+        MPI_Finalize();
+        return 1;
+    }
+
+    ThreadPool::Get().SetThreadCount(std::max(options.threads, 1u));
+
+    {
+        DistributedSimulation simulation(MPI_COMM_WORLD);
+        DomainSettings settings;
+        settings.solver.openingAngle = options.openingAngle;
+        settings.exportOpeningAngle = options.openingAngle;
+        settings.balanceInterval = options.balanceInterval;
+        simulation.SetSettings(settings);
+
+        SpawnPlummerSphere(simulation, options);
+        simulation.Rebalance();
+
+        if (options.verifySamples > 0)
+        {
+            simulation.ComputeAccelerations(1.0f);
+            VerifyAccelerations(simulation, options.verifySamples);
+        }
+
+        // Per-step maxima over ranks: the step time is set by the slowest one.
+        double exchangeMs = 0.0, forceMs = 0.0, imported = 0.0, migrated = 0.0, imbalance = 0.0;
+        MPI_Barrier(MPI_COMM_WORLD);
+        const double start = MPI_Wtime();
+        for (uint32_t step = 0; step < options.steps; step++) {
+            simulation.Step(options.timestep, 1.0f);
+            const DomainStats& stats = simulation.GetStats();
+            double local[4] = { stats.exchangeMs, stats.forceMs, static_cast<double>(stats.importedBodies), static_cast<double>(stats.migratedBodies) };
+            double slowest[4];
+            MPI_Reduce(local, slowest, 4, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+            exchangeMs += slowest[0];
+            forceMs += slowest[1];
+            imported += slowest[2];
+            migrated += slowest[3];
+            imbalance += stats.imbalance;
+        }
+        const double seconds = MPI_Wtime() - start;
+
+        const uint64_t globalCount = simulation.GetGlobalBodyCount();
+        if (rank == 0)
+        {
+            const double steps = std::max(options.steps, 1u);
+            std::cout << "Ranks: " << simulation.GetRankCount() << ", bodies: " << globalCount << ", steps: " << options.steps << "\n"
+                      << "Step: " << seconds * 1000.0 / steps << " ms (slowest rank: exchange " << exchangeMs / steps
+                      << " ms, force " << forceMs / steps << " ms)\n"
+                      << "Imported per rank: " << imported / steps << " max, migrated " << migrated / steps << " max\n"
+                      << "Imbalance: " << imbalance / steps << ", rebalances: " << simulation.GetStats().rebalances << std::endl;
+        }
+
+        if (options.verifySamples > 0)
+        {
+            simulation.ComputeAccelerations(1.0f);
+            VerifyAccelerations(simulation, options.verifySamples);
+        }
+    }
+
+    MPI_Finalize();
+    return 0;
+}
\ No newline at end of file
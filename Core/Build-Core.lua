@@ -37,6 +37,15 @@ project "Core"
         systemversion "latest"
         defines { "WINDOWS" }
 
+    filter "options:mpi"
+        defines { "SPACESIM_MPI" }
+
+    filter { "options:mpi", "system:windows" }
+        includedirs { "$(MSMPI_INC)" }
+
+    filter { "options:mpi", "system:linux" }
+        buildoptions { "`mpicxx --showme:compile`" }
+
     filter "configurations:Debug"
         defines { "DEBUG" }
         runtime "Debug"
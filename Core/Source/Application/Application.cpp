@@ -1,4 +1,5 @@
 #include "Application.h"
+#include <algorithm>
 #include <iostream>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_transform.hpp>
@@ -67,6 +68,9 @@ void Application::Init()
     
     m_Simulation = std::make_unique<GravitySimulation>();
     m_Simulation->Init();
+    
+    m_SimulationThread = std::make_unique<SimulationThread>(*m_Simulation);
+    m_SimulationThread->Start();
 }
 
 void Application::InitImGui()
@@ -84,6 +88,8 @@ void Application::InitImGui()
 
 void Application::Shutdown()
 {
+    m_SimulationThread.reset();
+    
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -94,18 +100,10 @@ void Application::Shutdown()
 
 void Application::Run()
 {
-    float lastFrame = static_cast<float>(glfwGetTime());
-    
     while (!glfwWindowShouldClose(m_Window))
     {
-        float currentFrame = static_cast<float>(glfwGetTime());
-        float deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-        
         ProcessInput();
         
-        Update(deltaTime);
-        
         Render();
         RenderUI();
         
@@ -122,7 +120,7 @@ void Application::ProcessInput()
     static bool spacePressed = false;
     if (glfwGetKey(m_Window, GLFW_KEY_SPACE) == GLFW_PRESS) {
         if (!spacePressed) {
-            m_PauseSimulation = !m_PauseSimulation;
+            m_SimulationThread->SetPaused(!m_SimulationThread->IsPaused());
             spacePressed = true;
         }
     } else {
@@ -132,7 +130,7 @@ void Application::ProcessInput()
     static bool rPressed = false;
     if (glfwGetKey(m_Window, GLFW_KEY_R) == GLFW_PRESS) {
         if (!rPressed) {
-            m_Simulation->Reset();
+            m_SimulationThread->Post(SimulationCommand::MakeReset());
             rPressed = true;
         }
     } else {
@@ -142,7 +140,7 @@ void Application::ProcessInput()
     static bool aPressed = false;
     if (glfwGetKey(m_Window, GLFW_KEY_A) == GLFW_PRESS) {
         if (!aPressed) {
-            m_Simulation->AddRandomPlanet();
+            m_SimulationThread->Post(SimulationCommand::MakeAddRandomPlanet());
             aPressed = true;
         }
     } else {
@@ -150,13 +148,28 @@ void Application::ProcessInput()
     }
 }
 
-void Application::Update(float deltaTime)
+void Application::UpdatePlayback()
 {
-    if (!m_PauseSimulation)
+    const double now = glfwGetTime();
+    const double realDelta = m_PlaybackClock > 0.0 ? now - m_PlaybackClock : 0.0;
+    m_PlaybackClock = now;
+
+    if (m_PlaybackPlaying)
     {
-        float scaledDeltaTime = deltaTime * m_TimeScale;
-        m_Simulation->Update(scaledDeltaTime, m_GravityStrength);
+        m_PlaybackTime += realDelta * m_PlaybackSpeed;
+        if (m_PlaybackTime >= m_Playback.GetEndTime())
+        {
+            m_PlaybackTime = m_Playback.GetEndTime();
+            m_PlaybackPlaying = false;
+        }
     }
+
+    if (m_PlaybackTime == m_PlaybackPublished)
+        return;
+
+    std::unique_lock<std::mutex> simulationLock = m_SimulationThread->Lock();
+    m_Simulation->PublishPlayback(m_Playback, m_PlaybackTime);
+    m_PlaybackPublished = m_PlaybackTime;
 }
 
 void Application::Render()
@@ -182,7 +195,9 @@ void Application::Render()
         100.0f
     );
     
-    m_Simulation->Render(view, projection);
+    if (m_Playback.IsOpen())
+        UpdatePlayback();
+    m_Simulation->Render(view, projection, m_InterpolateRendering);
 }
 
 void Application::RenderUI()
@@ -192,44 +207,578 @@ void Application::RenderUI()
     ImGui::NewFrame();
     
     ImGui::Begin("Simulation Controls");
+    
+    const SimulationStatus& status = m_SimulationThread->AcquireStatus();
 
     if (ImGui::CollapsingHeader("Simulation Status", ImGuiTreeNodeFlags_DefaultOpen))
     {
-        ImGui::Text("Bodies: %zu", m_Simulation->GetBodyCount());
+        ImGui::Text("Bodies: %zu", status.bodyCount);
+        
+        bool paused = m_SimulationThread->IsPaused();
+        if (ImGui::Checkbox("Pause Simulation", &paused))
+            m_SimulationThread->SetPaused(paused);
         
-        ImGui::Checkbox("Pause Simulation", &m_PauseSimulation);
+        bool collisions = status.collisionsEnabled;
+        if (ImGui::Checkbox("Collisions", &collisions))
+            m_SimulationThread->Post(SimulationCommand::MakeSetParameter(SimulationParameter::CollisionsEnabled, static_cast<uint64_t>(collisions)));
         
         if (ImGui::Button("Reset Simulation"))
         {
-            m_Simulation->Reset();
+            m_SimulationThread->Post(SimulationCommand::MakeReset());
+        }
+        
+        ImGui::Separator();
+        
+        const char* sceneNames[] = { "Solar System", "Plummer Sphere", "Hernquist Halo", "Disk Galaxy", "Asteroid Belt", "Cluster In Galaxy" };
+        ImGui::Combo("Scene", &m_SceneIndex, sceneNames, IM_ARRAYSIZE(sceneNames));
+        if (m_SceneIndex != static_cast<int>(Scene::SolarSystem))
+            ImGui::SliderInt("Scene Bodies", &m_SceneBodyCount, 100, 1000000, "%d", ImGuiSliderFlags_Logarithmic);
+        
+        if (ImGui::Button("Load Scene"))
+        {
+            m_SimulationThread->Post(SimulationCommand::MakeLoadScene(static_cast<uint32_t>(m_SceneIndex), static_cast<uint64_t>(m_SceneBodyCount), m_GravityStrength));
+        }
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Starts the scene in equilibrium for the current gravity strength");
+        
+        ImGui::Separator();
+        
+        ImGui::Text("Command Log");
+        ImGui::InputText("##CommandLog", m_CommandLogPath, sizeof(m_CommandLogPath));
+        if (status.recording)
+        {
+            if (ImGui::Button("Stop Recording"))
+                m_SimulationThread->Post(SimulationCommand::MakeStopRecording());
+        }
+        else if (ImGui::Button("Record"))
+        {
+            m_SimulationThread->Post(SimulationCommand::MakeStartRecording(m_CommandLogPath));
+        }
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Logs every command with the step it was applied at; load a scene first to make the log self-contained");
+        ImGui::SameLine();
+        if (status.replaying)
+        {
+            if (ImGui::Button("Stop Replay"))
+                m_SimulationThread->Post(SimulationCommand::MakeStopReplay());
+        }
+        else if (ImGui::Button("Replay"))
+        {
+            m_SimulationThread->Post(SimulationCommand::MakeStartReplay(m_CommandLogPath));
+        }
+
+        ImGui::Separator();
+
+        ImGui::Text("Checkpoint");
+        bool autosaveChanged = ImGui::InputText("##Checkpoint", m_CheckpointPath, sizeof(m_CheckpointPath));
+        if (ImGui::Button("Save Checkpoint"))
+            m_SimulationThread->Post(SimulationCommand::MakeSaveCheckpoint(m_CheckpointPath));
+        ImGui::SameLine();
+        if (ImGui::Button("Load Checkpoint"))
+            m_SimulationThread->Post(SimulationCommand::MakeLoadCheckpoint(m_CheckpointPath));
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Continues the saved run with its scene and solver settings; the rewind history starts over");
+
+        autosaveChanged |= ImGui::Checkbox("Autosave", &m_Autosave);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Writes the checkpoint in the background while the simulation keeps stepping");
+        if (m_Autosave)
+        {
+            autosaveChanged |= ImGui::SliderInt("Autosave Steps", &m_AutosaveInterval, 10, 100000, "%d", ImGuiSliderFlags_Logarithmic);
+
+            int mode = static_cast<int>(status.checkpointMode);
+            const char* modeNames[] = { "Fork", "Thread" };
+            if (ImGui::Combo("Autosave Mode", &mode, modeNames, IM_ARRAYSIZE(modeNames)))
+                m_SimulationThread->Post(SimulationCommand::MakeSetCheckpointMode(static_cast<CheckpointMode>(mode)));
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Fork: a child process writes the pages it shares with the simulation copy-on-write\nThread: the state is copied and a writer thread saves the copy");
+
+            const AsyncCheckpointStats& stats = status.checkpointStats;
+            ImGui::Text("Pause: %.0f us, Write: %.0f ms", stats.pauseUs, stats.writeMs);
+            ImGui::Text("Saved: %llu, Skipped: %llu, Failed: %llu", static_cast<unsigned long long>(stats.completed),
+                        static_cast<unsigned long long>(stats.skipped), static_cast<unsigned long long>(stats.failed));
+        }
+        if (autosaveChanged)
+            m_SimulationThread->Post(SimulationCommand::MakeSetAutosave(m_Autosave ? static_cast<uint64_t>(m_AutosaveInterval) : 0, m_CheckpointPath));
+
+        ImGui::Separator();
+
+        ImGui::Text("Trajectory");
+        ImGui::InputText("##Trajectory", m_TrajectoryPath, sizeof(m_TrajectoryPath));
+        if (status.trajectoryOpen)
+        {
+            if (ImGui::Button("Stop Trajectory"))
+                m_SimulationThread->Post(SimulationCommand::MakeCloseTrajectory());
+
+            const TrajectoryStats& stats = status.trajectoryStats;
+            ImGui::Text("Frames: %llu, Dropped: %llu, %.1f MB", static_cast<unsigned long long>(stats.frames),
+                        static_cast<unsigned long long>(stats.dropped), stats.bytesWritten / (1024.0 * 1024.0));
+            ImGui::Text("Capture: %.2f ms", stats.captureMs);
+            if (stats.payloadBytes > 0)
+                ImGui::Text("Compression: %.1fx", static_cast<double>(stats.positionBytes) / static_cast<double>(stats.payloadBytes));
+        }
+        else
+        {
+            ImGui::SliderInt("Steps Per Frame", &m_TrajectoryInterval, 1, 1000, "%d", ImGuiSliderFlags_Logarithmic);
+            ImGui::Checkbox("Quantize", &m_TrajectoryQuantized);
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Rounds positions to a grid over each chunk's bounds and stores what motion does not predict");
+            if (m_TrajectoryQuantized)
+                ImGui::SliderFloat("Max Error", &m_TrajectoryError, 1.0e-6f, 1.0e-2f, "%.1e", ImGuiSliderFlags_Logarithmic);
+            if (ImGui::Button("Record Trajectory"))
+            {
+                TrajectorySettings settings;
+                settings.frameInterval = static_cast<uint32_t>(m_TrajectoryInterval);
+                settings.encoding = m_TrajectoryQuantized ? TrajectoryEncoding::Quantized : TrajectoryEncoding::Raw;
+                settings.quantizationError = m_TrajectoryError;
+                m_SimulationThread->Post(SimulationCommand::MakeOpenTrajectory(m_TrajectoryPath, settings));
+            }
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Writes every body's position in the background for offline analysis");
+        }
+
+        if (m_Playback.IsOpen())
+        {
+            ImGui::Text("Playback: %zu frames", m_Playback.GetFrameCount());
+            const double startTime = m_Playback.GetStartTime();
+            const double endTime = m_Playback.GetEndTime();
+            ImGui::SliderScalar("##PlaybackTime", ImGuiDataType_Double, &m_PlaybackTime, &startTime, &endTime, "t = %.3f");
+            if (ImGui::Button(m_PlaybackPlaying ? "Pause Playback" : "Play"))
+            {
+                if (!m_PlaybackPlaying && m_PlaybackTime >= endTime)
+                    m_PlaybackTime = startTime;
+                m_PlaybackPlaying = !m_PlaybackPlaying;
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Close Playback"))
+            {
+                m_Playback.Close();
+                m_SimulationThread->RequestRenderState();
+            }
+            ImGui::SliderFloat("Playback Speed", &m_PlaybackSpeed, 0.001f, 1000.0f, "%.3g", ImGuiSliderFlags_Logarithmic);
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Simulation time played per second");
+        }
+        else if (ImGui::Button("Play Trajectory") && m_Playback.Open(m_TrajectoryPath))
+        {
+            // The recording replaces the simulated bodies on screen until playback is closed.
+            m_SimulationThread->SetPaused(true);
+            m_PlaybackTime = m_Playback.GetStartTime();
+            m_PlaybackPublished = -1.0;
+            m_PlaybackPlaying = false;
+            m_PlaybackSpeed = static_cast<float>(std::max((m_Playback.GetEndTime() - m_PlaybackTime) / 20.0, 0.001));
         }
     }
     
     if (ImGui::CollapsingHeader("Simulation Parameters", ImGuiTreeNodeFlags_DefaultOpen))
     {
         ImGui::Text("Gravity Strength");
-        ImGui::SliderFloat("##GravityStrength", &m_GravityStrength, 0.0f, 5.0f, "%.2f");
+        if (ImGui::SliderFloat("##GravityStrength", &m_GravityStrength, 0.0f, 5.0f, "%.2f"))
+            m_SimulationThread->Post(SimulationCommand::MakeSetParameter(SimulationParameter::GravityStrength, m_GravityStrength));
         if (ImGui::IsItemHovered())
             ImGui::SetTooltip("Adjusts the strength of gravity in the simulation");
         
-        ImGui::Text("Time Scale");
-        ImGui::SliderFloat("##TimeScale", &m_TimeScale, 0.0f, 5.0f, "%.2f");
+        SchedulerSettings scheduler = status.schedulerSettings;
+        bool schedulerChanged = false;
+        const double minWarp = 0.01;
+        const double maxWarp = 1.0e6;
+        ImGui::Text("Time Warp");
+        schedulerChanged |= ImGui::SliderScalar("##TimeWarp", ImGuiDataType_Double, &scheduler.warp, &minWarp, &maxWarp, "%.3gx", ImGuiSliderFlags_Logarithmic);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Simulated seconds per real second");
+        
+        ImGui::Text("Max Substep");
+        schedulerChanged |= ImGui::SliderFloat("##MaxSubstep", &scheduler.maxSubstep, 0.0005f, 0.05f, "%.4f", ImGuiSliderFlags_Logarithmic);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Largest integration step; high warps run many of these per frame");
+        
+        ImGui::Text("Frame Budget (ms)");
+        schedulerChanged |= ImGui::SliderFloat("##FrameBudget", &scheduler.frameBudgetMs, 1.0f, 50.0f, "%.1f");
         if (ImGui::IsItemHovered())
-            ImGui::SetTooltip("Adjusts the speed of the simulation");
+            ImGui::SetTooltip("CPU time per frame the simulation may spend on substeps");
+        
+        if (schedulerChanged)
+            m_SimulationThread->Post(SimulationCommand::MakeSetSchedulerSettings(scheduler));
+        
+        ImGui::Checkbox("Interpolate Rendering", &m_InterpolateRendering);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Draws bodies between the last two substeps so motion stays smooth when the frame rate and physics rate differ");
+        
+        const SchedulerStats& schedulerStats = status.schedulerStats;
+        ImGui::Text("Achieved warp: %.3gx", schedulerStats.achievedWarp);
+        ImGui::Text("Substeps: %u x %.4f (%.3f ms each)", schedulerStats.substepsLastFrame, schedulerStats.substepSize, schedulerStats.averageSubstepMs);
+        if (schedulerStats.fallingBehind)
+            ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "Falling behind: %.3g s dropped", schedulerStats.droppedTime);
         
         if (ImGui::Button("Reset Parameters")) {
             m_GravityStrength = 1.0f;
-            m_TimeScale = 1.0f;
+            m_SimulationThread->Post(SimulationCommand::MakeSetParameter(SimulationParameter::GravityStrength, m_GravityStrength));
+            m_SimulationThread->Post(SimulationCommand::MakeSetSchedulerSettings(SchedulerSettings()));
         }
     }
     
+    if (ImGui::CollapsingHeader("Solver"))
+    {
+        SolverSettings settings = status.solverSettings;
+        bool changed = false;
+
+        const char* solverNames[] = { "Direct Sum", "Barnes-Hut", "Barnes-Hut (Group Walk)" };
+        int solverIndex = static_cast<int>(settings.type);
+        if (ImGui::Combo("Method", &solverIndex, solverNames, IM_ARRAYSIZE(solverNames)))
+        {
+            settings.type = static_cast<SolverType>(solverIndex);
+            changed = true;
+        }
+
+        if (settings.type != SolverType::DirectSum)
+        {
+            changed |= ImGui::SliderFloat("Opening Angle", &settings.openingAngle, 0.1f, 1.5f, "%.2f");
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Smaller values are more accurate but slower");
+
+            bool quadrupole = settings.expansionOrder >= 2;
+            if (ImGui::Checkbox("Quadrupole Moments", &quadrupole))
+            {
+                settings.expansionOrder = quadrupole ? 2 : 0;
+                changed = true;
+            }
+        }
+
+        if (changed)
+            m_SimulationThread->Post(SimulationCommand::MakeSetSolverSettings(settings));
+
+        AutotuneSettings autotune = status.autotuneSettings;
+        bool autotuneChanged = ImGui::Checkbox("Autotune", &autotune.enabled);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Times each method at startup and when the body count changes, and keeps the fastest within the error budget");
+        if (autotune.enabled)
+        {
+            autotuneChanged |= ImGui::SliderFloat("Force Error Tolerance", &autotune.forceErrorTolerance, 1e-5f, 1e-1f, "%.1e", ImGuiSliderFlags_Logarithmic);
+            if (ImGui::Button("Retune Now"))
+                m_SimulationThread->Post(SimulationCommand::MakeRequestAutotune());
+        }
+        if (autotuneChanged)
+            m_SimulationThread->Post(SimulationCommand::MakeSetAutotuneSettings(autotune));
+
+        if (status.hasAutotuneResult)
+        {
+            const AutotuneResult& result = status.autotuneResult;
+            ImGui::Text("Tuned for %zu bodies: %s, %u threads", result.bodyCount, GetSolverName(result.solver.type), result.threadCount);
+            ImGui::Text("Tuned step %.3f ms, error %.2e, %u trials in %.0f ms", result.stepMs, result.forceError, result.trialCount, result.tuningMs);
+        }
+
+        const SolverStats& stats = status.solverStats;
+        ImGui::Text("Force: %.3f ms", stats.forceMs);
+        if (settings.type != SolverType::DirectSum)
+        {
+            ImGui::Text("Tree maintenance: %.3f ms", stats.maintenanceMs);
+            ImGui::Text("Refits since rebuild: %u", stats.refitsSinceRebuild);
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Diagnostics"))
+    {
+        bool deterministic = status.reductionMode == ReductionMode::Deterministic;
+        if (ImGui::Checkbox("Deterministic Reductions", &deterministic))
+        {
+            const ReductionMode mode = deterministic ? ReductionMode::Deterministic : ReductionMode::Fast;
+            m_SimulationThread->Post(SimulationCommand::MakeSetParameter(SimulationParameter::ReductionMode, static_cast<uint64_t>(mode)));
+        }
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Sums give identical bits regardless of the thread count");
+
+        if (ImGui::Checkbox("Track Energy", &m_TrackEnergy))
+        {
+            m_SimulationThread->SetTrackEnergy(m_TrackEnergy);
+            m_ReferenceSerial = status.diagnosticsSerial;
+            m_ReferencePending = m_TrackEnergy;
+        }
+
+        if (m_ReferencePending && status.diagnosticsSerial > m_ReferenceSerial)
+        {
+            m_ReferenceEnergy = status.diagnostics.totalEnergy;
+            m_ReferencePending = false;
+        }
+
+        if (m_TrackEnergy && !m_ReferencePending)
+        {
+            const EnergyDiagnostics& diagnostics = status.diagnostics;
+            ImGui::Text("Kinetic: %.6g", diagnostics.kineticEnergy);
+            ImGui::Text("Potential: %.6g", diagnostics.potentialEnergy);
+            ImGui::Text("Total: %.9g", diagnostics.totalEnergy);
+            if (m_ReferenceEnergy != 0.0)
+                ImGui::Text("Relative drift: %.3e", (diagnostics.totalEnergy - m_ReferenceEnergy) / std::abs(m_ReferenceEnergy));
+            ImGui::Text("Angular momentum: %.6g", glm::length(diagnostics.angularMomentum));
+            ImGui::Text("Diagnostics: %.3f ms", diagnostics.elapsedMs);
+
+            if (ImGui::Button("Reset Drift"))
+                m_ReferenceEnergy = diagnostics.totalEnergy;
+        }
+    }
+
+    if (ImGui::CollapsingHeader("External Field"))
+    {
+        std::vector<PotentialComponent> components = status.externalPotentials;
+        bool fieldChanged = false;
+        int removed = -1;
+
+        for (size_t c = 0; c < components.size(); c++) {
+            PotentialComponent& component = components[c];
+            ImGui::PushID(static_cast<int>(c));
+            ImGui::Text("%s", GetPotentialName(component.type));
+            fieldChanged |= ImGui::SliderFloat("Mass", &component.mass, 0.0f, 50000.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+            fieldChanged |= ImGui::SliderFloat(component.type == PotentialType::RotatingBar ? "Half Length" : "Scale Radius",
+                                               &component.scaleRadius, 0.1f, 50.0f, "%.2f");
+            if (component.type != PotentialType::NFWHalo)
+                fieldChanged |= ImGui::SliderFloat(component.type == PotentialType::RotatingBar ? "Softening" : "Scale Height",
+                                                   &component.scaleHeight, 0.01f, 10.0f, "%.2f");
+            if (component.type == PotentialType::RotatingBar)
+                fieldChanged |= ImGui::SliderFloat("Pattern Speed", &component.patternSpeed, -5.0f, 5.0f, "%.3f");
+            if (ImGui::Button("Remove"))
+                removed = static_cast<int>(c);
+            ImGui::Separator();
+            ImGui::PopID();
+        }
+
+        if (removed >= 0)
+        {
+            components.erase(components.begin() + removed);
+            fieldChanged = true;
+        }
+
+        if (ImGui::Button("Add Halo"))
+        {
+            PotentialComponent component;
+            component.type = PotentialType::NFWHalo;
+            components.push_back(component);
+            fieldChanged = true;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Add Disk"))
+        {
+            PotentialComponent component;
+            component.type = PotentialType::MiyamotoNagaiDisk;
+            component.scaleRadius = 6.0f;
+            component.scaleHeight = 0.5f;
+            components.push_back(component);
+            fieldChanged = true;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Add Bar"))
+        {
+            PotentialComponent component;
+            component.type = PotentialType::RotatingBar;
+            component.scaleRadius = 4.0f;
+            component.patternSpeed = 1.0f;
+            components.push_back(component);
+            fieldChanged = true;
+        }
+
+        if (fieldChanged)
+            m_SimulationThread->Post(SimulationCommand::MakeSetExternalPotentials(components));
+    }
+
+    if (ImGui::CollapsingHeader("Encounters"))
+    {
+        EncounterSettings encounters = status.encounterSettings;
+        bool encountersChanged = ImGui::Checkbox("Catalog Encounters", &encounters.enabled);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Logs every approach closer than the threshold to a binary file");
+
+        ImGui::Text("Threshold");
+        encountersChanged |= ImGui::SliderFloat("##EncounterThreshold", &encounters.threshold, 0.01f, 5.0f, "%.3f", ImGuiSliderFlags_Logarithmic);
+
+        ImGui::Text("Log File");
+        ImGui::InputText("##EncounterLog", m_EncounterLogPath, sizeof(m_EncounterLogPath));
+        if (ImGui::IsItemDeactivatedAfterEdit())
+        {
+            encounters.logPath = m_EncounterLogPath;
+            encountersChanged = true;
+        }
+
+        if (encountersChanged)
+            m_SimulationThread->Post(SimulationCommand::MakeSetEncounterSettings(encounters));
+
+        const EncounterStats& stats = status.encounterStats;
+        ImGui::Text("Encounters: %llu", static_cast<unsigned long long>(stats.encounters));
+        ImGui::Text("Collisions: %llu", static_cast<unsigned long long>(stats.collisions));
+        ImGui::Text("Written: %llu, dropped: %llu", static_cast<unsigned long long>(status.encountersWritten),
+                    static_cast<unsigned long long>(stats.dropped));
+        ImGui::Text("Candidates: %u (%.3f ms)", stats.candidatePairs, stats.detectMs);
+    }
+
+    if (ImGui::CollapsingHeader("Orbital Elements"))
+    {
+        OrbitTrackerSettings orbits = status.orbitSettings;
+        bool orbitsChanged = ImGui::Checkbox("Track Orbits", &orbits.enabled);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Computes a, e, i, node, periapsis and mean anomaly of every body");
+
+        int interval = static_cast<int>(orbits.interval);
+        ImGui::Text("Interval (steps)");
+        if (ImGui::SliderInt("##OrbitInterval", &interval, 1, 200))
+        {
+            orbits.interval = static_cast<uint32_t>(interval);
+            orbitsChanged = true;
+        }
+
+        int primary = orbits.primary == InvalidBodyHandle ? -1 : static_cast<int>(orbits.primary);
+        ImGui::Text("Primary Handle");
+        if (ImGui::InputInt("##OrbitPrimary", &primary))
+        {
+            orbits.primary = primary < 0 ? InvalidBodyHandle : static_cast<BodyHandle>(primary);
+            orbitsChanged = true;
+        }
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("-1 uses the most massive body");
+
+        orbitsChanged |= ImGui::Checkbox("Stream to Disk", &orbits.streamToDisk);
+        ImGui::InputText("##OrbitLog", m_OrbitLogPath, sizeof(m_OrbitLogPath));
+        if (ImGui::IsItemDeactivatedAfterEdit())
+        {
+            orbits.logPath = m_OrbitLogPath;
+            orbitsChanged = true;
+        }
+
+        if (orbitsChanged)
+            m_SimulationThread->Post(SimulationCommand::MakeSetOrbitSettings(orbits));
+
+        const OrbitTrackerStats& stats = status.orbitStats;
+        ImGui::Text("Primary: %u, compute %.3f ms", stats.primary, stats.computeMs);
+        ImGui::Text("Snapshots: %llu, written: %llu, skipped: %llu", static_cast<unsigned long long>(stats.snapshots),
+                    static_cast<unsigned long long>(stats.written), static_cast<unsigned long long>(stats.skipped));
+
+        const std::vector<float>& eccentricity = status.eccentricity;
+        const std::vector<float>& semiMajorAxis = status.semiMajorAxis;
+        if (status.orbitElementsSnapshot != m_OrbitHistogramSnapshot)
+        {
+            m_OrbitHistogramSnapshot = status.orbitElementsSnapshot;
+
+            // Bound orbits only; the axis range stops at the 95th percentile so a few wide orbits don't flatten the plot.
+            std::vector<float> bound;
+            bound.reserve(semiMajorAxis.size());
+            for (size_t i = 0; i < semiMajorAxis.size(); i++) {
+                if (eccentricity[i] < 1.0f && semiMajorAxis[i] > 0.0f)
+                    bound.push_back(semiMajorAxis[i]);
+            }
+            m_SemiMajorAxisRange = 0.0f;
+            if (!bound.empty())
+            {
+                auto percentile = bound.begin() + bound.size() * 95 / 100;
+                std::nth_element(bound.begin(), percentile, bound.end());
+                m_SemiMajorAxisRange = *percentile;
+            }
+
+            constexpr size_t Bins = 40;
+            m_EccentricityHistogram.assign(Bins, 0.0f);
+            m_SemiMajorAxisHistogram.assign(Bins, 0.0f);
+            for (size_t i = 0; i < semiMajorAxis.size(); i++) {
+                const float e = eccentricity[i];
+                if (e < 1.0f)
+                    m_EccentricityHistogram[static_cast<size_t>(e * Bins)] += 1.0f;
+                const float a = semiMajorAxis[i];
+                if (e < 1.0f && a > 0.0f && a < m_SemiMajorAxisRange)
+                    m_SemiMajorAxisHistogram[static_cast<size_t>(a / m_SemiMajorAxisRange * Bins)] += 1.0f;
+            }
+        }
+
+        if (!m_EccentricityHistogram.empty())
+        {
+            ImGui::Text("Eccentricity (0 - 1)");
+            ImGui::PlotHistogram("##Eccentricity", m_EccentricityHistogram.data(), static_cast<int>(m_EccentricityHistogram.size()),
+                                 0, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+            ImGui::Text("Semi-major Axis (0 - %.2f)", m_SemiMajorAxisRange);
+            ImGui::PlotHistogram("##SemiMajorAxis", m_SemiMajorAxisHistogram.data(), static_cast<int>(m_SemiMajorAxisHistogram.size()),
+                                 0, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+        }
+    }
+
+    if (ImGui::CollapsingHeader("History"))
+    {
+        HistorySettings history = status.historySettings;
+        bool historyChanged = ImGui::Checkbox("Record History", &history.enabled);
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Keeps compressed snapshots to rewind to; loading a scene clears them");
+
+        int interval = static_cast<int>(history.interval);
+        ImGui::Text("Interval (steps)");
+        if (ImGui::SliderInt("##HistoryInterval", &interval, 1, 200))
+        {
+            history.interval = static_cast<uint32_t>(interval);
+            historyChanged = true;
+        }
+
+        int keyframeInterval = static_cast<int>(history.keyframeInterval);
+        ImGui::Text("Keyframe Interval (snapshots)");
+        if (ImGui::SliderInt("##HistoryKeyframes", &keyframeInterval, 1, 64))
+        {
+            history.keyframeInterval = static_cast<uint32_t>(keyframeInterval);
+            historyChanged = true;
+        }
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Longer runs of deltas compress better but take longer to restore");
+
+        int budget = static_cast<int>(history.memoryBudgetMB);
+        ImGui::Text("Memory Budget (MB)");
+        if (ImGui::SliderInt("##HistoryBudget", &budget, 16, 4096, "%d", ImGuiSliderFlags_Logarithmic))
+        {
+            history.memoryBudgetMB = static_cast<uint32_t>(budget);
+            historyChanged = true;
+        }
+
+        if (historyChanged)
+            m_SimulationThread->Post(SimulationCommand::MakeSetHistorySettings(history));
+
+        // The history guards its own entries, so the timeline is read from it directly.
+        const StateHistory& timeline = m_Simulation->GetHistory();
+        const HistoryStats stats = timeline.GetStats();
+        ImGui::Text("Snapshots: %zu, skipped: %llu", stats.entries, static_cast<unsigned long long>(stats.skipped));
+        ImGui::Text("Memory: %.1f MB (%.1fx)", stats.compressedBytes / (1024.0 * 1024.0),
+                    stats.compressedBytes > 0 ? static_cast<double>(stats.rawBytes) / stats.compressedBytes : 0.0);
+        ImGui::Text("Compress %.2f ms, restore %.2f ms", stats.compressMs, stats.restoreMs);
+
+        timeline.GetEntrySteps(m_HistorySteps);
+        if (!m_HistorySteps.empty())
+        {
+            const int last = static_cast<int>(m_HistorySteps.size()) - 1;
+            if (!m_ScrubbingHistory)
+                m_HistoryStep = m_HistorySteps.back();
+            // The slider works on positions; map the selected step to the nearest snapshot still kept.
+            int index = static_cast<int>(std::lower_bound(m_HistorySteps.begin(), m_HistorySteps.end(), m_HistoryStep) - m_HistorySteps.begin());
+            index = std::min(index, last);
+
+            ImGui::Text("Timeline (step %llu)", static_cast<unsigned long long>(m_HistorySteps[index]));
+            ImGui::SliderInt("##HistoryTimeline", &index, 0, last);
+            m_HistoryStep = m_HistorySteps[index];
+            if (ImGui::IsItemActivated())
+                m_SimulationThread->SetPaused(true);
+            m_ScrubbingHistory = ImGui::IsItemActive();
+            if (ImGui::IsItemDeactivatedAfterEdit())
+                m_SimulationThread->Post(SimulationCommand::MakeRestoreHistory(m_HistoryStep));
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Pauses and rewinds to the chosen snapshot on release; later snapshots are discarded");
+        }
+    }
+
     if (ImGui::CollapsingHeader("Add Planet", ImGuiTreeNodeFlags_DefaultOpen))
     {
         if (ImGui::Button("Add Random Planet"))
         {
-            m_Simulation->AddRandomPlanet();
+            m_SimulationThread->Post(SimulationCommand::MakeAddRandomPlanet());
+        }
+        
+        ImGui::SliderInt("Count", &m_SpawnCount, 1, 100000, "%d", ImGuiSliderFlags_Logarithmic);
+        if (ImGui::Button("Spawn Random Planets"))
+        {
+            m_SimulationThread->Post(SimulationCommand::MakeSpawnRandomPlanets(static_cast<uint64_t>(m_SpawnCount)));
         }
         
+        uint64_t seed = status.seed;
+        if (ImGui::InputScalar("Seed", ImGuiDataType_U64, &seed))
+            m_SimulationThread->Post(SimulationCommand::MakeSetParameter(SimulationParameter::Seed, seed));
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Random bodies are reproducible for a given seed");
+        
         ImGui::Separator();
         
         ImGui::Text("Custom Planet Parameters:");
@@ -250,12 +799,45 @@ void Application::RenderUI()
         
         if (ImGui::Button("Add Custom Planet"))
         {
-            m_Simulation->AddPlanetWithParams(
-                m_NewPlanetDistance,
-                m_NewPlanetAngle,
-                m_NewPlanetRadius,
-                m_NewPlanetColor
-            );
+            m_SimulationThread->Post(SimulationCommand::MakeAddPlanet(m_NewPlanetDistance, m_NewPlanetAngle, m_NewPlanetRadius, m_NewPlanetColor));
+        }
+    }
+    
+    if (ImGui::CollapsingHeader("Gas"))
+    {
+        ImGui::Text("Gas particles: %zu", status.gasParticleCount);
+        
+        ImGui::SliderInt("Particles", &m_GasParticleCount, 1000, 200000);
+        ImGui::SliderFloat("Disk Mass", &m_GasDiskMass, 0.1f, 50.0f, "%.1f");
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("Total gas mass of the disk (the sun has mass 1000)");
+        
+        if (ImGui::Button("Add Gas Disk"))
+        {
+            m_SimulationThread->Post(SimulationCommand::MakeAddGasDisk(static_cast<uint64_t>(m_GasParticleCount), 3.0f, 18.0f, m_GasDiskMass));
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Clear Gas"))
+        {
+            m_SimulationThread->Post(SimulationCommand::MakeClearGas());
+        }
+        
+        SPHSettings settings = status.gasSettings;
+        const char* kernelNames[] = { "Cubic Spline", "Wendland C2" };
+        int kernelIndex = static_cast<int>(settings.kernel);
+        bool changed = ImGui::Combo("Kernel", &kernelIndex, kernelNames, IM_ARRAYSIZE(kernelNames));
+        settings.kernel = static_cast<SPHKernel>(kernelIndex);
+        changed |= ImGui::SliderFloat("Viscosity Alpha", &settings.viscosityAlpha, 0.0f, 2.0f, "%.2f");
+        changed |= ImGui::Checkbox("Self Gravity", &settings.selfGravity);
+        if (changed)
+            m_SimulationThread->Post(SimulationCommand::MakeSetGasSettings(settings));
+        
+        if (status.gasParticleCount > 0)
+        {
+            const SPHStats& stats = status.gasStats;
+            ImGui::Text("Neighbors: %.1f avg, %llu rebuilds", stats.averageNeighbors, static_cast<unsigned long long>(stats.neighborRebuilds));
+            ImGui::Text("Density: %.2f ms  Forces: %.2f ms", stats.densityMs, stats.forceMs);
+            ImGui::Text("Neighbor lists: %.2f ms  Gravity: %.2f ms", stats.neighborMs, stats.gravityMs);
         }
     }
     
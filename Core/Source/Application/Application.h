@@ -6,6 +6,7 @@
 #include <Glad/gl.h>
 #include <GLFW/glfw3.h>
 #include "Simulation/GravitySimulation.h"
+#include "Simulation/SimulationThread.h"
 
 namespace SpaceSim {
 
@@ -21,9 +22,9 @@ private:
     void InitImGui();
     void Shutdown();
     void ProcessInput();
-    void Update(float deltaTime);
     void Render();
     void RenderUI();
+    void UpdatePlayback();
     
     void OnMouseMove(double xpos, double ypos);
     void OnMouseButton(int button, int action, int mods);
@@ -42,12 +43,45 @@ private:
     double m_LastMouseY = 0.0;
     
     float m_GravityStrength = 1.0f;
-    float m_TimeScale = 1.0f;
-    bool m_PauseSimulation = false;
     float m_NewPlanetDistance = 8.0f;
     float m_NewPlanetAngle = 0.0f;
     float m_NewPlanetRadius = 0.3f;
     glm::vec4 m_NewPlanetColor = glm::vec4(0.5f, 0.5f, 0.9f, 1.0f);
+    int m_SpawnCount = 1000;
+    int m_SceneIndex = 0;
+    int m_SceneBodyCount = 10000;
+    int m_GasParticleCount = 20000;
+    float m_GasDiskMass = 5.0f;
+    bool m_TrackEnergy = false;
+    double m_ReferenceEnergy = 0.0;
+    // The first diagnostics newer than this serial become the reference after tracking is turned on.
+    uint64_t m_ReferenceSerial = 0;
+    bool m_ReferencePending = false;
+    bool m_InterpolateRendering = true;
+    char m_CommandLogPath[256] = "commands.bin";
+    char m_CheckpointPath[256] = "checkpoint.ssc";
+    bool m_Autosave = false;
+    int m_AutosaveInterval = 1000;
+    char m_TrajectoryPath[256] = "trajectory.sst";
+    int m_TrajectoryInterval = 1;
+    bool m_TrajectoryQuantized = false;
+    float m_TrajectoryError = 1.0e-4f;
+    TrajectoryReader m_Playback;
+    double m_PlaybackTime = 0.0;
+    double m_PlaybackPublished = -1.0;
+    double m_PlaybackClock = 0.0;
+    float m_PlaybackSpeed = 1.0f;
+    bool m_PlaybackPlaying = false;
+    char m_EncounterLogPath[256] = "encounters.bin";
+    char m_OrbitLogPath[256] = "orbits.bin";
+    uint64_t m_OrbitHistogramSnapshot = 0;
+    std::vector<float> m_EccentricityHistogram;
+    std::vector<float> m_SemiMajorAxisHistogram;
+    float m_SemiMajorAxisRange = 0.0f;
+    // The timeline selection is kept as a step, so it stays on the same snapshot when older ones are dropped.
+    uint64_t m_HistoryStep = 0;
+    std::vector<uint64_t> m_HistorySteps;
+    bool m_ScrubbingHistory = false;
     
     struct CameraPreset {
         float distance;
@@ -58,6 +92,7 @@ private:
     std::vector<CameraPreset> m_CameraPresets;
     
     std::unique_ptr<GravitySimulation> m_Simulation;
+    std::unique_ptr<SimulationThread> m_SimulationThread;
     
     static void FramebufferSizeCallback(GLFWwindow* window, int width, int height);
     static void MouseMoveCallback(GLFWwindow* window, double xpos, double ypos);
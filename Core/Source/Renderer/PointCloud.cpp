@@ -0,0 +1,59 @@
+#include "PointCloud.h"
+
+namespace SpaceSim {
+
+PointCloud::PointCloud()
+    : m_VAO(0), m_VBO(0), m_Capacity(0)
+{
+    m_Shader = std::make_unique<Shader>();
+}
+
+PointCloud::~PointCloud()
+{
+    glDeleteVertexArrays(1, &m_VAO);
+    glDeleteBuffers(1, &m_VBO);
+}
+
+void PointCloud::Init()
+{
+    m_Shader->LoadFromFile("../Shaders/Particle.vert", "../Shaders/Particle.frag");
+    
+    glGenVertexArrays(1, &m_VAO);
+    glGenBuffers(1, &m_VBO);
+    
+    glBindVertexArray(m_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    
+    glBindVertexArray(0);
+}
+
+void PointCloud::Draw(const std::vector<glm::vec3>& positions, const glm::mat4& view, const glm::mat4& projection,
+                      const glm::vec4& color, float pointSize)
+{
+    if (positions.empty() || m_VAO == 0)
+        return;
+    
+    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+    if (positions.size() > m_Capacity)
+    {
+        m_Capacity = positions.size();
+        glBufferData(GL_ARRAY_BUFFER, m_Capacity * sizeof(glm::vec3), nullptr, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, positions.size() * sizeof(glm::vec3), positions.data());
+    
+    m_Shader->Bind();
+    m_Shader->SetMat4("u_View", view);
+    m_Shader->SetMat4("u_Projection", projection);
+    m_Shader->SetVec4("u_Color", color);
+    m_Shader->SetFloat("u_PointSize", pointSize);
+    
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glBindVertexArray(m_VAO);
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(positions.size()));
+    glBindVertexArray(0);
+}
+
+}
\ No newline at end of file
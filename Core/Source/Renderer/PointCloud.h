@@ -0,0 +1,30 @@
+#ifndef POINT_CLOUD_H
+#define POINT_CLOUD_H
+
+#include <memory>
+#include <vector>
+#include <Glad/gl.h>
+#include <glm/glm.hpp>
+#include "Shader.h"
+
+namespace SpaceSim {
+
+class PointCloud {
+public:
+    PointCloud();
+    ~PointCloud();
+    
+    void Init();
+    void Draw(const std::vector<glm::vec3>& positions, const glm::mat4& view, const glm::mat4& projection,
+              const glm::vec4& color, float pointSize);
+    
+private:
+    uint32_t m_VAO;
+    uint32_t m_VBO;
+    size_t m_Capacity;
+    std::unique_ptr<Shader> m_Shader;
+};
+
+}
+
+#endif
\ No newline at end of file
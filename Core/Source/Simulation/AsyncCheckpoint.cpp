@@ -0,0 +1,221 @@
+#include "AsyncCheckpoint.h"
+#include "GravitySimulation.h"
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace SpaceSim {
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+AsyncCheckpointer::~AsyncCheckpointer()
+{
+    Wait();
+    if (m_Writer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_StopWriter = true;
+        }
+        m_Condition.notify_one();
+        m_Writer.join();
+    }
+}
+
+void AsyncCheckpointer::SetMode(CheckpointMode mode)
+{
+    if (mode == m_Mode)
+        return;
+
+    Wait();
+    m_Mode = mode;
+}
+
+bool AsyncCheckpointer::Start(const GravitySimulation& simulation, const std::string& path)
+{
+    Poll();
+    auto start = std::chrono::steady_clock::now();
+    bool started = false;
+#ifndef _WIN32
+    if (m_Mode == CheckpointMode::Fork)
+        started = StartFork(simulation, path);
+    else
+#endif
+        started = StartThread(simulation, path);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (started)
+    {
+        m_Stats.started++;
+        m_Stats.pauseUs = ElapsedMs(start) * 1000.0;
+    }
+    else
+    {
+        m_Stats.skipped++;
+    }
+    return started;
+}
+
+bool AsyncCheckpointer::StartFork(const GravitySimulation& simulation, const std::string& path)
+{
+#ifdef _WIN32
+    return StartThread(simulation, path);
+#else
+    if (m_Child > 0)
+        return false;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_PendingReady || m_Writing)
+            return false;
+    }
+
+    // Only pointers into the simulation's arrays; the child sees them as they are at the fork.
+    simulation.PrepareCheckpoint(m_ForkCheckpoint.writer, m_ForkCheckpoint.parameters);
+    const pid_t child = fork();
+    if (child == 0)
+    {
+        // The child has only this thread, so it writes serially and leaves without running any destructors
+        // or exit handlers that belong to the parent.
+        const bool written = m_ForkCheckpoint.writer.Write(path, m_ForkCheckpoint.parameters, false);
+        _exit(written ? 0 : 1);
+    }
+
+    m_ForkCheckpoint.writer.Clear();
+    if (child < 0)
+    {
+        std::cerr << "fork() failed, writing the checkpoint from a thread instead" << std::endl;
+        return StartThread(simulation, path);
+    }
+
+    m_Child = child;
+    m_ChildStart = std::chrono::steady_clock::now();
+    return true;
+#endif
+}
+
+bool AsyncCheckpointer::StartThread(const GravitySimulation& simulation, const std::string& path)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_PendingReady || m_Child > 0)
+            return false;
+        if (!m_Writer.joinable())
+        {
+            m_StopWriter = false;
+            m_Writer = std::thread(&AsyncCheckpointer::WriterLoop, this);
+        }
+    }
+
+    // The writer only touches m_Pending after it is marked ready, so it is filled without the lock.
+    simulation.PrepareCheckpoint(m_Pending.writer, m_Pending.parameters);
+    m_Pending.writer.CopySections();
+    m_Pending.path = path;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_PendingReady = true;
+    }
+    m_Condition.notify_one();
+    return true;
+}
+
+void AsyncCheckpointer::Poll()
+{
+#ifndef _WIN32
+    if (m_Child <= 0)
+        return;
+
+    int status = 0;
+    if (waitpid(m_Child, &status, WNOHANG) == m_Child)
+        FinishChild(status);
+#endif
+}
+
+void AsyncCheckpointer::FinishChild(int status)
+{
+#ifndef _WIN32
+    const bool written = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (written)
+    {
+        m_Stats.completed++;
+        m_Stats.writeMs = ElapsedMs(m_ChildStart);
+    }
+    else
+    {
+        m_Stats.failed++;
+    }
+    m_Child = -1;
+#endif
+}
+
+void AsyncCheckpointer::Wait()
+{
+#ifndef _WIN32
+    if (m_Child > 0)
+    {
+        int status = 0;
+        if (waitpid(m_Child, &status, 0) == m_Child)
+            FinishChild(status);
+        else
+            m_Child = -1;
+    }
+#endif
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_IdleCondition.wait(lock, [this] { return !m_PendingReady && !m_Writing; });
+}
+
+bool AsyncCheckpointer::IsBusy() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Child > 0 || m_PendingReady || m_Writing;
+}
+
+AsyncCheckpointStats AsyncCheckpointer::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Stats;
+}
+
+void AsyncCheckpointer::WriterLoop()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (true)
+    {
+        m_Condition.wait(lock, [this] { return m_PendingReady || m_StopWriter; });
+        if (m_StopWriter)
+            break;
+
+        std::swap(m_Working, m_Pending);
+        m_PendingReady = false;
+        m_Writing = true;
+
+        lock.unlock();
+        auto start = std::chrono::steady_clock::now();
+        // Serial, so the simulation keeps the thread pool to itself.
+        const bool written = m_Working.writer.Write(m_Working.path, m_Working.parameters, false);
+        const double writeMs = ElapsedMs(start);
+        lock.lock();
+
+        m_Writing = false;
+        if (written)
+        {
+            m_Stats.completed++;
+            m_Stats.writeMs = writeMs;
+        }
+        else
+        {
+            m_Stats.failed++;
+        }
+        m_IdleCondition.notify_all();
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#ifndef ASYNC_CHECKPOINT_H
+#define ASYNC_CHECKPOINT_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Checkpoint.h"
+
+namespace SpaceSim {
+
+class GravitySimulation;
+
+enum class CheckpointMode {
+    Fork,
+    Thread
+};
+
+struct AsyncCheckpointStats {
+    uint64_t started = 0;
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+    uint64_t skipped = 0;
+    // Time the caller spent in the last Start(), and the time the last finished checkpoint took to write.
+    double pauseUs = 0.0;
+    double writeMs = 0.0;
+};
+
+// Writes checkpoints while the simulation keeps stepping. Fork mode forks the process and the child writes
+// the arrays it inherited, which copy-on-write keeps as they were at the fork while the parent steps on;
+// the caller only pays for the fork. Thread mode copies the sections into a pending buffer that a writer
+// thread swaps with the one it writes from, so the caller pays for one parallel copy. Fork mode runs as
+// thread mode where fork() is unavailable or fails. A checkpoint requested while the last one is still
+// waiting to be written, or while the other mode's writer is still running, is skipped.
+class AsyncCheckpointer {
+public:
+    AsyncCheckpointer() = default;
+    ~AsyncCheckpointer();
+    AsyncCheckpointer(const AsyncCheckpointer&) = delete;
+    AsyncCheckpointer& operator=(const AsyncCheckpointer&) = delete;
+
+    CheckpointMode GetMode() const { return m_Mode; }
+    // Waits for a checkpoint still being written the other way, so the two never write one path at once.
+    void SetMode(CheckpointMode mode);
+
+    // Call between steps, from the thread that steps the simulation.
+    bool Start(const GravitySimulation& simulation, const std::string& path);
+    // Reaps a finished child process. Call regularly in fork mode.
+    void Poll();
+    // Blocks until every started checkpoint is on disk.
+    void Wait();
+    bool IsBusy() const;
+    AsyncCheckpointStats GetStats() const;
+
+private:
+    struct PendingCheckpoint {
+        CheckpointWriter writer;
+        CheckpointParameters parameters;
+        std::string path;
+    };
+
+    bool StartFork(const GravitySimulation& simulation, const std::string& path);
+    bool StartThread(const GravitySimulation& simulation, const std::string& path);
+    void FinishChild(int status);
+    void WriterLoop();
+
+    CheckpointMode m_Mode = CheckpointMode::Fork;
+    int m_Child = -1;
+    std::chrono::steady_clock::time_point m_ChildStart;
+    PendingCheckpoint m_ForkCheckpoint;
+
+    std::thread m_Writer;
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    std::condition_variable m_IdleCondition;
+    bool m_StopWriter = false;
+    bool m_PendingReady = false;
+    bool m_Writing = false;
+    PendingCheckpoint m_Pending;
+    // Writer thread only.
+    PendingCheckpoint m_Working;
+
+    // Guarded by m_Mutex.
+    AsyncCheckpointStats m_Stats;
+};
+
+}
+
+#endif
\ No newline at end of file
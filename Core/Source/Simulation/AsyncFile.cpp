@@ -0,0 +1,369 @@
+#include "AsyncFile.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace SpaceSim {
+
+// Larger writes are split; io_uring lengths and Windows write sizes are 32-bit.
+constexpr uint64_t MaxWriteSize = 1ull << 30;
+
+AsyncFile::~AsyncFile()
+{
+    Close();
+}
+
+bool AsyncFile::IsOpen() const
+{
+#ifdef _WIN32
+    return m_File != nullptr;
+#else
+    return m_File >= 0;
+#endif
+}
+
+bool AsyncFile::Create(const std::string& path, uint32_t queueDepth, bool useRing)
+{
+    Close();
+    m_Path = path;
+    m_Failed = false;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        std::cerr << "Failed to create file: " << path << std::endl;
+        return false;
+    }
+    m_File = file;
+#else
+    m_File = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (m_File < 0)
+    {
+        std::cerr << "Failed to create file: " << path << std::endl;
+        return false;
+    }
+#endif
+
+    queueDepth = std::max(queueDepth, 1u);
+    m_Requests.assign(queueDepth, Request{});
+    m_FreeRequests.clear();
+    for (uint32_t i = queueDepth; i > 0; i--) {
+        m_FreeRequests.push_back(i - 1);
+    }
+    m_Finished.clear();
+    m_InFlight = 0;
+
+    if (useRing && !SetupRing(queueDepth))
+        std::cerr << "io_uring is unavailable, writing " << path << " with blocking writes" << std::endl;
+    return true;
+}
+
+void AsyncFile::Close()
+{
+    // A failed ring wait leaves nothing to wait on; tearing the ring down cancels what is left.
+    while (m_InFlight > 0) {
+        const uint32_t inFlight = m_InFlight;
+        Reap(true);
+        if (m_InFlight == inFlight && m_Failed)
+            break;
+    }
+    DestroyRing();
+
+#ifdef _WIN32
+    if (m_File)
+        CloseHandle(m_File);
+    m_File = nullptr;
+#else
+    if (m_File >= 0)
+        close(m_File);
+    m_File = -1;
+#endif
+    m_InFlight = 0;
+}
+
+bool AsyncFile::Write(const void* data, uint64_t size, uint64_t offset, uint64_t tag)
+{
+    if (m_Failed || !IsOpen())
+        return false;
+
+    if (size == 0 || !UsesRing())
+    {
+        if (size > 0 && !WriteBlocking(data, size, offset))
+        {
+            m_Failed = true;
+            return false;
+        }
+        m_Finished.push_back(tag);
+        return true;
+    }
+
+    while (m_FreeRequests.empty()) {
+        if (!Reap(true))
+            return false;
+    }
+
+    const uint32_t index = m_FreeRequests.back();
+    m_FreeRequests.pop_back();
+    m_Requests[index] = Request{ static_cast<const uint8_t*>(data), size, offset, tag };
+    m_InFlight++;
+    return Submit(index);
+}
+
+bool AsyncFile::Complete(std::vector<uint64_t>& tags, bool wait)
+{
+    if (UsesRing() && m_InFlight > 0)
+        Reap(wait);
+
+    tags.insert(tags.end(), m_Finished.begin(), m_Finished.end());
+    m_Finished.clear();
+    return !m_Failed;
+}
+
+bool AsyncFile::Sync()
+{
+    while (m_InFlight > 0) {
+        if (!Reap(true))
+            break;
+    }
+    if (m_Failed || !IsOpen())
+        return false;
+
+#ifdef _WIN32
+    const bool synced = FlushFileBuffers(m_File) != 0;
+#elif defined(__APPLE__)
+    const bool synced = fsync(m_File) == 0;
+#else
+    const bool synced = fdatasync(m_File) == 0;
+#endif
+    if (!synced)
+        std::cerr << "Failed to flush " << m_Path << std::endl;
+    return synced;
+}
+
+bool AsyncFile::WriteBlocking(const void* data, uint64_t size, uint64_t offset)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0)
+    {
+        const uint64_t length = std::min(size, MaxWriteSize);
+#ifdef _WIN32
+        OVERLAPPED position = {};
+        position.Offset = static_cast<DWORD>(offset);
+        position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD written = 0;
+        if (!WriteFile(m_File, bytes, static_cast<DWORD>(length), &written, &position) || written == 0)
+#else
+        const ssize_t written = pwrite(m_File, bytes, static_cast<size_t>(length), static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+#endif
+        {
+            std::cerr << "Failed to write " << length << " bytes at " << offset << " to " << m_Path << std::endl;
+            return false;
+        }
+        bytes += written;
+        offset += static_cast<uint64_t>(written);
+        size -= static_cast<uint64_t>(written);
+    }
+    return true;
+}
+
+#ifdef __linux__
+
+static int IoUringSetup(uint32_t entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int IoUringEnter(int ring, uint32_t submit, uint32_t minComplete, uint32_t flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, ring, submit, minComplete, flags, nullptr, 0));
+}
+
+bool AsyncFile::SetupRing(uint32_t queueDepth)
+{
+    io_uring_params params = {};
+    const int ring = IoUringSetup(queueDepth, &params);
+    if (ring < 0)
+        return false;
+
+    m_Ring = ring;
+    m_SqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    m_CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap)
+        m_SqRingSize = m_CqRingSize = std::max(m_SqRingSize, m_CqRingSize);
+
+    void* sqRing = mmap(nullptr, m_SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    m_SqRing = sqRing == MAP_FAILED ? nullptr : sqRing;
+    if (singleMap)
+    {
+        m_CqRing = m_SqRing;
+    }
+    else
+    {
+        void* cqRing = mmap(nullptr, m_CqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+        m_CqRing = cqRing == MAP_FAILED ? nullptr : cqRing;
+    }
+    m_SqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, m_SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+    m_Sqes = sqes == MAP_FAILED ? nullptr : sqes;
+    if (!m_SqRing || !m_CqRing || !m_Sqes)
+    {
+        DestroyRing();
+        return false;
+    }
+
+    uint8_t* sq = static_cast<uint8_t*>(m_SqRing);
+    m_SqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+    m_SqMask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+    m_SqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+    uint8_t* cq = static_cast<uint8_t*>(m_CqRing);
+    m_CqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+    m_CqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+    m_CqMask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+    m_Cqes = cq + params.cq_off.cqes;
+    return true;
+}
+
+void AsyncFile::DestroyRing()
+{
+    if (m_Sqes)
+        munmap(m_Sqes, m_SqesSize);
+    if (m_CqRing && m_CqRing != m_SqRing)
+        munmap(m_CqRing, m_CqRingSize);
+    if (m_SqRing)
+        munmap(m_SqRing, m_SqRingSize);
+    if (m_Ring >= 0)
+        close(m_Ring);
+    m_Sqes = m_CqRing = m_SqRing = nullptr;
+    m_Ring = -1;
+}
+
+bool AsyncFile::Submit(uint32_t request)
+{
+    const Request& pending = m_Requests[request];
+    // Only this thread moves the tail, so it is read plainly and published with a release store.
+    const uint32_t tail = *m_SqTail;
+    const uint32_t slot = tail & m_SqMask;
+    io_uring_sqe& sqe = static_cast<io_uring_sqe*>(m_Sqes)[slot];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_WRITE;
+    sqe.fd = m_File;
+    sqe.addr = reinterpret_cast<uint64_t>(pending.data);
+    sqe.len = static_cast<uint32_t>(std::min(pending.size, MaxWriteSize));
+    sqe.off = pending.offset;
+    sqe.user_data = request;
+    m_SqArray[slot] = slot;
+    std::atomic_ref<uint32_t>(*m_SqTail).store(tail + 1, std::memory_order_release);
+
+    while (IoUringEnter(m_Ring, 1, 0, 0) < 0) {
+        if (errno == EINTR)
+            continue;
+        if (errno == EAGAIN || errno == EBUSY)
+        {
+            // The kernel is short of resources or completions; drain some and retry.
+            if (!Reap(true))
+                return false;
+            continue;
+        }
+        std::cerr << "io_uring submit failed for " << m_Path << std::endl;
+        m_Failed = true;
+        return false;
+    }
+    return true;
+}
+
+bool AsyncFile::Reap(bool wait)
+{
+    uint32_t head = *m_CqHead;
+    uint32_t tail = std::atomic_ref<uint32_t>(*m_CqTail).load(std::memory_order_acquire);
+    while (head == tail && wait && m_InFlight > 0)
+    {
+        if (IoUringEnter(m_Ring, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+        {
+            std::cerr << "io_uring wait failed for " << m_Path << std::endl;
+            m_Failed = true;
+            return false;
+        }
+        tail = std::atomic_ref<uint32_t>(*m_CqTail).load(std::memory_order_acquire);
+    }
+
+    std::vector<uint32_t> resubmit;
+    for (; head != tail; head++) {
+        const io_uring_cqe& cqe = static_cast<const io_uring_cqe*>(m_Cqes)[head & m_CqMask];
+        const uint32_t index = static_cast<uint32_t>(cqe.user_data);
+        Request& request = m_Requests[index];
+        if (cqe.res <= 0)
+        {
+            std::cerr << "Failed to write " << request.size << " bytes at " << request.offset << " to " << m_Path
+                      << " (" << std::strerror(-cqe.res) << ")" << std::endl;
+            m_Failed = true;
+        }
+        else if (static_cast<uint64_t>(cqe.res) < request.size)
+        {
+            // Short or split write: queue the rest under the same entry.
+            request.data += cqe.res;
+            request.offset += static_cast<uint64_t>(cqe.res);
+            request.size -= static_cast<uint64_t>(cqe.res);
+            resubmit.push_back(index);
+            continue;
+        }
+        else
+        {
+            m_Finished.push_back(request.tag);
+        }
+        m_FreeRequests.push_back(index);
+        m_InFlight--;
+    }
+    std::atomic_ref<uint32_t>(*m_CqHead).store(head, std::memory_order_release);
+
+    for (uint32_t index : resubmit) {
+        if (!Submit(index))
+            return false;
+    }
+    return !m_Failed;
+}
+
+#else
+
+bool AsyncFile::SetupRing(uint32_t)
+{
+    return false;
+}
+
+void AsyncFile::DestroyRing()
+{
+}
+
+bool AsyncFile::Submit(uint32_t)
+{
+    return false;
+}
+
+bool AsyncFile::Reap(bool)
+{
+    return !m_Failed;
+}
+
+#endif
+
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef ASYNC_FILE_H
+#define ASYNC_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SpaceSim {
+
+// Write-only file with a queue of positioned writes in flight. On Linux the writes go through an io_uring
+// set up with raw system calls; elsewhere, or when the kernel refuses a ring, each write is a blocking
+// pwrite that completes before Write() returns. Buffers must stay untouched until their tag comes back
+// from Complete(). Not thread-safe: one thread queues and reaps.
+class AsyncFile {
+public:
+    AsyncFile() = default;
+    ~AsyncFile();
+    AsyncFile(const AsyncFile&) = delete;
+    AsyncFile& operator=(const AsyncFile&) = delete;
+
+    // Creates or truncates the file. queueDepth bounds the writes in flight.
+    bool Create(const std::string& path, uint32_t queueDepth = 32, bool useRing = true);
+    // Waits for every write in flight.
+    void Close();
+
+    // Waits for a free queue entry when the queue is full.
+    bool Write(const void* data, uint64_t size, uint64_t offset, uint64_t tag);
+    // Appends the tags of finished writes. With wait set, blocks until at least one finishes when any are in
+    // flight. Returns false once any write has failed.
+    bool Complete(std::vector<uint64_t>& tags, bool wait);
+    // Waits for every write in flight and flushes the file to disk.
+    bool Sync();
+
+    bool IsOpen() const;
+    bool UsesRing() const { return m_Ring >= 0; }
+    uint32_t GetInFlight() const { return m_InFlight; }
+    bool HasFailed() const { return m_Failed; }
+
+private:
+    struct Request {
+        const uint8_t* data = nullptr;
+        uint64_t size = 0;
+        uint64_t offset = 0;
+        uint64_t tag = 0;
+    };
+
+    bool WriteBlocking(const void* data, uint64_t size, uint64_t offset);
+    bool SetupRing(uint32_t queueDepth);
+    void DestroyRing();
+    bool Submit(uint32_t request);
+    bool Reap(bool wait);
+
+    std::string m_Path;
+    std::vector<Request> m_Requests;
+    std::vector<uint32_t> m_FreeRequests;
+    std::vector<uint64_t> m_Finished;
+    uint32_t m_InFlight = 0;
+    bool m_Failed = false;
+#ifdef _WIN32
+    void* m_File = nullptr;
+#else
+    int m_File = -1;
+#endif
+
+    // io_uring state; m_Ring stays -1 without one.
+    int m_Ring = -1;
+    void* m_SqRing = nullptr;
+    size_t m_SqRingSize = 0;
+    void* m_CqRing = nullptr;
+    size_t m_CqRingSize = 0;
+    void* m_Sqes = nullptr;
+    size_t m_SqesSize = 0;
+    uint32_t* m_SqTail = nullptr;
+    uint32_t m_SqMask = 0;
+    uint32_t* m_SqArray = nullptr;
+    uint32_t* m_CqHead = nullptr;
+    uint32_t* m_CqTail = nullptr;
+    uint32_t m_CqMask = 0;
+    void* m_Cqes = nullptr;
+};
+
+}
+
+#endif
\ No newline at end of file
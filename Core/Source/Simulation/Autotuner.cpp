@@ -0,0 +1,186 @@
+#include "Autotuner.h"
+#include "GravityKernels.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace SpaceSim {
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Autotuner::NeedsTuning(size_t bodyCount) const
+{
+    if (bodyCount < 2)
+        return false;
+    if (!m_HasResult)
+        return true;
+
+    double ratio = static_cast<double>(bodyCount) / static_cast<double>(std::max<size_t>(1, m_Result.bodyCount));
+    return ratio >= m_Settings.retuneFactor || ratio <= 1.0 / m_Settings.retuneFactor;
+}
+
+const AutotuneResult& Autotuner::Tune(const std::vector<glm::vec3>& positions, const std::vector<float>& masses,
+                                      const SpatialSort& sort, float gravityStrength, const SolverSettings& current)
+{
+    auto start = std::chrono::steady_clock::now();
+    const size_t count = positions.size();
+    ThreadPool& pool = ThreadPool::Get();
+    const uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    pool.SetThreadCount(maxThreads);
+
+    const size_t sampleCount = std::min<size_t>(m_Settings.errorSamples, count);
+    m_SampleIndices.resize(sampleCount);
+    for (size_t k = 0; k < sampleCount; k++) {
+        m_SampleIndices[k] = static_cast<uint32_t>(k * count / sampleCount);
+    }
+
+    m_ReferenceAccelerations.resize(sampleCount);
+    pool.ParallelFor(sampleCount, 4, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            const glm::dvec3 position(positions[m_SampleIndices[k]]);
+            glm::dvec3 acceleration(0.0);
+            for (size_t j = 0; j < count; j++) {
+                glm::dvec3 direction = glm::dvec3(positions[j]) - position;
+                double distanceSquared = glm::dot(direction, direction);
+
+                if (distanceSquared < MinInteractionDistanceSquared) continue;
+
+                acceleration += direction * (masses[j] / (distanceSquared * std::sqrt(distanceSquared)));
+            }
+            m_ReferenceAccelerations[k] = acceleration * static_cast<double>(gravityStrength);
+        }
+    });
+
+    SolverSettings best = current;
+    best.type = SolverType::DirectSum;
+    double bestMs = TimeDirectSum(positions, masses) / maxThreads;
+    float bestError = 0.0f;
+    uint32_t trials = 1;
+
+    // Each sweep goes from the widest opening angle down. Narrower angles are only more accurate and
+    // slower, so a sweep ends at the first angle within the error budget or the first one slower than
+    // the best candidate so far.
+    const float openingAngles[] = { 1.0f, 0.8f, 0.6f, 0.45f, 0.3f };
+    const int repeats = count < 20000 ? 3 : 1;
+    std::vector<glm::vec3> accelerations;
+
+    for (SolverType type : { SolverType::GroupWalk, SolverType::BarnesHut }) {
+        for (uint32_t order : { 2u, 0u }) {
+            GravitySolver solver;
+            SolverSettings settings = current;
+            settings.type = type;
+            settings.expansionOrder = order;
+            settings.openingAngle = openingAngles[0];
+            solver.SetSettings(settings);
+            solver.ComputeAccelerations(positions, masses, sort, gravityStrength, accelerations);
+
+            for (float openingAngle : openingAngles) {
+                settings.openingAngle = openingAngle;
+                solver.SetSettings(settings);
+
+                double ms = std::numeric_limits<double>::max();
+                for (int r = 0; r < repeats; r++) {
+                    solver.ComputeAccelerations(positions, masses, sort, gravityStrength, accelerations);
+                    ms = std::min(ms, solver.GetStats().maintenanceMs + solver.GetStats().forceMs);
+                }
+                trials++;
+
+                if (ms >= bestMs)
+                    break;
+
+                float error = MeasureError(accelerations);
+                if (error <= m_Settings.forceErrorTolerance)
+                {
+                    best = settings;
+                    bestMs = ms;
+                    bestError = error;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Small problems can lose more to dispatch than they gain from extra threads.
+    uint32_t bestThreads = maxThreads;
+    if (best.type != SolverType::DirectSum || count <= 20000)
+    {
+        GravitySolver solver;
+        solver.SetSettings(best);
+        for (uint32_t threads = maxThreads; threads > 0; threads /= 2) {
+            pool.SetThreadCount(threads);
+            solver.ComputeAccelerations(positions, masses, sort, gravityStrength, accelerations);
+
+            double ms = std::numeric_limits<double>::max();
+            for (int r = 0; r < repeats; r++) {
+                solver.ComputeAccelerations(positions, masses, sort, gravityStrength, accelerations);
+                ms = std::min(ms, solver.GetStats().maintenanceMs + solver.GetStats().forceMs);
+            }
+            trials++;
+
+            if (threads == maxThreads || ms < bestMs)
+            {
+                bestMs = ms;
+                bestThreads = threads;
+            }
+        }
+        pool.SetThreadCount(bestThreads);
+    }
+
+    m_Result.solver = best;
+    m_Result.threadCount = bestThreads;
+    m_Result.bodyCount = count;
+    m_Result.stepMs = bestMs;
+    m_Result.forceError = bestError;
+    m_Result.trialCount = trials;
+    m_Result.tuningMs = ElapsedMs(start);
+    m_HasResult = true;
+    return m_Result;
+}
+
+double Autotuner::TimeDirectSum(const std::vector<glm::vec3>& positions, const std::vector<float>& masses) const
+{
+    // Single-threaded cost of the sampled targets, scaled up to all bodies.
+    const size_t count = positions.size();
+    auto start = std::chrono::steady_clock::now();
+    glm::vec3 checksum(0.0f);
+    for (uint32_t i : m_SampleIndices) {
+        glm::vec3 acceleration(0.0f);
+        for (size_t j = 0; j < count; j++) {
+            glm::vec3 direction = positions[j] - positions[i];
+            float distanceSquared = glm::dot(direction, direction);
+
+            if (distanceSquared < MinInteractionDistanceSquared) continue;
+
+            float inverseDistance = 1.0f / std::sqrt(distanceSquared);
+            acceleration += direction * (masses[j] * inverseDistance * inverseDistance * inverseDistance);
+        }
+        checksum += acceleration;
+    }
+    volatile float sink = checksum.x;
+    (void)sink;
+
+    return ElapsedMs(start) * static_cast<double>(count) / static_cast<double>(std::max<size_t>(1, m_SampleIndices.size()));
+}
+
+float Autotuner::MeasureError(const std::vector<glm::vec3>& accelerations) const
+{
+    double sum = 0.0;
+    for (size_t k = 0; k < m_SampleIndices.size(); k++) {
+        const glm::dvec3& reference = m_ReferenceAccelerations[k];
+        double referenceSquared = glm::dot(reference, reference);
+        if (referenceSquared <= 0.0)
+            continue;
+
+        glm::dvec3 difference = glm::dvec3(accelerations[m_SampleIndices[k]]) - reference;
+        sum += glm::dot(difference, difference) / referenceSquared;
+    }
+    return static_cast<float>(std::sqrt(sum / static_cast<double>(std::max<size_t>(1, m_SampleIndices.size()))));
+}
+
+}
\ No newline at end of file
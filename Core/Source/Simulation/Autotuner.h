@@ -0,0 +1,58 @@
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "GravitySolver.h"
+#include "SpatialSort.h"
+
+namespace SpaceSim {
+
+struct AutotuneSettings {
+    bool enabled = false;
+    float forceErrorTolerance = 1e-3f;
+    float retuneFactor = 1.5f;
+    uint32_t errorSamples = 256;
+};
+
+struct AutotuneResult {
+    SolverSettings solver;
+    uint32_t threadCount = 1;
+    size_t bodyCount = 0;
+    double stepMs = 0.0;
+    float forceError = 0.0f;
+    uint32_t trialCount = 0;
+    double tuningMs = 0.0;
+};
+
+// Picks the gravity solver, opening angle, expansion order and thread count with the lowest measured
+// force time whose RMS relative acceleration error on a sample of bodies stays within the tolerance.
+// The error is measured against an exact direct sum over the sampled targets.
+class Autotuner {
+public:
+    bool NeedsTuning(size_t bodyCount) const;
+    const AutotuneResult& Tune(const std::vector<glm::vec3>& positions, const std::vector<float>& masses,
+                               const SpatialSort& sort, float gravityStrength, const SolverSettings& current);
+
+    const AutotuneSettings& GetSettings() const { return m_Settings; }
+    void SetSettings(const AutotuneSettings& settings) { m_Settings = settings; }
+    const AutotuneResult& GetResult() const { return m_Result; }
+    bool HasResult() const { return m_HasResult; }
+    void Invalidate() { m_HasResult = false; }
+
+private:
+    double TimeDirectSum(const std::vector<glm::vec3>& positions, const std::vector<float>& masses) const;
+    float MeasureError(const std::vector<glm::vec3>& accelerations) const;
+
+    AutotuneSettings m_Settings;
+    AutotuneResult m_Result;
+    bool m_HasResult = false;
+
+    std::vector<uint32_t> m_SampleIndices;
+    std::vector<glm::dvec3> m_ReferenceAccelerations;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef BODY_GENERATOR_H
+#define BODY_GENERATOR_H
+
+#include <cstddef>
+#include <functional>
+#include "CelestialBody.h"
+#include "Random.h"
+
+namespace SpaceSim {
+
+// Fills in one spawned body. index counts from 0 within the spawn call, random is that body's own stream.
+using BodyGenerator = std::function<void(size_t index, RandomStream& random, CelestialBody& body)>;
+
+}
+
+#endif
\ No newline at end of file
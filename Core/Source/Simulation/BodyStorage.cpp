@@ -0,0 +1,147 @@
+#include "BodyStorage.h"
+#include "ThreadPool.h"
+
+namespace SpaceSim {
+
+template<typename T>
+static void Gather(std::vector<T>& values, const std::vector<uint32_t>& order)
+{
+    std::vector<T> gathered(values.size());
+    ThreadPool::Get().ParallelFor(order.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            gathered[i] = values[order[i]];
+        }
+    });
+    values.swap(gathered);
+}
+
+BodyHandle BodyStorage::Add(const CelestialBody& body)
+{
+    size_t index = Append(1);
+    SetBody(index, body);
+    return m_Handles[index];
+}
+
+size_t BodyStorage::Append(size_t count)
+{
+    size_t first = Size();
+    size_t newSize = first + count;
+
+    m_Positions.resize(newSize, glm::vec3(0.0f));
+    m_Velocities.resize(newSize, glm::vec3(0.0f));
+    m_Masses.resize(newSize, 0.0f);
+    m_Radii.resize(newSize, 0.0f);
+    m_Colors.resize(newSize, glm::vec4(1.0f));
+    m_Handles.resize(newSize);
+
+    BodyHandle firstHandle = static_cast<BodyHandle>(m_HandleToIndex.size());
+    m_HandleToIndex.resize(m_HandleToIndex.size() + count);
+    for (size_t i = 0; i < count; i++) {
+        m_Handles[first + i] = firstHandle + static_cast<BodyHandle>(i);
+        m_HandleToIndex[firstHandle + i] = static_cast<uint32_t>(first + i);
+    }
+
+    return first;
+}
+
+void BodyStorage::Remove(BodyHandle handle)
+{
+    uint32_t index = IndexOf(handle);
+    if (index == InvalidBodyIndex)
+        return;
+
+    size_t last = Size() - 1;
+    if (index != last)
+    {
+        m_Positions[index] = m_Positions[last];
+        m_Velocities[index] = m_Velocities[last];
+        m_Masses[index] = m_Masses[last];
+        m_Radii[index] = m_Radii[last];
+        m_Colors[index] = m_Colors[last];
+        m_Handles[index] = m_Handles[last];
+        m_HandleToIndex[m_Handles[index]] = index;
+    }
+
+    m_Positions.pop_back();
+    m_Velocities.pop_back();
+    m_Masses.pop_back();
+    m_Radii.pop_back();
+    m_Colors.pop_back();
+    m_Handles.pop_back();
+    m_HandleToIndex[handle] = InvalidBodyIndex;
+}
+
+void BodyStorage::RestoreHandles(const std::vector<BodyHandle>& handles, size_t handleCapacity)
+{
+    if (handles.size() != Size())
+        return;
+
+    m_Handles = handles;
+    m_HandleToIndex.assign(handleCapacity, InvalidBodyIndex);
+    for (size_t i = 0; i < m_Handles.size(); i++) {
+        if (m_Handles[i] >= m_HandleToIndex.size())
+            m_HandleToIndex.resize(m_Handles[i] + 1, InvalidBodyIndex);
+        m_HandleToIndex[m_Handles[i]] = static_cast<uint32_t>(i);
+    }
+}
+
+void BodyStorage::Clear()
+{
+    m_Positions.clear();
+    m_Velocities.clear();
+    m_Masses.clear();
+    m_Radii.clear();
+    m_Colors.clear();
+    m_Handles.clear();
+    m_HandleToIndex.clear();
+}
+
+void BodyStorage::Reserve(size_t count)
+{
+    m_Positions.reserve(count);
+    m_Velocities.reserve(count);
+    m_Masses.reserve(count);
+    m_Radii.reserve(count);
+    m_Colors.reserve(count);
+    m_Handles.reserve(count);
+}
+
+void BodyStorage::Permute(const std::vector<uint32_t>& order)
+{
+    if (order.size() != Size())
+        return;
+
+    Gather(m_Positions, order);
+    Gather(m_Velocities, order);
+    Gather(m_Masses, order);
+    Gather(m_Radii, order);
+    Gather(m_Colors, order);
+    Gather(m_Handles, order);
+
+    for (size_t i = 0; i < m_Handles.size(); i++) {
+        m_HandleToIndex[m_Handles[i]] = static_cast<uint32_t>(i);
+    }
+}
+
+CelestialBody BodyStorage::GetBody(size_t index) const
+{
+    return CelestialBody{ m_Radii[index], m_Colors[index], m_Positions[index], m_Velocities[index], m_Masses[index] };
+}
+
+void BodyStorage::SetBody(size_t index, const CelestialBody& body)
+{
+    m_Positions[index] = body.position;
+    m_Velocities[index] = body.velocity;
+    m_Masses[index] = body.mass;
+    m_Radii[index] = body.radius;
+    m_Colors[index] = body.color;
+}
+
+uint32_t BodyStorage::IndexOf(BodyHandle handle) const
+{
+    if (handle >= m_HandleToIndex.size())
+        return InvalidBodyIndex;
+    return m_HandleToIndex[handle];
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#ifndef BODY_STORAGE_H
+#define BODY_STORAGE_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "CelestialBody.h"
+
+namespace SpaceSim {
+
+using BodyHandle = uint32_t;
+constexpr BodyHandle InvalidBodyHandle = 0xFFFFFFFFu;
+constexpr uint32_t InvalidBodyIndex = 0xFFFFFFFFu;
+
+// Structure-of-arrays body store. Indices change when bodies are removed or reordered,
+// handles stay valid for the lifetime of the body.
+class BodyStorage {
+public:
+    BodyHandle Add(const CelestialBody& body);
+    size_t Append(size_t count);
+    void Remove(BodyHandle handle);
+    void Clear();
+    void Reserve(size_t count);
+    void Permute(const std::vector<uint32_t>& order);
+
+    size_t Size() const { return m_Positions.size(); }
+    bool Empty() const { return m_Positions.empty(); }
+
+    CelestialBody GetBody(size_t index) const;
+    void SetBody(size_t index, const CelestialBody& body);
+    BodyHandle GetHandle(size_t index) const { return m_Handles[index]; }
+    uint32_t IndexOf(BodyHandle handle) const;
+
+    // Handles issued so far, including removed ones. Restoring a saved store needs it so new bodies
+    // never reuse a handle that was saved.
+    size_t GetHandleCapacity() const { return m_HandleToIndex.size(); }
+    // Index of every handle issued so far, InvalidBodyIndex for removed bodies.
+    const std::vector<uint32_t>& GetHandleIndices() const { return m_HandleToIndex; }
+    void RestoreHandles(const std::vector<BodyHandle>& handles, size_t handleCapacity);
+
+    std::vector<glm::vec3>& GetPositions() { return m_Positions; }
+    std::vector<glm::vec3>& GetVelocities() { return m_Velocities; }
+    std::vector<float>& GetMasses() { return m_Masses; }
+    std::vector<float>& GetRadii() { return m_Radii; }
+    std::vector<glm::vec4>& GetColors() { return m_Colors; }
+
+    const std::vector<glm::vec3>& GetPositions() const { return m_Positions; }
+    const std::vector<glm::vec3>& GetVelocities() const { return m_Velocities; }
+    const std::vector<float>& GetMasses() const { return m_Masses; }
+    const std::vector<float>& GetRadii() const { return m_Radii; }
+    const std::vector<glm::vec4>& GetColors() const { return m_Colors; }
+    const std::vector<BodyHandle>& GetHandles() const { return m_Handles; }
+
+private:
+    std::vector<glm::vec3> m_Positions;
+    std::vector<glm::vec3> m_Velocities;
+    std::vector<float> m_Masses;
+    std::vector<float> m_Radii;
+    std::vector<glm::vec4> m_Colors;
+    std::vector<BodyHandle> m_Handles;
+
+    std::vector<uint32_t> m_HandleToIndex;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "BroadPhase.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace SpaceSim {
+
+void BroadPhase::FindPairs(const SpatialSort& sort, const std::vector<glm::vec3>& positions,
+                           const std::vector<float>& radii, float margin)
+{
+    m_Pairs.clear();
+
+    const size_t count = sort.Size();
+    if (count < 2)
+        return;
+
+    const float boundsSize = sort.GetBounds().size;
+    const std::vector<uint64_t>& keys = sort.GetSortedKeys();
+    const std::vector<uint32_t>& indices = sort.GetSortedIndices();
+
+    ThreadPool& pool = ThreadPool::Get();
+    const uint32_t taskCount = static_cast<uint32_t>(std::clamp<size_t>(count / 2048, 1, pool.GetThreadCount() * 4));
+    m_TaskPairs.resize(taskCount);
+
+    pool.Dispatch(taskCount, [&](uint32_t task) {
+        std::vector<BodyPair>& pairs = m_TaskPairs[task];
+        pairs.clear();
+
+        size_t begin = count * task / taskCount;
+        size_t end = count * (task + 1) / taskCount;
+        for (size_t p = begin; p < end; p++) {
+            const uint32_t i = indices[p];
+            const float ownRadius = radii[i];
+
+            // Search the level whose cells are at least as wide as this body's reach, so the
+            // 3x3x3 block around it covers every smaller partner.
+            const float cellsAcross = boundsSize / std::max(2.0f * ownRadius + margin, 1e-6f);
+            const uint32_t level = cellsAcross < 2.0f ? 0u
+                : std::min(MortonBitsPerAxis, static_cast<uint32_t>(std::floor(std::log2(cellsAcross))));
+            const uint32_t cellShift = MortonBitsPerAxis - level;
+            const uint32_t keyShift = cellShift * 3;
+            const int32_t cellLimit = 1 << level;
+
+            const glm::ivec3 cell = glm::ivec3(DecodeMorton(keys[p]) >> cellShift);
+            const glm::ivec3 low = glm::max(cell - glm::ivec3(1), glm::ivec3(0));
+            const glm::ivec3 high = glm::min(cell + glm::ivec3(1), glm::ivec3(cellLimit - 1));
+
+            auto consider = [&](size_t q) {
+                const uint32_t j = indices[q];
+
+                // The larger body owns the pair; equal radii are split by sorted position.
+                if (radii[j] > ownRadius || (radii[j] == ownRadius && q <= p))
+                    return;
+
+                const float reachSum = ownRadius + radii[j] + margin;
+                glm::vec3 delta = positions[j] - positions[i];
+                if (glm::dot(delta, delta) < reachSum * reachSum)
+                    pairs.push_back({ i, j });
+            };
+
+            for (int32_t z = low.z; z <= high.z; z++) {
+                for (int32_t y = low.y; y <= high.y; y++) {
+                    for (int32_t x = low.x; x <= high.x; x++) {
+                        uint64_t neighborCell = EncodeMorton(x, y, z);
+                        auto first = std::lower_bound(keys.begin(), keys.end(), neighborCell << keyShift);
+                        for (auto it = first; it != keys.end() && (*it >> keyShift) == neighborCell; ++it) {
+                            consider(it - keys.begin());
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    for (const auto& pairs : m_TaskPairs) {
+        m_Pairs.insert(m_Pairs.end(), pairs.begin(), pairs.end());
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef BROAD_PHASE_H
+#define BROAD_PHASE_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "SpatialSort.h"
+
+namespace SpaceSim {
+
+struct BodyPair {
+    uint32_t first;
+    uint32_t second;
+};
+
+// Sphere-overlap candidates from the Morton-sorted keys. Each pair is reported by its larger body, which
+// searches the neighbouring cells at the grid level matching its own reach, so bodies of very different
+// sizes share one sorted key array without a single grid cell size.
+class BroadPhase {
+public:
+    void FindPairs(const SpatialSort& sort, const std::vector<glm::vec3>& positions,
+                   const std::vector<float>& radii, float margin = 0.0f);
+
+    const std::vector<BodyPair>& GetPairs() const { return m_Pairs; }
+
+private:
+    std::vector<BodyPair> m_Pairs;
+    std::vector<std::vector<BodyPair>> m_TaskPairs;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,362 @@
+#include "Checkpoint.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace SpaceSim {
+
+constexpr uint64_t HashPrime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t HashPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t HashPrime3 = 0x165667B19E3779F9ull;
+
+static std::atomic<uint64_t> s_TemporaryFiles{ 0 };
+
+static uint64_t RotateLeft(uint64_t value, uint32_t bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static uint64_t HashRound(uint64_t accumulator, uint64_t word)
+{
+    return RotateLeft(accumulator + word * HashPrime2, 31) * HashPrime1;
+}
+
+// Four independent multiply-rotate lanes over 32-byte stripes, in the style of xxHash64, so a block hashes
+// at close to memory bandwidth.
+static uint64_t HashBytes(const uint8_t* data, size_t size)
+{
+    uint64_t lanes[4] = { HashPrime1 + HashPrime2, HashPrime2, 0, 0 - HashPrime1 };
+    size_t offset = 0;
+    for (; offset + 32 <= size; offset += 32) {
+        uint64_t words[4];
+        std::memcpy(words, data + offset, sizeof(words));
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            lanes[lane] = HashRound(lanes[lane], words[lane]);
+        }
+    }
+
+    uint64_t hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+    hash += static_cast<uint64_t>(size);
+    for (; offset + 8 <= size; offset += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + offset, sizeof(word));
+        hash = RotateLeft(hash ^ HashRound(0, word), 27) * HashPrime1 + HashPrime3;
+    }
+    for (; offset < size; offset++) {
+        hash = RotateLeft(hash ^ (data[offset] * HashPrime3), 11) * HashPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= HashPrime2;
+    hash ^= hash >> 29;
+    hash *= HashPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static uint64_t AlignOffset(uint64_t offset)
+{
+    return (offset + CheckpointAlignment - 1) / CheckpointAlignment * CheckpointAlignment;
+}
+
+static uint64_t GetSectionBytes(const CheckpointSectionEntry& entry)
+{
+    return entry.count * entry.elementSize;
+}
+
+static uint64_t GetBlockCount(const CheckpointSectionEntry& entry)
+{
+    return (GetSectionBytes(entry) + CheckpointBlockSize - 1) / CheckpointBlockSize;
+}
+
+// Index of each section's first checksum block, with the total block count at the end.
+static std::vector<uint64_t> GetFirstBlocks(const std::vector<CheckpointSectionEntry>& entries)
+{
+    std::vector<uint64_t> firstBlocks(entries.size() + 1, 0);
+    for (size_t s = 0; s < entries.size(); s++) {
+        firstBlocks[s + 1] = firstBlocks[s] + GetBlockCount(entries[s]);
+    }
+    return firstBlocks;
+}
+
+// Runs visit(section, block, offset, size) for every block of every section, on the thread pool if parallel.
+template<typename Visit>
+static void ForEachBlock(const std::vector<CheckpointSectionEntry>& entries, const std::vector<uint64_t>& firstBlocks, const Visit& visit,
+                         bool parallel = true)
+{
+    auto visitRange = [&](size_t begin, size_t end) {
+        size_t section = std::upper_bound(firstBlocks.begin(), firstBlocks.end(), begin) - firstBlocks.begin() - 1;
+        for (size_t block = begin; block < end; block++) {
+            while (block >= firstBlocks[section + 1]) {
+                section++;
+            }
+            const uint64_t offset = (block - firstBlocks[section]) * CheckpointBlockSize;
+            const uint64_t size = std::min<uint64_t>(CheckpointBlockSize, GetSectionBytes(entries[section]) - offset);
+            visit(section, block, offset, size);
+        }
+    };
+
+    if (parallel)
+        ThreadPool::Get().ParallelFor(static_cast<size_t>(firstBlocks.back()), 1, visitRange);
+    else
+        visitRange(0, static_cast<size_t>(firstBlocks.back()));
+}
+
+// A section's checksum hashes its block hashes in order.
+static std::vector<uint64_t> FoldBlockHashes(const std::vector<uint64_t>& firstBlocks, const std::vector<uint64_t>& blockHashes)
+{
+    std::vector<uint64_t> checksums(firstBlocks.size() - 1);
+    for (size_t s = 0; s < checksums.size(); s++) {
+        const size_t blocks = static_cast<size_t>(firstBlocks[s + 1] - firstBlocks[s]);
+        checksums[s] = HashBytes(reinterpret_cast<const uint8_t*>(blockHashes.data() + firstBlocks[s]), blocks * sizeof(uint64_t));
+    }
+    return checksums;
+}
+
+static uint64_t HashHeader(const CheckpointHeader& header, const std::vector<CheckpointSectionEntry>& entries)
+{
+    std::vector<uint8_t> bytes(sizeof(CheckpointHeader) + entries.size() * sizeof(CheckpointSectionEntry));
+    CheckpointHeader copy = header;
+    copy.checksum = 0;
+    std::memcpy(bytes.data(), &copy, sizeof(copy));
+    if (!entries.empty())
+        std::memcpy(bytes.data() + sizeof(copy), entries.data(), entries.size() * sizeof(CheckpointSectionEntry));
+    return HashBytes(bytes.data(), bytes.size());
+}
+
+void CheckpointWriter::Clear()
+{
+    m_Sections.clear();
+}
+
+void CheckpointWriter::AddSection(CheckpointSection id, const void* data, uint32_t elementSize, uint64_t count)
+{
+    PendingSection section;
+    section.entry = { static_cast<uint32_t>(id), elementSize, count, 0, 0 };
+    section.data = data;
+    m_Sections.push_back(section);
+}
+
+void CheckpointWriter::CopySections()
+{
+    if (m_Buffers.size() < m_Sections.size())
+        m_Buffers.resize(m_Sections.size());
+
+    std::vector<CheckpointSectionEntry> entries;
+    for (size_t s = 0; s < m_Sections.size(); s++) {
+        m_Buffers[s].resize(static_cast<size_t>(GetSectionBytes(m_Sections[s].entry)));
+        entries.push_back(m_Sections[s].entry);
+    }
+
+    ForEachBlock(entries, GetFirstBlocks(entries), [&](size_t section, size_t, uint64_t offset, uint64_t size) {
+        std::memcpy(m_Buffers[section].data() + offset, static_cast<const uint8_t*>(m_Sections[section].data) + offset,
+                    static_cast<size_t>(size));
+    });
+    for (size_t s = 0; s < m_Sections.size(); s++) {
+        m_Sections[s].data = m_Buffers[s].data();
+    }
+}
+
+bool CheckpointWriter::Write(const std::string& path, const CheckpointParameters& parameters, bool parallel)
+{
+    std::vector<CheckpointSectionEntry> entries;
+    uint64_t offset = AlignOffset(sizeof(CheckpointHeader) + m_Sections.size() * sizeof(CheckpointSectionEntry));
+    uint64_t fileSize = offset;
+    for (PendingSection& section : m_Sections) {
+        section.entry.offset = offset;
+        fileSize = offset + GetSectionBytes(section.entry);
+        offset = AlignOffset(fileSize);
+        entries.push_back(section.entry);
+    }
+
+    // Every writer gets its own temporary file, so a forked child and a writer thread saving to the same path
+    // never write into one file; the last rename wins with a complete checkpoint.
+#ifdef _WIN32
+    const int processId = _getpid();
+#else
+    const int processId = static_cast<int>(getpid());
+#endif
+    const std::string temporaryPath = path + "." + std::to_string(processId) + "." + std::to_string(s_TemporaryFiles++) + ".tmp";
+    MappedFile file;
+    if (!file.Create(temporaryPath, fileSize))
+        return false;
+
+    // Blocks are copied and hashed while still in cache, and the page faults of the new file are spread over
+    // all threads.
+    uint8_t* base = file.GetData();
+    const std::vector<uint64_t> firstBlocks = GetFirstBlocks(entries);
+    std::vector<uint64_t> blockHashes(firstBlocks.back());
+    ForEachBlock(entries, firstBlocks, [&](size_t section, size_t block, uint64_t offset, uint64_t size) {
+        uint8_t* destination = base + entries[section].offset + offset;
+        std::memcpy(destination, static_cast<const uint8_t*>(m_Sections[section].data) + offset, static_cast<size_t>(size));
+        blockHashes[block] = HashBytes(destination, static_cast<size_t>(size));
+    }, parallel);
+
+    const std::vector<uint64_t> checksums = FoldBlockHashes(firstBlocks, blockHashes);
+    for (size_t s = 0; s < entries.size(); s++) {
+        entries[s].checksum = checksums[s];
+    }
+
+    CheckpointHeader header = {};
+    header.magic = CheckpointMagic;
+    header.version = CheckpointVersion;
+    header.headerSize = sizeof(CheckpointHeader);
+    header.sectionCount = static_cast<uint32_t>(entries.size());
+    header.blockSize = CheckpointBlockSize;
+    header.fileSize = fileSize;
+    header.parameters = parameters;
+    header.checksum = HashHeader(header, entries);
+
+    std::memcpy(base, &header, sizeof(header));
+    if (!entries.empty())
+        std::memcpy(base + sizeof(header), entries.data(), entries.size() * sizeof(CheckpointSectionEntry));
+
+    const bool flushed = file.Flush(0, fileSize, true);
+    file.Close();
+    std::error_code error;
+    if (!flushed)
+    {
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        std::cerr << "Failed to replace checkpoint " << path << ": " << error.message() << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
+
+bool CheckpointReader::Open(const std::string& path)
+{
+    Close();
+    if (!m_File.Open(path, MappedAccess::ReadOnly))
+        return false;
+
+    const uint64_t fileSize = m_File.GetSize();
+    if (fileSize < sizeof(CheckpointHeader))
+    {
+        std::cerr << "Checkpoint " << path << " is truncated" << std::endl;
+        Close();
+        return false;
+    }
+
+    std::memcpy(&m_Header, m_File.GetData(), sizeof(m_Header));
+    if (m_Header.magic != CheckpointMagic || m_Header.version != CheckpointVersion || m_Header.headerSize != sizeof(CheckpointHeader) ||
+        m_Header.blockSize != CheckpointBlockSize)
+    {
+        std::cerr << "Not a version " << CheckpointVersion << " checkpoint: " << path << std::endl;
+        Close();
+        return false;
+    }
+
+    const uint64_t tableEnd = sizeof(CheckpointHeader) + static_cast<uint64_t>(m_Header.sectionCount) * sizeof(CheckpointSectionEntry);
+    if (m_Header.fileSize != fileSize || tableEnd > fileSize)
+    {
+        std::cerr << "Checkpoint " << path << " is truncated" << std::endl;
+        Close();
+        return false;
+    }
+
+    m_Sections.resize(m_Header.sectionCount);
+    if (!m_Sections.empty())
+        std::memcpy(m_Sections.data(), m_File.GetData() + sizeof(CheckpointHeader), m_Sections.size() * sizeof(CheckpointSectionEntry));
+
+    bool valid = HashHeader(m_Header, m_Sections) == m_Header.checksum;
+    for (const CheckpointSectionEntry& entry : m_Sections) {
+        valid = valid && entry.elementSize > 0 && entry.offset >= tableEnd && entry.offset <= fileSize &&
+                entry.count <= (fileSize - entry.offset) / entry.elementSize;
+    }
+    if (!valid)
+    {
+        std::cerr << "Checkpoint " << path << " has a damaged header" << std::endl;
+        Close();
+        return false;
+    }
+
+    m_File.Advise(0, fileSize, MappedHint::Sequential);
+    return true;
+}
+
+bool CheckpointReader::Verify() const
+{
+    const uint8_t* base = m_File.GetData();
+    const std::vector<uint64_t> firstBlocks = GetFirstBlocks(m_Sections);
+    std::vector<uint64_t> blockHashes(firstBlocks.back());
+    ForEachBlock(m_Sections, firstBlocks, [&](size_t section, size_t block, uint64_t offset, uint64_t size) {
+        blockHashes[block] = HashBytes(base + m_Sections[section].offset + offset, static_cast<size_t>(size));
+    });
+
+    const std::vector<uint64_t> checksums = FoldBlockHashes(firstBlocks, blockHashes);
+    for (size_t s = 0; s < m_Sections.size(); s++) {
+        if (checksums[s] != m_Sections[s].checksum)
+        {
+            std::cerr << "Checkpoint " << m_File.GetPath() << ": section " << m_Sections[s].id << " fails its checksum" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void CheckpointReader::Close()
+{
+    m_File.Close();
+    m_Header = {};
+    m_Sections.clear();
+}
+
+const CheckpointSectionEntry* CheckpointReader::FindSection(CheckpointSection id) const
+{
+    for (const CheckpointSectionEntry& entry : m_Sections) {
+        if (entry.id == static_cast<uint32_t>(id))
+            return &entry;
+    }
+    return nullptr;
+}
+
+uint64_t CheckpointReader::GetSectionCount(CheckpointSection id) const
+{
+    const CheckpointSectionEntry* entry = FindSection(id);
+    return entry ? entry->count : 0;
+}
+
+uint32_t CheckpointReader::GetSectionElementSize(CheckpointSection id) const
+{
+    const CheckpointSectionEntry* entry = FindSection(id);
+    return entry ? entry->elementSize : 0;
+}
+
+bool CheckpointReader::ReadSection(CheckpointSection id, void* data, uint32_t elementSize, uint64_t count) const
+{
+    const CheckpointSectionEntry* entry = FindSection(id);
+    if (!entry || entry->elementSize != elementSize || entry->count != count)
+    {
+        std::cerr << "Checkpoint " << m_File.GetPath() << " has no section " << static_cast<uint32_t>(id) << " of "
+                  << count << " elements of " << elementSize << " bytes" << std::endl;
+        return false;
+    }
+
+    const uint8_t* source = m_File.GetData() + entry->offset;
+    const uint64_t bytes = GetSectionBytes(*entry);
+    ThreadPool::Get().ParallelFor(static_cast<size_t>((bytes + CheckpointBlockSize - 1) / CheckpointBlockSize), 1, [&](size_t begin, size_t end) {
+        const uint64_t first = begin * static_cast<uint64_t>(CheckpointBlockSize);
+        const uint64_t last = std::min<uint64_t>(end * static_cast<uint64_t>(CheckpointBlockSize), bytes);
+        std::memcpy(static_cast<uint8_t*>(data) + first, source + first, static_cast<size_t>(last - first));
+    });
+    return true;
+}
+
+}
\ No newline at end of file
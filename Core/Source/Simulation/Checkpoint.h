@@ -0,0 +1,147 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+namespace SpaceSim {
+
+// Checkpoint layout: CheckpointHeader, the section table, then every section at a page-aligned offset as
+// one tightly packed array. Sections are checksummed in fixed blocks so both ends can hash in parallel.
+// Readers skip section ids they do not know, so later versions can add sections without breaking old files.
+constexpr uint64_t CheckpointMagic = 0x54504B434D495353ull; // "SSIMCKPT"
+constexpr uint32_t CheckpointVersion = 1;
+constexpr uint32_t CheckpointAlignment = 4096;
+constexpr uint32_t CheckpointBlockSize = 1u << 20;
+
+enum class CheckpointSection : uint32_t {
+    Positions,
+    Velocities,
+    Masses,
+    Radii,
+    Colors,
+    Handles,
+    GasPositions,
+    GasVelocities,
+    GasMasses,
+    GasInternalEnergies,
+    GasSmoothingLengths,
+    ExternalPotentials
+};
+
+// Clocks and random streams followed by the settings needed to continue the run. Enums are stored as
+// their integer values.
+struct CheckpointParameters {
+    uint64_t stepCount = 0;
+    double simulationTime = 0.0;
+    uint64_t seed = 0;
+    uint64_t nextStream = 0;
+    uint64_t handleCapacity = 0;
+    uint64_t sceneBodyCount = 0;
+    float renderTime = 0.0f;
+    uint32_t sunHandle = 0;
+    uint32_t scene = 0;
+    float sceneGravityStrength = 1.0f;
+    uint32_t collisionsEnabled = 0;
+    uint32_t reorderInterval = 0;
+    uint32_t reductionMode = 0;
+    uint32_t solverType = 0;
+    float openingAngle = 0.0f;
+    uint32_t expansionOrder = 0;
+    uint32_t leafSize = 0;
+    float rebuildThreshold = 0.0f;
+};
+
+struct CheckpointHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t sectionCount;
+    uint32_t blockSize;
+    uint64_t fileSize;
+    // Covers the header with this field zeroed and the section table.
+    uint64_t checksum;
+    CheckpointParameters parameters;
+};
+
+struct CheckpointSectionEntry {
+    uint32_t id;
+    uint32_t elementSize;
+    uint64_t count;
+    uint64_t offset;
+    uint64_t checksum;
+};
+
+static_assert(sizeof(CheckpointParameters) == 96, "CheckpointParameters is written to checkpoints as is");
+static_assert(sizeof(CheckpointHeader) == 136, "CheckpointHeader is written to checkpoints as is");
+static_assert(sizeof(CheckpointSectionEntry) == 32, "CheckpointSectionEntry is written to checkpoints as is");
+
+// Collects sections that point at the caller's arrays and writes them in one pass: the file is mapped at
+// its final size and every block is copied and hashed, on the thread pool unless parallel is off. The file
+// is written next to the target and renamed over it once flushed, so a crash mid-save keeps the previous
+// checkpoint.
+class CheckpointWriter {
+public:
+    void Clear();
+    void AddSection(CheckpointSection id, const void* data, uint32_t elementSize, uint64_t count);
+
+    template<typename T>
+    void AddSection(CheckpointSection id, const std::vector<T>& data)
+    {
+        AddSection(id, data.data(), static_cast<uint32_t>(sizeof(T)), data.size());
+    }
+
+    // Copies the sections into buffers the writer owns, so the caller's arrays may change while Write() runs
+    // on another thread. The buffers are kept for the next checkpoint.
+    void CopySections();
+
+    bool Write(const std::string& path, const CheckpointParameters& parameters, bool parallel = true);
+
+private:
+    struct PendingSection {
+        CheckpointSectionEntry entry;
+        const void* data;
+    };
+
+    std::vector<PendingSection> m_Sections;
+    std::vector<std::vector<uint8_t>> m_Buffers;
+};
+
+// Maps a checkpoint and reads sections straight out of the page cache. Open() validates the header and
+// section table; Verify() hashes every section, so callers can reject a damaged file before touching
+// their own state.
+class CheckpointReader {
+public:
+    bool Open(const std::string& path);
+    bool Verify() const;
+    void Close();
+
+    const CheckpointParameters& GetParameters() const { return m_Header.parameters; }
+    bool HasSection(CheckpointSection id) const { return FindSection(id) != nullptr; }
+    uint64_t GetSectionCount(CheckpointSection id) const;
+    uint32_t GetSectionElementSize(CheckpointSection id) const;
+
+    // Copies count elements of a section into data. Fails when the section is missing or differs in element
+    // size or count; the vector overload resizes to the section first.
+    bool ReadSection(CheckpointSection id, void* data, uint32_t elementSize, uint64_t count) const;
+
+    template<typename T>
+    bool ReadSection(CheckpointSection id, std::vector<T>& data) const
+    {
+        data.resize(GetSectionCount(id));
+        return ReadSection(id, data.data(), static_cast<uint32_t>(sizeof(T)), data.size());
+    }
+
+private:
+    const CheckpointSectionEntry* FindSection(CheckpointSection id) const;
+
+    MappedFile m_File;
+    CheckpointHeader m_Header = {};
+    std::vector<CheckpointSectionEntry> m_Sections;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <glm/glm.hpp>
+
+namespace SpaceSim {
+
+struct EnergyDiagnostics {
+    double kineticEnergy = 0.0;
+    double potentialEnergy = 0.0;
+    double totalEnergy = 0.0;
+    glm::dvec3 momentum = glm::dvec3(0.0);
+    glm::dvec3 angularMomentum = glm::dvec3(0.0);
+    double elapsedMs = 0.0;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,383 @@
+#include "DistributedSimulation.h"
+
+#ifdef SPACESIM_MPI
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+
+namespace SpaceSim {
+
+// Cost histogram resolution along the Morton curve: 2^15 bins, five octree levels.
+constexpr uint32_t BalanceBits = 15;
+// Most boxes a rank publishes to describe its domain for the opening test.
+constexpr size_t MaxOutlineBoxes = 16;
+constexpr uint64_t MinStepsBetweenBalances = 2;
+
+struct BodyRecord {
+    glm::vec3 position;
+    float mass;
+    glm::vec3 velocity;
+    uint32_t padding;
+    uint64_t id;
+};
+
+// Morton-contiguous domains are compact but their single bounding box can span much of the volume,
+// so a domain is described by up to MaxOutlineBoxes of its top octree nodes instead.
+static void CollectOutline(const Octree& tree, std::vector<float>& boxes)
+{
+    boxes.clear();
+    if (!tree.IsBuilt())
+        return;
+
+    const std::vector<OctreeNode>& nodes = tree.GetNodes();
+    std::vector<uint32_t> level = { 0 };
+    std::vector<uint32_t> next;
+    while (true)
+    {
+        next.clear();
+        for (uint32_t index : level) {
+            const OctreeNode& node = nodes[index];
+            if (node.childCount == 0)
+            {
+                next.push_back(index);
+                continue;
+            }
+            for (uint32_t c = 0; c < node.childCount; c++) {
+                next.push_back(node.firstChild + c);
+            }
+        }
+        if (next.size() > MaxOutlineBoxes || next.size() == level.size())
+            break;
+        level.swap(next);
+    }
+
+    for (uint32_t index : level) {
+        const OctreeNode& node = nodes[index];
+        boxes.insert(boxes.end(), { node.boundsMin.x, node.boundsMin.y, node.boundsMin.z,
+                                    node.boundsMax.x, node.boundsMax.y, node.boundsMax.z });
+    }
+}
+
+static float DistanceToOutline(const glm::vec3& point, const float* boxes, int boxCount)
+{
+    float nearest = FLT_MAX;
+    for (int b = 0; b < boxCount; b++) {
+        const float* box = boxes + b * 6;
+        const glm::vec3 clamped = glm::clamp(point, glm::vec3(box[0], box[1], box[2]), glm::vec3(box[3], box[4], box[5]));
+        nearest = std::min(nearest, glm::length(point - clamped));
+    }
+    return nearest;
+}
+
+DistributedSimulation::DistributedSimulation(MPI_Comm communicator)
+    : m_Communicator(communicator)
+{
+    MPI_Comm_rank(m_Communicator, &m_Rank);
+    MPI_Comm_size(m_Communicator, &m_RankCount);
+    m_Solver.SetSettings(m_Settings.solver);
+}
+
+void DistributedSimulation::SetSettings(const DomainSettings& settings)
+{
+    m_Settings = settings;
+    m_Settings.balanceInterval = std::max(m_Settings.balanceInterval, 1u);
+    m_Solver.SetSettings(m_Settings.solver);
+}
+
+void DistributedSimulation::AddBodies(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& velocities,
+                                      const std::vector<float>& masses, const std::vector<uint64_t>& ids)
+{
+    m_Positions.insert(m_Positions.end(), positions.begin(), positions.end());
+    m_Velocities.insert(m_Velocities.end(), velocities.begin(), velocities.end());
+    m_Masses.insert(m_Masses.end(), masses.begin(), masses.end());
+    m_Ids.insert(m_Ids.end(), ids.begin(), ids.end());
+    m_Stats.localBodies = m_Positions.size();
+}
+
+uint64_t DistributedSimulation::GetGlobalBodyCount() const
+{
+    uint64_t local = m_Positions.size();
+    uint64_t global = 0;
+    MPI_Allreduce(&local, &global, 1, MPI_UINT64_T, MPI_SUM, m_Communicator);
+    return global;
+}
+
+void DistributedSimulation::Step(float deltaTime, float gravityStrength)
+{
+    ComputeAccelerations(gravityStrength);
+
+    glm::vec3* positions = m_Positions.data();
+    glm::vec3* velocities = m_Velocities.data();
+    ThreadPool::Get().ParallelFor(m_Positions.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            velocities[i] += m_Accelerations[i] * deltaTime;
+            positions[i] += velocities[i] * deltaTime;
+        }
+    });
+    m_StepCount++;
+
+    const double local = m_Stats.exchangeMs + m_Stats.forceMs;
+    double slowest = 0.0;
+    double total = 0.0;
+    MPI_Allreduce(&local, &slowest, 1, MPI_DOUBLE, MPI_MAX, m_Communicator);
+    MPI_Allreduce(&local, &total, 1, MPI_DOUBLE, MPI_SUM, m_Communicator);
+    m_Stats.imbalance = total > 0.0 ? static_cast<float>(slowest * m_RankCount / total) : 1.0f;
+
+    const uint64_t sinceBalance = m_StepCount - m_LastBalanceStep;
+    if (m_RankCount > 1 && (sinceBalance >= m_Settings.balanceInterval ||
+                            (sinceBalance >= MinStepsBetweenBalances && m_Stats.imbalance > m_Settings.imbalanceThreshold)))
+        Rebalance();
+}
+
+void DistributedSimulation::ComputeAccelerations(float gravityStrength)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    ExchangeEssentialTrees();
+    auto exchanged = std::chrono::high_resolution_clock::now();
+
+    const size_t count = m_Positions.size();
+    m_AllPositions.assign(m_Positions.begin(), m_Positions.end());
+    m_AllMasses.assign(m_Masses.begin(), m_Masses.end());
+    for (const glm::vec4& body : m_Imports) {
+        m_AllPositions.emplace_back(body.x, body.y, body.z);
+        m_AllMasses.push_back(body.w);
+    }
+
+    // The imported set changes every step, so the tree is rebuilt rather than refit. Imported bodies only
+    // act as sources.
+    m_Accelerations.resize(count);
+    if (!m_AllPositions.empty())
+    {
+        m_AllSort.Update(m_AllPositions);
+        m_Solver.Invalidate();
+        m_Solver.ComputeAccelerations(m_AllPositions, m_AllMasses, m_AllSort, gravityStrength, m_AllAccelerations, count);
+        std::copy(m_AllAccelerations.begin(), m_AllAccelerations.begin() + count, m_Accelerations.begin());
+    }
+
+    m_Stats.localBodies = count;
+    m_Stats.importedBodies = m_Imports.size();
+    m_Stats.exchangeMs = std::chrono::duration<double, std::milli>(exchanged - start).count();
+    m_Stats.forceMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - exchanged).count();
+}
+
+void DistributedSimulation::ExchangeEssentialTrees()
+{
+    const size_t count = m_Positions.size();
+    if (count > 0)
+    {
+        m_LocalSort.Update(m_Positions);
+        m_LocalTree.Build(m_LocalSort, m_Settings.exportLeafSize);
+        m_LocalTree.Refit(m_Positions, m_Masses);
+    }
+    else
+    {
+        m_LocalTree.Clear();
+    }
+
+    std::vector<float> outline;
+    CollectOutline(m_LocalTree, outline);
+    const int outlineFloats = static_cast<int>(outline.size());
+    std::vector<int> outlineCounts(m_RankCount);
+    std::vector<int> outlineOffsets(m_RankCount);
+    MPI_Allgather(&outlineFloats, 1, MPI_INT, outlineCounts.data(), 1, MPI_INT, m_Communicator);
+    int outlineTotal = 0;
+    for (int r = 0; r < m_RankCount; r++) {
+        outlineOffsets[r] = outlineTotal;
+        outlineTotal += outlineCounts[r];
+    }
+    std::vector<float> outlines(outlineTotal);
+    MPI_Allgatherv(outline.data(), outlineFloats, MPI_FLOAT, outlines.data(), outlineCounts.data(), outlineOffsets.data(),
+                   MPI_FLOAT, m_Communicator);
+
+    m_Exports.clear();
+    m_SendCounts.assign(m_RankCount, 0);
+    m_SendOffsets.assign(m_RankCount, 0);
+    const std::vector<OctreeNode>& nodes = m_LocalTree.GetNodes();
+    const std::vector<uint32_t>& bodyOrder = m_LocalTree.GetBodyOrder();
+    const float theta = m_Settings.exportOpeningAngle;
+    std::vector<uint32_t> stack;
+    for (int r = 0; r < m_RankCount; r++) {
+        m_SendOffsets[r] = static_cast<int>(m_Exports.size());
+        const int boxCount = outlineCounts[r] / 6;
+        if (r == m_Rank || boxCount == 0 || nodes.empty())
+            continue;
+
+        const float* boxes = outlines.data() + outlineOffsets[r];
+        stack.assign(1, 0);
+        while (!stack.empty())
+        {
+            const OctreeNode& node = nodes[stack.back()];
+            stack.pop_back();
+            if (node.mass <= 0.0f)
+                continue;
+
+            const glm::vec3 extent = node.boundsMax - node.boundsMin;
+            const float size = std::max(extent.x, std::max(extent.y, extent.z));
+            if (size < theta * DistanceToOutline(node.centerOfMass, boxes, boxCount))
+            {
+                m_Exports.emplace_back(node.centerOfMass, node.mass);
+            }
+            else if (node.childCount == 0)
+            {
+                for (uint32_t k = node.firstBody; k < node.firstBody + node.bodyCount; k++) {
+                    const uint32_t body = bodyOrder[k];
+                    m_Exports.emplace_back(m_Positions[body], m_Masses[body]);
+                }
+            }
+            else
+            {
+                for (uint32_t c = 0; c < node.childCount; c++) {
+                    stack.push_back(node.firstChild + c);
+                }
+            }
+        }
+        m_SendCounts[r] = static_cast<int>(m_Exports.size()) - m_SendOffsets[r];
+    }
+
+    m_ReceiveCounts.assign(m_RankCount, 0);
+    m_ReceiveOffsets.assign(m_RankCount, 0);
+    MPI_Alltoall(m_SendCounts.data(), 1, MPI_INT, m_ReceiveCounts.data(), 1, MPI_INT, m_Communicator);
+    int received = 0;
+    for (int r = 0; r < m_RankCount; r++) {
+        m_ReceiveOffsets[r] = received;
+        received += m_ReceiveCounts[r];
+    }
+
+    // Records travel as four floats each, so scale counts and offsets for MPI_FLOAT.
+    m_Imports.resize(received);
+    auto toFloats = [](std::vector<int>& values) {
+        for (int& value : values) {
+            value *= 4;
+        }
+    };
+    toFloats(m_SendCounts);
+    toFloats(m_SendOffsets);
+    toFloats(m_ReceiveCounts);
+    toFloats(m_ReceiveOffsets);
+    MPI_Alltoallv(m_Exports.data(), m_SendCounts.data(), m_SendOffsets.data(), MPI_FLOAT,
+                  m_Imports.data(), m_ReceiveCounts.data(), m_ReceiveOffsets.data(), MPI_FLOAT, m_Communicator);
+    m_Stats.exportedBodies = m_Exports.size();
+}
+
+void DistributedSimulation::Rebalance()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const size_t count = m_Positions.size();
+    // Lower corner and negated upper corner, so a single MPI_MIN reduction finds both.
+    float corners[6] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+    for (const glm::vec3& position : m_Positions) {
+        for (int axis = 0; axis < 3; axis++) {
+            corners[axis] = std::min(corners[axis], position[axis]);
+            corners[axis + 3] = std::min(corners[axis + 3], -position[axis]);
+        }
+    }
+    float global[6];
+    MPI_Allreduce(corners, global, 6, MPI_FLOAT, MPI_MIN, m_Communicator);
+    const glm::vec3 boundsMin(global[0], global[1], global[2]);
+    const glm::vec3 boundsMax(-global[3], -global[4], -global[5]);
+    if (boundsMin.x > boundsMax.x)
+        return;
+
+    const glm::vec3 extent = boundsMax - boundsMin;
+    const float size = std::max(extent.x, std::max(extent.y, extent.z)) * 1.0001f + 1e-6f;
+    const float cellsPerUnit = static_cast<float>(1u << MortonBitsPerAxis) / size;
+    const uint32_t maxCell = (1u << MortonBitsPerAxis) - 1;
+
+    // Every body on a rank is charged the same share of that rank's last force time; ranks that were
+    // slow hand out more of their bins until the measured cost evens out over successive balances.
+    const double costPerBody = count > 0 && m_Stats.forceMs > 0.0 ? m_Stats.forceMs / count : 1.0;
+    std::vector<uint32_t> bins(count);
+    m_CostHistogram.assign(size_t(1) << BalanceBits, 0.0);
+    for (size_t i = 0; i < count; i++) {
+        const glm::vec3 cell = (m_Positions[i] - boundsMin) * cellsPerUnit;
+        const uint64_t key = EncodeMorton(std::min(static_cast<uint32_t>(std::max(cell.x, 0.0f)), maxCell),
+                                          std::min(static_cast<uint32_t>(std::max(cell.y, 0.0f)), maxCell),
+                                          std::min(static_cast<uint32_t>(std::max(cell.z, 0.0f)), maxCell));
+        bins[i] = static_cast<uint32_t>(key >> (MortonKeyBits - BalanceBits));
+        m_CostHistogram[bins[i]] += costPerBody;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, m_CostHistogram.data(), static_cast<int>(m_CostHistogram.size()), MPI_DOUBLE, MPI_SUM, m_Communicator);
+
+    double total = 0.0;
+    for (double cost : m_CostHistogram) {
+        total += cost;
+    }
+
+    // Owner of a bin is the rank whose equal share of the total cost contains the bin's midpoint.
+    std::vector<int> binOwners(m_CostHistogram.size());
+    double cumulative = 0.0;
+    for (size_t b = 0; b < m_CostHistogram.size(); b++) {
+        const double midpoint = cumulative + 0.5 * m_CostHistogram[b];
+        binOwners[b] = std::min(m_RankCount - 1, static_cast<int>(midpoint / std::max(total, 1e-30) * m_RankCount));
+        cumulative += m_CostHistogram[b];
+    }
+
+    std::vector<int> owners(count);
+    for (size_t i = 0; i < count; i++) {
+        owners[i] = binOwners[bins[i]];
+    }
+    Migrate(owners);
+
+    m_LastBalanceStep = m_StepCount;
+    m_Stats.rebalances++;
+    m_Stats.balanceMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void DistributedSimulation::Migrate(const std::vector<int>& owners)
+{
+    const size_t count = m_Positions.size();
+    std::vector<int> sendCounts(m_RankCount, 0);
+    for (int owner : owners) {
+        sendCounts[owner]++;
+    }
+
+    std::vector<int> sendOffsets(m_RankCount, 0);
+    for (int r = 1; r < m_RankCount; r++) {
+        sendOffsets[r] = sendOffsets[r - 1] + sendCounts[r - 1];
+    }
+
+    std::vector<BodyRecord> outgoing(count);
+    std::vector<int> cursor = sendOffsets;
+    for (size_t i = 0; i < count; i++) {
+        outgoing[cursor[owners[i]]++] = BodyRecord{ m_Positions[i], m_Masses[i], m_Velocities[i], 0, m_Ids[i] };
+    }
+    m_Stats.migratedBodies = count - static_cast<size_t>(sendCounts[m_Rank]);
+
+    std::vector<int> receiveCounts(m_RankCount, 0);
+    MPI_Alltoall(sendCounts.data(), 1, MPI_INT, receiveCounts.data(), 1, MPI_INT, m_Communicator);
+    std::vector<int> receiveOffsets(m_RankCount, 0);
+    int received = 0;
+    for (int r = 0; r < m_RankCount; r++) {
+        receiveOffsets[r] = received;
+        received += receiveCounts[r];
+    }
+
+    // One contiguous MPI type per record keeps the counts in records rather than bytes.
+    MPI_Datatype recordType;
+    MPI_Type_contiguous(sizeof(BodyRecord), MPI_BYTE, &recordType);
+    MPI_Type_commit(&recordType);
+    std::vector<BodyRecord> incoming(received);
+    MPI_Alltoallv(outgoing.data(), sendCounts.data(), sendOffsets.data(), recordType,
+                  incoming.data(), receiveCounts.data(), receiveOffsets.data(), recordType, m_Communicator);
+    MPI_Type_free(&recordType);
+
+    m_Positions.resize(received);
+    m_Velocities.resize(received);
+    m_Masses.resize(received);
+    m_Ids.resize(received);
+    for (int i = 0; i < received; i++) {
+        m_Positions[i] = incoming[i].position;
+        m_Velocities[i] = incoming[i].velocity;
+        m_Masses[i] = incoming[i].mass;
+        m_Ids[i] = incoming[i].id;
+    }
+    m_Accelerations.clear();
+    m_Stats.localBodies = m_Positions.size();
+}
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,113 @@
+#ifndef DISTRIBUTED_SIMULATION_H
+#define DISTRIBUTED_SIMULATION_H
+
+#ifdef SPACESIM_MPI
+
+#include <mpi.h>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "GravitySolver.h"
+#include "Octree.h"
+#include "SpatialSort.h"
+
+namespace SpaceSim {
+
+struct DomainSettings {
+    SolverSettings solver = { SolverType::BarnesHut };
+    // Opening angle for the nodes sent to other ranks, measured from the nearest point of their domain.
+    float exportOpeningAngle = 0.5f;
+    uint32_t exportLeafSize = 16;
+    uint32_t balanceInterval = 16;
+    // Rebalances early when the slowest rank's step takes this many times the mean.
+    float imbalanceThreshold = 1.25f;
+};
+
+struct DomainStats {
+    size_t localBodies = 0;
+    size_t importedBodies = 0;
+    size_t exportedBodies = 0;
+    size_t migratedBodies = 0;
+    uint64_t rebalances = 0;
+    float imbalance = 1.0f;
+    double exchangeMs = 0.0;
+    double forceMs = 0.0;
+    double balanceMs = 0.0;
+};
+
+// One N-body run spread over the ranks of an MPI communicator. Each rank owns a contiguous range of a
+// Morton curve over the global bounds, sized so every range carries an equal share of the measured force
+// cost. The ranges are recomputed every balanceInterval steps, or sooner when the ranks drift out of
+// balance, and bodies migrate to their new owners. For forces, every rank sends every other rank its
+// locally essential tree: octree nodes that pass the opening criterion from the receiver's domain box go
+// as pseudo-bodies at their centre of mass, the bodies of leaves that don't go as they are. The local
+// solver then runs over own and imported bodies, and only own bodies are integrated.
+class DistributedSimulation {
+public:
+    explicit DistributedSimulation(MPI_Comm communicator);
+
+    int GetRank() const { return m_Rank; }
+    int GetRankCount() const { return m_RankCount; }
+
+    // Adds bodies owned by this rank. Ids must be unique across all ranks.
+    void AddBodies(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& velocities,
+                   const std::vector<float>& masses, const std::vector<uint64_t>& ids);
+
+    // Forces, then the same kick-drift update as GravitySimulation. Collective over the communicator.
+    void Step(float deltaTime, float gravityStrength);
+    void ComputeAccelerations(float gravityStrength);
+    void Rebalance();
+
+    size_t GetLocalBodyCount() const { return m_Positions.size(); }
+    uint64_t GetGlobalBodyCount() const;
+    uint64_t GetStepCount() const { return m_StepCount; }
+    const std::vector<glm::vec3>& GetPositions() const { return m_Positions; }
+    const std::vector<glm::vec3>& GetVelocities() const { return m_Velocities; }
+    const std::vector<float>& GetMasses() const { return m_Masses; }
+    const std::vector<uint64_t>& GetIds() const { return m_Ids; }
+    const std::vector<glm::vec3>& GetAccelerations() const { return m_Accelerations; }
+
+    const DomainSettings& GetSettings() const { return m_Settings; }
+    void SetSettings(const DomainSettings& settings);
+    const DomainStats& GetStats() const { return m_Stats; }
+
+private:
+    void ExchangeEssentialTrees();
+    void Migrate(const std::vector<int>& owners);
+
+    MPI_Comm m_Communicator;
+    int m_Rank = 0;
+    int m_RankCount = 1;
+    DomainSettings m_Settings;
+    DomainStats m_Stats;
+    uint64_t m_StepCount = 0;
+    uint64_t m_LastBalanceStep = 0;
+
+    std::vector<glm::vec3> m_Positions;
+    std::vector<glm::vec3> m_Velocities;
+    std::vector<float> m_Masses;
+    std::vector<uint64_t> m_Ids;
+    std::vector<glm::vec3> m_Accelerations;
+
+    SpatialSort m_LocalSort;
+    Octree m_LocalTree;
+    std::vector<glm::vec4> m_Exports;
+    std::vector<glm::vec4> m_Imports;
+    std::vector<int> m_SendCounts;
+    std::vector<int> m_SendOffsets;
+    std::vector<int> m_ReceiveCounts;
+    std::vector<int> m_ReceiveOffsets;
+
+    std::vector<glm::vec3> m_AllPositions;
+    std::vector<float> m_AllMasses;
+    std::vector<glm::vec3> m_AllAccelerations;
+    SpatialSort m_AllSort;
+    GravitySolver m_Solver;
+    std::vector<double> m_CostHistogram;
+};
+
+}
+
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "EncounterCatalog.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace SpaceSim {
+
+EncounterCatalog::~EncounterCatalog()
+{
+    CloseLog();
+}
+
+void EncounterCatalog::SetSettings(const EncounterSettings& settings)
+{
+    bool reopen = settings.enabled != m_Settings.enabled || settings.logPath != m_Settings.logPath;
+    m_Settings = settings;
+
+    if (reopen)
+    {
+        CloseLog();
+        if (m_Settings.enabled && !m_Settings.logPath.empty())
+            OpenLog(m_Settings.logPath);
+    }
+}
+
+void EncounterCatalog::Detect(const BodyStorage& bodies, const SpatialSort& sort, BroadPhase& broadPhase, double stepStart, float deltaTime)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const glm::vec3* positions = bodies.GetPositions().data();
+    const glm::vec3* velocities = bodies.GetVelocities().data();
+    const float* radii = bodies.GetRadii().data();
+    const BodyHandle* handles = bodies.GetHandles().data();
+    const float thresholdSq = m_Settings.threshold * m_Settings.threshold;
+    const float halfThreshold = m_Settings.threshold * 0.5f;
+
+    ThreadPool& pool = ThreadPool::Get();
+
+    // Half the threshold plus the distance covered this step. Never smaller than the radius, so the same
+    // pairs also serve collision resolution.
+    m_Reach.resize(bodies.Size());
+    pool.ParallelFor(bodies.Size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            m_Reach[i] = std::max(radii[i], halfThreshold + glm::length(velocities[i]) * deltaTime);
+        }
+    });
+
+    broadPhase.FindPairs(sort, bodies.GetPositions(), m_Reach);
+    const std::vector<BodyPair>& pairs = broadPhase.GetPairs();
+
+    const uint32_t taskCount = static_cast<uint32_t>(std::clamp<size_t>(pairs.size() / 4096, 1, pool.GetThreadCount()));
+    m_TaskEvents.resize(taskCount);
+
+    pool.Dispatch(taskCount, [&](uint32_t task) {
+        std::vector<EncounterEvent>& events = m_TaskEvents[task];
+        events.clear();
+
+        size_t begin = pairs.size() * task / taskCount;
+        size_t end = pairs.size() * (task + 1) / taskCount;
+        for (size_t p = begin; p < end; p++) {
+            const uint32_t a = pairs[p].first;
+            const uint32_t b = pairs[p].second;
+
+            // Separation over the step is start + velocity * t for t in [0, deltaTime].
+            const glm::vec3 velocity = velocities[b] - velocities[a];
+            const glm::vec3 separation = positions[b] - positions[a] - velocity * deltaTime;
+            const float speedSq = glm::dot(velocity, velocity);
+            if (speedSq == 0.0f)
+                continue;
+
+            // Only minima strictly after the step start are recorded, so an approach straddling two
+            // steps is reported once.
+            const float closest = -glm::dot(separation, velocity) / speedSq;
+            if (closest <= 0.0f || closest > deltaTime)
+                continue;
+
+            const glm::vec3 nearest = separation + velocity * closest;
+            const float distanceSq = glm::dot(nearest, nearest);
+            if (distanceSq >= thresholdSq)
+                continue;
+
+            const float distance = std::sqrt(distanceSq);
+            EncounterEvent event;
+            event.time = stepStart + closest;
+            event.first = handles[a];
+            event.second = handles[b];
+            event.minDistance = distance;
+            event.relativeSpeed = std::sqrt(speedSq);
+            event.type = distance < radii[a] + radii[b] ? EncounterType::Collision : EncounterType::Encounter;
+            event.reserved = 0;
+            events.push_back(event);
+        }
+    });
+
+    const bool logging = IsLogging();
+    for (const auto& events : m_TaskEvents) {
+        for (const EncounterEvent& event : events) {
+            if (event.type == EncounterType::Collision)
+                m_Stats.collisions++;
+            else
+                m_Stats.encounters++;
+
+            if (logging && !m_Queue.Push(event))
+                m_Stats.dropped++;
+        }
+    }
+
+    m_Stats.candidatePairs = static_cast<uint32_t>(pairs.size());
+    auto end = std::chrono::high_resolution_clock::now();
+    m_Stats.detectMs = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void EncounterCatalog::OpenLog(const std::string& path)
+{
+    m_Log.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_Log)
+    {
+        std::cerr << "Failed to open encounter log: " << path << std::endl;
+        return;
+    }
+
+    EncounterLogHeader header = { EncounterLogMagic, EncounterLogVersion, sizeof(EncounterEvent), 0 };
+    m_Log.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    EncounterEvent discarded;
+    while (m_Queue.Pop(discarded)) {}
+
+    m_Written.store(0, std::memory_order_relaxed);
+    m_StopWriter.store(false, std::memory_order_relaxed);
+    m_Writer = std::thread(&EncounterCatalog::WriterLoop, this);
+}
+
+void EncounterCatalog::CloseLog()
+{
+    if (m_Writer.joinable())
+    {
+        m_StopWriter.store(true, std::memory_order_release);
+        m_Writer.join();
+    }
+    if (m_Log.is_open())
+        m_Log.close();
+}
+
+void EncounterCatalog::WriterLoop()
+{
+    std::vector<EncounterEvent> batch;
+    batch.reserve(4096);
+
+    while (true)
+    {
+        // Read the stop flag before draining, so everything pushed before the stop request gets written.
+        const bool stopping = m_StopWriter.load(std::memory_order_acquire);
+
+        EncounterEvent event;
+        while (batch.size() < batch.capacity() && m_Queue.Pop(event)) {
+            batch.push_back(event);
+        }
+
+        if (!batch.empty())
+        {
+            m_Log.write(reinterpret_cast<const char*>(batch.data()), batch.size() * sizeof(EncounterEvent));
+            m_Written.fetch_add(batch.size(), std::memory_order_relaxed);
+            batch.clear();
+            continue;
+        }
+
+        if (stopping)
+            break;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    m_Log.flush();
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+#ifndef ENCOUNTER_CATALOG_H
+#define ENCOUNTER_CATALOG_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BodyStorage.h"
+#include "BroadPhase.h"
+
+namespace SpaceSim {
+
+enum class EncounterType : uint32_t {
+    Encounter,
+    Collision
+};
+
+// One record of the binary log. Bodies are identified by handle, which survives spatial reordering.
+struct EncounterEvent {
+    double time;
+    BodyHandle first;
+    BodyHandle second;
+    float minDistance;
+    float relativeSpeed;
+    EncounterType type;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(EncounterEvent) == 32, "EncounterEvent is written to disk as is");
+
+// Log layout: EncounterLogHeader followed by packed EncounterEvent records in detection order.
+constexpr uint32_t EncounterLogMagic = 0x56455353u; // "SSEV"
+constexpr uint32_t EncounterLogVersion = 1;
+
+struct EncounterLogHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+
+struct EncounterSettings {
+    bool enabled = false;
+    float threshold = 0.5f;
+    std::string logPath = "encounters.bin";
+};
+
+struct EncounterStats {
+    uint64_t encounters = 0;
+    uint64_t collisions = 0;
+    uint64_t dropped = 0;
+    uint32_t candidatePairs = 0;
+    float detectMs = 0.0f;
+};
+
+// Single-producer single-consumer ring. The simulation thread pushes, the log writer pops, and
+// neither ever waits on the other.
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool Push(const T& value)
+    {
+        const size_t head = m_Head.load(std::memory_order_relaxed);
+        if (head - m_Tail.load(std::memory_order_acquire) == Capacity)
+            return false;
+        m_Items[head & (Capacity - 1)] = value;
+        m_Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T& value)
+    {
+        const size_t tail = m_Tail.load(std::memory_order_relaxed);
+        if (tail == m_Head.load(std::memory_order_acquire))
+            return false;
+        value = m_Items[tail & (Capacity - 1)];
+        m_Tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, Capacity> m_Items;
+    alignas(64) std::atomic<size_t> m_Head{ 0 };
+    alignas(64) std::atomic<size_t> m_Tail{ 0 };
+};
+
+// Catalogs every close approach below the threshold distance. Candidates come from the collision
+// broad phase run with each body's reach over the step, and bodies move in straight lines within a
+// step of the integrator, so the time and distance of closest approach follow exactly from the
+// end-of-step positions and velocities. Events whose minimum falls inside the step are queued and
+// written out by a background thread.
+class EncounterCatalog {
+public:
+    EncounterCatalog() = default;
+    ~EncounterCatalog();
+    EncounterCatalog(const EncounterCatalog&) = delete;
+    EncounterCatalog& operator=(const EncounterCatalog&) = delete;
+
+    // Runs the broad phase with each body's reach over the step, then catalogs the pairs. The pairs are left
+    // in broadPhase; every pair overlapping at the end of the step is among them.
+    void Detect(const BodyStorage& bodies, const SpatialSort& sort, BroadPhase& broadPhase, double stepStart, float deltaTime);
+
+    const EncounterSettings& GetSettings() const { return m_Settings; }
+    void SetSettings(const EncounterSettings& settings);
+    const EncounterStats& GetStats() const { return m_Stats; }
+    uint64_t GetWrittenCount() const { return m_Written.load(std::memory_order_relaxed); }
+    bool IsLogging() const { return m_Writer.joinable(); }
+
+private:
+    void OpenLog(const std::string& path);
+    void CloseLog();
+    void WriterLoop();
+
+    EncounterSettings m_Settings;
+    EncounterStats m_Stats;
+    std::vector<float> m_Reach;
+    std::vector<std::vector<EncounterEvent>> m_TaskEvents;
+
+    SpscRing<EncounterEvent, 1 << 16> m_Queue;
+    std::ofstream m_Log;
+    std::thread m_Writer;
+    std::atomic<bool> m_StopWriter{ false };
+    std::atomic<uint64_t> m_Written{ 0 };
+};
+
+}
+
+#endif
\ No newline at end of file
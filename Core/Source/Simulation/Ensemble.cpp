@@ -0,0 +1,409 @@
+#include "Ensemble.h"
+#include "SimdLanes.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <glm/ext/scalar_constants.hpp>
+
+namespace SpaceSim {
+
+constexpr uint32_t EjectionCheckInterval = 16;
+
+// One system per lane: body i of lane l lives at i * Lanes::Width + l.
+struct LaneGroup {
+    size_t bodyCount = 0;
+    std::vector<float> px, py, pz;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> ax, ay, az;
+    std::vector<float> mass, radius;
+    float active[Lanes::Width] = {};
+};
+
+static void LoadSystem(LaneGroup& group, uint32_t lane, const std::vector<CelestialBody>& bodies)
+{
+    for (size_t i = 0; i < group.bodyCount; i++) {
+        const size_t index = i * Lanes::Width + lane;
+        group.px[index] = bodies[i].position.x;
+        group.py[index] = bodies[i].position.y;
+        group.pz[index] = bodies[i].position.z;
+        group.vx[index] = bodies[i].velocity.x;
+        group.vy[index] = bodies[i].velocity.y;
+        group.vz[index] = bodies[i].velocity.z;
+        group.mass[index] = bodies[i].mass;
+        group.radius[index] = bodies[i].radius;
+    }
+    group.active[lane] = 1.0f;
+}
+
+// Unused lanes get massless, well separated bodies so they neither attract nor overlap anything.
+static void LoadPadding(LaneGroup& group, uint32_t lane)
+{
+    for (size_t i = 0; i < group.bodyCount; i++) {
+        const size_t index = i * Lanes::Width + lane;
+        group.px[index] = static_cast<float>(i);
+        group.py[index] = group.pz[index] = 0.0f;
+        group.vx[index] = group.vy[index] = group.vz[index] = 0.0f;
+        group.mass[index] = group.radius[index] = 0.0f;
+    }
+    group.active[lane] = 0.0f;
+}
+
+// Returns a lane mask of systems with at least one overlapping pair.
+static Lanes ComputeAccelerations(LaneGroup& group, Lanes gravity, Lanes softening2)
+{
+    const size_t n = group.bodyCount;
+    std::fill(group.ax.begin(), group.ax.end(), 0.0f);
+    std::fill(group.ay.begin(), group.ay.end(), 0.0f);
+    std::fill(group.az.begin(), group.az.end(), 0.0f);
+
+    const Lanes one = Lanes::Broadcast(1.0f);
+    Lanes overlap = Lanes::Broadcast(0.0f);
+    for (size_t i = 0; i < n; i++) {
+        const size_t a = i * Lanes::Width;
+        const Lanes xi = Lanes::Load(&group.px[a]);
+        const Lanes yi = Lanes::Load(&group.py[a]);
+        const Lanes zi = Lanes::Load(&group.pz[a]);
+        const Lanes mi = Lanes::Load(&group.mass[a]);
+        const Lanes ri = Lanes::Load(&group.radius[a]);
+        Lanes axi = Lanes::Load(&group.ax[a]);
+        Lanes ayi = Lanes::Load(&group.ay[a]);
+        Lanes azi = Lanes::Load(&group.az[a]);
+
+        for (size_t j = i + 1; j < n; j++) {
+            const size_t b = j * Lanes::Width;
+            const Lanes dx = Lanes::Load(&group.px[b]) - xi;
+            const Lanes dy = Lanes::Load(&group.py[b]) - yi;
+            const Lanes dz = Lanes::Load(&group.pz[b]) - zi;
+            const Lanes r2 = dx * dx + dy * dy + dz * dz + softening2;
+            const Lanes inverse = one / Sqrt(r2);
+            const Lanes inverse3 = gravity * inverse * inverse * inverse;
+            const Lanes towardJ = Lanes::Load(&group.mass[b]) * inverse3;
+            const Lanes towardI = mi * inverse3;
+
+            axi = axi + dx * towardJ;
+            ayi = ayi + dy * towardJ;
+            azi = azi + dz * towardJ;
+            (Lanes::Load(&group.ax[b]) - dx * towardI).Store(&group.ax[b]);
+            (Lanes::Load(&group.ay[b]) - dy * towardI).Store(&group.ay[b]);
+            (Lanes::Load(&group.az[b]) - dz * towardI).Store(&group.az[b]);
+
+            const Lanes reach = ri + Lanes::Load(&group.radius[b]);
+            overlap = Max(overlap, SelectIfLess(r2, reach * reach, one));
+        }
+
+        axi.Store(&group.ax[a]);
+        ayi.Store(&group.ay[a]);
+        azi.Store(&group.az[a]);
+    }
+    return overlap;
+}
+
+static void Kick(LaneGroup& group, Lanes dt)
+{
+    for (size_t i = 0; i < group.bodyCount * Lanes::Width; i += Lanes::Width) {
+        (Lanes::Load(&group.vx[i]) + Lanes::Load(&group.ax[i]) * dt).Store(&group.vx[i]);
+        (Lanes::Load(&group.vy[i]) + Lanes::Load(&group.ay[i]) * dt).Store(&group.vy[i]);
+        (Lanes::Load(&group.vz[i]) + Lanes::Load(&group.az[i]) * dt).Store(&group.vz[i]);
+    }
+}
+
+static void Drift(LaneGroup& group, Lanes dt)
+{
+    for (size_t i = 0; i < group.bodyCount * Lanes::Width; i += Lanes::Width) {
+        (Lanes::Load(&group.px[i]) + Lanes::Load(&group.vx[i]) * dt).Store(&group.px[i]);
+        (Lanes::Load(&group.py[i]) + Lanes::Load(&group.vy[i]) * dt).Store(&group.py[i]);
+        (Lanes::Load(&group.pz[i]) + Lanes::Load(&group.vz[i]) * dt).Store(&group.pz[i]);
+    }
+}
+
+// Returns a lane mask of systems with a body at least ejectionRadius from the primary.
+static Lanes FindDistantBodies(const LaneGroup& group, Lanes ejectionRadius2)
+{
+    const Lanes one = Lanes::Broadcast(1.0f);
+    const Lanes x0 = Lanes::Load(&group.px[0]);
+    const Lanes y0 = Lanes::Load(&group.py[0]);
+    const Lanes z0 = Lanes::Load(&group.pz[0]);
+    Lanes distant = Lanes::Broadcast(0.0f);
+    for (size_t i = Lanes::Width; i < group.bodyCount * Lanes::Width; i += Lanes::Width) {
+        const Lanes dx = Lanes::Load(&group.px[i]) - x0;
+        const Lanes dy = Lanes::Load(&group.py[i]) - y0;
+        const Lanes dz = Lanes::Load(&group.pz[i]) - z0;
+        distant = Max(distant, SelectIfGreaterEqual(dx * dx + dy * dy + dz * dz, ejectionRadius2, one));
+    }
+    return distant;
+}
+
+static glm::vec3 PositionOf(const LaneGroup& group, size_t body, uint32_t lane)
+{
+    const size_t index = body * Lanes::Width + lane;
+    return glm::vec3(group.px[index], group.py[index], group.pz[index]);
+}
+
+static glm::vec3 VelocityOf(const LaneGroup& group, size_t body, uint32_t lane)
+{
+    const size_t index = body * Lanes::Width + lane;
+    return glm::vec3(group.vx[index], group.vy[index], group.vz[index]);
+}
+
+static bool FindCollision(const LaneGroup& group, uint32_t lane, EnsembleResult& result)
+{
+    for (size_t i = 0; i < group.bodyCount; i++) {
+        for (size_t j = i + 1; j < group.bodyCount; j++) {
+            const glm::vec3 delta = PositionOf(group, j, lane) - PositionOf(group, i, lane);
+            const float reach = group.radius[i * Lanes::Width + lane] + group.radius[j * Lanes::Width + lane];
+            if (glm::dot(delta, delta) < reach * reach)
+            {
+                result.outcome = EnsembleOutcome::Collided;
+                result.first = static_cast<uint32_t>(i);
+                result.second = static_cast<uint32_t>(j);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool FindEjection(const LaneGroup& group, uint32_t lane, float gravity, float ejectionRadius, EnsembleResult& result)
+{
+    const glm::vec3 primaryPosition = PositionOf(group, 0, lane);
+    const glm::vec3 primaryVelocity = VelocityOf(group, 0, lane);
+    const float primaryMass = group.mass[lane];
+    for (size_t i = 1; i < group.bodyCount; i++) {
+        const float distance = glm::length(PositionOf(group, i, lane) - primaryPosition);
+        if (distance < ejectionRadius)
+            continue;
+
+        const glm::vec3 relativeVelocity = VelocityOf(group, i, lane) - primaryVelocity;
+        const float mass = group.mass[i * Lanes::Width + lane];
+        if (0.5f * glm::dot(relativeVelocity, relativeVelocity) > gravity * (primaryMass + mass) / distance)
+        {
+            result.outcome = EnsembleOutcome::Ejected;
+            result.first = static_cast<uint32_t>(i);
+            result.second = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+static double ComputeEnergy(const LaneGroup& group, uint32_t lane, float gravity, float softening2)
+{
+    double kinetic = 0.0;
+    double potential = 0.0;
+    for (size_t i = 0; i < group.bodyCount; i++) {
+        const double mi = group.mass[i * Lanes::Width + lane];
+        const glm::vec3 velocity = VelocityOf(group, i, lane);
+        kinetic += 0.5 * mi * glm::dot(velocity, velocity);
+        for (size_t j = i + 1; j < group.bodyCount; j++) {
+            const glm::vec3 delta = PositionOf(group, j, lane) - PositionOf(group, i, lane);
+            potential -= gravity * mi * group.mass[j * Lanes::Width + lane] / std::sqrt(glm::dot(delta, delta) + softening2);
+        }
+    }
+    return kinetic + potential;
+}
+
+EnsembleGenerator PlanetarySystem(const PlanetarySystemParams& params)
+{
+    return [params](size_t, RandomStream& random, std::vector<CelestialBody>& bodies) {
+        bodies.clear();
+        bodies.push_back(CelestialBody{ params.starRadius, glm::vec4(1.0f, 0.9f, 0.6f, 1.0f), glm::vec3(0.0f), glm::vec3(0.0f), params.starMass });
+
+        float spacedRadius = params.innerRadius;
+        for (size_t k = 0; k < params.planetCount; k++) {
+            const float semiMajorAxis = spacedRadius * (1.0f + params.spacingJitter * random.NextNormal());
+            spacedRadius *= params.spacing;
+            const float mass = params.planetMass * (1.0f + params.massJitter * random.NextFloat(-1.0f, 1.0f));
+            const float eccentricity = std::min(params.eccentricityScale * std::sqrt(-2.0f * std::log(1.0f - random.NextFloat())), 0.9f);
+            const float inclination = params.inclinationScale * std::sqrt(-2.0f * std::log(1.0f - random.NextFloat()));
+            const float node = random.NextFloat(0.0f, 2.0f * glm::pi<float>());
+            const float periapsis = random.NextFloat(0.0f, 2.0f * glm::pi<float>());
+            const float trueAnomaly = random.NextFloat(0.0f, 2.0f * glm::pi<float>());
+
+            // Perifocal state rotated by node, inclination and argument of periapsis. The element frame's
+            // z axis is the world's -y, matching ComputeOrbitalElements.
+            const float semiLatusRectum = semiMajorAxis * (1.0f - eccentricity * eccentricity);
+            const float distance = semiLatusRectum / (1.0f + eccentricity * std::cos(trueAnomaly));
+            const float speed = std::sqrt(params.gravityStrength * (params.starMass + mass) / semiLatusRectum);
+            const glm::vec2 position(distance * std::cos(trueAnomaly), distance * std::sin(trueAnomaly));
+            const glm::vec2 velocity(-speed * std::sin(trueAnomaly), speed * (eccentricity + std::cos(trueAnomaly)));
+
+            const float cosNode = std::cos(node), sinNode = std::sin(node);
+            const float cosPeriapsis = std::cos(periapsis), sinPeriapsis = std::sin(periapsis);
+            const float cosInclination = std::cos(inclination), sinInclination = std::sin(inclination);
+            const glm::vec3 p(cosNode * cosPeriapsis - sinNode * sinPeriapsis * cosInclination,
+                              sinNode * cosPeriapsis + cosNode * sinPeriapsis * cosInclination,
+                              sinPeriapsis * sinInclination);
+            const glm::vec3 q(-cosNode * sinPeriapsis - sinNode * cosPeriapsis * cosInclination,
+                              -sinNode * sinPeriapsis + cosNode * cosPeriapsis * cosInclination,
+                              cosPeriapsis * sinInclination);
+            auto toWorld = [&](glm::vec2 perifocal) {
+                const glm::vec3 element = p * perifocal.x + q * perifocal.y;
+                return glm::vec3(element.x, -element.z, element.y);
+            };
+
+            bodies.push_back(CelestialBody{ params.planetRadius, glm::vec4(0.5f, 0.6f, 0.9f, 1.0f), toWorld(position), toWorld(velocity), mass });
+        }
+
+        float totalMass = 0.0f;
+        glm::vec3 center(0.0f);
+        glm::vec3 momentum(0.0f);
+        for (const CelestialBody& body : bodies) {
+            totalMass += body.mass;
+            center += body.position * body.mass;
+            momentum += body.velocity * body.mass;
+        }
+        for (CelestialBody& body : bodies) {
+            body.position -= center / totalMass;
+            body.velocity -= momentum / totalMass;
+        }
+    };
+}
+
+EnsembleStats RunEnsemble(const EnsembleSettings& settings, const EnsembleGenerator& generator, std::vector<EnsembleResult>& results)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    EnsembleStats stats;
+    stats.systems = settings.systemCount;
+    results.assign(settings.systemCount, EnsembleResult());
+    if (settings.systemCount == 0)
+        return stats;
+
+    const uint64_t stepCount = static_cast<uint64_t>(std::ceil(settings.duration / settings.timestep));
+    const float softening2 = settings.softening * settings.softening;
+    const size_t groupCount = (settings.systemCount + Lanes::Width - 1) / Lanes::Width;
+    std::atomic<uint64_t> stepsTaken{ 0 };
+
+    // One task per lane group, so the pool hands out groups as threads free up and early finishers don't
+    // leave cores idle.
+    ThreadPool::Get().Dispatch(static_cast<uint32_t>(groupCount), [&](uint32_t groupIndex) {
+        LaneGroup group;
+        std::vector<CelestialBody> bodies;
+        double initialEnergy[Lanes::Width] = {};
+        const size_t firstSystem = static_cast<size_t>(groupIndex) * Lanes::Width;
+
+        for (uint32_t lane = 0; lane < Lanes::Width; lane++) {
+            const size_t system = firstSystem + lane;
+            if (system >= settings.systemCount)
+            {
+                LoadPadding(group, lane);
+                continue;
+            }
+
+            RandomStream random(settings.seed, system);
+            generator(system, random, bodies);
+            if (lane > 0 && bodies.size() != group.bodyCount)
+            {
+                std::cerr << "Ensemble system " << system << " has " << bodies.size() << " bodies, expected " << group.bodyCount << std::endl;
+                LoadPadding(group, lane);
+                results[system].system = system;
+                results[system].outcome = EnsembleOutcome::Invalid;
+                continue;
+            }
+            if (lane == 0)
+            {
+                group.bodyCount = bodies.size();
+                const size_t size = group.bodyCount * Lanes::Width;
+                for (std::vector<float>* array : { &group.px, &group.py, &group.pz, &group.vx, &group.vy, &group.vz,
+                                                   &group.ax, &group.ay, &group.az, &group.mass, &group.radius }) {
+                    array->assign(size, 0.0f);
+                }
+            }
+            LoadSystem(group, lane, bodies);
+            results[system].system = system;
+            initialEnergy[lane] = ComputeEnergy(group, lane, settings.gravityStrength, softening2);
+        }
+
+        const Lanes gravity = Lanes::Broadcast(settings.gravityStrength);
+        const Lanes softening = Lanes::Broadcast(softening2);
+        const Lanes ejectionRadius2 = Lanes::Broadcast(settings.ejectionRadius * settings.ejectionRadius);
+        uint32_t running = 0;
+        for (uint32_t lane = 0; lane < Lanes::Width; lane++) {
+            running += group.active[lane] != 0.0f ? 1 : 0;
+        }
+        uint64_t laneSteps = 0;
+
+        ComputeAccelerations(group, gravity, softening);
+        for (uint64_t step = 0; step < stepCount && running > 0; step++) {
+            // Stopped systems keep their last state: their lanes advance with a zero timestep.
+            const Lanes active = Lanes::Load(group.active);
+            const Lanes dt = Lanes::Broadcast(settings.timestep) * active;
+            const Lanes halfDt = dt * Lanes::Broadcast(0.5f);
+            Kick(group, halfDt);
+            Drift(group, dt);
+            const Lanes overlap = ComputeAccelerations(group, gravity, softening);
+            Kick(group, halfDt);
+            laneSteps += running;
+
+            const bool collided = settings.stopOnCollision && ReduceAdd(overlap * active) > 0.0f;
+            const bool distant = settings.stopOnEjection && (step + 1) % EjectionCheckInterval == 0 &&
+                                 ReduceAdd(FindDistantBodies(group, ejectionRadius2) * active) > 0.0f;
+            if (!collided && !distant)
+                continue;
+
+            for (uint32_t lane = 0; lane < Lanes::Width; lane++) {
+                if (group.active[lane] == 0.0f)
+                    continue;
+
+                EnsembleResult& result = results[firstSystem + lane];
+                if ((collided && FindCollision(group, lane, result)) ||
+                    (distant && FindEjection(group, lane, settings.gravityStrength, settings.ejectionRadius, result)))
+                {
+                    result.time = static_cast<float>((step + 1) * settings.timestep);
+                    group.active[lane] = 0.0f;
+                    running--;
+                }
+            }
+        }
+
+        for (uint32_t lane = 0; lane < Lanes::Width && firstSystem + lane < settings.systemCount; lane++) {
+            EnsembleResult& result = results[firstSystem + lane];
+            if (result.outcome == EnsembleOutcome::Invalid)
+                continue;
+            if (result.outcome == EnsembleOutcome::Survived)
+                result.time = static_cast<float>(stepCount * settings.timestep);
+            // A system with no energy to begin with has no relative error.
+            if (initialEnergy[lane] == 0.0)
+                continue;
+            const double energy = ComputeEnergy(group, lane, settings.gravityStrength, softening2);
+            result.energyError = static_cast<float>(std::abs((energy - initialEnergy[lane]) / initialEnergy[lane]));
+        }
+        stepsTaken += laneSteps;
+    });
+
+    double terminationTime = 0.0;
+    double energyError = 0.0;
+    for (const EnsembleResult& result : results) {
+        switch (result.outcome)
+        {
+        case EnsembleOutcome::Survived:
+            stats.survived++;
+            energyError += result.energyError;
+            stats.maxEnergyError = std::max(stats.maxEnergyError, static_cast<double>(result.energyError));
+            break;
+        case EnsembleOutcome::Ejected:
+            stats.ejected++;
+            terminationTime += result.time;
+            break;
+        case EnsembleOutcome::Collided:
+            stats.collided++;
+            terminationTime += result.time;
+            break;
+        case EnsembleOutcome::Invalid:
+            stats.invalid++;
+            break;
+        }
+    }
+    const size_t terminated = stats.ejected + stats.collided;
+    stats.meanTerminationTime = terminated > 0 ? terminationTime / terminated : 0.0;
+    stats.meanEnergyError = stats.survived > 0 ? energyError / stats.survived : 0.0;
+    stats.steps = stepsTaken.load();
+    stats.wallSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    stats.systemsPerSecond = stats.systems / std::max(stats.wallSeconds, 1e-9);
+    return stats;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "CelestialBody.h"
+#include "Random.h"
+
+namespace SpaceSim {
+
+// Fills in the bodies of one ensemble member. Every call must produce the same number of bodies; body 0
+// is the primary that ejections are measured from.
+using EnsembleGenerator = std::function<void(size_t system, RandomStream& random, std::vector<CelestialBody>& bodies)>;
+
+struct EnsembleSettings {
+    size_t systemCount = 1000;
+    uint64_t seed = 0x5EED5EEDull;
+    float gravityStrength = 1.0f;
+    float timestep = 0.002f;
+    double duration = 100.0;
+    float softening = 0.0f;
+    float ejectionRadius = 200.0f;
+    bool stopOnCollision = true;
+    bool stopOnEjection = true;
+};
+
+enum class EnsembleOutcome : uint32_t {
+    Survived,
+    Ejected,
+    Collided,
+    // The generator produced a different number of bodies than the first system of its group; not run.
+    Invalid
+};
+
+// first and second are body indices within the system: the colliding pair, or the ejected body and the primary.
+struct EnsembleResult {
+    uint64_t system = 0;
+    EnsembleOutcome outcome = EnsembleOutcome::Survived;
+    uint32_t first = 0;
+    uint32_t second = 0;
+    float time = 0.0f;
+    float energyError = 0.0f;
+};
+
+struct EnsembleStats {
+    size_t systems = 0;
+    size_t survived = 0;
+    size_t ejected = 0;
+    size_t collided = 0;
+    size_t invalid = 0;
+    double meanTerminationTime = 0.0;
+    double meanEnergyError = 0.0;
+    double maxEnergyError = 0.0;
+    uint64_t steps = 0;
+    double wallSeconds = 0.0;
+    double systemsPerSecond = 0.0;
+};
+
+// Star with planetCount planets on jittered, nearly circular orbits spaced by a constant ratio, moved to
+// its centre-of-mass frame. Eccentricities and inclinations are Rayleigh distributed.
+struct PlanetarySystemParams {
+    size_t planetCount = 5;
+    float starMass = 1000.0f;
+    float starRadius = 1.5f;
+    float innerRadius = 4.0f;
+    float spacing = 1.35f;
+    float spacingJitter = 0.03f;
+    float planetMass = 0.5f;
+    float massJitter = 0.5f;
+    float planetRadius = 0.05f;
+    float eccentricityScale = 0.05f;
+    float inclinationScale = 0.02f;
+    float gravityStrength = 1.0f;
+};
+
+EnsembleGenerator PlanetarySystem(const PlanetarySystemParams& params);
+
+// Integrates systemCount independent systems with direct summation and kick-drift-kick leapfrog, without
+// any rendering state. Systems are packed one per SIMD lane and the lane groups are spread over the thread
+// pool. A system stops at its first collision or ejection (body beyond ejectionRadius from the primary and
+// unbound from it); its lane is frozen and the group ends early once every lane has stopped.
+EnsembleStats RunEnsemble(const EnsembleSettings& settings, const EnsembleGenerator& generator, std::vector<EnsembleResult>& results);
+
+}
+
+#endif
\ No newline at end of file
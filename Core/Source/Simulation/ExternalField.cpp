@@ -0,0 +1,199 @@
+#include "ExternalField.h"
+#include "SimdLanes.h"
+#include <algorithm>
+#include <cmath>
+
+namespace SpaceSim {
+
+// The force kernels below are written once for plain floats and once for SIMD lanes.
+template <typename T> T Splat(float value);
+template <> float Splat<float>(float value) { return value; }
+template <> Lanes Splat<Lanes>(float value) { return Lanes::Broadcast(value); }
+
+static float Sqrt(float value) { return std::sqrt(value); }
+static float Log(float value) { return std::log(value); }
+
+// Relative softening of the NFW cusp, which keeps ln(1 + x) / x away from 0/0 at the centre.
+constexpr float NFWSofteningSquared = 1e-6f;
+
+template <typename T>
+static void AddNFWAcceleration(const PotentialComponent& component, T dx, T dy, T dz, T& ax, T& ay, T& az)
+{
+    const T one = Splat<T>(1.0f);
+    const T scale = Splat<T>(component.scaleRadius);
+    const T r2 = dx * dx + dy * dy + dz * dz + Splat<T>(NFWSofteningSquared * component.scaleRadius * component.scaleRadius);
+    const T r = Sqrt(r2);
+    const T x = r / scale;
+
+    // ln(1 + x) computed as ln(u) * x / (u - 1), which cancels the rounding of u = 1 + x.
+    const T u = one + x;
+    const T log1p = Log(u) * x / (u - one);
+    const T factor = Splat<T>(component.mass) * (log1p / r - one / (scale + r)) / r2;
+    ax = ax - dx * factor;
+    ay = ay - dy * factor;
+    az = az - dz * factor;
+}
+
+template <typename T>
+static void AddDiskAcceleration(const PotentialComponent& component, T dx, T dy, T dz, T& ax, T& ay, T& az)
+{
+    const T vertical = Sqrt(dy * dy + Splat<T>(component.scaleHeight * component.scaleHeight));
+    const T lifted = Splat<T>(component.scaleRadius) + vertical;
+    const T d2 = dx * dx + dz * dz + lifted * lifted;
+    const T factor = Splat<T>(component.mass) / (d2 * Sqrt(d2));
+    ax = ax - dx * factor;
+    ay = ay - dy * factor * lifted / vertical;
+    az = az - dz * factor;
+}
+
+template <typename T>
+static void AddBarAcceleration(const PotentialComponent& component, const glm::vec2& axis, T dx, T dy, T dz, T& ax, T& ay, T& az)
+{
+    const T one = Splat<T>(1.0f);
+    const T cosAngle = Splat<T>(axis.x);
+    const T sinAngle = Splat<T>(axis.y);
+    const T halfLength = Splat<T>(component.scaleRadius);
+
+    // u along the bar, v across it in the plane.
+    const T u = dx * cosAngle + dz * sinAngle;
+    const T v = dz * cosAngle - dx * sinAngle;
+    const T rho2 = v * v + dy * dy + Splat<T>(component.scaleHeight * component.scaleHeight);
+    const T front = u + halfLength;
+    const T back = u - halfLength;
+    const T frontDistance = Sqrt(front * front + rho2);
+    const T backDistance = Sqrt(back * back + rho2);
+
+    const T k = Splat<T>(component.mass / (2.0f * component.scaleRadius));
+    const T along = k * (one / frontDistance - one / backDistance);
+    const T across = k * (back / backDistance - front / frontDistance) / rho2;
+    const T acrossV = across * v;
+    ax = ax + along * cosAngle - acrossV * sinAngle;
+    ay = ay + across * dy;
+    az = az + along * sinAngle + acrossV * cosAngle;
+}
+
+const char* GetPotentialName(PotentialType type)
+{
+    switch (type)
+    {
+    case PotentialType::NFWHalo: return "NFW Halo";
+    case PotentialType::MiyamotoNagaiDisk: return "Miyamoto-Nagai Disk";
+    case PotentialType::RotatingBar: return "Rotating Bar";
+    }
+    return "Unknown";
+}
+
+void ExternalField::SetComponents(const std::vector<PotentialComponent>& components)
+{
+    m_Components = components;
+    SetTime(m_Time);
+}
+
+void ExternalField::SetTime(double time)
+{
+    m_Time = time;
+    m_BarAxes.resize(m_Components.size());
+    for (size_t c = 0; c < m_Components.size(); c++) {
+        const double angle = m_Components[c].phase + m_Components[c].patternSpeed * time;
+        m_BarAxes[c] = glm::vec2(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+    }
+}
+
+void ExternalField::Accumulate(const float* x, const float* y, const float* z, size_t count, float* ax, float* ay, float* az) const
+{
+    for (size_t t = 0; t < count; t += Lanes::Width) {
+        const Lanes px = Lanes::Load(x + t);
+        const Lanes py = Lanes::Load(y + t);
+        const Lanes pz = Lanes::Load(z + t);
+        Lanes accX = Lanes::Load(ax + t);
+        Lanes accY = Lanes::Load(ay + t);
+        Lanes accZ = Lanes::Load(az + t);
+
+        for (size_t c = 0; c < m_Components.size(); c++) {
+            const PotentialComponent& component = m_Components[c];
+            const Lanes dx = px - Lanes::Broadcast(component.center.x);
+            const Lanes dy = py - Lanes::Broadcast(component.center.y);
+            const Lanes dz = pz - Lanes::Broadcast(component.center.z);
+
+            switch (component.type)
+            {
+            case PotentialType::NFWHalo: AddNFWAcceleration(component, dx, dy, dz, accX, accY, accZ); break;
+            case PotentialType::MiyamotoNagaiDisk: AddDiskAcceleration(component, dx, dy, dz, accX, accY, accZ); break;
+            case PotentialType::RotatingBar: AddBarAcceleration(component, m_BarAxes[c], dx, dy, dz, accX, accY, accZ); break;
+            }
+        }
+
+        accX.Store(ax + t);
+        accY.Store(ay + t);
+        accZ.Store(az + t);
+    }
+}
+
+glm::vec3 ExternalField::GetAcceleration(const glm::vec3& position) const
+{
+    float ax = 0.0f;
+    float ay = 0.0f;
+    float az = 0.0f;
+    for (size_t c = 0; c < m_Components.size(); c++) {
+        const PotentialComponent& component = m_Components[c];
+        const glm::vec3 d = position - component.center;
+
+        switch (component.type)
+        {
+        case PotentialType::NFWHalo: AddNFWAcceleration(component, d.x, d.y, d.z, ax, ay, az); break;
+        case PotentialType::MiyamotoNagaiDisk: AddDiskAcceleration(component, d.x, d.y, d.z, ax, ay, az); break;
+        case PotentialType::RotatingBar: AddBarAcceleration(component, m_BarAxes[c], d.x, d.y, d.z, ax, ay, az); break;
+        }
+    }
+    return glm::vec3(ax, ay, az);
+}
+
+float ExternalField::GetPotential(const glm::vec3& position) const
+{
+    float potential = 0.0f;
+    for (size_t c = 0; c < m_Components.size(); c++) {
+        const PotentialComponent& component = m_Components[c];
+        const glm::vec3 d = position - component.center;
+
+        switch (component.type)
+        {
+        case PotentialType::NFWHalo:
+        {
+            const float r = std::sqrt(glm::dot(d, d) + NFWSofteningSquared * component.scaleRadius * component.scaleRadius);
+            potential -= component.mass * std::log1p(r / component.scaleRadius) / r;
+            break;
+        }
+        case PotentialType::MiyamotoNagaiDisk:
+        {
+            const float lifted = component.scaleRadius + std::sqrt(d.y * d.y + component.scaleHeight * component.scaleHeight);
+            potential -= component.mass / std::sqrt(d.x * d.x + d.z * d.z + lifted * lifted);
+            break;
+        }
+        case PotentialType::RotatingBar:
+        {
+            const glm::vec2& axis = m_BarAxes[c];
+            const float u = d.x * axis.x + d.z * axis.y;
+            const float v = d.z * axis.x - d.x * axis.y;
+            const float rho = std::sqrt(v * v + d.y * d.y + component.scaleHeight * component.scaleHeight);
+            potential -= component.mass / (2.0f * component.scaleRadius) *
+                         (std::asinh((u + component.scaleRadius) / rho) - std::asinh((u - component.scaleRadius) / rho));
+            break;
+        }
+        }
+    }
+    return potential;
+}
+
+float ExternalField::GetCircularSpeed(float radius) const
+{
+    constexpr int Samples = 16;
+    float inward = 0.0f;
+    for (int s = 0; s < Samples; s++) {
+        const float angle = 6.28318530718f * s / Samples;
+        const glm::vec3 direction(std::cos(angle), 0.0f, std::sin(angle));
+        inward -= glm::dot(GetAcceleration(direction * radius), direction);
+    }
+    return std::sqrt(std::max(0.0f, inward / Samples * radius));
+}
+
+}
\ No newline at end of file
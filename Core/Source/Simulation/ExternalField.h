@@ -0,0 +1,61 @@
+#ifndef EXTERNAL_FIELD_H
+#define EXTERNAL_FIELD_H
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace SpaceSim {
+
+enum class PotentialType {
+    NFWHalo,
+    MiyamotoNagaiDisk,
+    RotatingBar
+};
+
+const char* GetPotentialName(PotentialType type);
+
+// One analytic background component. The galactic plane is x-z with y up, like the disk scenes.
+//   NFWHalo: mass is the characteristic mass 4 pi rho_s r_s^3, scaleRadius is r_s.
+//   MiyamotoNagaiDisk: total mass, radial scale a = scaleRadius, vertical scale b = scaleHeight.
+//   RotatingBar: a uniform needle of half-length scaleRadius softened by scaleHeight, turning about +y
+//   at patternSpeed radians per time unit from angle phase.
+struct PotentialComponent {
+    PotentialType type = PotentialType::NFWHalo;
+    float mass = 1000.0f;
+    float scaleRadius = 10.0f;
+    float scaleHeight = 1.0f;
+    float patternSpeed = 0.0f;
+    float phase = 0.0f;
+    glm::vec3 center = glm::vec3(0.0f);
+};
+
+// Sum of analytic potentials that stands in for a galaxy too large to simulate body by body. Values are
+// per unit G; the solvers scale them with the gravity strength along with the N-body forces.
+class ExternalField {
+public:
+    void SetComponents(const std::vector<PotentialComponent>& components);
+    const std::vector<PotentialComponent>& GetComponents() const { return m_Components; }
+    bool IsEmpty() const { return m_Components.empty(); }
+
+    // Rotating components take their orientation at this time.
+    void SetTime(double time);
+
+    // Adds the field's acceleration to count targets. count must be a multiple of GetKernelLaneWidth().
+    void Accumulate(const float* x, const float* y, const float* z, size_t count, float* ax, float* ay, float* az) const;
+
+    glm::vec3 GetAcceleration(const glm::vec3& position) const;
+    float GetPotential(const glm::vec3& position) const;
+
+    // Speed of a circular orbit in the plane at this distance from the origin, averaged over azimuth.
+    float GetCircularSpeed(float radius) const;
+
+private:
+    std::vector<PotentialComponent> m_Components;
+    std::vector<glm::vec2> m_BarAxes;
+    double m_Time = 0.0;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "GravityKernels.h"
+#include "SimdLanes.h"
+
+namespace SpaceSim {
+
+void ParticleBuffer::Clear()
+{
+    x.clear();
+    y.clear();
+    z.clear();
+    mass.clear();
+}
+
+void ParticleBuffer::Push(const glm::vec3& position, float m)
+{
+    x.push_back(position.x);
+    y.push_back(position.y);
+    z.push_back(position.z);
+    mass.push_back(m);
+}
+
+void CellBuffer::Clear()
+{
+    x.clear();
+    y.clear();
+    z.clear();
+    mass.clear();
+    qxx.clear();
+    qyy.clear();
+    qzz.clear();
+    qxy.clear();
+    qxz.clear();
+    qyz.clear();
+}
+
+void CellBuffer::Push(const OctreeNode& node)
+{
+    x.push_back(node.centerOfMass.x);
+    y.push_back(node.centerOfMass.y);
+    z.push_back(node.centerOfMass.z);
+    mass.push_back(node.mass);
+    qxx.push_back(node.quadrupole.xx);
+    qyy.push_back(node.quadrupole.yy);
+    qzz.push_back(node.quadrupole.zz);
+    qxy.push_back(node.quadrupole.xy);
+    qxz.push_back(node.quadrupole.xz);
+    qyz.push_back(node.quadrupole.yz);
+}
+
+uint32_t GetKernelLaneWidth()
+{
+    return Lanes::Width;
+}
+
+void AccumulateParticleParticle(const ParticleBuffer& sources, const float* tx, const float* ty, const float* tz,
+                                size_t targetCount, float* ax, float* ay, float* az)
+{
+    const size_t sourceCount = sources.Size();
+    const Lanes one = Lanes::Broadcast(1.0f);
+    const Lanes minDistanceSquared = Lanes::Broadcast(MinInteractionDistanceSquared);
+
+    for (size_t t = 0; t < targetCount; t += Lanes::Width) {
+        const Lanes px = Lanes::Load(tx + t);
+        const Lanes py = Lanes::Load(ty + t);
+        const Lanes pz = Lanes::Load(tz + t);
+        Lanes accX = Lanes::Broadcast(0.0f);
+        Lanes accY = Lanes::Broadcast(0.0f);
+        Lanes accZ = Lanes::Broadcast(0.0f);
+
+        for (size_t j = 0; j < sourceCount; j++) {
+            Lanes dx = Lanes::Broadcast(sources.x[j]) - px;
+            Lanes dy = Lanes::Broadcast(sources.y[j]) - py;
+            Lanes dz = Lanes::Broadcast(sources.z[j]) - pz;
+            Lanes distanceSquared = dx * dx + dy * dy + dz * dz;
+
+            Lanes inverseDistance = one / Sqrt(distanceSquared);
+            Lanes weight = Lanes::Broadcast(sources.mass[j]) * inverseDistance * inverseDistance * inverseDistance;
+            weight = SelectIfGreaterEqual(distanceSquared, minDistanceSquared, weight);
+
+            accX = accX + dx * weight;
+            accY = accY + dy * weight;
+            accZ = accZ + dz * weight;
+        }
+
+        (Lanes::Load(ax + t) + accX).Store(ax + t);
+        (Lanes::Load(ay + t) + accY).Store(ay + t);
+        (Lanes::Load(az + t) + accZ).Store(az + t);
+    }
+}
+
+void AccumulateParticleCell(const CellBuffer& cells, bool quadrupole, const float* tx, const float* ty, const float* tz,
+                            size_t targetCount, float* ax, float* ay, float* az)
+{
+    const size_t cellCount = cells.Size();
+    const Lanes one = Lanes::Broadcast(1.0f);
+    const Lanes twoAndHalf = Lanes::Broadcast(2.5f);
+    const Lanes minDistanceSquared = Lanes::Broadcast(MinInteractionDistanceSquared);
+
+    for (size_t t = 0; t < targetCount; t += Lanes::Width) {
+        const Lanes px = Lanes::Load(tx + t);
+        const Lanes py = Lanes::Load(ty + t);
+        const Lanes pz = Lanes::Load(tz + t);
+        Lanes accX = Lanes::Broadcast(0.0f);
+        Lanes accY = Lanes::Broadcast(0.0f);
+        Lanes accZ = Lanes::Broadcast(0.0f);
+
+        for (size_t c = 0; c < cellCount; c++) {
+            // r points from the cell's center of mass to the target.
+            Lanes rx = px - Lanes::Broadcast(cells.x[c]);
+            Lanes ry = py - Lanes::Broadcast(cells.y[c]);
+            Lanes rz = pz - Lanes::Broadcast(cells.z[c]);
+            Lanes r2 = rx * rx + ry * ry + rz * rz;
+
+            Lanes inverseR = one / Sqrt(r2);
+            Lanes inverseR2 = inverseR * inverseR;
+            Lanes inverseR3 = inverseR2 * inverseR;
+            Lanes monopole = SelectIfGreaterEqual(r2, minDistanceSquared, Lanes::Broadcast(cells.mass[c]) * inverseR3);
+
+            accX = accX - rx * monopole;
+            accY = accY - ry * monopole;
+            accZ = accZ - rz * monopole;
+
+            if (quadrupole)
+            {
+                Lanes qxx = Lanes::Broadcast(cells.qxx[c]);
+                Lanes qyy = Lanes::Broadcast(cells.qyy[c]);
+                Lanes qzz = Lanes::Broadcast(cells.qzz[c]);
+                Lanes qxy = Lanes::Broadcast(cells.qxy[c]);
+                Lanes qxz = Lanes::Broadcast(cells.qxz[c]);
+                Lanes qyz = Lanes::Broadcast(cells.qyz[c]);
+
+                Lanes qrx = qxx * rx + qxy * ry + qxz * rz;
+                Lanes qry = qxy * rx + qyy * ry + qyz * rz;
+                Lanes qrz = qxz * rx + qyz * ry + qzz * rz;
+                Lanes rqr = rx * qrx + ry * qry + rz * qrz;
+
+                Lanes inverseR5 = SelectIfGreaterEqual(r2, minDistanceSquared, inverseR3 * inverseR2);
+                Lanes inverseR7 = SelectIfGreaterEqual(r2, minDistanceSquared, inverseR3 * inverseR2 * inverseR2);
+                Lanes radial = twoAndHalf * rqr * inverseR7;
+
+                accX = accX + qrx * inverseR5 - rx * radial;
+                accY = accY + qry * inverseR5 - ry * radial;
+                accZ = accZ + qrz * inverseR5 - rz * radial;
+            }
+        }
+
+        (Lanes::Load(ax + t) + accX).Store(ax + t);
+        (Lanes::Load(ay + t) + accY).Store(ay + t);
+        (Lanes::Load(az + t) + accZ).Store(az + t);
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef GRAVITY_KERNELS_H
+#define GRAVITY_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Octree.h"
+
+namespace SpaceSim {
+
+// Pairs closer than this are ignored, which also drops self-interaction.
+constexpr float MinInteractionDistanceSquared = 0.01f;
+
+struct ParticleBuffer {
+    std::vector<float> x, y, z, mass;
+
+    void Clear();
+    void Push(const glm::vec3& position, float m);
+    size_t Size() const { return mass.size(); }
+};
+
+struct CellBuffer {
+    std::vector<float> x, y, z, mass;
+    std::vector<float> qxx, qyy, qzz, qxy, qxz, qyz;
+
+    void Clear();
+    void Push(const OctreeNode& node);
+    size_t Size() const { return mass.size(); }
+};
+
+// Targets are processed in blocks of GetKernelLaneWidth() bodies, so target and acceleration
+// arrays must be padded to a multiple of it. Accelerations are accumulated, not overwritten.
+uint32_t GetKernelLaneWidth();
+
+void AccumulateParticleParticle(const ParticleBuffer& sources, const float* tx, const float* ty, const float* tz,
+                                size_t targetCount, float* ax, float* ay, float* az);
+
+void AccumulateParticleCell(const CellBuffer& cells, bool quadrupole, const float* tx, const float* ty, const float* tz,
+                            size_t targetCount, float* ax, float* ay, float* az);
+
+}
+
+#endif
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "GravitySimulation.h"
-#include <random>
+#include "ThreadPool.h"
+#include "InitialConditions.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
 #include <cmath>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/ext/scalar_constants.hpp>
@@ -11,6 +15,8 @@ GravitySimulation::GravitySimulation()
 {
     m_Shader = std::make_unique<Shader>();
     m_Skybox = std::make_unique<Skybox>();
+    m_GasRenderer = std::make_unique<PointCloud>();
+    m_Solver.SetExternalField(&m_ExternalField);
 }
 
 void GravitySimulation::Init()
@@ -27,6 +33,7 @@ void GravitySimulation::Init()
     };
     
     m_Skybox->Init(skyboxFaces);
+    m_GasRenderer->Init();
     
     Reset();
 }
@@ -35,105 +42,495 @@ void GravitySimulation::Update(float deltaTime, float gravityStrength)
 {
     m_Time += deltaTime * 0.5f;
     
-    for (auto& body : m_Bodies) {
-        body->Update(m_Bodies, deltaTime, gravityStrength);
+    if (m_SpatialSortStale || m_SpatialSort.Size() != m_Bodies.Size())
+    {
+        m_SpatialSort.Update(m_Bodies.GetPositions());
+        m_SpatialSortStale = false;
     }
+    
+    if (m_Autotuner.GetSettings().enabled && m_Autotuner.NeedsTuning(m_Bodies.Size()))
+        RunAutotune(gravityStrength);
+    
+    m_ExternalField.SetTime(m_SimulationTime);
+    if (m_Gas.GetParticleCount() > 0)
+    {
+        // The gas runs the bodies' gravity as well, through the same solver and tree.
+        m_Gas.ComputeAccelerations(m_Solver, gravityStrength, m_Bodies.GetPositions(), m_Bodies.GetMasses(), m_Accelerations);
+        m_PreviousGasPositions = m_Gas.GetPositions();
+        m_Gas.Integrate(deltaTime);
+    }
+    else
+    {
+        m_Solver.ComputeAccelerations(m_Bodies.GetPositions(), m_Bodies.GetMasses(), m_SpatialSort, gravityStrength, m_Accelerations);
+    }
+    
+    const double stepStart = m_SimulationTime;
+    m_PreviousPositions = m_Bodies.GetPositions();
+    Integrate(deltaTime);
+    m_SimulationTime += deltaTime;
+    UpdateSpatialOrder();
+
+    if (m_Encounters.GetSettings().enabled)
+        m_Encounters.Detect(m_Bodies, m_SpatialSort, m_BroadPhase, stepStart, deltaTime);
+
+    if (m_CollisionsEnabled)
+        ResolveCollisions();
+
+    m_StepCount++;
+    m_SpatialIndex.MarkMoved();
+    m_Orbits.Update(m_Bodies, m_StepCount, m_SimulationTime, gravityStrength);
+
+    if (SimulationState* state = m_History.BeginCapture(m_StepCount))
+    {
+        CaptureState(*state);
+        m_History.EndCapture();
+    }
+}
+
+void GravitySimulation::Integrate(float deltaTime)
+{
+    glm::vec3* positions = m_Bodies.GetPositions().data();
+    glm::vec3* velocities = m_Bodies.GetVelocities().data();
+
+    ThreadPool::Get().ParallelFor(m_Bodies.Size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            velocities[i] += m_Accelerations[i] * deltaTime;
+            positions[i] += velocities[i] * deltaTime;
+        }
+    });
+}
+
+const SpatialIndex& GravitySimulation::GetSpatialIndex()
+{
+    m_SpatialIndex.Update(m_Bodies);
+    return m_SpatialIndex;
+}
+
+float GravitySimulation::GetMaxStableTimestep() const
+{
+    return m_Gas.GetParticleCount() > 0 ? m_Gas.GetMaxStableTimestep() : 0.0f;
+}
+
+void GravitySimulation::SetAutotuneSettings(const AutotuneSettings& settings)
+{
+    if (settings.forceErrorTolerance != m_Autotuner.GetSettings().forceErrorTolerance)
+        m_Autotuner.Invalidate();
+    m_Autotuner.SetSettings(settings);
+}
+
+void GravitySimulation::RunAutotune(float gravityStrength)
+{
+    const AutotuneResult& result = m_Autotuner.Tune(m_Bodies.GetPositions(), m_Bodies.GetMasses(), m_SpatialSort,
+                                                    gravityStrength, m_Solver.GetSettings());
+    m_Solver.SetSettings(result.solver);
+    
+    std::cout << "Autotune: " << result.bodyCount << " bodies -> " << GetSolverName(result.solver.type);
+    if (result.solver.type != SolverType::DirectSum)
+        std::cout << ", opening angle " << result.solver.openingAngle << (result.solver.expansionOrder >= 2 ? ", quadrupole" : ", monopole");
+    std::cout << ", " << result.threadCount << " threads, " << result.stepMs << " ms per force pass, error "
+              << result.forceError << " (tolerance " << m_Autotuner.GetSettings().forceErrorTolerance << "), "
+              << result.trialCount << " trials in " << result.tuningMs << " ms" << std::endl;
+}
 
-    for (size_t i = 0; i < m_Bodies.size(); i++) {
-        for (size_t j = i + 1; j < m_Bodies.size(); j++) {
-            if (m_Bodies[i]->CheckCollision(m_Bodies[j])) {
-                m_Bodies[i]->ResolveCollision(m_Bodies[j]);
+void GravitySimulation::UpdateSpatialOrder()
+{
+    m_SpatialSort.Update(m_Bodies.GetPositions());
+
+    if (m_ReorderInterval > 0 && m_StepCount % m_ReorderInterval == 0)
+    {
+        const std::vector<uint32_t>& order = m_SpatialSort.GetSortedIndices();
+        m_Bodies.Permute(order);
+        if (m_PreviousPositions.size() == order.size())
+        {
+            m_PermuteScratch.resize(order.size());
+            for (size_t i = 0; i < order.size(); i++) {
+                m_PermuteScratch[i] = m_PreviousPositions[order[i]];
             }
+            m_PreviousPositions.swap(m_PermuteScratch);
+        }
+        PermuteSolverTree(order);
+        m_SpatialIndex.OnBodiesPermuted(m_SpatialSort.GetSortedIndices());
+        m_SpatialSort.OnBodiesPermuted();
+    }
+}
+
+void GravitySimulation::PermuteSolverTree(const std::vector<uint32_t>& order)
+{
+    const size_t gasCount = m_Gas.GetParticleCount();
+    if (gasCount == 0)
+    {
+        m_Solver.OnBodiesPermuted(order);
+        return;
+    }
+
+    // The tree also holds the gas, which stays behind the bodies.
+    m_SolverOrder.assign(order.begin(), order.end());
+    for (size_t i = 0; i < gasCount; i++) {
+        m_SolverOrder.push_back(static_cast<uint32_t>(order.size() + i));
+    }
+    m_Solver.OnBodiesPermuted(m_SolverOrder);
+}
+
+void GravitySimulation::ResolveCollisions()
+{
+    const std::vector<glm::vec3>& positions = m_Bodies.GetPositions();
+    const std::vector<float>& radii = m_Bodies.GetRadii();
+
+    // The encounter pass already found every pair within reach this step; keep the ones overlapping now.
+    if (m_Encounters.GetSettings().enabled)
+    {
+        m_CollisionPairs.clear();
+        for (const BodyPair& pair : m_BroadPhase.GetPairs()) {
+            const float reach = radii[pair.first] + radii[pair.second];
+            const glm::vec3 delta = positions[pair.second] - positions[pair.first];
+            if (glm::dot(delta, delta) < reach * reach)
+                m_CollisionPairs.push_back(pair);
         }
     }
+    else
+    {
+        m_BroadPhase.FindPairs(m_SpatialSort, positions, radii);
+    }
+    const std::vector<BodyPair>& pairs = m_Encounters.GetSettings().enabled ? m_CollisionPairs : m_BroadPhase.GetPairs();
+
+    if (pairs.size() < 256)
+    {
+        for (const BodyPair& pair : pairs) {
+            ResolveCollision(pair.first, pair.second);
+        }
+        return;
+    }
+
+    // Each pair goes into the first batch after every earlier pair that shares one of its bodies. Bodies
+    // within a batch are disjoint, so resolving batches in order, each in parallel, gives exactly the
+    // result of the sequential loop above on any number of threads.
+    m_BodyBatches.assign(m_Bodies.Size(), 0);
+    m_PairBatches.resize(pairs.size());
+    uint32_t batchCount = 0;
+    for (size_t p = 0; p < pairs.size(); p++) {
+        uint32_t batch = std::max(m_BodyBatches[pairs[p].first], m_BodyBatches[pairs[p].second]);
+        m_PairBatches[p] = batch;
+        m_BodyBatches[pairs[p].first] = batch + 1;
+        m_BodyBatches[pairs[p].second] = batch + 1;
+        batchCount = std::max(batchCount, batch + 1);
+    }
+
+    m_BatchOffsets.assign(batchCount + 1, 0);
+    for (uint32_t batch : m_PairBatches) {
+        m_BatchOffsets[batch + 1]++;
+    }
+    for (uint32_t b = 0; b < batchCount; b++) {
+        m_BatchOffsets[b + 1] += m_BatchOffsets[b];
+    }
+
+    m_BatchedPairs.resize(pairs.size());
+    std::vector<uint32_t> cursor(m_BatchOffsets.begin(), m_BatchOffsets.end() - 1);
+    for (size_t p = 0; p < pairs.size(); p++) {
+        m_BatchedPairs[cursor[m_PairBatches[p]]++] = pairs[p];
+    }
+
+    for (uint32_t b = 0; b < batchCount; b++) {
+        const uint32_t first = m_BatchOffsets[b];
+        ThreadPool::Get().ParallelFor(m_BatchOffsets[b + 1] - first, 64, [&](size_t begin, size_t end) {
+            for (size_t p = first + begin; p < first + end; p++) {
+                ResolveCollision(m_BatchedPairs[p].first, m_BatchedPairs[p].second);
+            }
+        });
+    }
+}
+
+void GravitySimulation::ResolveCollision(uint32_t first, uint32_t second)
+{
+    std::vector<glm::vec3>& positions = m_Bodies.GetPositions();
+    std::vector<glm::vec3>& velocities = m_Bodies.GetVelocities();
+    const std::vector<float>& masses = m_Bodies.GetMasses();
+    const std::vector<float>& radii = m_Bodies.GetRadii();
+
+    glm::vec3 direction = positions[second] - positions[first];
+    float distance = glm::length(direction);
+    float minDistance = radii[first] + radii[second];
+
+    if (distance >= minDistance)
+        return;
+    
+    if (distance == 0.0f)
+    {
+        direction = glm::vec3(0.001f, 0.0f, 0.0f);
+        distance = 0.001f;
+    }
+    
+    glm::vec3 normal = direction / distance;
+    
+    float overlap = minDistance - distance;
+    positions[first] -= normal * (overlap * 0.5f);
+    positions[second] += normal * (overlap * 0.5f);
+    
+    glm::vec3 relativeVelocity = velocities[second] - velocities[first];
+    
+    float velocityAlongNormal = glm::dot(relativeVelocity, normal);
+    
+    if (velocityAlongNormal > 0)
+        return;
+    
+    float restitution = 0.8f;
+    
+    float impulseScalar = -(1.0f + restitution) * velocityAlongNormal;
+    impulseScalar /= (1.0f / masses[first]) + (1.0f / masses[second]);
+    
+    glm::vec3 impulse = normal * impulseScalar;
+    velocities[first] -= impulse / masses[first];
+    velocities[second] += impulse / masses[second];
+}
+
+struct DiagnosticSums {
+    double kineticEnergy;
+    double potentialEnergy;
+    glm::dvec3 momentum;
+    glm::dvec3 angularMomentum;
+
+    DiagnosticSums operator+(const DiagnosticSums& other) const
+    {
+        return { kineticEnergy + other.kineticEnergy, potentialEnergy + other.potentialEnergy,
+                 momentum + other.momentum, angularMomentum + other.angularMomentum };
+    }
+};
+
+const EnergyDiagnostics& GravitySimulation::ComputeDiagnostics(float gravityStrength)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    const std::vector<glm::vec3>& positions = m_Bodies.GetPositions();
+    const std::vector<glm::vec3>& velocities = m_Bodies.GetVelocities();
+    const std::vector<float>& masses = m_Bodies.GetMasses();
+    if (m_Gas.GetParticleCount() > 0)
+    {
+        // The solver's tree holds the gas too, so the bodies' potentials include its pull.
+        m_Gas.GatherGravitySources(positions, masses);
+        m_Solver.ComputePotentials(m_Gas.GetGravityPositions(), m_Gas.GetGravityMasses(), gravityStrength, m_Potentials, positions.size());
+    }
+    else
+    {
+        m_Solver.ComputePotentials(positions, masses, gravityStrength, m_Potentials);
+    }
+    m_ExternalField.SetTime(m_SimulationTime);
+    const bool hasExternal = !m_ExternalField.IsEmpty();
+
+    const DiagnosticSums zero{ 0.0, 0.0, glm::dvec3(0.0), glm::dvec3(0.0) };
+    DiagnosticSums sums = ParallelReduce(m_Bodies.Size(), zero, m_ReductionMode, [&](size_t i) {
+        const double mass = masses[i];
+        const glm::dvec3 position(positions[i]);
+        const glm::dvec3 momentum = glm::dvec3(velocities[i]) * mass;
+        double potential = 0.5 * m_Potentials[i];
+        if (hasExternal)
+            potential += gravityStrength * m_ExternalField.GetPotential(positions[i]);
+        return DiagnosticSums{ 0.5 * glm::dot(momentum, glm::dvec3(velocities[i])), mass * potential,
+                               momentum, glm::cross(position, momentum) };
+    });
+
+    m_Diagnostics.kineticEnergy = sums.kineticEnergy;
+    m_Diagnostics.potentialEnergy = sums.potentialEnergy;
+    m_Diagnostics.totalEnergy = sums.kineticEnergy + sums.potentialEnergy;
+    m_Diagnostics.momentum = sums.momentum;
+    m_Diagnostics.angularMomentum = sums.angularMomentum;
+    m_Diagnostics.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return m_Diagnostics;
+}
+
+void GravitySimulation::PublishRenderState(double stepInterval)
+{
+    RenderState& state = m_RenderStates.GetWriteBuffer();
+    state.positions = m_Bodies.GetPositions();
+    state.radii = m_Bodies.GetRadii();
+    state.colors = m_Bodies.GetColors();
+    state.gasPositions = m_Gas.GetPositions();
+
+    // Bodies spawned since the last step have no previous position; such a state is drawn as is.
+    if (m_PreviousPositions.size() == state.positions.size())
+        state.previousPositions = m_PreviousPositions;
+    else
+        state.previousPositions.clear();
+    if (m_PreviousGasPositions.size() == state.gasPositions.size())
+        state.previousGasPositions = m_PreviousGasPositions;
+    else
+        state.previousGasPositions.clear();
+
+    state.sunIndex = m_Bodies.IndexOf(m_SunHandle);
+    state.time = m_Time;
+    state.stepInterval = stepInterval;
+    state.publishTime = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    m_RenderStates.Publish();
+}
+
+bool GravitySimulation::PublishPlayback(TrajectoryReader& trajectory, double time)
+{
+    RenderState& state = m_RenderStates.GetWriteBuffer();
+    if (!trajectory.Sample(time, state.positions, state.radii, state.colors, state.sunIndex))
+        return false;
+
+    // Frames are already blended to the requested time; gas is not recorded.
+    state.previousPositions.clear();
+    state.gasPositions.clear();
+    state.previousGasPositions.clear();
+    state.time = m_Time;
+    state.stepInterval = 0.0;
+    state.publishTime = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    m_RenderStates.Publish();
+    return true;
 }
 
-void GravitySimulation::Render(const glm::mat4& view, const glm::mat4& projection)
+void GravitySimulation::Render(const glm::mat4& view, const glm::mat4& projection, bool interpolate)
 {
     m_Skybox->Draw(view, projection);
     
-    glm::vec3 sunPosition = m_Bodies.empty() ? glm::vec3(0.0f) : m_Bodies[0]->GetPosition();
+    const RenderState& state = m_RenderStates.Acquire();
     
-    for (size_t i = 0; i < m_Bodies.size(); i++) {
-        m_Shader->Bind();
-        
-        m_Shader->SetVec4("u_Color", m_Bodies[i]->GetColor());
+    // Blend from the previous step towards the published one over the real time one step takes.
+    float interpolation = 1.0f;
+    if (interpolate && state.stepInterval > 0.0)
+    {
+        const double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        interpolation = static_cast<float>(std::clamp((now - state.publishTime) / state.stepInterval, 0.0, 1.0));
+    }
+    
+    const std::vector<glm::vec3>& positions = state.positions;
+    const bool blendBodies = interpolation < 1.0f && !state.previousPositions.empty();
+    auto renderPosition = [&](size_t i) {
+        return blendBodies ? glm::mix(state.previousPositions[i], positions[i], interpolation) : positions[i];
+    };
+    
+    const uint32_t sunIndex = state.sunIndex;
+    glm::vec3 sunPosition = sunIndex == InvalidBodyIndex ? glm::vec3(0.0f) : renderPosition(sunIndex);
+    
+    m_Shader->Bind();
+    m_Shader->SetMat4("u_View", view);
+    m_Shader->SetMat4("u_Projection", projection);
+    m_Shader->SetVec3("u_LightPos", sunPosition);
+    m_Shader->SetVec3("u_LightColor", glm::vec3(1.0f, 1.0f, 1.0f));
+    m_Shader->SetFloat("u_AmbientStrength", 0.3f);
+    m_Shader->SetFloat("u_Time", state.time);
+    
+    const std::vector<float>& radii = state.radii;
+    const std::vector<glm::vec4>& colors = state.colors;
+    
+    for (size_t i = 0; i < positions.size(); i++) {
+        m_Shader->SetVec4("u_Color", colors[i]);
         
-        glm::mat4 model = glm::translate(glm::mat4(1.0f), m_Bodies[i]->GetPosition());
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), renderPosition(i));
+        model = glm::scale(model, glm::vec3(radii[i]));
         m_Shader->SetMat4("u_Model", model);
-        m_Shader->SetMat4("u_View", view);
-        m_Shader->SetMat4("u_Projection", projection);
-        
-        m_Shader->SetVec3("u_LightPos", sunPosition);
-        m_Shader->SetVec3("u_LightColor", glm::vec3(1.0f, 1.0f, 1.0f));
-        m_Shader->SetFloat("u_AmbientStrength", 0.3f);
-        m_Shader->SetFloat("u_Time", m_Time);
         
-        m_Shader->SetBool("u_IsSun", i == 0);
+        m_Shader->SetBool("u_IsSun", i == sunIndex);
         
-        m_Bodies[i]->DrawMesh();
+        GetSphereMesh(radii[i]).Draw();
+    }
+    
+    const std::vector<glm::vec3>& gasPositions = state.gasPositions;
+    if (interpolation < 1.0f && !state.previousGasPositions.empty())
+    {
+        m_RenderScratch.resize(gasPositions.size());
+        for (size_t i = 0; i < gasPositions.size(); i++) {
+            m_RenderScratch[i] = glm::mix(state.previousGasPositions[i], gasPositions[i], interpolation);
+        }
+        m_GasRenderer->Draw(m_RenderScratch, view, projection, glm::vec4(0.9f, 0.6f, 0.4f, 1.0f), 40.0f);
+    }
+    else
+    {
+        m_GasRenderer->Draw(gasPositions, view, projection, glm::vec4(0.9f, 0.6f, 0.4f, 1.0f), 40.0f);
     }
 }
 
-GravitySimulation::OrbitParameters GravitySimulation::GetRandomOrbitParameters(float gravityStrength)
+Sphere& GravitySimulation::GetSphereMesh(float radius)
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> distRadius(3.0f, 15.0f);
-    std::uniform_real_distribution<float> distAngle(0.0f, 2.0f * glm::pi<float>());
-    std::uniform_real_distribution<float> distInclination(-0.3f, 0.3f);
+    uint32_t detail = static_cast<uint32_t>(glm::max(10.0f, glm::min(30.0f, radius * 5.0f)));
+    
+    auto& mesh = m_SphereMeshes[detail];
+    if (!mesh)
+        mesh = std::make_unique<Sphere>(1.0f, detail, detail);
     
+    return *mesh;
+}
+
+GravitySimulation::OrbitParameters GravitySimulation::GetRandomOrbitParameters(RandomStream& random, float gravityStrength)
+{
     OrbitParameters params;
     
-    params.distance = distRadius(gen);
+    params.distance = random.NextFloat(3.0f, 15.0f);
     
     const float sunMass = 1000.0f;
     params.speed = std::sqrt(gravityStrength * sunMass / params.distance);
     
-    params.angle = distAngle(gen);
+    params.angle = random.NextFloat(0.0f, 2.0f * glm::pi<float>());
     
-    params.inclination = distInclination(gen);
+    params.inclination = random.NextFloat(-0.3f, 0.3f);
     
     return params;
 }
 
+size_t GravitySimulation::SpawnBodies(size_t count, const BodyGenerator& generator)
+{
+    const size_t first = m_Bodies.Append(count);
+    m_SpatialIndex.Invalidate();
+    const uint64_t firstStream = m_NextStream;
+    m_NextStream += count;
+
+    std::vector<glm::vec3>& positions = m_Bodies.GetPositions();
+    std::vector<glm::vec3>& velocities = m_Bodies.GetVelocities();
+    std::vector<float>& masses = m_Bodies.GetMasses();
+    std::vector<float>& radii = m_Bodies.GetRadii();
+    std::vector<glm::vec4>& colors = m_Bodies.GetColors();
+
+    ThreadPool::Get().ParallelFor(count, 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            RandomStream random(m_Seed, firstStream + i);
+            CelestialBody body{ 1.0f, glm::vec4(1.0f), glm::vec3(0.0f), glm::vec3(0.0f), 1.0f };
+            generator(i, random, body);
+
+            positions[first + i] = body.position;
+            velocities[first + i] = body.velocity;
+            masses[first + i] = body.mass;
+            radii[first + i] = body.radius;
+            colors[first + i] = body.color;
+        }
+    });
+
+    return first;
+}
+
+void GravitySimulation::SpawnRandomPlanets(size_t count)
+{
+    SpawnBodies(count, [this](size_t, RandomStream& random, CelestialBody& body) {
+        OrbitParameters orbit = GetRandomOrbitParameters(random);
+        
+        body.position = glm::vec3(
+            orbit.distance * std::cos(orbit.angle),
+            orbit.distance * std::sin(orbit.inclination),
+            orbit.distance * std::sin(orbit.angle)
+        );
+        
+        body.velocity = glm::vec3(
+            -orbit.speed * std::sin(orbit.angle),
+            orbit.speed * std::cos(orbit.inclination) * 0.1f,
+            orbit.speed * std::cos(orbit.angle)
+        );
+        
+        body.radius = random.NextFloat(0.2f, 0.6f);
+        body.mass = body.radius * body.radius * body.radius * 10.0f;
+        
+        if (random.NextFloat() > 0.5f) {
+            float blue = 0.5f + random.NextFloat() * 0.5f;
+            float green = 0.3f + random.NextFloat() * 0.7f;
+            body.color = glm::vec4(0.0f, green, blue, 1.0f);
+        } else {
+            float red = 0.7f + random.NextFloat() * 0.3f;
+            float green = 0.2f + random.NextFloat() * 0.3f;
+            body.color = glm::vec4(red, green, 0.1f, 1.0f);
+        }
+    });
+}
+
 void GravitySimulation::AddRandomPlanet()
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> distRadius(0.2f, 0.6f);
-    std::uniform_real_distribution<float> distColor(0.0f, 1.0f);
-    std::uniform_real_distribution<float> distColorType(0.0f, 1.0f);
-    
-    OrbitParameters orbit = GetRandomOrbitParameters();
-    
-    glm::vec3 position(
-        orbit.distance * std::cos(orbit.angle),
-        orbit.distance * std::sin(orbit.inclination),
-        orbit.distance * std::sin(orbit.angle)
-    );
-    
-    glm::vec3 velocity(
-        -orbit.speed * std::sin(orbit.angle),
-        orbit.speed * std::cos(orbit.inclination) * 0.1f,
-        orbit.speed * std::cos(orbit.angle)
-    );
-    
-    float radius = distRadius(gen);
-    float mass = radius * radius * radius * 10.0f;
-    
-    glm::vec4 color;
-    if (distColorType(gen) > 0.5f) {
-        float blue = 0.5f + distColor(gen) * 0.5f;
-        float green = 0.3f + distColor(gen) * 0.7f;
-        color = glm::vec4(0.0f, green, blue, 1.0f);
-    } else {
-        float red = 0.7f + distColor(gen) * 0.3f;
-        float green = 0.2f + distColor(gen) * 0.3f;
-        color = glm::vec4(red, green, 0.1f, 1.0f);
-    }
-    
-    m_Bodies.push_back(std::make_shared<CelestialBody>(radius, color, position, velocity, mass));
+    SpawnRandomPlanets(1);
 }
 
 void GravitySimulation::AddPlanetWithParams(float distance, float angle, float radius, const glm::vec4& color)
@@ -142,10 +539,8 @@ void GravitySimulation::AddPlanetWithParams(float distance, float angle, float r
     
     const float orbitSpeed = std::sqrt(1.0f * sunMass / distance);
     
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> distInclination(-0.2f, 0.2f);
-    float inclination = distInclination(gen);
+    RandomStream random(m_Seed, m_NextStream++);
+    float inclination = random.NextFloat(-0.2f, 0.2f);
     
     glm::vec3 position(
         distance * std::cos(angle),
@@ -161,20 +556,386 @@ void GravitySimulation::AddPlanetWithParams(float distance, float angle, float r
     
     float mass = radius * radius * radius * 10.0f;
     
-    m_Bodies.push_back(std::make_shared<CelestialBody>(radius, color, position, velocity, mass));
+    m_Bodies.Add(CelestialBody{ radius, color, position, velocity, mass });
+    m_SpatialIndex.Invalidate();
+}
+
+void GravitySimulation::RemoveBody(BodyHandle handle)
+{
+    m_Bodies.Remove(handle);
+    m_Solver.Invalidate();
+    m_SpatialIndex.Invalidate();
+}
+
+void GravitySimulation::AddGasDisk(size_t particleCount, float innerRadius, float outerRadius, float totalMass)
+{
+    if (particleCount == 0 || outerRadius <= innerRadius)
+        return;
+    
+    const uint32_t sunIndex = m_Bodies.IndexOf(m_SunHandle);
+    GasDiskParams disk;
+    disk.count = particleCount;
+    disk.centralMass = sunIndex == InvalidBodyIndex ? 1000.0f : m_Bodies.GetMasses()[sunIndex];
+    disk.innerRadius = innerRadius;
+    disk.outerRadius = outerRadius;
+    disk.totalMass = totalMass;
+    disk.center = sunIndex == InvalidBodyIndex ? glm::vec3(0.0f) : m_Bodies.GetPositions()[sunIndex];
+    disk.velocity = sunIndex == InvalidBodyIndex ? glm::vec3(0.0f) : m_Bodies.GetVelocities()[sunIndex];
+    
+    const uint64_t firstStream = m_NextStream;
+    m_NextStream += particleCount;
+    m_Gas.SpawnParticles(particleCount, m_Seed, firstStream, GasDisk(disk, m_Gas.GetSettings()));
+}
+
+void GravitySimulation::ClearGas()
+{
+    m_Gas.Clear();
+}
+
+void GravitySimulation::CaptureState(SimulationState& state) const
+{
+    state.stepCount = m_StepCount;
+    state.simulationTime = m_SimulationTime;
+    state.renderTime = m_Time;
+    state.seed = m_Seed;
+    state.nextStream = m_NextStream;
+    state.sunHandle = m_SunHandle;
+    state.handleCapacity = m_Bodies.GetHandleCapacity();
+
+    state.positions = m_Bodies.GetPositions();
+    state.velocities = m_Bodies.GetVelocities();
+    state.masses = m_Bodies.GetMasses();
+    state.radii = m_Bodies.GetRadii();
+    state.colors = m_Bodies.GetColors();
+    state.handles = m_Bodies.GetHandles();
+
+    state.gasPositions = m_Gas.GetPositions();
+    state.gasVelocities = m_Gas.GetVelocities();
+    state.gasMasses = m_Gas.GetMasses();
+    state.gasInternalEnergies = m_Gas.GetInternalEnergies();
+    state.gasSmoothingLengths = m_Gas.GetSmoothingLengths();
+}
+
+void GravitySimulation::RestoreState(const SimulationState& state)
+{
+    m_Bodies.Clear();
+    m_Bodies.Append(state.positions.size());
+    m_Bodies.GetPositions() = state.positions;
+    m_Bodies.GetVelocities() = state.velocities;
+    m_Bodies.GetMasses() = state.masses;
+    m_Bodies.GetRadii() = state.radii;
+    m_Bodies.GetColors() = state.colors;
+    m_Bodies.RestoreHandles(state.handles, state.handleCapacity);
+
+    m_Gas.Clear();
+    m_Gas.AddParticles(state.gasPositions.size());
+    m_Gas.GetPositions() = state.gasPositions;
+    m_Gas.GetVelocities() = state.gasVelocities;
+    m_Gas.GetMasses() = state.gasMasses;
+    m_Gas.GetInternalEnergies() = state.gasInternalEnergies;
+    m_Gas.GetSmoothingLengths() = state.gasSmoothingLengths;
+
+    m_StepCount = state.stepCount;
+    m_SimulationTime = state.simulationTime;
+    m_Time = state.renderTime;
+    m_Seed = state.seed;
+    m_NextStream = state.nextStream;
+    m_SunHandle = state.sunHandle;
+    OnStateReplaced();
+}
+
+void GravitySimulation::OnStateReplaced()
+{
+    m_PreviousPositions.clear();
+    m_PreviousGasPositions.clear();
+    // Sorting takes longer than restoring a large state, so it waits for the next step.
+    m_SpatialSortStale = true;
+    m_Solver.Invalidate();
+    m_SpatialIndex.Invalidate();
+}
+
+static_assert(sizeof(PotentialComponent) == 36, "PotentialComponent is written to checkpoints as is");
+
+bool GravitySimulation::SaveCheckpoint(const std::string& path) const
+{
+    CheckpointWriter writer;
+    CheckpointParameters parameters;
+    PrepareCheckpoint(writer, parameters);
+    return writer.Write(path, parameters);
+}
+
+void GravitySimulation::PrepareCheckpoint(CheckpointWriter& writer, CheckpointParameters& parameters) const
+{
+    parameters.stepCount = m_StepCount;
+    parameters.simulationTime = m_SimulationTime;
+    parameters.seed = m_Seed;
+    parameters.nextStream = m_NextStream;
+    parameters.handleCapacity = m_Bodies.GetHandleCapacity();
+    parameters.sceneBodyCount = m_SceneBodyCount;
+    parameters.renderTime = m_Time;
+    parameters.sunHandle = m_SunHandle;
+    parameters.scene = static_cast<uint32_t>(m_Scene);
+    parameters.sceneGravityStrength = m_SceneGravityStrength;
+    parameters.collisionsEnabled = m_CollisionsEnabled ? 1 : 0;
+    parameters.reorderInterval = m_ReorderInterval;
+    parameters.reductionMode = static_cast<uint32_t>(m_ReductionMode);
+
+    const SolverSettings& solver = m_Solver.GetSettings();
+    parameters.solverType = static_cast<uint32_t>(solver.type);
+    parameters.openingAngle = solver.openingAngle;
+    parameters.expansionOrder = solver.expansionOrder;
+    parameters.leafSize = solver.leafSize;
+    parameters.rebuildThreshold = solver.rebuildThreshold;
+
+    writer.Clear();
+    writer.AddSection(CheckpointSection::Positions, m_Bodies.GetPositions());
+    writer.AddSection(CheckpointSection::Velocities, m_Bodies.GetVelocities());
+    writer.AddSection(CheckpointSection::Masses, m_Bodies.GetMasses());
+    writer.AddSection(CheckpointSection::Radii, m_Bodies.GetRadii());
+    writer.AddSection(CheckpointSection::Colors, m_Bodies.GetColors());
+    writer.AddSection(CheckpointSection::Handles, m_Bodies.GetHandles());
+    writer.AddSection(CheckpointSection::GasPositions, m_Gas.GetPositions());
+    writer.AddSection(CheckpointSection::GasVelocities, m_Gas.GetVelocities());
+    writer.AddSection(CheckpointSection::GasMasses, m_Gas.GetMasses());
+    writer.AddSection(CheckpointSection::GasInternalEnergies, m_Gas.GetInternalEnergies());
+    writer.AddSection(CheckpointSection::GasSmoothingLengths, m_Gas.GetSmoothingLengths());
+    writer.AddSection(CheckpointSection::ExternalPotentials, m_ExternalField.GetComponents());
+}
+
+bool GravitySimulation::LoadCheckpoint(const std::string& path)
+{
+    CheckpointReader reader;
+    if (!reader.Open(path) || !reader.Verify())
+        return false;
+
+    const uint64_t bodyCount = reader.GetSectionCount(CheckpointSection::Positions);
+    const uint64_t gasCount = reader.GetSectionCount(CheckpointSection::GasPositions);
+    auto matches = [&](CheckpointSection section, uint32_t elementSize, uint64_t count) {
+        return reader.GetSectionElementSize(section) == elementSize && reader.GetSectionCount(section) == count;
+    };
+    const bool consistent = matches(CheckpointSection::Positions, sizeof(glm::vec3), bodyCount) &&
+                            matches(CheckpointSection::Velocities, sizeof(glm::vec3), bodyCount) &&
+                            matches(CheckpointSection::Masses, sizeof(float), bodyCount) &&
+                            matches(CheckpointSection::Radii, sizeof(float), bodyCount) &&
+                            matches(CheckpointSection::Colors, sizeof(glm::vec4), bodyCount) &&
+                            matches(CheckpointSection::Handles, sizeof(BodyHandle), bodyCount) &&
+                            matches(CheckpointSection::GasPositions, sizeof(glm::vec3), gasCount) &&
+                            matches(CheckpointSection::GasVelocities, sizeof(glm::vec3), gasCount) &&
+                            matches(CheckpointSection::GasMasses, sizeof(float), gasCount) &&
+                            matches(CheckpointSection::GasInternalEnergies, sizeof(float), gasCount) &&
+                            matches(CheckpointSection::GasSmoothingLengths, sizeof(float), gasCount) &&
+                            (!reader.HasSection(CheckpointSection::ExternalPotentials) ||
+                             reader.GetSectionElementSize(CheckpointSection::ExternalPotentials) == sizeof(PotentialComponent));
+    if (!consistent)
+    {
+        std::cerr << "Checkpoint " << path << " has mismatched body or gas sections" << std::endl;
+        return false;
+    }
+
+    const CheckpointParameters& parameters = reader.GetParameters();
+    if (parameters.scene > static_cast<uint32_t>(Scene::ClusterInGalaxy) ||
+        parameters.reductionMode > static_cast<uint32_t>(ReductionMode::Deterministic) ||
+        parameters.solverType > static_cast<uint32_t>(SolverType::GroupWalk))
+    {
+        std::cerr << "Checkpoint " << path << " has unknown scene " << parameters.scene << ", reduction mode "
+                  << parameters.reductionMode << " or solver " << parameters.solverType << std::endl;
+        return false;
+    }
+
+    // Sections are copied straight from the mapping into the body and gas arrays.
+    std::vector<BodyHandle> handles;
+    m_Bodies.Clear();
+    m_Bodies.Append(bodyCount);
+    m_Gas.Clear();
+    m_Gas.AddParticles(gasCount);
+    std::vector<PotentialComponent> potentials;
+    bool read = reader.ReadSection(CheckpointSection::Positions, m_Bodies.GetPositions()) &&
+                reader.ReadSection(CheckpointSection::Velocities, m_Bodies.GetVelocities()) &&
+                reader.ReadSection(CheckpointSection::Masses, m_Bodies.GetMasses()) &&
+                reader.ReadSection(CheckpointSection::Radii, m_Bodies.GetRadii()) &&
+                reader.ReadSection(CheckpointSection::Colors, m_Bodies.GetColors()) &&
+                reader.ReadSection(CheckpointSection::Handles, handles) &&
+                reader.ReadSection(CheckpointSection::GasPositions, m_Gas.GetPositions()) &&
+                reader.ReadSection(CheckpointSection::GasVelocities, m_Gas.GetVelocities()) &&
+                reader.ReadSection(CheckpointSection::GasMasses, m_Gas.GetMasses()) &&
+                reader.ReadSection(CheckpointSection::GasInternalEnergies, m_Gas.GetInternalEnergies()) &&
+                reader.ReadSection(CheckpointSection::GasSmoothingLengths, m_Gas.GetSmoothingLengths());
+    if (reader.HasSection(CheckpointSection::ExternalPotentials))
+        read = read && reader.ReadSection(CheckpointSection::ExternalPotentials, potentials);
+    if (!read)
+    {
+        // The sections were validated above, so this means a bug; never leave a half-loaded run behind.
+        Reset();
+        return false;
+    }
+    m_Bodies.RestoreHandles(handles, parameters.handleCapacity);
+
+    m_StepCount = parameters.stepCount;
+    m_SimulationTime = parameters.simulationTime;
+    m_Seed = parameters.seed;
+    m_NextStream = parameters.nextStream;
+    m_SceneBodyCount = parameters.sceneBodyCount;
+    m_Time = parameters.renderTime;
+    m_SunHandle = parameters.sunHandle;
+    m_Scene = static_cast<Scene>(parameters.scene);
+    m_SceneGravityStrength = parameters.sceneGravityStrength;
+    m_CollisionsEnabled = parameters.collisionsEnabled != 0;
+    m_ReorderInterval = parameters.reorderInterval;
+    m_ReductionMode = static_cast<ReductionMode>(parameters.reductionMode);
+
+    SolverSettings solver = m_Solver.GetSettings();
+    solver.type = static_cast<SolverType>(parameters.solverType);
+    solver.openingAngle = parameters.openingAngle;
+    solver.expansionOrder = parameters.expansionOrder;
+    solver.leafSize = parameters.leafSize;
+    solver.rebuildThreshold = parameters.rebuildThreshold;
+    m_Solver.SetSettings(solver);
+    m_ExternalField.SetComponents(potentials);
+
+    m_History.Clear();
+    OnStateReplaced();
+    return true;
+}
+
+bool GravitySimulation::RestoreHistory(uint64_t step)
+{
+    if (!m_History.Restore(step, m_RestoreScratch))
+        return false;
+
+    RestoreState(m_RestoreScratch);
+    return true;
 }
 
 void GravitySimulation::Reset()
 {
-    m_Bodies.clear();
+    LoadScene(m_Scene, m_SceneBodyCount, m_SceneGravityStrength);
+}
+
+void GravitySimulation::LoadScene(Scene scene, size_t bodyCount, float gravityStrength)
+{
+    m_Bodies.Clear();
+    m_Gas.Clear();
+    m_PreviousPositions.clear();
+    m_PreviousGasPositions.clear();
+    m_History.Clear();
+    m_Solver.Invalidate();
+    m_SpatialIndex.Invalidate();
+    m_StepCount = 0;
+    m_SimulationTime = 0.0;
+    m_NextStream = 0;
+    m_SunHandle = InvalidBodyHandle;
+    m_Scene = scene;
+    m_SceneBodyCount = bodyCount;
+    m_SceneGravityStrength = gravityStrength;
+    m_ExternalField.SetComponents({});
+    
+    // Star and dark-matter particles are collisionless; their radii are only for drawing.
+    m_CollisionsEnabled = scene == Scene::SolarSystem || scene == Scene::AsteroidBelt;
     
-    m_Bodies.push_back(std::make_shared<CelestialBody>(
+    switch (scene)
+    {
+    case Scene::SolarSystem:
+        AddSolarSystem();
+        break;
+    case Scene::PlummerSphere:
+    {
+        PlummerParams params;
+        params.count = bodyCount;
+        params.gravityStrength = gravityStrength;
+        size_t first = SpawnBodies(bodyCount, PlummerSphere(params));
+        RemoveNetMotion(m_Bodies, first, bodyCount, params.center, params.velocity);
+        break;
+    }
+    case Scene::HernquistHalo:
+    {
+        HernquistParams params;
+        params.count = bodyCount;
+        params.gravityStrength = gravityStrength;
+        size_t first = SpawnBodies(bodyCount, HernquistHalo(params));
+        RemoveNetMotion(m_Bodies, first, bodyCount, params.center, params.velocity);
+        break;
+    }
+    case Scene::DiskGalaxy:
+    {
+        HernquistParams halo;
+        halo.count = bodyCount / 2;
+        halo.totalMass = 1000.0f;
+        halo.scaleRadius = 4.0f;
+        halo.gravityStrength = gravityStrength;
+        halo.color = glm::vec4(0.8f, 0.5f, 0.4f, 1.0f);
+        
+        ExponentialDiskParams disk;
+        disk.count = bodyCount - halo.count;
+        disk.diskMass = 100.0f;
+        disk.haloMass = halo.totalMass;
+        disk.haloScaleRadius = halo.scaleRadius;
+        disk.gravityStrength = gravityStrength;
+        
+        size_t first = SpawnBodies(halo.count, HernquistHalo(halo));
+        SpawnBodies(disk.count, ExponentialDisk(disk));
+        RemoveNetMotion(m_Bodies, first, bodyCount, glm::vec3(0.0f), glm::vec3(0.0f));
+        break;
+    }
+    case Scene::AsteroidBelt:
+    {
+        m_SunHandle = m_Bodies.Add(CelestialBody{ 1.5f, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), glm::vec3(0.0f), glm::vec3(0.0f), 1000.0f });
+        
+        KeplerianBeltParams params;
+        params.count = bodyCount;
+        params.gravityStrength = gravityStrength;
+        SpawnBodies(bodyCount, KeplerianBelt(params));
+        break;
+    }
+    case Scene::ClusterInGalaxy:
+    {
+        PotentialComponent halo;
+        halo.type = PotentialType::NFWHalo;
+        halo.mass = 20000.0f;
+        halo.scaleRadius = 20.0f;
+
+        PotentialComponent disk;
+        disk.type = PotentialType::MiyamotoNagaiDisk;
+        disk.mass = 5000.0f;
+        disk.scaleRadius = 6.0f;
+        disk.scaleHeight = 0.5f;
+
+        PotentialComponent bar;
+        bar.type = PotentialType::RotatingBar;
+        bar.mass = 1000.0f;
+        bar.scaleRadius = 4.0f;
+        bar.scaleHeight = 1.0f;
+        m_ExternalField.SetComponents({ halo, disk, bar });
+
+        // Corotation just outside the bar end.
+        bar.patternSpeed = std::sqrt(gravityStrength) * m_ExternalField.GetCircularSpeed(5.0f) / 5.0f;
+        m_ExternalField.SetComponents({ halo, disk, bar });
+
+        // A cluster on a circular orbit well outside the bar, large enough to lose stars into tidal tails.
+        const float orbitRadius = 12.0f;
+        PlummerParams cluster;
+        cluster.count = bodyCount;
+        cluster.totalMass = 20.0f;
+        cluster.scaleRadius = 0.5f;
+        cluster.maxRadius = 2.5f;
+        cluster.gravityStrength = gravityStrength;
+        cluster.center = glm::vec3(orbitRadius, 0.0f, 0.0f);
+        cluster.velocity = glm::vec3(0.0f, 0.0f, std::sqrt(gravityStrength) * m_ExternalField.GetCircularSpeed(orbitRadius));
+        size_t first = SpawnBodies(bodyCount, PlummerSphere(cluster));
+        RemoveNetMotion(m_Bodies, first, bodyCount, cluster.center, cluster.velocity);
+        break;
+    }
+    }
+}
+
+void GravitySimulation::AddSolarSystem()
+{
+    m_SunHandle = m_Bodies.Add(CelestialBody{
         1.5f,
         glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
         glm::vec3(0.0f, 0.0f, 0.0f),
         glm::vec3(0.0f, 0.0f, 0.0f),
         1000.0f
-    ));
+    });
     
     AddPlanetWithParams(4.0f, 0.0f, 0.3f, glm::vec4(0.2f, 0.7f, 0.9f, 1.0f));
     AddPlanetWithParams(7.0f, glm::pi<float>()/3.0f, 0.4f, glm::vec4(0.8f, 0.4f, 0.2f, 1.0f));
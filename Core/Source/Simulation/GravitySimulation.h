@@ -1,15 +1,62 @@
 #ifndef GRAVITY_SIMULATION_H
 #define GRAVITY_SIMULATION_H
 
+#include <functional>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <glm/glm.hpp>
 #include "Renderer/Shader.h"
 #include "Renderer/Skybox.h"
+#include "Renderer/Sphere.h"
+#include "Renderer/PointCloud.h"
 #include "CelestialBody.h"
+#include "BodyGenerator.h"
+#include "BodyStorage.h"
+#include "SpatialSort.h"
+#include "BroadPhase.h"
+#include "SpatialIndex.h"
+#include "GravitySolver.h"
+#include "SPHSolver.h"
+#include "Autotuner.h"
+#include "Reduction.h"
+#include "Diagnostics.h"
+#include "Random.h"
+#include "EncounterCatalog.h"
+#include "OrbitalElements.h"
+#include "TripleBuffer.h"
+#include "SimulationState.h"
+#include "Checkpoint.h"
+#include "StateHistory.h"
+#include "Trajectory.h"
 
 namespace SpaceSim {
 
+enum class Scene {
+    SolarSystem,
+    PlummerSphere,
+    HernquistHalo,
+    DiskGalaxy,
+    AsteroidBelt,
+    ClusterInGalaxy
+};
+
+// Everything Render needs from one step. The simulation thread publishes these and the render thread
+// draws the newest one, so neither waits for the other.
+struct RenderState {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> previousPositions;
+    std::vector<float> radii;
+    std::vector<glm::vec4> colors;
+    std::vector<glm::vec3> gasPositions;
+    std::vector<glm::vec3> previousGasPositions;
+    uint32_t sunIndex = InvalidBodyIndex;
+    float time = 0.0f;
+    double publishTime = 0.0;
+    double stepInterval = 0.0;
+};
+
 class GravitySimulation {
 public:
     GravitySimulation();
@@ -17,18 +64,151 @@ public:
     
     void Init();
     void Update(float deltaTime, float gravityStrength);
-    void Render(const glm::mat4& view, const glm::mat4& projection);
+    // Draws the newest published state. With interpolate set, bodies move from their previous-step positions
+    // to the published ones over stepInterval real seconds after publishing.
+    void Render(const glm::mat4& view, const glm::mat4& projection, bool interpolate = true);
+    void PublishRenderState(double stepInterval = 0.0);
+    // Publishes the recorded bodies at time in place of the simulated ones. Nothing else may publish at the
+    // same time, so call it with the simulation thread locked and paused.
+    bool PublishPlayback(TrajectoryReader& trajectory, double time);
     
     void AddRandomPlanet();
+    void SpawnRandomPlanets(size_t count);
+    size_t SpawnBodies(size_t count, const BodyGenerator& generator);
     void AddPlanetWithParams(float distance, float angle, float radius, const glm::vec4& color);
+    void RemoveBody(BodyHandle handle);
+    void AddGasDisk(size_t particleCount, float innerRadius, float outerRadius, float totalMass);
+    void ClearGas();
     void Reset();
+    void LoadScene(Scene scene, size_t bodyCount = 0, float gravityStrength = 1.0f);
+    Scene GetScene() const { return m_Scene; }
+    bool GetCollisionsEnabled() const { return m_CollisionsEnabled; }
+    void SetCollisionsEnabled(bool enabled) { m_CollisionsEnabled = enabled; }
     
-    size_t GetBodyCount() const { return m_Bodies.size(); }
+    size_t GetBodyCount() const { return m_Bodies.Size(); }
+    double GetSimulationTime() const { return m_SimulationTime; }
+    uint64_t GetStepCount() const { return m_StepCount; }
+    BodyHandle GetSunHandle() const { return m_SunHandle; }
+    const BodyStorage& GetBodies() const { return m_Bodies; }
+    const SpatialSort& GetSpatialSort() const { return m_SpatialSort; }
+    // Neighbour, range and ray queries over the bodies. The index is refitted or rebuilt here when bodies
+    // changed since the last call, so steps that nobody queries pay nothing for it.
+    const SpatialIndex& GetSpatialIndex();
+
+    const SolverSettings& GetSolverSettings() const { return m_Solver.GetSettings(); }
+    void SetSolverSettings(const SolverSettings& settings) { m_Solver.SetSettings(settings); }
+    const SolverStats& GetSolverStats() const { return m_Solver.GetStats(); }
+
+    // With autotuning on, the solver settings and thread count are re-measured whenever the body count
+    // changes by the retune factor.
+    const AutotuneSettings& GetAutotuneSettings() const { return m_Autotuner.GetSettings(); }
+    void SetAutotuneSettings(const AutotuneSettings& settings);
+    const Autotuner& GetAutotuner() const { return m_Autotuner; }
+    void RequestAutotune() { m_Autotuner.Invalidate(); }
+    // Analytic galaxy components acting on bodies and gas. LoadScene replaces them with the scene's own.
+    const std::vector<PotentialComponent>& GetExternalPotentials() const { return m_ExternalField.GetComponents(); }
+    void SetExternalPotentials(const std::vector<PotentialComponent>& components) { m_ExternalField.SetComponents(components); }
+    const ExternalField& GetExternalField() const { return m_ExternalField; }
+
+    // While the catalog is enabled its broad phase also supplies the collision pairs.
+    const EncounterSettings& GetEncounterSettings() const { return m_Encounters.GetSettings(); }
+    void SetEncounterSettings(const EncounterSettings& settings) { m_Encounters.SetSettings(settings); }
+    const EncounterCatalog& GetEncounters() const { return m_Encounters; }
+
+    const OrbitTrackerSettings& GetOrbitSettings() const { return m_Orbits.GetSettings(); }
+    void SetOrbitSettings(const OrbitTrackerSettings& settings) { m_Orbits.SetSettings(settings); }
+    const OrbitTracker& GetOrbits() const { return m_Orbits; }
+    // Snapshots every interval steps that RestoreHistory rewinds to. LoadScene clears it.
+    const HistorySettings& GetHistorySettings() const { return m_History.GetSettings(); }
+    void SetHistorySettings(const HistorySettings& settings) { m_History.SetSettings(settings); }
+    const StateHistory& GetHistory() const { return m_History; }
+    bool RestoreHistory(uint64_t step);
+
+    void CaptureState(SimulationState& state) const;
+    void RestoreState(const SimulationState& state);
+    // Versioned, checksummed binary snapshot of the state with the scene, solver and external field settings,
+    // so a run can continue in a later session.
+    bool SaveCheckpoint(const std::string& path) const;
+    // Fills in the checkpoint of the current state with sections pointing at the simulation's own arrays,
+    // which stay valid until the next change to the simulation.
+    void PrepareCheckpoint(CheckpointWriter& writer, CheckpointParameters& parameters) const;
+    // Replaces the run with a checkpoint's and clears the rewind history. A file that fails validation
+    // leaves the current run untouched.
+    bool LoadCheckpoint(const std::string& path);
+
+    const SPHSolver& GetGas() const { return m_Gas; }
+    SPHSolver& GetGas() { return m_Gas; }
+    // Largest step the gas can take (CFL), or 0 when nothing limits the step.
+    float GetMaxStableTimestep() const;
+
+    uint32_t GetReorderInterval() const { return m_ReorderInterval; }
+    void SetReorderInterval(uint32_t steps) { m_ReorderInterval = steps; }
+
+    // Spawned bodies draw from the seed's stream sequence, which restarts on Reset, so a session replays exactly.
+    uint64_t GetSeed() const { return m_Seed; }
+    void SetSeed(uint64_t seed) { m_Seed = seed; m_NextStream = 0; }
+
+    ReductionMode GetReductionMode() const { return m_ReductionMode; }
+    void SetReductionMode(ReductionMode mode) { m_ReductionMode = mode; }
+
+    // Energy and momentum of the point masses, summed with the current reduction mode.
+    const EnergyDiagnostics& ComputeDiagnostics(float gravityStrength);
+    const EnergyDiagnostics& GetDiagnostics() const { return m_Diagnostics; }
     
 private:
-    std::vector<std::shared_ptr<CelestialBody>> m_Bodies;
+    void Integrate(float deltaTime);
+    void UpdateSpatialOrder();
+    void PermuteSolverTree(const std::vector<uint32_t>& order);
+    void OnStateReplaced();
+    void RunAutotune(float gravityStrength);
+    void ResolveCollisions();
+    void ResolveCollision(uint32_t first, uint32_t second);
+    void AddSolarSystem();
+    Sphere& GetSphereMesh(float radius);
+
+    BodyStorage m_Bodies;
+    std::vector<glm::vec3> m_Accelerations;
+    std::vector<glm::vec3> m_PreviousPositions;
+    std::vector<glm::vec3> m_PreviousGasPositions;
+    std::vector<glm::vec3> m_PermuteScratch;
+    std::vector<uint32_t> m_SolverOrder;
+    TripleBuffer<RenderState> m_RenderStates;
+    std::vector<glm::vec3> m_RenderScratch;
+    SpatialSort m_SpatialSort;
+    bool m_SpatialSortStale = false;
+    BroadPhase m_BroadPhase;
+    SpatialIndex m_SpatialIndex;
+    GravitySolver m_Solver;
+    Autotuner m_Autotuner;
+    SPHSolver m_Gas;
+    ExternalField m_ExternalField;
+    EncounterCatalog m_Encounters;
+    OrbitTracker m_Orbits;
+    StateHistory m_History;
+    SimulationState m_RestoreScratch;
+    std::vector<BodyPair> m_CollisionPairs;
+    BodyHandle m_SunHandle = InvalidBodyHandle;
+    uint64_t m_StepCount = 0;
+    double m_SimulationTime = 0.0;
+    Scene m_Scene = Scene::SolarSystem;
+    size_t m_SceneBodyCount = 0;
+    float m_SceneGravityStrength = 1.0f;
+    bool m_CollisionsEnabled = true;
+    uint32_t m_ReorderInterval = 16;
+    ReductionMode m_ReductionMode = ReductionMode::Fast;
+    uint64_t m_Seed = 0x5EED5EEDull;
+    uint64_t m_NextStream = 0;
+    EnergyDiagnostics m_Diagnostics;
+    std::vector<float> m_Potentials;
+    std::vector<uint32_t> m_BodyBatches;
+    std::vector<uint32_t> m_PairBatches;
+    std::vector<uint32_t> m_BatchOffsets;
+    std::vector<BodyPair> m_BatchedPairs;
+
     std::unique_ptr<Shader> m_Shader;
     std::unique_ptr<Skybox> m_Skybox;
+    std::unique_ptr<PointCloud> m_GasRenderer;
+    std::unordered_map<uint32_t, std::unique_ptr<Sphere>> m_SphereMeshes;
     float m_Time;
     
     struct OrbitParameters {
@@ -38,7 +218,7 @@ private:
         float inclination;
     };
     
-    OrbitParameters GetRandomOrbitParameters(float gravityStrength = 1.0f);
+    OrbitParameters GetRandomOrbitParameters(RandomStream& random, float gravityStrength = 1.0f);
 };
 
 }
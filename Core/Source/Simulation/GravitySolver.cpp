@@ -0,0 +1,413 @@
+#include "GravitySolver.h"
+#include "GravityKernels.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace SpaceSim {
+
+struct GroupWalkBuffers {
+    ParticleBuffer particles;
+    CellBuffer cells;
+    std::vector<uint32_t> stack;
+    std::vector<float> tx, ty, tz;
+    std::vector<float> ax, ay, az;
+};
+
+static thread_local GroupWalkBuffers t_GroupWalkBuffers;
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+const char* GetSolverName(SolverType type)
+{
+    switch (type)
+    {
+    case SolverType::DirectSum: return "Direct Sum";
+    case SolverType::BarnesHut: return "Barnes-Hut";
+    case SolverType::GroupWalk: return "Barnes-Hut (Group Walk)";
+    }
+    return "Unknown";
+}
+
+void GravitySolver::SetSettings(const SolverSettings& settings)
+{
+    if (settings.leafSize != m_Settings.leafSize)
+        m_TreeInvalid = true;
+    m_Settings = settings;
+}
+
+void GravitySolver::ComputeAccelerations(const std::vector<glm::vec3>& positions, const std::vector<float>& masses,
+                                         const SpatialSort& sort, float gravityStrength, std::vector<glm::vec3>& accelerations,
+                                         size_t activeCount)
+{
+    accelerations.resize(positions.size());
+    activeCount = std::min(activeCount, positions.size());
+
+    if (m_Settings.type == SolverType::DirectSum)
+    {
+        m_Stats.maintenanceMs = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        ComputeDirect(positions, masses, gravityStrength, accelerations, activeCount);
+        m_Stats.forceMs = ElapsedMs(start);
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    UpdateTree(positions, masses, sort);
+    m_Stats.maintenanceMs = ElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    if (m_Settings.type == SolverType::GroupWalk)
+        ComputeGroupTree(positions, masses, gravityStrength, accelerations, activeCount);
+    else
+        ComputeTree(positions, masses, gravityStrength, accelerations, activeCount);
+    m_Stats.forceMs = ElapsedMs(start);
+}
+
+void GravitySolver::ComputePotentials(const std::vector<glm::vec3>& positions, const std::vector<float>& masses,
+                                      float gravityStrength, std::vector<float>& potentials, size_t activeCount) const
+{
+    const size_t count = positions.size();
+    activeCount = std::min(activeCount, count);
+    potentials.resize(activeCount);
+
+    const bool useTree = m_Settings.type != SolverType::DirectSum && m_Octree.IsBuilt() && m_Octree.GetBodyCount() == count;
+    if (!useTree)
+    {
+        ThreadPool::Get().ParallelFor(activeCount, 64, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                float potential = 0.0f;
+                for (size_t j = 0; j < count; j++) {
+                    glm::vec3 direction = positions[j] - positions[i];
+                    float distanceSquared = glm::dot(direction, direction);
+
+                    if (distanceSquared < MinInteractionDistanceSquared) continue;
+
+                    potential -= masses[j] / std::sqrt(distanceSquared);
+                }
+                potentials[i] = potential * gravityStrength;
+            }
+        });
+        return;
+    }
+
+    const std::vector<OctreeNode>& nodes = m_Octree.GetNodes();
+    const std::vector<uint32_t>& bodyOrder = m_Octree.GetBodyOrder();
+    const float theta2 = m_Settings.openingAngle * m_Settings.openingAngle;
+    const bool useQuadrupole = m_Settings.expansionOrder >= 2;
+    const uint32_t maxStack = m_Octree.GetDepth() * 8 + 1;
+
+    ThreadPool::Get().ParallelFor(bodyOrder.size(), 32, [&](size_t begin, size_t end) {
+        std::vector<uint32_t> stack(maxStack);
+
+        for (size_t k = begin; k < end; k++) {
+            const uint32_t i = bodyOrder[k];
+            if (i >= activeCount)
+                continue;
+            const glm::vec3 position = positions[i];
+            float potential = 0.0f;
+
+            uint32_t stackSize = 0;
+            stack[stackSize++] = 0;
+            while (stackSize > 0)
+            {
+                const OctreeNode& node = nodes[stack[--stackSize]];
+                glm::vec3 r = position - node.centerOfMass;
+                float r2 = glm::dot(r, r);
+                glm::vec3 extent = node.boundsMax - node.boundsMin;
+                float size = glm::max(extent.x, glm::max(extent.y, extent.z));
+
+                bool inside = glm::all(glm::greaterThanEqual(position, node.boundsMin)) &&
+                              glm::all(glm::lessThanEqual(position, node.boundsMax));
+
+                if (!inside && size * size < theta2 * r2 && r2 >= MinInteractionDistanceSquared)
+                {
+                    float inverseR = 1.0f / std::sqrt(r2);
+                    potential -= node.mass * inverseR;
+
+                    if (useQuadrupole)
+                    {
+                        const Quadrupole& q = node.quadrupole;
+                        float rqr = q.xx * r.x * r.x + q.yy * r.y * r.y + q.zz * r.z * r.z
+                                  + 2.0f * (q.xy * r.x * r.y + q.xz * r.x * r.z + q.yz * r.y * r.z);
+                        float inverseR2 = inverseR * inverseR;
+                        potential -= 0.5f * rqr * inverseR2 * inverseR2 * inverseR;
+                    }
+                }
+                else if (node.childCount == 0)
+                {
+                    for (uint32_t b = node.firstBody; b < node.firstBody + node.bodyCount; b++) {
+                        const uint32_t j = bodyOrder[b];
+                        glm::vec3 direction = positions[j] - position;
+                        float distanceSquared = glm::dot(direction, direction);
+
+                        if (distanceSquared < MinInteractionDistanceSquared) continue;
+
+                        potential -= masses[j] / std::sqrt(distanceSquared);
+                    }
+                }
+                else
+                {
+                    for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+                        stack[stackSize++] = c;
+                    }
+                }
+            }
+
+            potentials[i] = potential * gravityStrength;
+        }
+    });
+}
+
+void GravitySolver::OnBodiesPermuted(const std::vector<uint32_t>& order)
+{
+    if (m_Octree.IsBuilt())
+        m_Octree.RemapBodies(order);
+}
+
+void GravitySolver::UpdateTree(const std::vector<glm::vec3>& positions, const std::vector<float>& masses, const SpatialSort& sort)
+{
+    bool rebuild = m_TreeInvalid || !m_Octree.IsBuilt() || m_Octree.GetBodyCount() != positions.size();
+
+    if (!rebuild)
+    {
+        m_Octree.Refit(positions, masses);
+        m_Stats.refitsSinceRebuild++;
+        rebuild = m_Octree.GetQualityRatio() > m_Settings.rebuildThreshold;
+    }
+
+    if (rebuild && sort.Size() != positions.size())
+    {
+        // The caller sorted a different set than it passed in; the stale tree is dropped and the forces fall
+        // back to direct summation until a matching sort arrives.
+        if (!m_SortMismatchReported)
+            std::cerr << "Gravity tree sort has " << sort.Size() << " entries for " << positions.size()
+                      << " bodies, using direct summation" << std::endl;
+        m_SortMismatchReported = true;
+        m_Octree.Clear();
+        return;
+    }
+
+    if (rebuild)
+    {
+        m_Octree.Build(sort, m_Settings.leafSize);
+        m_Octree.Refit(positions, masses);
+        m_Stats.refitsSinceRebuild = 0;
+        m_Stats.rebuildCount++;
+        m_TreeInvalid = false;
+        m_SortMismatchReported = false;
+    }
+}
+
+void GravitySolver::ComputeDirect(const std::vector<glm::vec3>& positions, const std::vector<float>& masses,
+                                  float gravityStrength, std::vector<glm::vec3>& accelerations, size_t activeCount)
+{
+    const size_t count = positions.size();
+    const ExternalField* external = m_ExternalField && !m_ExternalField->IsEmpty() ? m_ExternalField : nullptr;
+
+    ThreadPool::Get().ParallelFor(activeCount, 64, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            glm::vec3 acceleration(0.0f);
+            for (size_t j = 0; j < count; j++) {
+                glm::vec3 direction = positions[j] - positions[i];
+                float distanceSquared = glm::dot(direction, direction);
+                
+                if (distanceSquared < MinInteractionDistanceSquared) continue;
+                
+                float inverseDistance = 1.0f / std::sqrt(distanceSquared);
+                acceleration += direction * (masses[j] * inverseDistance * inverseDistance * inverseDistance);
+            }
+            if (external)
+                acceleration += external->GetAcceleration(positions[i]);
+            accelerations[i] = acceleration * gravityStrength;
+        }
+    });
+}
+
+void GravitySolver::ComputeTree(const std::vector<glm::vec3>& positions, const std::vector<float>& masses,
+                                float gravityStrength, std::vector<glm::vec3>& accelerations, size_t activeCount)
+{
+    if (!m_Octree.IsBuilt() || m_Octree.GetBodyCount() != positions.size())
+    {
+        ComputeDirect(positions, masses, gravityStrength, accelerations, activeCount);
+        return;
+    }
+
+    const std::vector<OctreeNode>& nodes = m_Octree.GetNodes();
+    const std::vector<uint32_t>& bodyOrder = m_Octree.GetBodyOrder();
+    const float theta2 = m_Settings.openingAngle * m_Settings.openingAngle;
+    const bool useQuadrupole = m_Settings.expansionOrder >= 2;
+    const uint32_t maxStack = m_Octree.GetDepth() * 8 + 1;
+    const ExternalField* external = m_ExternalField && !m_ExternalField->IsEmpty() ? m_ExternalField : nullptr;
+
+    ThreadPool::Get().ParallelFor(bodyOrder.size(), 32, [&](size_t begin, size_t end) {
+        std::vector<uint32_t> stack(maxStack);
+
+        for (size_t k = begin; k < end; k++) {
+            const uint32_t i = bodyOrder[k];
+            if (i >= activeCount)
+                continue;
+            const glm::vec3 position = positions[i];
+            glm::vec3 acceleration(0.0f);
+
+            uint32_t stackSize = 0;
+            stack[stackSize++] = 0;
+            while (stackSize > 0)
+            {
+                const OctreeNode& node = nodes[stack[--stackSize]];
+                glm::vec3 r = position - node.centerOfMass;
+                float r2 = glm::dot(r, r);
+                glm::vec3 extent = node.boundsMax - node.boundsMin;
+                float size = glm::max(extent.x, glm::max(extent.y, extent.z));
+
+                bool inside = glm::all(glm::greaterThanEqual(position, node.boundsMin)) &&
+                              glm::all(glm::lessThanEqual(position, node.boundsMax));
+
+                if (!inside && size * size < theta2 * r2 && r2 >= MinInteractionDistanceSquared)
+                {
+                    float inverseR = 1.0f / std::sqrt(r2);
+                    float inverseR2 = inverseR * inverseR;
+                    float inverseR3 = inverseR2 * inverseR;
+                    acceleration -= r * (node.mass * inverseR3);
+
+                    if (useQuadrupole)
+                    {
+                        const Quadrupole& q = node.quadrupole;
+                        glm::vec3 qr(q.xx * r.x + q.xy * r.y + q.xz * r.z,
+                                     q.xy * r.x + q.yy * r.y + q.yz * r.z,
+                                     q.xz * r.x + q.yz * r.y + q.zz * r.z);
+                        float rqr = glm::dot(r, qr);
+                        float inverseR5 = inverseR3 * inverseR2;
+                        acceleration += qr * inverseR5 - r * (2.5f * rqr * inverseR5 * inverseR2);
+                    }
+                }
+                else if (node.childCount == 0)
+                {
+                    for (uint32_t b = node.firstBody; b < node.firstBody + node.bodyCount; b++) {
+                        const uint32_t j = bodyOrder[b];
+                        glm::vec3 direction = positions[j] - position;
+                        float distanceSquared = glm::dot(direction, direction);
+                        
+                        if (distanceSquared < MinInteractionDistanceSquared) continue;
+                        
+                        float inverseDistance = 1.0f / std::sqrt(distanceSquared);
+                        acceleration += direction * (masses[j] * inverseDistance * inverseDistance * inverseDistance);
+                    }
+                }
+                else
+                {
+                    for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+                        stack[stackSize++] = c;
+                    }
+                }
+            }
+
+            if (external)
+                acceleration += external->GetAcceleration(position);
+            accelerations[i] = acceleration * gravityStrength;
+        }
+    });
+}
+
+void GravitySolver::ComputeGroupTree(const std::vector<glm::vec3>& positions, const std::vector<float>& masses,
+                                     float gravityStrength, std::vector<glm::vec3>& accelerations, size_t activeCount)
+{
+    if (!m_Octree.IsBuilt() || m_Octree.GetBodyCount() != positions.size())
+    {
+        ComputeDirect(positions, masses, gravityStrength, accelerations, activeCount);
+        return;
+    }
+
+    const std::vector<OctreeNode>& nodes = m_Octree.GetNodes();
+    const std::vector<uint32_t>& bodyOrder = m_Octree.GetBodyOrder();
+    const std::vector<uint32_t>& leaves = m_Octree.GetLeaves();
+    const float theta2 = m_Settings.openingAngle * m_Settings.openingAngle;
+    const bool useQuadrupole = m_Settings.expansionOrder >= 2;
+    const uint32_t maxStack = m_Octree.GetDepth() * 8 + 1;
+    const uint32_t laneWidth = GetKernelLaneWidth();
+    const ExternalField* external = m_ExternalField && !m_ExternalField->IsEmpty() ? m_ExternalField : nullptr;
+
+    ThreadPool::Get().ParallelFor(leaves.size(), 4, [&](size_t begin, size_t end) {
+        GroupWalkBuffers& buffers = t_GroupWalkBuffers;
+        buffers.stack.resize(maxStack);
+
+        for (size_t l = begin; l < end; l++) {
+            const OctreeNode& group = nodes[leaves[l]];
+            bool active = false;
+            for (uint32_t b = group.firstBody; b < group.firstBody + group.bodyCount && !active; b++) {
+                active = bodyOrder[b] < activeCount;
+            }
+            if (!active)
+                continue;
+
+            buffers.particles.Clear();
+            buffers.cells.Clear();
+
+            // A cell is accepted for the whole group only if it passes the opening test from the
+            // closest point of the group's bounds.
+            uint32_t stackSize = 0;
+            buffers.stack[stackSize++] = 0;
+            while (stackSize > 0)
+            {
+                const OctreeNode& node = nodes[buffers.stack[--stackSize]];
+                glm::vec3 gap = glm::max(glm::max(group.boundsMin - node.centerOfMass, node.centerOfMass - group.boundsMax), glm::vec3(0.0f));
+                float gap2 = glm::dot(gap, gap);
+                glm::vec3 extent = node.boundsMax - node.boundsMin;
+                float size = glm::max(extent.x, glm::max(extent.y, extent.z));
+
+                if (size * size < theta2 * gap2)
+                {
+                    buffers.cells.Push(node);
+                }
+                else if (node.childCount == 0)
+                {
+                    for (uint32_t b = node.firstBody; b < node.firstBody + node.bodyCount; b++) {
+                        const uint32_t j = bodyOrder[b];
+                        buffers.particles.Push(positions[j], masses[j]);
+                    }
+                }
+                else
+                {
+                    for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+                        buffers.stack[stackSize++] = c;
+                    }
+                }
+            }
+
+            const size_t targetCount = group.bodyCount;
+            const size_t paddedCount = (targetCount + laneWidth - 1) / laneWidth * laneWidth;
+            buffers.tx.resize(paddedCount);
+            buffers.ty.resize(paddedCount);
+            buffers.tz.resize(paddedCount);
+            buffers.ax.assign(paddedCount, 0.0f);
+            buffers.ay.assign(paddedCount, 0.0f);
+            buffers.az.assign(paddedCount, 0.0f);
+
+            for (size_t t = 0; t < paddedCount; t++) {
+                const glm::vec3& position = positions[bodyOrder[group.firstBody + glm::min(t, targetCount - 1)]];
+                buffers.tx[t] = position.x;
+                buffers.ty[t] = position.y;
+                buffers.tz[t] = position.z;
+            }
+
+            AccumulateParticleParticle(buffers.particles, buffers.tx.data(), buffers.ty.data(), buffers.tz.data(),
+                                       paddedCount, buffers.ax.data(), buffers.ay.data(), buffers.az.data());
+            AccumulateParticleCell(buffers.cells, useQuadrupole, buffers.tx.data(), buffers.ty.data(), buffers.tz.data(),
+                                   paddedCount, buffers.ax.data(), buffers.ay.data(), buffers.az.data());
+            if (external)
+                external->Accumulate(buffers.tx.data(), buffers.ty.data(), buffers.tz.data(), paddedCount,
+                                     buffers.ax.data(), buffers.ay.data(), buffers.az.data());
+
+            for (size_t t = 0; t < targetCount; t++) {
+                accelerations[bodyOrder[group.firstBody + t]] = glm::vec3(buffers.ax[t], buffers.ay[t], buffers.az[t]) * gravityStrength;
+            }
+        }
+    });
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#ifndef GRAVITY_SOLVER_H
+#define GRAVITY_SOLVER_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "SpatialSort.h"
+#include "Octree.h"
+#include "ExternalField.h"
+
+namespace SpaceSim {
+
+enum class SolverType {
+    DirectSum,
+    BarnesHut,
+    GroupWalk
+};
+
+const char* GetSolverName(SolverType type);
+
+struct SolverSettings {
+    SolverType type = SolverType::DirectSum;
+    float openingAngle = 0.5f;
+    uint32_t expansionOrder = 2;
+    uint32_t leafSize = 16;
+    float rebuildThreshold = 1.5f;
+};
+
+struct SolverStats {
+    double maintenanceMs = 0.0;
+    double forceMs = 0.0;
+    uint32_t refitsSinceRebuild = 0;
+    uint64_t rebuildCount = 0;
+};
+
+// Computes gravitational accelerations for any set of point masses. The tree solvers keep their octree
+// across calls and only refit it until the tree quality drops below the rebuild threshold.
+// GroupWalk builds one interaction list per octree leaf and evaluates it with the SIMD kernels.
+class GravitySolver {
+public:
+    // Only bodies below activeCount get accelerations; the rest act as sources only.
+    void ComputeAccelerations(const std::vector<glm::vec3>& positions, const std::vector<float>& masses,
+                              const SpatialSort& sort, float gravityStrength, std::vector<glm::vec3>& accelerations,
+                              size_t activeCount = SIZE_MAX);
+
+    // Specific potential at each body below activeCount. Uses the current tree when it matches the bodies,
+    // otherwise sums directly.
+    void ComputePotentials(const std::vector<glm::vec3>& positions, const std::vector<float>& masses,
+                           float gravityStrength, std::vector<float>& potentials, size_t activeCount = SIZE_MAX) const;
+
+    void OnBodiesPermuted(const std::vector<uint32_t>& order);
+    void Invalidate() { m_TreeInvalid = true; }
+
+    // Background field added to every body in the same pass as the N-body forces. Potentials exclude it.
+    void SetExternalField(const ExternalField* field) { m_ExternalField = field; }
+
+    const SolverSettings& GetSettings() const { return m_Settings; }
+    void SetSettings(const SolverSettings& settings);
+    const SolverStats& GetStats() const { return m_Stats; }
+    const Octree& GetOctree() const { return m_Octree; }
+
+private:
+    void UpdateTree(const std::vector<glm::vec3>& positions, const std::vector<float>& masses, const SpatialSort& sort);
+    void ComputeDirect(const std::vector<glm::vec3>& positions, const std::vector<float>& masses,
+                       float gravityStrength, std::vector<glm::vec3>& accelerations, size_t activeCount);
+    void ComputeTree(const std::vector<glm::vec3>& positions, const std::vector<float>& masses,
+                     float gravityStrength, std::vector<glm::vec3>& accelerations, size_t activeCount);
+    void ComputeGroupTree(const std::vector<glm::vec3>& positions, const std::vector<float>& masses,
+                          float gravityStrength, std::vector<glm::vec3>& accelerations, size_t activeCount);
+
+    SolverSettings m_Settings;
+    SolverStats m_Stats;
+    Octree m_Octree;
+    const ExternalField* m_ExternalField = nullptr;
+    bool m_TreeInvalid = true;
+    // Reported once until the next build, rather than every step.
+    bool m_SortMismatchReported = false;
+};
+
+}
+
+#endif
\ No newline at end of file
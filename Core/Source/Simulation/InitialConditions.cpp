@@ -0,0 +1,304 @@
+#include "InitialConditions.h"
+#include "Reduction.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/ext/scalar_constants.hpp>
+
+namespace SpaceSim {
+
+static glm::vec3 RandomDirection(RandomStream& random)
+{
+    float cosTheta = random.NextFloat(-1.0f, 1.0f);
+    float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+    float phi = random.NextFloat(0.0f, 2.0f * glm::pi<float>());
+    return glm::vec3(sinTheta * std::cos(phi), cosTheta, sinTheta * std::sin(phi));
+}
+
+// Modified Bessel functions, polynomial fits from Abramowitz & Stegun 9.8.1-9.8.8.
+static double BesselI0(double x)
+{
+    if (x < 3.75)
+    {
+        double t = (x / 3.75) * (x / 3.75);
+        return 1.0 + t * (3.5156229 + t * (3.0899424 + t * (1.2067492 + t * (0.2659732 + t * (0.0360768 + t * 0.0045813)))));
+    }
+    double t = 3.75 / x;
+    return std::exp(x) / std::sqrt(x) * (0.39894228 + t * (0.01328592 + t * (0.00225319 + t * (-0.00157565 + t * (0.00916281
+        + t * (-0.02057706 + t * (0.02635537 + t * (-0.01647633 + t * 0.00392377))))))));
+}
+
+static double BesselI1(double x)
+{
+    if (x < 3.75)
+    {
+        double t = (x / 3.75) * (x / 3.75);
+        return x * (0.5 + t * (0.87890594 + t * (0.51498869 + t * (0.15084934 + t * (0.02658733 + t * (0.00301532 + t * 0.00032411))))));
+    }
+    double t = 3.75 / x;
+    return std::exp(x) / std::sqrt(x) * (0.39894228 + t * (-0.03988024 + t * (-0.00362018 + t * (0.00163801 + t * (-0.01031555
+        + t * (0.02282967 + t * (-0.02895312 + t * (0.01787654 - t * 0.00420059))))))));
+}
+
+static double BesselK0(double x)
+{
+    if (x <= 2.0)
+    {
+        double t = x * x / 4.0;
+        return -std::log(x / 2.0) * BesselI0(x) + (-0.57721566 + t * (0.42278420 + t * (0.23069756 + t * (0.03488590
+            + t * (0.00262698 + t * (0.00010750 + t * 0.0000074))))));
+    }
+    double t = 2.0 / x;
+    return std::exp(-x) / std::sqrt(x) * (1.25331414 + t * (-0.07832358 + t * (0.02189568 + t * (-0.01062446
+        + t * (0.00587872 + t * (-0.00251540 + t * 0.00053208))))));
+}
+
+static double BesselK1(double x)
+{
+    if (x <= 2.0)
+    {
+        double t = x * x / 4.0;
+        return std::log(x / 2.0) * BesselI1(x) + (1.0 / x) * (1.0 + t * (0.15443144 + t * (-0.67278579 + t * (-0.18156897
+            + t * (-0.01919402 + t * (-0.00110404 - t * 0.00004686))))));
+    }
+    double t = 2.0 / x;
+    return std::exp(-x) / std::sqrt(x) * (1.25331414 + t * (0.23498619 + t * (-0.03655620 + t * (0.01504268
+        + t * (-0.00780353 + t * (0.00325614 - t * 0.00068245))))));
+}
+
+BodyGenerator PlummerSphere(const PlummerParams& params)
+{
+    const float bodyMass = params.totalMass / static_cast<float>(std::max<size_t>(1, params.count));
+    const float velocityScale = std::sqrt(params.gravityStrength * params.totalMass / params.scaleRadius);
+    const float ratio = params.maxRadius / params.scaleRadius;
+    const float maxMassFraction = std::pow(ratio * ratio / (1.0f + ratio * ratio), 1.5f);
+
+    // Aarseth, Henon & Wielen (1974): radius from the cumulative mass, speed by rejection from q^2 (1 - q^2)^3.5.
+    return [=](size_t, RandomStream& random, CelestialBody& body) {
+        float massFraction = std::max(random.NextFloat() * maxMassFraction, 1e-7f);
+        float r = 1.0f / std::sqrt(std::pow(massFraction, -2.0f / 3.0f) - 1.0f);
+
+        float q;
+        do {
+            q = random.NextFloat();
+        } while (0.1f * random.NextFloat() >= q * q * std::pow(1.0f - q * q, 3.5f));
+        float speed = q * std::sqrt(2.0f) * std::pow(1.0f + r * r, -0.25f);
+
+        body.position = params.center + RandomDirection(random) * (r * params.scaleRadius);
+        body.velocity = params.velocity + RandomDirection(random) * (speed * velocityScale);
+        body.mass = bodyMass;
+        body.radius = params.bodyRadius;
+        body.color = params.color;
+    };
+}
+
+BodyGenerator HernquistHalo(const HernquistParams& params)
+{
+    const float bodyMass = params.totalMass / static_cast<float>(std::max<size_t>(1, params.count));
+    const double gm = static_cast<double>(params.gravityStrength) * params.totalMass;
+    const double a = params.scaleRadius;
+    const double maxRoot = params.maxRadius / (params.maxRadius + params.scaleRadius);
+
+    // Isotropic distribution function from Hernquist (1990), eq. 17, up to its constant factor.
+    auto distribution = [](double q) {
+        double q2 = q * q;
+        double s = 1.0 - q2;
+        return (3.0 * std::asin(q) + q * std::sqrt(s) * (1.0 - 2.0 * q2) * (8.0 * q2 * q2 - 8.0 * q2 - 3.0)) / std::pow(s, 2.5);
+    };
+
+    // M(<r) / M = (r / (r + a))^2, so the square root of a uniform mass fraction gives r / (r + a).
+    return [=](size_t, RandomStream& random, CelestialBody& body) {
+        double root = std::max(std::sqrt(static_cast<double>(random.NextFloat())) * maxRoot, 1e-6);
+        double r = a * root / (1.0 - root);
+        double potential = -gm / (r + a);
+
+        // Speeds are capped so no orbit reaches past maxRadius, where the sampled mass is missing.
+        double maxSpeed = std::sqrt(std::max(-2.0 * (potential + gm / (params.maxRadius + a)), 0.0));
+
+        auto weight = [&](double v) {
+            double q2 = -(0.5 * v * v + potential) * a / gm;
+            return q2 <= 0.0 ? 0.0 : v * v * distribution(std::sqrt(std::min(q2, 1.0 - 1e-12)));
+        };
+
+        double envelope = 0.0;
+        for (int k = 1; k < 32; k++) {
+            envelope = std::max(envelope, weight(maxSpeed * k / 32.0));
+        }
+        envelope *= 1.2;
+
+        double speed;
+        do {
+            speed = maxSpeed * random.NextFloat();
+        } while (envelope * random.NextFloat() > weight(speed));
+
+        body.position = params.center + RandomDirection(random) * static_cast<float>(r);
+        body.velocity = params.velocity + RandomDirection(random) * static_cast<float>(speed);
+        body.mass = bodyMass;
+        body.radius = params.bodyRadius;
+        body.color = params.color;
+    };
+}
+
+BodyGenerator ExponentialDisk(const ExponentialDiskParams& params)
+{
+    const float bodyMass = params.diskMass / static_cast<float>(std::max<size_t>(1, params.count));
+    const double g = params.gravityStrength;
+    const double scaleLength = params.scaleLength;
+    const double centralDensity = params.diskMass / (2.0 * glm::pi<double>() * scaleLength * scaleLength);
+
+    // Freeman (1970) rotation curve of the disk plus the spherical components.
+    auto circularSpeedSquared = [=](double radius) {
+        double y = radius / (2.0 * scaleLength);
+        double disk = 4.0 * glm::pi<double>() * g * centralDensity * scaleLength * y * y
+            * (BesselI0(y) * BesselK0(y) - BesselI1(y) * BesselK1(y));
+        double halo = g * params.haloMass * radius / ((radius + params.haloScaleRadius) * (radius + params.haloScaleRadius));
+        return disk + halo + g * params.centralMass / radius;
+    };
+
+    return [=](size_t, RandomStream& random, CelestialBody& body) {
+        // Surface density R exp(-R/Rd) is a gamma distribution of shape 2.
+        double radius;
+        do {
+            radius = -scaleLength * std::log((1.0 - random.NextFloat()) * (1.0 - random.NextFloat()));
+        } while (radius > params.maxRadius || radius < 1e-3 * scaleLength);
+
+        float angle = random.NextFloat(0.0f, 2.0f * glm::pi<float>());
+        float u = std::clamp(random.NextFloat(), 1e-6f, 1.0f - 1e-6f);
+        float height = params.scaleHeight * std::atanh(2.0f * u - 1.0f);
+
+        double step = 1e-3 * radius;
+        double vc2 = circularSpeedSquared(radius);
+        double derivative = (circularSpeedSquared(radius + step) - circularSpeedSquared(radius - step)) / (2.0 * step);
+        double omega2 = vc2 / (radius * radius);
+        double kappa2 = std::max(derivative / radius + 2.0 * omega2, 1e-12);
+
+        double surfaceDensity = centralDensity * std::exp(-radius / scaleLength);
+        double sigmaR = params.toomreQ * 3.36 * g * surfaceDensity / std::sqrt(kappa2);
+        double sigmaPhi = sigmaR * std::sqrt(kappa2 / (4.0 * omega2));
+        double sigmaZ = std::sqrt(glm::pi<double>() * g * surfaceDensity * params.scaleHeight);
+        double meanRotation2 = vc2 - sigmaR * sigmaR * (kappa2 / (4.0 * omega2) - 1.0 + 2.0 * radius / scaleLength);
+        double meanRotation = std::sqrt(std::max(meanRotation2, 0.0));
+
+        glm::vec3 radial(std::cos(angle), 0.0f, std::sin(angle));
+        glm::vec3 tangential(-std::sin(angle), 0.0f, std::cos(angle));
+        float vR = static_cast<float>(sigmaR) * random.NextNormal();
+        float vPhi = static_cast<float>(meanRotation + sigmaPhi * random.NextNormal());
+        float vZ = static_cast<float>(sigmaZ) * random.NextNormal();
+
+        body.position = params.center + radial * static_cast<float>(radius) + glm::vec3(0.0f, height, 0.0f);
+        body.velocity = params.velocity + radial * vR + tangential * vPhi + glm::vec3(0.0f, vZ, 0.0f);
+        body.mass = bodyMass;
+        body.radius = params.bodyRadius;
+        body.color = params.color;
+    };
+}
+
+BodyGenerator KeplerianBelt(const KeplerianBeltParams& params)
+{
+    const float bodyMass = params.totalMass / static_cast<float>(std::max<size_t>(1, params.count));
+    const float gm = params.gravityStrength * params.centralMass;
+    const float exponent = 2.0f - params.surfaceDensityIndex;
+
+    return [=](size_t, RandomStream& random, CelestialBody& body) {
+        float u = random.NextFloat();
+        float a;
+        if (std::abs(exponent) < 1e-4f)
+            a = params.innerRadius * std::pow(params.outerRadius / params.innerRadius, u);
+        else
+            a = std::pow(std::pow(params.innerRadius, exponent) + u * (std::pow(params.outerRadius, exponent)
+                - std::pow(params.innerRadius, exponent)), 1.0f / exponent);
+
+        float e = std::min(params.eccentricityScale * std::sqrt(-2.0f * std::log(1.0f - random.NextFloat())), 0.9f);
+        float inclination = params.inclinationScale * std::sqrt(-2.0f * std::log(1.0f - random.NextFloat()));
+        float node = random.NextFloat(0.0f, 2.0f * glm::pi<float>());
+        float periapsis = random.NextFloat(0.0f, 2.0f * glm::pi<float>());
+        float meanAnomaly = random.NextFloat(0.0f, 2.0f * glm::pi<float>());
+
+        float eccentricAnomaly = meanAnomaly + e * std::sin(meanAnomaly);
+        for (int k = 0; k < 8; k++) {
+            eccentricAnomaly -= (eccentricAnomaly - e * std::sin(eccentricAnomaly) - meanAnomaly) / (1.0f - e * std::cos(eccentricAnomaly));
+        }
+
+        float cosE = std::cos(eccentricAnomaly);
+        float sinE = std::sin(eccentricAnomaly);
+        float semiMinor = std::sqrt(1.0f - e * e);
+        float distance = a * (1.0f - e * cosE);
+        float speedScale = std::sqrt(gm * a) / distance;
+        glm::vec2 orbitPosition(a * (cosE - e), a * semiMinor * sinE);
+        glm::vec2 orbitVelocity(-speedScale * sinE, speedScale * semiMinor * cosE);
+
+        // Perifocal frame to the reference plane, R3(node) R1(inclination) R3(periapsis), with y as the pole.
+        float cosO = std::cos(node), sinO = std::sin(node);
+        float cosI = std::cos(inclination), sinI = std::sin(inclination);
+        float cosW = std::cos(periapsis), sinW = std::sin(periapsis);
+        glm::vec3 p(cosO * cosW - sinO * sinW * cosI, sinW * sinI, sinO * cosW + cosO * sinW * cosI);
+        glm::vec3 q(-cosO * sinW - sinO * cosW * cosI, cosW * sinI, -sinO * sinW + cosO * cosW * cosI);
+
+        body.position = params.center + p * orbitPosition.x + q * orbitPosition.y;
+        body.velocity = params.velocity + p * orbitVelocity.x + q * orbitVelocity.y;
+        body.mass = bodyMass;
+        body.radius = random.NextFloat(params.minBodyRadius, params.maxBodyRadius);
+        body.color = params.color * random.NextFloat(0.8f, 1.2f);
+        body.color.a = 1.0f;
+    };
+}
+
+GasGenerator GasDisk(const GasDiskParams& params, const SPHSettings& settings)
+{
+    const float particleMass = params.totalMass / static_cast<float>(std::max<size_t>(1, params.count));
+    const float surfaceDensity = params.totalMass / (glm::pi<float>() * (params.outerRadius * params.outerRadius - params.innerRadius * params.innerRadius));
+    const float gamma = settings.adiabaticIndex;
+
+    return [=](size_t, RandomStream& random, GasParticle& particle) {
+        float radius = std::sqrt(random.NextFloat(params.innerRadius * params.innerRadius, params.outerRadius * params.outerRadius));
+        float angle = random.NextFloat(0.0f, 2.0f * glm::pi<float>());
+        float scaleHeight = params.aspectRatio * radius;
+        float orbitSpeed = std::sqrt(params.centralMass / radius);
+        float soundSpeed = params.aspectRatio * orbitSpeed;
+        float density = surfaceDensity / (std::sqrt(2.0f * glm::pi<float>()) * scaleHeight);
+
+        particle.position = params.center + glm::vec3(radius * std::cos(angle), scaleHeight * random.NextNormal(), radius * std::sin(angle));
+        particle.velocity = params.velocity + glm::vec3(-orbitSpeed * std::sin(angle), 0.0f, orbitSpeed * std::cos(angle));
+        particle.mass = particleMass;
+        particle.internalEnergy = soundSpeed * soundSpeed / (gamma * (gamma - 1.0f));
+        particle.smoothingLength = glm::clamp(settings.smoothingFactor * std::cbrt(particleMass / density),
+                                              settings.minSmoothingLength, settings.maxSmoothingLength);
+    };
+}
+
+struct MassMoments {
+    double mass;
+    glm::dvec3 weightedPosition;
+    glm::dvec3 momentum;
+
+    MassMoments operator+(const MassMoments& other) const
+    {
+        return { mass + other.mass, weightedPosition + other.weightedPosition, momentum + other.momentum };
+    }
+};
+
+void RemoveNetMotion(BodyStorage& bodies, size_t first, size_t count, const glm::vec3& center, const glm::vec3& velocity)
+{
+    std::vector<glm::vec3>& positions = bodies.GetPositions();
+    std::vector<glm::vec3>& velocities = bodies.GetVelocities();
+    const std::vector<float>& masses = bodies.GetMasses();
+
+    const MassMoments zero{ 0.0, glm::dvec3(0.0), glm::dvec3(0.0) };
+    MassMoments moments = ParallelReduce(count, zero, ReductionMode::Deterministic, [&](size_t i) {
+        const double mass = masses[first + i];
+        return MassMoments{ mass, glm::dvec3(positions[first + i]) * mass, glm::dvec3(velocities[first + i]) * mass };
+    });
+
+    if (moments.mass <= 0.0)
+        return;
+
+    const glm::vec3 positionShift = center - glm::vec3(moments.weightedPosition / moments.mass);
+    const glm::vec3 velocityShift = velocity - glm::vec3(moments.momentum / moments.mass);
+    ThreadPool::Get().ParallelFor(count, 4096, [&](size_t begin, size_t end) {
+        for (size_t i = first + begin; i < first + end; i++) {
+            positions[i] += positionShift;
+            velocities[i] += velocityShift;
+        }
+    });
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#ifndef INITIAL_CONDITIONS_H
+#define INITIAL_CONDITIONS_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "BodyGenerator.h"
+#include "BodyStorage.h"
+#include "SPHSolver.h"
+
+namespace SpaceSim {
+
+// Equilibrium samplers for GravitySimulation::SpawnBodies. Masses are totals for the whole component and
+// are split evenly between its bodies, so the count passed to SpawnBodies must match `count`.
+
+struct PlummerParams {
+    size_t count = 10000;
+    float totalMass = 1000.0f;
+    float scaleRadius = 3.0f;
+    float maxRadius = 30.0f;
+    float gravityStrength = 1.0f;
+    float bodyRadius = 0.05f;
+    glm::vec4 color = glm::vec4(1.0f, 0.85f, 0.6f, 1.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 velocity = glm::vec3(0.0f);
+};
+
+struct HernquistParams {
+    size_t count = 10000;
+    float totalMass = 1000.0f;
+    float scaleRadius = 2.0f;
+    float maxRadius = 100.0f;
+    float gravityStrength = 1.0f;
+    float bodyRadius = 0.05f;
+    glm::vec4 color = glm::vec4(0.9f, 0.7f, 0.5f, 1.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 velocity = glm::vec3(0.0f);
+};
+
+// Thin exponential disk in the x-z plane with a sech^2 vertical profile. Velocity dispersions follow
+// from the Toomre Q and the vertical hydrostatic balance, and the mean rotation includes asymmetric drift.
+// haloMass/haloScaleRadius and centralMass are spherical components the disk orbits in; they are not spawned.
+struct ExponentialDiskParams {
+    size_t count = 10000;
+    float diskMass = 200.0f;
+    float scaleLength = 3.0f;
+    float scaleHeight = 0.3f;
+    float maxRadius = 18.0f;
+    float toomreQ = 1.5f;
+    float centralMass = 0.0f;
+    float haloMass = 0.0f;
+    float haloScaleRadius = 4.0f;
+    float gravityStrength = 1.0f;
+    float bodyRadius = 0.05f;
+    glm::vec4 color = glm::vec4(0.6f, 0.75f, 1.0f, 1.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 velocity = glm::vec3(0.0f);
+};
+
+// Test-particle belt on Keplerian orbits around centralMass. Semi-major axes follow a power-law surface
+// density, eccentricities and inclinations are Rayleigh distributed with the given scales.
+struct KeplerianBeltParams {
+    size_t count = 10000;
+    float centralMass = 1000.0f;
+    float innerRadius = 8.0f;
+    float outerRadius = 12.0f;
+    float surfaceDensityIndex = 1.0f;
+    float eccentricityScale = 0.05f;
+    float inclinationScale = 0.03f;
+    float totalMass = 0.1f;
+    float gravityStrength = 1.0f;
+    float minBodyRadius = 0.03f;
+    float maxBodyRadius = 0.08f;
+    glm::vec4 color = glm::vec4(0.6f, 0.55f, 0.5f, 1.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 velocity = glm::vec3(0.0f);
+};
+
+// Gas disk in the x-z plane with uniform surface density, a Gaussian vertical profile of height aspectRatio
+// times the radius and circular rotation about centralMass. The sound speed is aspectRatio times the orbital
+// speed, so the disk starts in vertical balance; settings give the adiabatic index and smoothing limits.
+struct GasDiskParams {
+    size_t count = 10000;
+    float centralMass = 1000.0f;
+    float innerRadius = 3.0f;
+    float outerRadius = 18.0f;
+    float totalMass = 10.0f;
+    float aspectRatio = 0.05f;
+    glm::vec3 center = glm::vec3(0.0f);
+    glm::vec3 velocity = glm::vec3(0.0f);
+};
+
+BodyGenerator PlummerSphere(const PlummerParams& params);
+BodyGenerator HernquistHalo(const HernquistParams& params);
+BodyGenerator ExponentialDisk(const ExponentialDiskParams& params);
+BodyGenerator KeplerianBelt(const KeplerianBeltParams& params);
+GasGenerator GasDisk(const GasDiskParams& params, const SPHSettings& settings);
+
+// Shifts bodies [first, first + count) so their centre of mass and mean velocity land exactly on
+// center/velocity, removing the sampling noise of a finite draw.
+void RemoveNetMotion(BodyStorage& bodies, size_t first, size_t count, const glm::vec3& center, const glm::vec3& velocity);
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,786 @@
+#include "MappedBodyStore.h"
+#include "GravityKernels.h"
+#include "SpatialSort.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace SpaceSim {
+
+static constexpr char StoreMagic[8] = { 'S', 'S', 'B', 'O', 'D', 'I', 'E', 'S' };
+static constexpr uint32_t StoreVersion = 1;
+static constexpr uint64_t HeaderBytes = 4096;
+static constexpr uint64_t FieldBytes = MappedBodyStore::ChunkSize * sizeof(float);
+static constexpr uint64_t ChunkBytes = FieldBytes * MappedBodyStore::FieldCount;
+static constexpr uint32_t SortBucketBits = 12;
+
+struct MappedStoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t chunkSize;
+    uint64_t bodyCount;
+    double time;
+    uint64_t stepCount;
+    // Leaf cells of the last sort, stored after the chunks.
+    uint64_t leafCount;
+    uint64_t sortedWork;
+};
+
+struct TileWalkBuffers {
+    ParticleBuffer particles;
+    CellBuffer cells;
+    std::vector<uint32_t> stack;
+    std::vector<float> tx, ty, tz;
+    std::vector<float> ax, ay, az;
+};
+
+static thread_local TileWalkBuffers t_TileWalkBuffers;
+
+static uint64_t GetDataBytes(uint64_t bodyCount)
+{
+    return HeaderBytes + (bodyCount + MappedBodyStore::ChunkSize - 1) / MappedBodyStore::ChunkSize * ChunkBytes;
+}
+
+static float* FieldAt(uint8_t* data, uint64_t index, MappedBodyStore::Field field)
+{
+    const uint64_t chunk = index / MappedBodyStore::ChunkSize;
+    const uint64_t lane = index % MappedBodyStore::ChunkSize;
+    return reinterpret_cast<float*>(data + HeaderBytes + chunk * ChunkBytes + field * FieldBytes) + lane;
+}
+
+static bool Accepts(const OctreeNode& node, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float theta2)
+{
+    glm::vec3 gap = glm::max(glm::max(boundsMin - node.centerOfMass, node.centerOfMass - boundsMax), glm::vec3(0.0f));
+    glm::vec3 extent = node.boundsMax - node.boundsMin;
+    float size = glm::max(extent.x, glm::max(extent.y, extent.z));
+    return size * size < theta2 * glm::dot(gap, gap);
+}
+
+bool MappedBodyStore::Create(const std::string& path, uint64_t bodyCount)
+{
+    Close();
+    if (!m_File.Create(path, GetDataBytes(bodyCount)))
+        return false;
+
+    MappedStoreHeader header = {};
+    std::memcpy(header.magic, StoreMagic, sizeof(StoreMagic));
+    header.version = StoreVersion;
+    header.chunkSize = ChunkSize;
+    header.bodyCount = bodyCount;
+    std::memcpy(m_File.GetData(), &header, sizeof(header));
+    m_BodyCount = bodyCount;
+    return true;
+}
+
+bool MappedBodyStore::Open(const std::string& path, MappedAccess access)
+{
+    Close();
+    if (!m_File.Open(path, access))
+        return false;
+
+    MappedStoreHeader header = {};
+    if (m_File.GetSize() >= HeaderBytes)
+        std::memcpy(&header, m_File.GetData(), sizeof(header));
+
+    const uint64_t dataBytes = GetDataBytes(header.bodyCount);
+    if (std::memcmp(header.magic, StoreMagic, sizeof(StoreMagic)) != 0 || header.version != StoreVersion ||
+        header.chunkSize != ChunkSize || m_File.GetSize() < dataBytes + header.leafCount * sizeof(LeafCell))
+    {
+        std::cerr << "Not a body store or truncated: " << path << std::endl;
+        m_File.Close();
+        return false;
+    }
+
+    m_BodyCount = header.bodyCount;
+    if (header.leafCount == 0)
+    {
+        if (access == MappedAccess::ReadWrite)
+            Sort();
+        return true;
+    }
+
+    std::vector<LeafCell> cells(header.leafCount);
+    std::memcpy(cells.data(), m_File.GetData() + dataBytes, cells.size() * sizeof(LeafCell));
+    BuildTree(cells);
+    RefitTiles(0, GetChunkCount());
+    RefitTree();
+    m_SortedWork = header.sortedWork;
+    return true;
+}
+
+void MappedBodyStore::Close()
+{
+    m_File.Close();
+    m_BodyCount = 0;
+    m_Nodes.clear();
+    m_Leaves.clear();
+    m_LeafFirstBody.clear();
+    m_TileLeaves.clear();
+    m_MaxStack = 0;
+    m_SortedWork = 0;
+}
+
+bool MappedBodyStore::Flush()
+{
+    return m_File.Flush(0, m_File.GetSize(), true);
+}
+
+uint32_t MappedBodyStore::GetChunkBodyCount(uint64_t chunk) const
+{
+    return static_cast<uint32_t>(std::min<uint64_t>(ChunkSize, m_BodyCount - std::min(m_BodyCount, chunk * ChunkSize)));
+}
+
+double MappedBodyStore::GetTime() const
+{
+    return IsOpen() ? reinterpret_cast<const MappedStoreHeader*>(m_File.GetData())->time : 0.0;
+}
+
+uint64_t MappedBodyStore::GetStepCount() const
+{
+    return IsOpen() ? reinterpret_cast<const MappedStoreHeader*>(m_File.GetData())->stepCount : 0;
+}
+
+size_t MappedBodyStore::GetSummaryBytes() const
+{
+    return m_Nodes.size() * sizeof(OctreeNode) + m_Leaves.size() * sizeof(uint32_t) +
+           m_LeafFirstBody.size() * sizeof(uint64_t) + m_TileLeaves.size() * sizeof(uint32_t);
+}
+
+uint64_t MappedBodyStore::GetFieldOffset(uint64_t chunk, Field field) const
+{
+    return HeaderBytes + chunk * ChunkBytes + field * FieldBytes;
+}
+
+float* MappedBodyStore::GetField(uint64_t chunk, Field field) const
+{
+    return reinterpret_cast<float*>(m_File.GetData() + GetFieldOffset(chunk, field));
+}
+
+CelestialBody MappedBodyStore::GetBody(uint64_t index) const
+{
+    uint8_t* data = m_File.GetData();
+    CelestialBody body = {};
+    body.position = glm::vec3(*FieldAt(data, index, PositionX), *FieldAt(data, index, PositionY), *FieldAt(data, index, PositionZ));
+    body.velocity = glm::vec3(*FieldAt(data, index, VelocityX), *FieldAt(data, index, VelocityY), *FieldAt(data, index, VelocityZ));
+    body.mass = *FieldAt(data, index, Mass);
+    return body;
+}
+
+void MappedBodyStore::SetBody(uint64_t index, const CelestialBody& body)
+{
+    uint8_t* data = m_File.GetData();
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        *FieldAt(data, index, static_cast<Field>(PositionX + axis)) = body.position[axis];
+        *FieldAt(data, index, static_cast<Field>(VelocityX + axis)) = body.velocity[axis];
+    }
+    *FieldAt(data, index, Mass) = body.mass;
+}
+
+uint32_t MappedBodyStore::GetSpans(uint32_t leaf, Span spans[2]) const
+{
+    const uint64_t first = m_LeafFirstBody[leaf];
+    const uint32_t count = m_Nodes[m_Leaves[leaf]].bodyCount;
+    const uint32_t lane = static_cast<uint32_t>(first % ChunkSize);
+    const uint32_t head = std::min(count, ChunkSize - lane);
+    spans[0] = { first / ChunkSize, lane, head };
+    if (head == count)
+        return 1;
+    spans[1] = { first / ChunkSize + 1, 0, count - head };
+    return 2;
+}
+
+void MappedBodyStore::ComputeKeys(uint64_t chunk, std::vector<uint64_t>& keys) const
+{
+    const float* px = GetField(chunk, PositionX);
+    const float* py = GetField(chunk, PositionY);
+    const float* pz = GetField(chunk, PositionZ);
+    const float scale = static_cast<float>(1u << MortonBitsPerAxis) / m_SortBounds.size;
+    const glm::vec3 maxCell(static_cast<float>((1u << MortonBitsPerAxis) - 1));
+    keys.resize(GetChunkBodyCount(chunk));
+    ThreadPool::Get().ParallelFor(keys.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            glm::uvec3 cell(glm::clamp((glm::vec3(px[k], py[k], pz[k]) - m_SortBounds.min) * scale, glm::vec3(0.0f), maxCell));
+            keys[k] = EncodeMorton(cell.x, cell.y, cell.z);
+        }
+    });
+}
+
+// The leaves are found in one pass over the sorted keys. A leaf starting at body a is the coarsest cell
+// that holds neither body a - 1 nor body a + LeafSize, so it has at most LeafSize bodies and leaves tile
+// the curve without overlap. Only bodies with identical keys can fill a cell at the finest level beyond
+// LeafSize; they are split into several leaves of that cell.
+void MappedBodyStore::FindLeaves(std::vector<LeafCell>& cells) const
+{
+    cells.clear();
+    if (m_BodyCount == 0)
+        return;
+
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> nextKeys;
+    const uint64_t chunkCount = GetChunkCount();
+    uint64_t previousKey = 0;
+    uint64_t body = 0;
+    ComputeKeys(0, keys);
+
+    for (uint64_t chunk = 0; chunk < chunkCount; chunk++) {
+        if (chunk + 1 < chunkCount)
+            ComputeKeys(chunk + 1, nextKeys);
+        else
+            nextKeys.clear();
+
+        const uint64_t base = chunk * ChunkSize;
+        auto keyAt = [&](uint64_t index) {
+            const uint64_t local = index - base;
+            return local < keys.size() ? keys[local] : nextKeys[local - keys.size()];
+        };
+
+        while (body < base + keys.size())
+        {
+            const uint64_t key = keyAt(body);
+            const bool hasAhead = body + LeafSize < m_BodyCount;
+            const uint64_t ahead = hasAhead ? keyAt(body + LeafSize) : 0;
+            uint32_t level = MortonBitsPerAxis;
+            for (uint32_t l = 0; l < MortonBitsPerAxis; l++) {
+                const uint32_t shift = 3 * (MortonBitsPerAxis - l);
+                if ((body > 0 && (previousKey >> shift) == (key >> shift)) || (hasAhead && (ahead >> shift) == (key >> shift)))
+                    continue;
+                level = l;
+                break;
+            }
+
+            const uint32_t shift = 3 * (MortonBitsPerAxis - level);
+            uint32_t count = 1;
+            while (count < LeafSize && body + count < m_BodyCount && (keyAt(body + count) >> shift) == (key >> shift)) {
+                count++;
+            }
+
+            cells.push_back({ body, count, level, key >> shift });
+            previousKey = keyAt(body + count - 1);
+            body += count;
+        }
+        std::swap(keys, nextKeys);
+    }
+}
+
+void MappedBodyStore::BuildTree(const std::vector<LeafCell>& cells)
+{
+    m_Nodes.clear();
+    m_Leaves.clear();
+    m_LeafFirstBody.clear();
+    m_TileLeaves.clear();
+    m_MaxStack = 0;
+    if (cells.empty())
+        return;
+
+    uint32_t deepestLevel = 0;
+    for (const LeafCell& cell : cells) {
+        deepestLevel = std::max(deepestLevel, cell.level);
+    }
+
+    const uint64_t chunkCount = GetChunkCount();
+    m_Leaves.resize(cells.size());
+    m_LeafFirstBody.resize(cells.size());
+    m_Nodes.resize(1);
+    BuildNode(0, 0, 0, cells.size(), cells);
+    m_MaxStack = m_MaxStack * (deepestLevel + 2) + 1;
+
+    m_TileLeaves.resize(chunkCount + 1);
+    for (uint64_t tile = 0; tile <= chunkCount; tile++) {
+        m_TileLeaves[tile] = static_cast<uint32_t>(std::lower_bound(m_LeafFirstBody.begin(), m_LeafFirstBody.end(), tile * ChunkSize) - m_LeafFirstBody.begin());
+    }
+}
+
+void MappedBodyStore::BuildNode(uint32_t nodeIndex, uint32_t level, size_t begin, size_t end, const std::vector<LeafCell>& cells)
+{
+    if (end - begin == 1 && cells[begin].level == level)
+    {
+        m_Nodes[nodeIndex].firstBody = static_cast<uint32_t>(begin);
+        m_Nodes[nodeIndex].bodyCount = cells[begin].count;
+        m_Leaves[begin] = nodeIndex;
+        m_LeafFirstBody[begin] = cells[begin].firstBody;
+        return;
+    }
+
+    // Leaves of one finest-level cell become siblings; otherwise the cells split on the next octant digit.
+    std::vector<std::pair<size_t, size_t>> children;
+    const bool split = cells[begin].level > level;
+    for (size_t i = begin; i < end;) {
+        size_t next = i + 1;
+        if (split)
+        {
+            const uint64_t digit = (cells[i].prefix >> (3 * (cells[i].level - level - 1))) & 7;
+            while (next < end && ((cells[next].prefix >> (3 * (cells[next].level - level - 1))) & 7) == digit) {
+                next++;
+            }
+        }
+        children.emplace_back(i, next);
+        i = next;
+    }
+
+    const uint32_t firstChild = static_cast<uint32_t>(m_Nodes.size());
+    m_Nodes.resize(m_Nodes.size() + children.size());
+    m_Nodes[nodeIndex].firstChild = firstChild;
+    m_Nodes[nodeIndex].childCount = static_cast<uint32_t>(children.size());
+    m_Nodes[nodeIndex].bodyCount = static_cast<uint32_t>(std::min<uint64_t>(cells[end - 1].firstBody + cells[end - 1].count - cells[begin].firstBody, UINT32_MAX));
+    m_MaxStack = std::max(m_MaxStack, static_cast<uint32_t>(children.size()));
+    for (size_t c = 0; c < children.size(); c++) {
+        BuildNode(firstChild + static_cast<uint32_t>(c), split ? level + 1 : level, children[c].first, children[c].second, cells);
+    }
+}
+
+void MappedBodyStore::RefitLeaf(uint32_t leaf)
+{
+    Span spans[2];
+    const uint32_t spanCount = GetSpans(leaf, spans);
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    glm::vec3 weightedPosition(0.0f);
+    float mass = 0.0f;
+    for (uint32_t s = 0; s < spanCount; s++) {
+        const float* px = GetField(spans[s].chunk, PositionX) + spans[s].first;
+        const float* py = GetField(spans[s].chunk, PositionY) + spans[s].first;
+        const float* pz = GetField(spans[s].chunk, PositionZ) + spans[s].first;
+        const float* masses = GetField(spans[s].chunk, Mass) + spans[s].first;
+        for (uint32_t k = 0; k < spans[s].count; k++) {
+            const glm::vec3 position(px[k], py[k], pz[k]);
+            boundsMin = glm::min(boundsMin, position);
+            boundsMax = glm::max(boundsMax, position);
+            weightedPosition += position * masses[k];
+            mass += masses[k];
+        }
+    }
+
+    glm::vec3 centerOfMass = mass > 0.0f ? weightedPosition / mass : (boundsMin + boundsMax) * 0.5f;
+    Quadrupole quadrupole;
+    for (uint32_t s = 0; s < spanCount; s++) {
+        const float* px = GetField(spans[s].chunk, PositionX) + spans[s].first;
+        const float* py = GetField(spans[s].chunk, PositionY) + spans[s].first;
+        const float* pz = GetField(spans[s].chunk, PositionZ) + spans[s].first;
+        const float* masses = GetField(spans[s].chunk, Mass) + spans[s].first;
+        for (uint32_t k = 0; k < spans[s].count; k++) {
+            AddPointQuadrupole(quadrupole, glm::vec3(px[k], py[k], pz[k]) - centerOfMass, masses[k]);
+        }
+    }
+
+    OctreeNode& node = m_Nodes[m_Leaves[leaf]];
+    node.boundsMin = boundsMin;
+    node.boundsMax = boundsMax;
+    node.centerOfMass = centerOfMass;
+    node.mass = mass;
+    node.quadrupole = quadrupole;
+}
+
+void MappedBodyStore::RefitTiles(uint64_t firstTile, uint64_t endTile)
+{
+    for (uint64_t tile = firstTile; tile < endTile; tile++) {
+        const uint32_t firstLeaf = m_TileLeaves[tile];
+        ThreadPool::Get().ParallelFor(m_TileLeaves[tile + 1] - firstLeaf, 16, [&](size_t begin, size_t end) {
+            for (size_t l = begin; l < end; l++) {
+                RefitLeaf(firstLeaf + static_cast<uint32_t>(l));
+            }
+        });
+    }
+}
+
+void MappedBodyStore::RefitTree()
+{
+    // Children come after their parent, so a backward pass sees every child refitted first.
+    for (size_t n = m_Nodes.size(); n-- > 0;) {
+        OctreeNode& node = m_Nodes[n];
+        if (node.childCount == 0)
+            continue;
+
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+        glm::vec3 weightedPosition(0.0f);
+        float mass = 0.0f;
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+            const OctreeNode& child = m_Nodes[c];
+            boundsMin = glm::min(boundsMin, child.boundsMin);
+            boundsMax = glm::max(boundsMax, child.boundsMax);
+            weightedPosition += child.centerOfMass * child.mass;
+            mass += child.mass;
+        }
+
+        glm::vec3 centerOfMass = mass > 0.0f ? weightedPosition / mass : (boundsMin + boundsMax) * 0.5f;
+        Quadrupole quadrupole;
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+            const OctreeNode& child = m_Nodes[c];
+            quadrupole.xx += child.quadrupole.xx;
+            quadrupole.yy += child.quadrupole.yy;
+            quadrupole.zz += child.quadrupole.zz;
+            quadrupole.xy += child.quadrupole.xy;
+            quadrupole.xz += child.quadrupole.xz;
+            quadrupole.yz += child.quadrupole.yz;
+            AddPointQuadrupole(quadrupole, child.centerOfMass - centerOfMass, child.mass);
+        }
+
+        node.boundsMin = boundsMin;
+        node.boundsMax = boundsMax;
+        node.centerOfMass = centerOfMass;
+        node.mass = mass;
+        node.quadrupole = quadrupole;
+    }
+
+}
+
+void MappedBodyStore::CollectSourceChunks(uint64_t tile, std::vector<uint64_t>& chunks) const
+{
+    chunks.clear();
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (uint32_t leaf = m_TileLeaves[tile]; leaf < m_TileLeaves[tile + 1]; leaf++) {
+        boundsMin = glm::min(boundsMin, m_Nodes[m_Leaves[leaf]].boundsMin);
+        boundsMax = glm::max(boundsMax, m_Nodes[m_Leaves[leaf]].boundsMax);
+    }
+
+    // Any leaf a member of the tile opens is also opened from the tile's bounds.
+    const float theta2 = m_Settings.openingAngle * m_Settings.openingAngle;
+    std::vector<uint32_t> stack(m_MaxStack);
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const OctreeNode& node = m_Nodes[stack[--stackSize]];
+        if (Accepts(node, boundsMin, boundsMax, theta2))
+            continue;
+
+        if (node.childCount == 0)
+        {
+            Span spans[2];
+            const uint32_t spanCount = GetSpans(node.firstBody, spans);
+            for (uint32_t s = 0; s < spanCount; s++) {
+                chunks.push_back(spans[s].chunk);
+            }
+        }
+        else
+        {
+            for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+                stack[stackSize++] = c;
+            }
+        }
+    }
+
+    std::sort(chunks.begin(), chunks.end());
+    chunks.erase(std::unique(chunks.begin(), chunks.end()), chunks.end());
+}
+
+void MappedBodyStore::PrefetchChunks(const std::vector<uint64_t>& chunks)
+{
+    for (uint64_t chunk : chunks) {
+        m_File.Advise(GetFieldOffset(chunk, PositionX), FieldBytes * 3, MappedHint::WillNeed);
+        m_File.Advise(GetFieldOffset(chunk, Mass), FieldBytes, MappedHint::WillNeed);
+    }
+    m_Stats.prefetchedChunks += chunks.size();
+}
+
+void MappedBodyStore::Kick(float deltaTime, float gravityStrength)
+{
+    if (m_Nodes.empty() || m_File.GetAccess() != MappedAccess::ReadWrite)
+        return;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const uint64_t tileCount = GetChunkCount();
+    const float theta2 = m_Settings.openingAngle * m_Settings.openingAngle;
+    const uint32_t laneWidth = GetKernelLaneWidth();
+    const float scale = gravityStrength * deltaTime;
+    std::atomic<uint64_t> sourceBodies{ 0 };
+    std::atomic<uint64_t> sourceCells{ 0 };
+    std::vector<uint64_t> sourceChunks;
+    m_Stats.prefetchedChunks = 0;
+
+    for (uint64_t tile = 0; tile < std::min<uint64_t>(m_Settings.prefetchTiles, tileCount); tile++) {
+        CollectSourceChunks(tile, sourceChunks);
+        PrefetchChunks(sourceChunks);
+    }
+
+    for (uint64_t tile = 0; tile < tileCount; tile++) {
+        if (m_Settings.prefetchTiles > 0 && tile + m_Settings.prefetchTiles < tileCount)
+        {
+            const uint64_t ahead = tile + m_Settings.prefetchTiles;
+            CollectSourceChunks(ahead, sourceChunks);
+            PrefetchChunks(sourceChunks);
+            m_File.Advise(GetFieldOffset(ahead, VelocityX), FieldBytes * 3, MappedHint::WillNeed);
+        }
+
+        const uint32_t firstLeaf = m_TileLeaves[tile];
+        ThreadPool::Get().Dispatch(m_TileLeaves[tile + 1] - firstLeaf, [&](uint32_t l) {
+            TileWalkBuffers& buffers = t_TileWalkBuffers;
+            buffers.stack.resize(m_MaxStack);
+            buffers.particles.Clear();
+            buffers.cells.Clear();
+
+            const uint32_t leaf = firstLeaf + l;
+            const OctreeNode& group = m_Nodes[m_Leaves[leaf]];
+            Span spans[2];
+            uint32_t stackSize = 0;
+            buffers.stack[stackSize++] = 0;
+            while (stackSize > 0)
+            {
+                const OctreeNode& node = m_Nodes[buffers.stack[--stackSize]];
+                if (Accepts(node, group.boundsMin, group.boundsMax, theta2))
+                {
+                    buffers.cells.Push(node);
+                }
+                else if (node.childCount == 0)
+                {
+                    const uint32_t spanCount = GetSpans(node.firstBody, spans);
+                    for (uint32_t s = 0; s < spanCount; s++) {
+                        const float* px = GetField(spans[s].chunk, PositionX) + spans[s].first;
+                        const float* py = GetField(spans[s].chunk, PositionY) + spans[s].first;
+                        const float* pz = GetField(spans[s].chunk, PositionZ) + spans[s].first;
+                        const float* masses = GetField(spans[s].chunk, Mass) + spans[s].first;
+                        for (uint32_t k = 0; k < spans[s].count; k++) {
+                            buffers.particles.Push(glm::vec3(px[k], py[k], pz[k]), masses[k]);
+                        }
+                    }
+                }
+                else
+                {
+                    for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+                        buffers.stack[stackSize++] = c;
+                    }
+                }
+            }
+
+            const size_t targetCount = group.bodyCount;
+            const size_t paddedCount = (targetCount + laneWidth - 1) / laneWidth * laneWidth;
+            buffers.tx.resize(paddedCount);
+            buffers.ty.resize(paddedCount);
+            buffers.tz.resize(paddedCount);
+            buffers.ax.assign(paddedCount, 0.0f);
+            buffers.ay.assign(paddedCount, 0.0f);
+            buffers.az.assign(paddedCount, 0.0f);
+
+            const uint32_t spanCount = GetSpans(leaf, spans);
+            size_t t = 0;
+            for (uint32_t s = 0; s < spanCount; s++) {
+                std::memcpy(&buffers.tx[t], GetField(spans[s].chunk, PositionX) + spans[s].first, spans[s].count * sizeof(float));
+                std::memcpy(&buffers.ty[t], GetField(spans[s].chunk, PositionY) + spans[s].first, spans[s].count * sizeof(float));
+                std::memcpy(&buffers.tz[t], GetField(spans[s].chunk, PositionZ) + spans[s].first, spans[s].count * sizeof(float));
+                t += spans[s].count;
+            }
+            for (; t < paddedCount; t++) {
+                buffers.tx[t] = buffers.tx[targetCount - 1];
+                buffers.ty[t] = buffers.ty[targetCount - 1];
+                buffers.tz[t] = buffers.tz[targetCount - 1];
+            }
+
+            AccumulateParticleParticle(buffers.particles, buffers.tx.data(), buffers.ty.data(), buffers.tz.data(),
+                                       paddedCount, buffers.ax.data(), buffers.ay.data(), buffers.az.data());
+            AccumulateParticleCell(buffers.cells, m_Settings.quadrupole, buffers.tx.data(), buffers.ty.data(), buffers.tz.data(),
+                                   paddedCount, buffers.ax.data(), buffers.ay.data(), buffers.az.data());
+
+            t = 0;
+            for (uint32_t s = 0; s < spanCount; s++) {
+                float* vx = GetField(spans[s].chunk, VelocityX) + spans[s].first;
+                float* vy = GetField(spans[s].chunk, VelocityY) + spans[s].first;
+                float* vz = GetField(spans[s].chunk, VelocityZ) + spans[s].first;
+                for (uint32_t k = 0; k < spans[s].count; k++, t++) {
+                    vx[k] += buffers.ax[t] * scale;
+                    vy[k] += buffers.ay[t] * scale;
+                    vz[k] += buffers.az[t] * scale;
+                }
+            }
+
+            sourceBodies.fetch_add(buffers.particles.Size(), std::memory_order_relaxed);
+            sourceCells.fetch_add(buffers.cells.Size(), std::memory_order_relaxed);
+        });
+
+        // Starting write-back per tile keeps dirty velocity pages from piling up until reclaim stalls on them.
+        m_File.Flush(GetFieldOffset(tile, VelocityX), FieldBytes * 3, false);
+    }
+
+    m_Stats.sourceBodies = sourceBodies.load();
+    m_Stats.sourceCells = sourceCells.load();
+    const uint64_t work = std::max<uint64_t>(m_Stats.sourceBodies + m_Stats.sourceCells, 1);
+    if (m_SortedWork == 0)
+    {
+        m_SortedWork = work;
+        reinterpret_cast<MappedStoreHeader*>(m_File.GetData())->sortedWork = work;
+    }
+    m_Stats.workRatio = static_cast<float>(static_cast<double>(work) / m_SortedWork);
+    m_Stats.kickMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void MappedBodyStore::Drift(float deltaTime)
+{
+    if (m_Nodes.empty() || m_File.GetAccess() != MappedAccess::ReadWrite)
+        return;
+
+    // A tile's last leaf may reach into the next chunk, so tile c - 1 is refitted and written back once
+    // chunk c has moved.
+    auto start = std::chrono::high_resolution_clock::now();
+    const uint64_t chunkCount = GetChunkCount();
+    m_File.Advise(0, m_File.GetSize(), MappedHint::Sequential);
+    for (uint64_t chunk = 0; chunk < chunkCount; chunk++) {
+        const uint32_t count = GetChunkBodyCount(chunk);
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            float* position = GetField(chunk, static_cast<Field>(PositionX + axis));
+            const float* velocity = GetField(chunk, static_cast<Field>(VelocityX + axis));
+            for (uint32_t k = 0; k < count; k++) {
+                position[k] += velocity[k] * deltaTime;
+            }
+        }
+
+        if (chunk > 0)
+        {
+            RefitTiles(chunk - 1, chunk);
+            m_File.Flush(GetFieldOffset(chunk - 1, PositionX), ChunkBytes, false);
+        }
+    }
+    RefitTiles(chunkCount - 1, chunkCount);
+    m_File.Flush(GetFieldOffset(chunkCount - 1, PositionX), ChunkBytes, false);
+    m_File.Advise(0, m_File.GetSize(), MappedHint::Normal);
+    RefitTree();
+
+    MappedStoreHeader* header = reinterpret_cast<MappedStoreHeader*>(m_File.GetData());
+    header->time += deltaTime;
+    header->stepCount++;
+    m_Stats.driftMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void MappedBodyStore::Step(float deltaTime, float gravityStrength)
+{
+    if (m_Nodes.empty())
+        Sort();
+
+    Kick(deltaTime, gravityStrength);
+    Drift(deltaTime);
+    if (m_Settings.resortThreshold > 0.0f && m_Stats.workRatio > m_Settings.resortThreshold)
+        Sort();
+}
+
+bool MappedBodyStore::Sort()
+{
+    if (m_BodyCount == 0 || m_File.GetAccess() != MappedAccess::ReadWrite)
+        return false;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    const uint64_t chunkCount = GetChunkCount();
+    m_File.Advise(0, m_File.GetSize(), MappedHint::Sequential);
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    for (uint64_t chunk = 0; chunk < chunkCount; chunk++) {
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            const float* position = GetField(chunk, static_cast<Field>(PositionX + axis));
+            for (uint32_t k = 0; k < GetChunkBodyCount(chunk); k++) {
+                boundsMin[axis] = std::min(boundsMin[axis], position[k]);
+                boundsMax[axis] = std::max(boundsMax[axis], position[k]);
+            }
+        }
+    }
+    const glm::vec3 extent = boundsMax - boundsMin;
+    m_SortBounds.min = boundsMin;
+    m_SortBounds.size = std::max(glm::max(extent.x, glm::max(extent.y, extent.z)) * 1.0001f, std::numeric_limits<float>::min());
+
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> offsets((1u << SortBucketBits) + 1, 0);
+    for (uint64_t chunk = 0; chunk < chunkCount; chunk++) {
+        ComputeKeys(chunk, keys);
+        for (uint64_t key : keys) {
+            offsets[(key >> (MortonKeyBits - SortBucketBits)) + 1]++;
+        }
+    }
+    for (size_t b = 1; b < offsets.size(); b++) {
+        offsets[b] += offsets[b - 1];
+    }
+
+    // Scatter into the scratch file. Each bucket is written front to back, so the scattered writes form
+    // one sequential stream per bucket and field.
+    MappedFile scratch;
+    const std::string scratchPath = m_File.GetPath() + ".sort";
+    const uint64_t dataBytes = GetDataBytes(m_BodyCount);
+    if (!scratch.Create(scratchPath, dataBytes))
+        return false;
+
+    std::vector<uint64_t> cursors(offsets.begin(), offsets.end() - 1);
+    std::vector<uint64_t> destinations;
+    for (uint64_t chunk = 0; chunk < chunkCount; chunk++) {
+        ComputeKeys(chunk, keys);
+        destinations.resize(keys.size());
+        for (size_t k = 0; k < keys.size(); k++) {
+            destinations[k] = cursors[keys[k] >> (MortonKeyBits - SortBucketBits)]++;
+        }
+        for (uint32_t field = 0; field < FieldCount; field++) {
+            const float* source = GetField(chunk, static_cast<Field>(field));
+            for (size_t k = 0; k < keys.size(); k++) {
+                *FieldAt(scratch.GetData(), destinations[k], static_cast<Field>(field)) = source[k];
+            }
+        }
+        if (chunk % 16 == 15)
+            scratch.Flush(0, dataBytes, false);
+    }
+
+    // Sort every bucket in memory and write it back in place of the original range.
+    scratch.Advise(0, scratch.GetSize(), MappedHint::Sequential);
+    const float scale = static_cast<float>(1u << MortonBitsPerAxis) / m_SortBounds.size;
+    const glm::vec3 maxCell(static_cast<float>((1u << MortonBitsPerAxis) - 1));
+    std::vector<uint32_t> order;
+    std::vector<uint64_t> keyScratch;
+    std::vector<uint32_t> orderScratch;
+    std::vector<float> values;
+    uint64_t flushedChunks = 0;
+    for (size_t b = 0; b + 1 < offsets.size(); b++) {
+        const uint64_t begin = offsets[b];
+        const uint32_t count = static_cast<uint32_t>(offsets[b + 1] - begin);
+        if (count == 0)
+            continue;
+
+        keys.resize(count);
+        order.resize(count);
+        for (uint32_t k = 0; k < count; k++) {
+            const glm::vec3 position(*FieldAt(scratch.GetData(), begin + k, PositionX), *FieldAt(scratch.GetData(), begin + k, PositionY),
+                                     *FieldAt(scratch.GetData(), begin + k, PositionZ));
+            glm::uvec3 cell(glm::clamp((position - m_SortBounds.min) * scale, glm::vec3(0.0f), maxCell));
+            keys[k] = EncodeMorton(cell.x, cell.y, cell.z);
+            order[k] = k;
+        }
+        RadixSortPairs(keys, order, keyScratch, orderScratch, MortonKeyBits);
+
+        values.resize(count);
+        for (uint32_t field = 0; field < FieldCount; field++) {
+            for (uint32_t k = 0; k < count; k++) {
+                values[k] = *FieldAt(scratch.GetData(), begin + k, static_cast<Field>(field));
+            }
+            for (uint32_t k = 0; k < count; k++) {
+                *FieldAt(m_File.GetData(), begin + k, static_cast<Field>(field)) = values[order[k]];
+            }
+        }
+        for (; flushedChunks < (begin + count) / ChunkSize; flushedChunks++) {
+            m_File.Flush(GetFieldOffset(flushedChunks, PositionX), ChunkBytes, false);
+        }
+    }
+
+    scratch.Close();
+    std::remove(scratchPath.c_str());
+
+    // The leaf cells are kept after the chunks so Open() can restore the tree without sorting.
+    std::vector<LeafCell> cells;
+    FindLeaves(cells);
+    if (!m_File.Resize(dataBytes + cells.size() * sizeof(LeafCell)))
+        return false;
+    std::memcpy(m_File.GetData() + dataBytes, cells.data(), cells.size() * sizeof(LeafCell));
+
+    BuildTree(cells);
+    RefitTiles(0, chunkCount);
+    m_File.Advise(0, m_File.GetSize(), MappedHint::Normal);
+    RefitTree();
+    m_SortedWork = 0;
+
+    MappedStoreHeader* header = reinterpret_cast<MappedStoreHeader*>(m_File.GetData());
+    header->leafCount = cells.size();
+    header->sortedWork = 0;
+    m_Stats.sorts++;
+    m_Stats.sortMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return true;
+}
+
+}
\ No newline at end of file
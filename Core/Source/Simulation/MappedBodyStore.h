@@ -0,0 +1,144 @@
+#ifndef MAPPED_BODY_STORE_H
+#define MAPPED_BODY_STORE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "CelestialBody.h"
+#include "MappedFile.h"
+#include "Octree.h"
+#include "SpatialSort.h"
+
+namespace SpaceSim {
+
+struct MappedStoreSettings {
+    float openingAngle = 0.5f;
+    bool quadrupole = true;
+    // Tiles whose source chunks are prefetched ahead of the tile being evaluated.
+    uint32_t prefetchTiles = 2;
+    // Leaves keep their bodies between sorts and grow as bodies move. Sort() runs again once a kick
+    // evaluates this many times the interactions of the first kick after the last sort.
+    float resortThreshold = 1.3f;
+};
+
+struct MappedStoreStats {
+    double sortMs = 0.0;
+    double kickMs = 0.0;
+    double driftMs = 0.0;
+    uint64_t sourceBodies = 0;
+    uint64_t sourceCells = 0;
+    uint64_t prefetchedChunks = 0;
+    uint64_t sorts = 0;
+    float workRatio = 1.0f;
+};
+
+// Body store for data sets beyond physical memory, kept in a memory-mapped file. Bodies are stored in
+// chunks of ChunkSize, each holding one array per field, so a pass over a field range reads whole pages.
+// Only the tree summaries live in RAM: an octree whose leaves are runs of up to LeafSize bodies in file
+// order, with a multipole per node.
+//
+// Kick() walks the chunks in file order as tiles. Each leaf of a tile gets an interaction list from the
+// tree: accepted nodes act as multipoles, the remaining leaves are read from the map. The chunks a tile
+// will read are hinted to the kernel prefetchTiles tiles ahead. Drift() streams the file once more, refits
+// the leaves and starts write-back of each chunk as it finishes. Bodies are sorted along a Morton curve,
+// so the near field of a tile lies mostly in neighbouring chunks, both passes stay close to sequential and
+// the page cache holds the working set.
+class MappedBodyStore {
+public:
+    static constexpr uint32_t LeafSize = 128;
+    static constexpr uint32_t ChunkSize = 65536;
+
+    enum Field : uint32_t {
+        PositionX,
+        PositionY,
+        PositionZ,
+        VelocityX,
+        VelocityY,
+        VelocityZ,
+        Mass,
+        FieldCount
+    };
+
+    // Fill the bodies with SetBody() or GetField(), then call Sort() to build the tree.
+    bool Create(const std::string& path, uint64_t bodyCount);
+    // Restores the tree saved by the last Sort(). A writable store that was never sorted is sorted here.
+    bool Open(const std::string& path, MappedAccess access = MappedAccess::ReadWrite);
+    void Close();
+    bool Flush();
+
+    bool IsOpen() const { return m_File.IsOpen(); }
+    uint64_t GetBodyCount() const { return m_BodyCount; }
+    uint64_t GetChunkCount() const { return (m_BodyCount + ChunkSize - 1) / ChunkSize; }
+    uint32_t GetChunkBodyCount(uint64_t chunk) const;
+    uint64_t GetFileSize() const { return m_File.GetSize(); }
+    double GetTime() const;
+    uint64_t GetStepCount() const;
+
+    float* GetField(uint64_t chunk, Field field) const;
+    CelestialBody GetBody(uint64_t index) const;
+    void SetBody(uint64_t index, const CelestialBody& body);
+
+    // Orders the bodies along a Morton curve and rebuilds the tree: a streaming bucket pass into a scratch
+    // file next to the store, then every bucket is sorted in memory and written back. Memory use is set by
+    // the largest bucket.
+    bool Sort();
+
+    void Kick(float deltaTime, float gravityStrength);
+    void Drift(float deltaTime);
+    // Same kick-drift update as GravitySimulation. Sorts first if there is no tree yet.
+    void Step(float deltaTime, float gravityStrength);
+
+    const std::vector<OctreeNode>& GetNodes() const { return m_Nodes; }
+    size_t GetLeafCount() const { return m_Leaves.size(); }
+    size_t GetSummaryBytes() const;
+    const MappedStoreSettings& GetSettings() const { return m_Settings; }
+    void SetSettings(const MappedStoreSettings& settings) { m_Settings = settings; }
+    const MappedStoreStats& GetStats() const { return m_Stats; }
+
+private:
+    struct Span {
+        uint64_t chunk;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    struct LeafCell {
+        uint64_t firstBody;
+        uint32_t count;
+        uint32_t level;
+        uint64_t prefix;
+    };
+
+    uint64_t GetFieldOffset(uint64_t chunk, Field field) const;
+    // Leaves may cross a chunk boundary, so a leaf is read as one or two spans.
+    uint32_t GetSpans(uint32_t leaf, Span spans[2]) const;
+    void ComputeKeys(uint64_t chunk, std::vector<uint64_t>& keys) const;
+    void FindLeaves(std::vector<LeafCell>& cells) const;
+    void BuildTree(const std::vector<LeafCell>& cells);
+    void BuildNode(uint32_t nodeIndex, uint32_t level, size_t begin, size_t end, const std::vector<LeafCell>& cells);
+    void RefitLeaf(uint32_t leaf);
+    void RefitTiles(uint64_t firstTile, uint64_t endTile);
+    void RefitTree();
+    void CollectSourceChunks(uint64_t tile, std::vector<uint64_t>& chunks) const;
+    void PrefetchChunks(const std::vector<uint64_t>& chunks);
+
+    MappedFile m_File;
+    uint64_t m_BodyCount = 0;
+    MappedStoreSettings m_Settings;
+    MappedStoreStats m_Stats;
+    SpatialBounds m_SortBounds;
+
+    // Root first, children after their parent. A leaf's firstBody is its position in m_Leaves.
+    std::vector<OctreeNode> m_Nodes;
+    std::vector<uint32_t> m_Leaves;
+    std::vector<uint64_t> m_LeafFirstBody;
+    // First leaf of every tile, plus the leaf count at the end.
+    std::vector<uint32_t> m_TileLeaves;
+    uint32_t m_MaxStack = 0;
+    uint64_t m_SortedWork = 0;
+};
+
+}
+
+#endif
\ No newline at end of file
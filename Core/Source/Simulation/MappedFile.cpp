@@ -0,0 +1,276 @@
+#include "MappedFile.h"
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace SpaceSim {
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        m_Path = std::move(other.m_Path);
+        m_Data = std::exchange(other.m_Data, nullptr);
+        m_Size = std::exchange(other.m_Size, 0);
+        m_Access = other.m_Access;
+#ifdef _WIN32
+        m_File = std::exchange(other.m_File, nullptr);
+        m_Mapping = std::exchange(other.m_Mapping, nullptr);
+#else
+        m_File = std::exchange(other.m_File, -1);
+#endif
+    }
+    return *this;
+}
+
+bool MappedFile::IsOpen() const
+{
+#ifdef _WIN32
+    return m_File != nullptr;
+#else
+    return m_File >= 0;
+#endif
+}
+
+size_t MappedFile::GetPageSize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+bool MappedFile::Create(const std::string& path, uint64_t size)
+{
+    Close();
+    m_Path = path;
+    m_Access = MappedAccess::ReadWrite;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        std::cerr << "Failed to create mapped file: " << path << std::endl;
+        return false;
+    }
+    m_File = file;
+#else
+    m_File = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_File < 0)
+    {
+        std::cerr << "Failed to create mapped file: " << path << std::endl;
+        return false;
+    }
+#endif
+
+    if (!Resize(size))
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool MappedFile::Open(const std::string& path, MappedAccess access)
+{
+    Close();
+    m_Path = path;
+    m_Access = access;
+    const bool writable = access == MappedAccess::ReadWrite;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | (writable ? GENERIC_WRITE : 0), FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size = {};
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size))
+    {
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        std::cerr << "Failed to open mapped file: " << path << std::endl;
+        return false;
+    }
+    m_File = file;
+    m_Size = static_cast<uint64_t>(size.QuadPart);
+#else
+    m_File = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    struct stat status = {};
+    if (m_File < 0 || fstat(m_File, &status) != 0)
+    {
+        std::cerr << "Failed to open mapped file: " << path << std::endl;
+        Close();
+        return false;
+    }
+    m_Size = static_cast<uint64_t>(status.st_size);
+#endif
+
+    if (!Map())
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool MappedFile::Resize(uint64_t size)
+{
+    if (m_Access != MappedAccess::ReadWrite)
+        return false;
+
+    Unmap();
+#ifdef _WIN32
+    LARGE_INTEGER distance;
+    distance.QuadPart = static_cast<LONGLONG>(size);
+    if (!SetFilePointerEx(m_File, distance, nullptr, FILE_BEGIN) || !SetEndOfFile(m_File))
+#else
+    if (ftruncate(m_File, static_cast<off_t>(size)) != 0)
+#endif
+    {
+        std::cerr << "Failed to resize mapped file " << m_Path << " to " << size << " bytes" << std::endl;
+        return false;
+    }
+
+    m_Size = size;
+    return Map();
+}
+
+bool MappedFile::Map()
+{
+    // Empty files cannot be mapped; they stay open with a null data pointer.
+    if (m_Size == 0)
+        return true;
+
+    const bool writable = m_Access == MappedAccess::ReadWrite;
+#ifdef _WIN32
+    m_Mapping = CreateFileMappingA(m_File, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                   static_cast<DWORD>(m_Size >> 32), static_cast<DWORD>(m_Size), nullptr);
+    void* data = m_Mapping ? MapViewOfFile(m_Mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!data)
+#else
+    void* data = mmap(nullptr, m_Size, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, m_File, 0);
+    if (data == MAP_FAILED)
+#endif
+    {
+        std::cerr << "Failed to map " << m_Size << " bytes of " << m_Path << std::endl;
+        return false;
+    }
+
+    m_Data = static_cast<uint8_t*>(data);
+    return true;
+}
+
+void MappedFile::Unmap()
+{
+#ifdef _WIN32
+    if (m_Data)
+        UnmapViewOfFile(m_Data);
+    if (m_Mapping)
+        CloseHandle(m_Mapping);
+    m_Mapping = nullptr;
+#else
+    if (m_Data)
+        munmap(m_Data, m_Size);
+#endif
+    m_Data = nullptr;
+}
+
+void MappedFile::Close()
+{
+    Unmap();
+#ifdef _WIN32
+    if (m_File)
+        CloseHandle(m_File);
+    m_File = nullptr;
+#else
+    if (m_File >= 0)
+        close(m_File);
+    m_File = -1;
+#endif
+    m_Size = 0;
+}
+
+void MappedFile::Advise(uint64_t offset, uint64_t length, MappedHint hint) const
+{
+    if (!m_Data || offset >= m_Size)
+        return;
+
+    const uint64_t page = GetPageSize();
+    const uint64_t begin = offset / page * page;
+    const uint64_t end = std::min(offset + length, m_Size);
+    uint8_t* address = m_Data + begin;
+    const size_t size = static_cast<size_t>(end - begin);
+
+#ifdef _WIN32
+    // Windows only takes per-range hints for prefetching and trimming; the access pattern hints have
+    // no per-range equivalent.
+    if (hint == MappedHint::WillNeed)
+    {
+        WIN32_MEMORY_RANGE_ENTRY range = { address, size };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+    else if (hint == MappedHint::DontNeed)
+    {
+        // Unlocking pages that are not locked fails but still drops them from the working set.
+        VirtualUnlock(address, size);
+    }
+#else
+    int advice = MADV_NORMAL;
+    switch (hint) {
+    case MappedHint::Normal: advice = MADV_NORMAL; break;
+    case MappedHint::Sequential: advice = MADV_SEQUENTIAL; break;
+    case MappedHint::Random: advice = MADV_RANDOM; break;
+    case MappedHint::WillNeed: advice = MADV_WILLNEED; break;
+    case MappedHint::DontNeed: advice = MADV_DONTNEED; break;
+    }
+    madvise(address, size, advice);
+#endif
+}
+
+bool MappedFile::Flush(uint64_t offset, uint64_t length, bool wait) const
+{
+    if (!m_Data || m_Access != MappedAccess::ReadWrite || offset >= m_Size)
+        return true;
+
+    const uint64_t page = GetPageSize();
+    const uint64_t begin = offset / page * page;
+    const uint64_t end = std::min(offset + length, m_Size);
+#ifdef _WIN32
+    bool flushed = FlushViewOfFile(m_Data + begin, static_cast<size_t>(end - begin)) != 0;
+    if (flushed && wait)
+        flushed = FlushFileBuffers(m_File) != 0;
+#elif defined(__linux__)
+    // MS_ASYNC does not start write-back on Linux; sync_file_range does without waiting for it.
+    bool flushed = wait ? msync(m_Data + begin, static_cast<size_t>(end - begin), MS_SYNC) == 0
+                        : sync_file_range(m_File, static_cast<off_t>(begin), static_cast<off_t>(end - begin), SYNC_FILE_RANGE_WRITE) == 0;
+#else
+    bool flushed = msync(m_Data + begin, static_cast<size_t>(end - begin), wait ? MS_SYNC : MS_ASYNC) == 0;
+#endif
+    if (!flushed)
+        std::cerr << "Failed to flush mapped file: " << m_Path << std::endl;
+    return flushed;
+}
+
+}
\ No newline at end of file
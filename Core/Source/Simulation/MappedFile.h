@@ -0,0 +1,71 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace SpaceSim {
+
+enum class MappedAccess {
+    ReadOnly,
+    ReadWrite
+};
+
+enum class MappedHint {
+    Normal,
+    Sequential,
+    Random,
+    WillNeed,
+    DontNeed
+};
+
+// Whole-file shared mapping. Writes go to the page cache and reach the file on Flush() or when the
+// kernel writes them back, so a mapping can be far larger than physical memory.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Creates or truncates the file to size bytes, mapped read-write.
+    bool Create(const std::string& path, uint64_t size);
+    bool Open(const std::string& path, MappedAccess access);
+    // Grows or shrinks the file and remaps it; the data pointer may change.
+    bool Resize(uint64_t size);
+    void Close();
+
+    // Ranges are rounded out to whole pages. Without wait, Flush() only starts write-back.
+    void Advise(uint64_t offset, uint64_t length, MappedHint hint) const;
+    bool Flush(uint64_t offset, uint64_t length, bool wait) const;
+
+    bool IsOpen() const;
+    uint8_t* GetData() const { return m_Data; }
+    uint64_t GetSize() const { return m_Size; }
+    MappedAccess GetAccess() const { return m_Access; }
+    const std::string& GetPath() const { return m_Path; }
+
+    static size_t GetPageSize();
+
+private:
+    bool Map();
+    void Unmap();
+
+    std::string m_Path;
+    uint8_t* m_Data = nullptr;
+    uint64_t m_Size = 0;
+    MappedAccess m_Access = MappedAccess::ReadOnly;
+#ifdef _WIN32
+    void* m_File = nullptr;
+    void* m_Mapping = nullptr;
+#else
+    int m_File = -1;
+#endif
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "Octree.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <limits>
+
+namespace SpaceSim {
+
+void AddPointQuadrupole(Quadrupole& q, const glm::vec3& d, float mass)
+{
+    float d2 = glm::dot(d, d);
+    q.xx += mass * (3.0f * d.x * d.x - d2);
+    q.yy += mass * (3.0f * d.y * d.y - d2);
+    q.zz += mass * (3.0f * d.z * d.z - d2);
+    q.xy += mass * 3.0f * d.x * d.y;
+    q.xz += mass * 3.0f * d.x * d.z;
+    q.yz += mass * 3.0f * d.y * d.z;
+}
+
+void Octree::Clear()
+{
+    m_Nodes.clear();
+    m_BodyOrder.clear();
+    m_Leaves.clear();
+    for (auto& level : m_Levels) {
+        level.clear();
+    }
+    m_BuildNodeExtent = 0.0f;
+    m_NodeExtent = 0.0f;
+}
+
+void Octree::Build(const SpatialSort& sort, uint32_t leafSize)
+{
+    Clear();
+
+    m_LeafSize = std::max(1u, leafSize);
+    m_BodyOrder = sort.GetSortedIndices();
+    if (m_BodyOrder.empty())
+        return;
+
+    m_BuildKeys = &sort.GetSortedKeys();
+    m_Nodes.emplace_back();
+    uint32_t depth = BuildNode(0, 0, 0, 0, static_cast<uint32_t>(m_BodyOrder.size()));
+    m_Levels.resize(depth);
+    m_BuildKeys = nullptr;
+}
+
+uint32_t Octree::BuildNode(uint32_t nodeIndex, uint32_t level, uint32_t depth, uint32_t begin, uint32_t end)
+{
+    if (m_Levels.size() <= depth)
+        m_Levels.resize(depth + 1);
+    m_Levels[depth].push_back(nodeIndex);
+
+    OctreeNode& node = m_Nodes[nodeIndex];
+    node.firstBody = begin;
+    node.bodyCount = end - begin;
+    node.firstChild = 0;
+    node.childCount = 0;
+
+    if (end - begin <= m_LeafSize || level == MortonBitsPerAxis)
+    {
+        m_Leaves.push_back(nodeIndex);
+        return depth + 1;
+    }
+
+    const std::vector<uint64_t>& keys = *m_BuildKeys;
+    const uint32_t shift = 3 * (MortonBitsPerAxis - level - 1);
+
+    uint32_t childBounds[9];
+    childBounds[0] = begin;
+    uint32_t childCount = 0;
+    for (uint32_t octant = 0; octant < 8; octant++) {
+        auto split = std::partition_point(keys.begin() + childBounds[octant], keys.begin() + end,
+            [&](uint64_t key) { return ((key >> shift) & 7) <= octant; });
+        childBounds[octant + 1] = static_cast<uint32_t>(split - keys.begin());
+        if (childBounds[octant + 1] > childBounds[octant])
+            childCount++;
+    }
+
+    const uint32_t firstChild = static_cast<uint32_t>(m_Nodes.size());
+    m_Nodes[nodeIndex].firstChild = firstChild;
+    m_Nodes[nodeIndex].childCount = childCount;
+    m_Nodes.resize(m_Nodes.size() + childCount);
+
+    uint32_t maxDepth = depth + 1;
+    uint32_t child = firstChild;
+    for (uint32_t octant = 0; octant < 8; octant++) {
+        if (childBounds[octant + 1] == childBounds[octant])
+            continue;
+        maxDepth = std::max(maxDepth, BuildNode(child++, level + 1, depth + 1, childBounds[octant], childBounds[octant + 1]));
+    }
+
+    return maxDepth;
+}
+
+void Octree::Refit(const std::vector<glm::vec3>& positions, const std::vector<float>& masses)
+{
+    if (m_Nodes.empty())
+        return;
+
+    ThreadPool& pool = ThreadPool::Get();
+    for (size_t depth = m_Levels.size(); depth-- > 0;) {
+        const std::vector<uint32_t>& levelNodes = m_Levels[depth];
+        pool.ParallelFor(levelNodes.size(), 64, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                RefitNode(m_Nodes[levelNodes[i]], positions, masses);
+            }
+        });
+    }
+
+    float nodeExtent = 0.0f;
+    for (const OctreeNode& node : m_Nodes) {
+        glm::vec3 extent = node.boundsMax - node.boundsMin;
+        nodeExtent += extent.x + extent.y + extent.z;
+    }
+
+    m_NodeExtent = nodeExtent;
+    if (m_BuildNodeExtent == 0.0f)
+        m_BuildNodeExtent = std::max(nodeExtent, std::numeric_limits<float>::min());
+}
+
+void Octree::RefitNode(OctreeNode& node, const std::vector<glm::vec3>& positions, const std::vector<float>& masses)
+{
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+    glm::vec3 weightedPosition(0.0f);
+    float mass = 0.0f;
+    Quadrupole quadrupole;
+
+    if (node.childCount == 0)
+    {
+        for (uint32_t k = node.firstBody; k < node.firstBody + node.bodyCount; k++) {
+            const uint32_t body = m_BodyOrder[k];
+            boundsMin = glm::min(boundsMin, positions[body]);
+            boundsMax = glm::max(boundsMax, positions[body]);
+            weightedPosition += positions[body] * masses[body];
+            mass += masses[body];
+        }
+
+        glm::vec3 centerOfMass = mass > 0.0f ? weightedPosition / mass : (boundsMin + boundsMax) * 0.5f;
+        for (uint32_t k = node.firstBody; k < node.firstBody + node.bodyCount; k++) {
+            const uint32_t body = m_BodyOrder[k];
+            AddPointQuadrupole(quadrupole, positions[body] - centerOfMass, masses[body]);
+        }
+
+        node.centerOfMass = centerOfMass;
+    }
+    else
+    {
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+            const OctreeNode& child = m_Nodes[c];
+            boundsMin = glm::min(boundsMin, child.boundsMin);
+            boundsMax = glm::max(boundsMax, child.boundsMax);
+            weightedPosition += child.centerOfMass * child.mass;
+            mass += child.mass;
+        }
+
+        glm::vec3 centerOfMass = mass > 0.0f ? weightedPosition / mass : (boundsMin + boundsMax) * 0.5f;
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+            const OctreeNode& child = m_Nodes[c];
+            quadrupole.xx += child.quadrupole.xx;
+            quadrupole.yy += child.quadrupole.yy;
+            quadrupole.zz += child.quadrupole.zz;
+            quadrupole.xy += child.quadrupole.xy;
+            quadrupole.xz += child.quadrupole.xz;
+            quadrupole.yz += child.quadrupole.yz;
+            AddPointQuadrupole(quadrupole, child.centerOfMass - centerOfMass, child.mass);
+        }
+
+        node.centerOfMass = centerOfMass;
+    }
+
+    node.boundsMin = boundsMin;
+    node.boundsMax = boundsMax;
+    node.mass = mass;
+    node.quadrupole = quadrupole;
+}
+
+void Octree::RemapBodies(const std::vector<uint32_t>& order)
+{
+    if (order.size() != m_BodyOrder.size())
+    {
+        Clear();
+        return;
+    }
+
+    m_InverseOrder.resize(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        m_InverseOrder[order[i]] = static_cast<uint32_t>(i);
+    }
+
+    ThreadPool::Get().ParallelFor(m_BodyOrder.size(), 8192, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            m_BodyOrder[k] = m_InverseOrder[m_BodyOrder[k]];
+        }
+    });
+}
+
+float Octree::GetQualityRatio() const
+{
+    if (m_BuildNodeExtent <= 0.0f)
+        return 1.0f;
+    return m_NodeExtent / m_BuildNodeExtent;
+}
+
+}
\ No newline at end of file
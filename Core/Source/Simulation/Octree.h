@@ -0,0 +1,70 @@
+#ifndef OCTREE_H
+#define OCTREE_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "SpatialSort.h"
+
+namespace SpaceSim {
+
+// Traceless quadrupole (xx, yy, zz, xy, xz, yz) about the node's center of mass.
+struct Quadrupole {
+    float xx = 0.0f, yy = 0.0f, zz = 0.0f;
+    float xy = 0.0f, xz = 0.0f, yz = 0.0f;
+};
+
+// Adds a point mass at offset d from the expansion centre.
+void AddPointQuadrupole(Quadrupole& q, const glm::vec3& d, float mass);
+
+struct OctreeNode {
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    glm::vec3 centerOfMass;
+    float mass;
+    Quadrupole quadrupole;
+    uint32_t firstBody;
+    uint32_t bodyCount;
+    uint32_t firstChild;
+    uint32_t childCount;
+};
+
+// Linearized octree over Morton-sorted bodies. Children of a node are stored contiguously and every
+// node owns a contiguous range of GetBodyOrder(). Between rebuilds the body assignment is kept and
+// Refit() recomputes bounds and multipoles bottom-up.
+class Octree {
+public:
+    void Build(const SpatialSort& sort, uint32_t leafSize);
+    void Refit(const std::vector<glm::vec3>& positions, const std::vector<float>& masses);
+    void RemapBodies(const std::vector<uint32_t>& order);
+    void Clear();
+
+    bool IsBuilt() const { return !m_Nodes.empty(); }
+    size_t GetBodyCount() const { return m_BodyOrder.size(); }
+    const std::vector<OctreeNode>& GetNodes() const { return m_Nodes; }
+    const std::vector<uint32_t>& GetBodyOrder() const { return m_BodyOrder; }
+    const std::vector<uint32_t>& GetLeaves() const { return m_Leaves; }
+    uint32_t GetDepth() const { return static_cast<uint32_t>(m_Levels.size()); }
+
+    // Summed node extents relative to the first refit after the last rebuild.
+    float GetQualityRatio() const;
+
+private:
+    uint32_t BuildNode(uint32_t nodeIndex, uint32_t level, uint32_t depth, uint32_t begin, uint32_t end);
+    void RefitNode(OctreeNode& node, const std::vector<glm::vec3>& positions, const std::vector<float>& masses);
+
+    std::vector<OctreeNode> m_Nodes;
+    std::vector<uint32_t> m_BodyOrder;
+    std::vector<uint32_t> m_Leaves;
+    std::vector<std::vector<uint32_t>> m_Levels;
+    const std::vector<uint64_t>* m_BuildKeys = nullptr;
+    uint32_t m_LeafSize = 16;
+
+    float m_BuildNodeExtent = 0.0f;
+    float m_NodeExtent = 0.0f;
+    std::vector<uint32_t> m_InverseOrder;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,284 @@
+#include "OrbitalElements.h"
+#include "SimdLanes.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace SpaceSim {
+
+void OrbitalElementSet::Resize(size_t count)
+{
+    semiMajorAxis.resize(count);
+    eccentricity.resize(count);
+    inclination.resize(count);
+    ascendingNode.resize(count);
+    argumentOfPeriapsis.resize(count);
+    meanAnomaly.resize(count);
+}
+
+void ComputeOrbitalElements(const BodyStorage& bodies, uint32_t primary, float gravityStrength, OrbitalElementSet& elements)
+{
+    const size_t count = bodies.Size();
+    elements.Resize(count);
+    if (primary >= count)
+        return;
+
+    const glm::vec3* positions = bodies.GetPositions().data();
+    const glm::vec3* velocities = bodies.GetVelocities().data();
+    const float* masses = bodies.GetMasses().data();
+    const glm::vec3 primaryPosition = positions[primary];
+    const glm::vec3 primaryVelocity = velocities[primary];
+    const float primaryMass = masses[primary];
+
+    constexpr uint32_t Width = Lanes::Width;
+    const Lanes zero = Lanes::Broadcast(0.0f);
+    const Lanes one = Lanes::Broadcast(1.0f);
+    const Lanes half = Lanes::Broadcast(0.5f);
+    const Lanes twoPi = Lanes::Broadcast(6.28318530718f);
+    const Lanes tiny = Lanes::Broadcast(1e-6f);
+
+    ThreadPool::Get().ParallelFor(count, 4096, [&](size_t begin, size_t end) {
+        float rxIn[Width], ryIn[Width], rzIn[Width], vxIn[Width], vyIn[Width], vzIn[Width], muIn[Width];
+        float out[6][Width];
+
+        for (size_t first = begin; first < end; first += Width) {
+            const size_t lanes = std::min<size_t>(Width, end - first);
+
+            // Gather relative state into the element frame (x, z, -y). Unused lanes repeat the last body.
+            for (size_t l = 0; l < Width; l++) {
+                const size_t i = first + std::min(l, lanes - 1);
+                const glm::vec3 r = positions[i] - primaryPosition;
+                const glm::vec3 v = velocities[i] - primaryVelocity;
+                rxIn[l] = r.x;
+                ryIn[l] = r.z;
+                rzIn[l] = -r.y;
+                vxIn[l] = v.x;
+                vyIn[l] = v.z;
+                vzIn[l] = -v.y;
+                muIn[l] = gravityStrength * (primaryMass + masses[i]);
+            }
+
+            const Lanes rx = Lanes::Load(rxIn), ry = Lanes::Load(ryIn), rz = Lanes::Load(rzIn);
+            const Lanes vx = Lanes::Load(vxIn), vy = Lanes::Load(vyIn), vz = Lanes::Load(vzIn);
+            const Lanes mu = Lanes::Load(muIn);
+
+            const Lanes r = Sqrt(Max(rx * rx + ry * ry + rz * rz, Lanes::Broadcast(1e-30f)));
+            const Lanes inverseR = one / r;
+            const Lanes inverseMu = one / mu;
+            const Lanes v2 = vx * vx + vy * vy + vz * vz;
+            const Lanes rv = rx * vx + ry * vy + rz * vz;
+            const Lanes muOverR = mu * inverseR;
+
+            const Lanes hx = ry * vz - rz * vy;
+            const Lanes hy = rz * vx - rx * vz;
+            const Lanes hz = rx * vy - ry * vx;
+            const Lanes nodeLength = Sqrt(hx * hx + hy * hy);
+            const Lanes h = Sqrt(nodeLength * nodeLength + hz * hz);
+            const Lanes inverseH = one / Max(h, Lanes::Broadcast(1e-30f));
+
+            const Lanes c = v2 - muOverR;
+            const Lanes ex = (c * rx - rv * vx) * inverseMu;
+            const Lanes ey = (c * ry - rv * vy) * inverseMu;
+            const Lanes ez = (c * rz - rv * vz) * inverseMu;
+            const Lanes e = Sqrt(ex * ex + ey * ey + ez * ez);
+
+            const Lanes energy = half * v2 - muOverR;
+            const Lanes semiMajorAxis = zero - half * mu / energy;
+            const Lanes inclination = Atan2(nodeLength, hz);
+
+            // Node direction, or +x for equatorial orbits where it is undefined.
+            const Lanes equatorialLimit = tiny * h;
+            const Lanes inverseNode = one / Max(nodeLength, Lanes::Broadcast(1e-30f));
+            const Lanes nx = SelectIfGreaterEqual(nodeLength, equatorialLimit, zero - hy * inverseNode) + SelectIfLess(nodeLength, equatorialLimit, one);
+            const Lanes ny = SelectIfGreaterEqual(nodeLength, equatorialLimit, hx * inverseNode);
+            Lanes ascendingNode = Atan2(ny, nx);
+
+            // Periapsis direction, or the node for circular orbits, which puts the anomaly on the argument of latitude.
+            const Lanes inverseE = one / Max(e, Lanes::Broadcast(1e-30f));
+            const Lanes px = SelectIfGreaterEqual(e, tiny, ex * inverseE) + SelectIfLess(e, tiny, nx);
+            const Lanes py = SelectIfGreaterEqual(e, tiny, ey * inverseE) + SelectIfLess(e, tiny, ny);
+            const Lanes pz = SelectIfGreaterEqual(e, tiny, ez * inverseE);
+
+            const Lanes sinOmega = (hx * (ny * pz) - hy * (nx * pz) + hz * (nx * py - ny * px)) * inverseH;
+            Lanes argumentOfPeriapsis = Atan2(sinOmega, nx * px + ny * py);
+
+            const Lanes cosNu = (px * rx + py * ry + pz * rz) * inverseR;
+            const Lanes sinNu = (hx * (py * rz - pz * ry) + hy * (pz * rx - px * rz) + hz * (px * ry - py * rx)) * inverseH * inverseR;
+            const Lanes inverseDenominator = one / (one + e * cosNu);
+
+            const Lanes ellipticRoot = Sqrt(Max(one - e * e, zero));
+            const Lanes eccentricAnomaly = Atan2(ellipticRoot * sinNu, e + cosNu);
+            Lanes ellipticMean = eccentricAnomaly - e * ellipticRoot * sinNu * inverseDenominator;
+            ellipticMean = ellipticMean + SelectIfLess(ellipticMean, zero, twoPi);
+
+            const Lanes hyperbolicRoot = Sqrt(Max(e * e - one, zero));
+            const Lanes sinhF = hyperbolicRoot * sinNu * inverseDenominator;
+            const Lanes absF = Log(Abs(sinhF) + Sqrt(sinhF * sinhF + one));
+            const Lanes hyperbolicAnomaly = absF - SelectIfLess(sinhF, zero, absF + absF);
+            const Lanes hyperbolicMean = e * sinhF - hyperbolicAnomaly;
+
+            const Lanes meanAnomaly = SelectIfLess(e, one, ellipticMean) + SelectIfGreaterEqual(e, one, hyperbolicMean);
+            ascendingNode = ascendingNode + SelectIfLess(ascendingNode, zero, twoPi);
+            argumentOfPeriapsis = argumentOfPeriapsis + SelectIfLess(argumentOfPeriapsis, zero, twoPi);
+
+            semiMajorAxis.Store(out[0]);
+            e.Store(out[1]);
+            inclination.Store(out[2]);
+            ascendingNode.Store(out[3]);
+            argumentOfPeriapsis.Store(out[4]);
+            meanAnomaly.Store(out[5]);
+
+            std::copy(out[0], out[0] + lanes, elements.semiMajorAxis.begin() + first);
+            std::copy(out[1], out[1] + lanes, elements.eccentricity.begin() + first);
+            std::copy(out[2], out[2] + lanes, elements.inclination.begin() + first);
+            std::copy(out[3], out[3] + lanes, elements.ascendingNode.begin() + first);
+            std::copy(out[4], out[4] + lanes, elements.argumentOfPeriapsis.begin() + first);
+            std::copy(out[5], out[5] + lanes, elements.meanAnomaly.begin() + first);
+        }
+    });
+
+    elements.semiMajorAxis[primary] = 0.0f;
+    elements.eccentricity[primary] = 0.0f;
+    elements.inclination[primary] = 0.0f;
+    elements.ascendingNode[primary] = 0.0f;
+    elements.argumentOfPeriapsis[primary] = 0.0f;
+    elements.meanAnomaly[primary] = 0.0f;
+}
+
+OrbitTracker::~OrbitTracker()
+{
+    CloseLog();
+}
+
+OrbitTrackerStats OrbitTracker::GetStats() const
+{
+    OrbitTrackerStats stats = m_Stats;
+    stats.written = m_Written.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void OrbitTracker::SetSettings(const OrbitTrackerSettings& settings)
+{
+    const bool streaming = settings.enabled && settings.streamToDisk;
+    const bool wasStreaming = m_Settings.enabled && m_Settings.streamToDisk;
+    const bool reopen = streaming != wasStreaming || (streaming && settings.logPath != m_Settings.logPath);
+    m_Settings = settings;
+    m_Settings.interval = std::max(m_Settings.interval, 1u);
+
+    if (reopen)
+    {
+        CloseLog();
+        if (streaming && !m_Settings.logPath.empty())
+            OpenLog(m_Settings.logPath);
+    }
+}
+
+void OrbitTracker::Update(const BodyStorage& bodies, uint64_t step, double time, float gravityStrength)
+{
+    if (!m_Settings.enabled || step % m_Settings.interval != 0 || bodies.Empty())
+        return;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    uint32_t primary = bodies.IndexOf(m_Settings.primary);
+    if (primary == InvalidBodyIndex)
+    {
+        const std::vector<float>& masses = bodies.GetMasses();
+        primary = static_cast<uint32_t>(std::max_element(masses.begin(), masses.end()) - masses.begin());
+    }
+
+    ComputeOrbitalElements(bodies, primary, gravityStrength, m_Elements);
+    m_Handles = bodies.GetHandles();
+
+    m_Stats.computeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    m_Stats.time = time;
+    m_Stats.primary = bodies.GetHandle(primary);
+    m_Stats.snapshots++;
+
+    if (!m_Writer.joinable())
+        return;
+
+    std::unique_lock<std::mutex> lock(m_Mutex, std::try_to_lock);
+    if (!lock.owns_lock() || m_PendingReady)
+    {
+        m_Stats.skipped++;
+        return;
+    }
+
+    m_PendingElements = m_Elements;
+    m_PendingHandles = m_Handles;
+    m_PendingTime = time;
+    m_PendingStep = step;
+    m_PendingPrimary = m_Stats.primary;
+    m_PendingReady = true;
+    lock.unlock();
+    m_Condition.notify_one();
+}
+
+void OrbitTracker::OpenLog(const std::string& path)
+{
+    m_Log.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_Log)
+    {
+        std::cerr << "Failed to open orbit log: " << path << std::endl;
+        return;
+    }
+
+    OrbitLogHeader header = { OrbitLogMagic, OrbitLogVersion, { 0, 0 } };
+    m_Log.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    m_PendingReady = false;
+    m_StopWriter = false;
+    m_Writer = std::thread(&OrbitTracker::WriterLoop, this);
+}
+
+void OrbitTracker::CloseLog()
+{
+    if (m_Writer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_StopWriter = true;
+        }
+        m_Condition.notify_one();
+        m_Writer.join();
+    }
+    if (m_Log.is_open())
+        m_Log.close();
+}
+
+void OrbitTracker::WriterLoop()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (true)
+    {
+        m_Condition.wait(lock, [this] { return m_PendingReady || m_StopWriter; });
+        if (!m_PendingReady)
+            break;
+
+        // The simulation thread only touches the pending buffers while no snapshot is pending.
+        lock.unlock();
+
+        const uint32_t count = static_cast<uint32_t>(m_PendingHandles.size());
+        m_Log.write(reinterpret_cast<const char*>(&m_PendingTime), sizeof(m_PendingTime));
+        m_Log.write(reinterpret_cast<const char*>(&m_PendingStep), sizeof(m_PendingStep));
+        m_Log.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        m_Log.write(reinterpret_cast<const char*>(&m_PendingPrimary), sizeof(m_PendingPrimary));
+        m_Log.write(reinterpret_cast<const char*>(m_PendingHandles.data()), count * sizeof(BodyHandle));
+        for (const std::vector<float>* values : { &m_PendingElements.semiMajorAxis, &m_PendingElements.eccentricity,
+                                                  &m_PendingElements.inclination, &m_PendingElements.ascendingNode,
+                                                  &m_PendingElements.argumentOfPeriapsis, &m_PendingElements.meanAnomaly }) {
+            m_Log.write(reinterpret_cast<const char*>(values->data()), count * sizeof(float));
+        }
+        m_Log.flush();
+
+        m_Written.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
+        m_PendingReady = false;
+        if (m_StopWriter)
+            break;
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#ifndef ORBITAL_ELEMENTS_H
+#define ORBITAL_ELEMENTS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BodyStorage.h"
+
+namespace SpaceSim {
+
+// Osculating Keplerian elements, one array per element. Angles are in radians. The reference plane is x-z
+// with the pole along -y, so the scenes' disks, which turn from +x towards +z, are prograde.
+// Hyperbolic orbits have a negative semi-major axis and a hyperbolic mean anomaly.
+struct OrbitalElementSet {
+    std::vector<float> semiMajorAxis;
+    std::vector<float> eccentricity;
+    std::vector<float> inclination;
+    std::vector<float> ascendingNode;
+    std::vector<float> argumentOfPeriapsis;
+    std::vector<float> meanAnomaly;
+
+    void Resize(size_t count);
+    size_t Size() const { return semiMajorAxis.size(); }
+};
+
+// Elements of every body about bodies[primary] with mu = G (M_primary + m). The primary's own entry is zero.
+void ComputeOrbitalElements(const BodyStorage& bodies, uint32_t primary, float gravityStrength, OrbitalElementSet& elements);
+
+// Log layout: OrbitLogHeader, then per snapshot: double time, uint64 step, uint32 count, uint32 primary handle,
+// count body handles, and the six element arrays of count floats each in OrbitalElementSet order.
+constexpr uint32_t OrbitLogMagic = 0x454F5353u; // "SSOE"
+constexpr uint32_t OrbitLogVersion = 1;
+
+struct OrbitLogHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t reserved[2];
+};
+
+struct OrbitTrackerSettings {
+    bool enabled = false;
+    uint32_t interval = 10;
+    BodyHandle primary = InvalidBodyHandle;
+    bool streamToDisk = false;
+    std::string logPath = "orbits.bin";
+};
+
+struct OrbitTrackerStats {
+    float computeMs = 0.0f;
+    double time = 0.0;
+    uint64_t snapshots = 0;
+    uint64_t written = 0;
+    uint64_t skipped = 0;
+    BodyHandle primary = InvalidBodyHandle;
+};
+
+// Recomputes the elements every interval steps about the chosen primary, or the most massive body when
+// none is set. Snapshots are copied to a writer thread; one arriving while the previous is still being
+// written is skipped rather than stalling the simulation.
+class OrbitTracker {
+public:
+    OrbitTracker() = default;
+    ~OrbitTracker();
+    OrbitTracker(const OrbitTracker&) = delete;
+    OrbitTracker& operator=(const OrbitTracker&) = delete;
+
+    void Update(const BodyStorage& bodies, uint64_t step, double time, float gravityStrength);
+
+    const OrbitTrackerSettings& GetSettings() const { return m_Settings; }
+    void SetSettings(const OrbitTrackerSettings& settings);
+    OrbitTrackerStats GetStats() const;
+
+    // Element i belongs to the body with handle GetHandles()[i] at the time of the last snapshot.
+    const OrbitalElementSet& GetElements() const { return m_Elements; }
+    const std::vector<BodyHandle>& GetHandles() const { return m_Handles; }
+
+private:
+    void OpenLog(const std::string& path);
+    void CloseLog();
+    void WriterLoop();
+
+    OrbitTrackerSettings m_Settings;
+    OrbitTrackerStats m_Stats;
+    // Counted by the writer thread, so it is kept apart from the other stats.
+    std::atomic<uint64_t> m_Written{ 0 };
+    OrbitalElementSet m_Elements;
+    std::vector<BodyHandle> m_Handles;
+
+    std::ofstream m_Log;
+    std::thread m_Writer;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_PendingReady = false;
+    bool m_StopWriter = false;
+    double m_PendingTime = 0.0;
+    uint64_t m_PendingStep = 0;
+    BodyHandle m_PendingPrimary = InvalidBodyHandle;
+    OrbitalElementSet m_PendingElements;
+    std::vector<BodyHandle> m_PendingHandles;
+};
+
+}
+
+#endif
\ No newline at end of file
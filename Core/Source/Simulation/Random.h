@@ -0,0 +1,84 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace SpaceSim {
+
+// Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3"). The output is a pure
+// function of key and counter, so any thread can produce any part of a sequence without shared state.
+inline std::array<uint32_t, 4> Philox4x32(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key)
+{
+    constexpr uint32_t Multiplier0 = 0xD2511F53u;
+    constexpr uint32_t Multiplier1 = 0xCD9E8D57u;
+    constexpr uint32_t Weyl0 = 0x9E3779B9u;
+    constexpr uint32_t Weyl1 = 0xBB67AE85u;
+
+    for (int round = 0; round < 10; round++) {
+        const uint64_t product0 = static_cast<uint64_t>(Multiplier0) * counter[0];
+        const uint64_t product1 = static_cast<uint64_t>(Multiplier1) * counter[2];
+        counter = {
+            static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+            static_cast<uint32_t>(product1),
+            static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+            static_cast<uint32_t>(product0)
+        };
+        key[0] += Weyl0;
+        key[1] += Weyl1;
+    }
+    return counter;
+}
+
+// Independent random sequence number `stream` of a seed. Body spawners use the body's index as the stream,
+// which makes every body's values independent of how the work is split between threads.
+class RandomStream {
+public:
+    RandomStream(uint64_t seed, uint64_t stream)
+        : m_Key{ static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32) },
+          m_Counter{ static_cast<uint32_t>(stream), static_cast<uint32_t>(stream >> 32), 0u, 0u }
+    {
+    }
+
+    uint32_t NextUInt()
+    {
+        if (m_Available == 0)
+        {
+            m_Block = Philox4x32(m_Counter, m_Key);
+            if (++m_Counter[2] == 0)
+                m_Counter[3]++;
+            m_Available = 4;
+        }
+        return m_Block[--m_Available];
+    }
+
+    // Uniform in [0, 1).
+    float NextFloat()
+    {
+        return static_cast<float>(NextUInt() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    float NextFloat(float min, float max)
+    {
+        return min + (max - min) * NextFloat();
+    }
+
+    // Standard normal deviate (Box-Muller).
+    float NextNormal()
+    {
+        const float u = 1.0f - NextFloat();
+        const float v = NextFloat();
+        return std::sqrt(-2.0f * std::log(u)) * std::cos(6.28318530718f * v);
+    }
+
+private:
+    std::array<uint32_t, 2> m_Key;
+    std::array<uint32_t, 4> m_Counter;
+    std::array<uint32_t, 4> m_Block{};
+    uint32_t m_Available = 0;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef REDUCTION_H
+#define REDUCTION_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "ThreadPool.h"
+
+namespace SpaceSim {
+
+enum class ReductionMode {
+    Fast,
+    Deterministic
+};
+
+constexpr size_t DeterministicBlockSize = 1024;
+
+// Sums map(i) over [0, count). Fast gives each thread one range, so the rounding depends on the thread count.
+// Deterministic sums fixed-size blocks and combines them pairwise in index order, which gives the same
+// bits on any number of threads.
+template <typename T, typename Map>
+T ParallelReduce(size_t count, const T& identity, ReductionMode mode, const Map& map)
+{
+    if (count == 0)
+        return identity;
+
+    ThreadPool& pool = ThreadPool::Get();
+
+    if (mode == ReductionMode::Fast)
+    {
+        const uint32_t taskCount = static_cast<uint32_t>(std::clamp<size_t>(count / 4096, 1, pool.GetThreadCount()));
+        std::vector<T> partials(taskCount, identity);
+        pool.Dispatch(taskCount, [&](uint32_t task) {
+            size_t begin = count * task / taskCount;
+            size_t end = count * (task + 1) / taskCount;
+            T sum = identity;
+            for (size_t i = begin; i < end; i++) {
+                sum = sum + map(i);
+            }
+            partials[task] = sum;
+        });
+
+        T total = identity;
+        for (const T& partial : partials) {
+            total = total + partial;
+        }
+        return total;
+    }
+
+    const size_t blockCount = (count + DeterministicBlockSize - 1) / DeterministicBlockSize;
+    std::vector<T> partials(blockCount, identity);
+    pool.ParallelFor(blockCount, 1, [&](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; block++) {
+            const size_t first = block * DeterministicBlockSize;
+            const size_t last = std::min(count, first + DeterministicBlockSize);
+            T sum = identity;
+            for (size_t i = first; i < last; i++) {
+                sum = sum + map(i);
+            }
+            partials[block] = sum;
+        }
+    });
+
+    for (size_t width = 1; width < blockCount; width *= 2) {
+        for (size_t block = 0; block + width < blockCount; block += width * 2) {
+            partials[block] = partials[block] + partials[block + width];
+        }
+    }
+    return partials[0];
+}
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,492 @@
+#include "SPHSolver.h"
+#include "SimdLanes.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <glm/ext/scalar_constants.hpp>
+
+namespace SpaceSim {
+
+struct SPHGatherBuffers {
+    std::vector<float> dx, dy, dz;
+    std::vector<float> dvx, dvy, dvz;
+    std::vector<float> mass, smoothingLength;
+    std::vector<float> pressureTerm, soundSpeed, density;
+};
+
+static thread_local SPHGatherBuffers t_GatherBuffers;
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static float KernelNormalization(SPHKernel kernel)
+{
+    return kernel == SPHKernel::CubicSpline ? 1.0f / glm::pi<float>() : 21.0f / (16.0f * glm::pi<float>());
+}
+
+// Both kernels have support 2h and are written branch-free so they evaluate on whole lane blocks.
+static inline Lanes KernelValue(SPHKernel kernel, Lanes q)
+{
+    const Lanes zero = Lanes::Broadcast(0.0f);
+    if (kernel == SPHKernel::CubicSpline)
+    {
+        Lanes outer = Max(Lanes::Broadcast(2.0f) - q, zero);
+        Lanes inner = Max(Lanes::Broadcast(1.0f) - q, zero);
+        return Lanes::Broadcast(0.25f) * outer * outer * outer - inner * inner * inner;
+    }
+
+    Lanes t = Max(Lanes::Broadcast(1.0f) - Lanes::Broadcast(0.5f) * q, zero);
+    Lanes t2 = t * t;
+    return t2 * t2 * (Lanes::Broadcast(2.0f) * q + Lanes::Broadcast(1.0f));
+}
+
+static inline Lanes KernelDerivative(SPHKernel kernel, Lanes q)
+{
+    const Lanes zero = Lanes::Broadcast(0.0f);
+    if (kernel == SPHKernel::CubicSpline)
+    {
+        Lanes outer = Max(Lanes::Broadcast(2.0f) - q, zero);
+        Lanes inner = Max(Lanes::Broadcast(1.0f) - q, zero);
+        return Lanes::Broadcast(3.0f) * inner * inner - Lanes::Broadcast(0.75f) * outer * outer;
+    }
+
+    Lanes t = Max(Lanes::Broadcast(1.0f) - Lanes::Broadcast(0.5f) * q, zero);
+    return Lanes::Broadcast(-5.0f) * q * t * t * t;
+}
+
+template<typename T>
+static void Gather(std::vector<T>& values, const std::vector<uint32_t>& order)
+{
+    std::vector<T> gathered(order.size());
+    ThreadPool::Get().ParallelFor(order.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            gathered[i] = values[order[i]];
+        }
+    });
+    values.swap(gathered);
+}
+
+void SPHSolver::Clear()
+{
+    m_Positions.clear();
+    m_Velocities.clear();
+    m_Masses.clear();
+    m_InternalEnergies.clear();
+    m_SmoothingLengths.clear();
+    m_Densities.clear();
+    m_Pressures.clear();
+    m_SoundSpeeds.clear();
+    m_Neighbors.clear();
+    m_NeighborOffsets.clear();
+    m_NeighborsDirty = true;
+}
+
+size_t SPHSolver::AddParticles(size_t count)
+{
+    size_t first = m_Positions.size();
+    size_t newSize = first + count;
+
+    m_Positions.resize(newSize, glm::vec3(0.0f));
+    m_Velocities.resize(newSize, glm::vec3(0.0f));
+    m_Masses.resize(newSize, 0.0f);
+    m_InternalEnergies.resize(newSize, m_Settings.minInternalEnergy);
+    m_SmoothingLengths.resize(newSize, m_Settings.minSmoothingLength);
+    m_Densities.resize(newSize, 0.0f);
+    m_Pressures.resize(newSize, 0.0f);
+    m_SoundSpeeds.resize(newSize, 0.0f);
+
+    m_NeighborsDirty = true;
+    return first;
+}
+
+size_t SPHSolver::SpawnParticles(size_t count, uint64_t seed, uint64_t firstStream, const GasGenerator& generator)
+{
+    const size_t first = AddParticles(count);
+    ThreadPool::Get().ParallelFor(count, 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            RandomStream random(seed, firstStream + i);
+            GasParticle particle{ glm::vec3(0.0f), glm::vec3(0.0f), 0.0f, m_Settings.minInternalEnergy, m_Settings.minSmoothingLength };
+            generator(i, random, particle);
+
+            m_Positions[first + i] = particle.position;
+            m_Velocities[first + i] = particle.velocity;
+            m_Masses[first + i] = particle.mass;
+            m_InternalEnergies[first + i] = particle.internalEnergy;
+            m_SmoothingLengths[first + i] = particle.smoothingLength;
+        }
+    });
+    return first;
+}
+
+void SPHSolver::ComputeAccelerations(GravitySolver& solver, float gravityStrength, const std::vector<glm::vec3>& bodyPositions,
+                                     const std::vector<float>& bodyMasses, std::vector<glm::vec3>& bodyAccelerations)
+{
+    const size_t count = m_Positions.size();
+    m_Accelerations.assign(count, glm::vec3(0.0f));
+    m_EnergyRates.assign(count, 0.0f);
+    if (count == 0)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    // Bodies close to the gas are keyed in the same bounds, so the gravity pass reuses this order rather than
+    // sorting the gas again. A distant body would coarsen the neighbor grid, so it gets a sort of its own.
+    SpatialBounds bounds = ComputeBounds(m_Positions);
+    m_SharedBounds = true;
+    if (!bodyPositions.empty())
+    {
+        const SpatialBounds combined = CombineBounds(bounds, ComputeBounds(bodyPositions));
+        m_SharedBounds = combined.size <= 2.0f * bounds.size;
+        if (m_SharedBounds)
+            bounds = combined;
+    }
+    m_SpatialSort.Update(m_Positions, bounds);
+    if (m_NeighborsDirty || !NeighborsValid())
+    {
+        RemapGravityTree(solver, bodyPositions.size());
+        UpdateNeighbors();
+    }
+    m_Stats.neighborMs = ElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    ComputeDensity();
+    m_Stats.densityMs = ElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    ComputeHydroForces();
+    m_Stats.forceMs = ElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    ComputeGravity(solver, gravityStrength, bodyPositions, bodyMasses, bodyAccelerations);
+    m_Stats.gravityMs = ElapsedMs(start);
+}
+
+bool SPHSolver::NeighborsValid() const
+{
+    const size_t count = m_Positions.size();
+    if (m_NeighborPositions.size() != count)
+        return false;
+
+    std::atomic<bool> valid{ true };
+    float maxDisplacement = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        maxDisplacement = std::max(maxDisplacement, glm::length(m_Positions[i] - m_NeighborPositions[i]));
+    }
+
+    // A pair stays covered while h_i + h_j plus both displacements fits within the padded build radii.
+    ThreadPool::Get().ParallelFor(count, 8192, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end && valid.load(std::memory_order_relaxed); i++) {
+            if (m_SmoothingLengths[i] + maxDisplacement > m_NeighborRadii[i])
+                valid.store(false, std::memory_order_relaxed);
+        }
+    });
+
+    return valid.load();
+}
+
+void SPHSolver::UpdateNeighbors()
+{
+    const size_t count = m_Positions.size();
+
+    // Keep particles in Morton order so neighbor loops and the gravity tree touch nearby memory.
+    const std::vector<uint32_t>& order = m_SpatialSort.GetSortedIndices();
+    Gather(m_Positions, order);
+    Gather(m_Velocities, order);
+    Gather(m_Masses, order);
+    Gather(m_InternalEnergies, order);
+    Gather(m_SmoothingLengths, order);
+    m_SpatialSort.OnBodiesPermuted();
+
+    const float skin = 1.0f + m_Settings.neighborSkin;
+    m_NeighborRadii.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        m_NeighborRadii[i] = m_SmoothingLengths[i] * skin;
+    }
+
+    m_BroadPhase.FindPairs(m_SpatialSort, m_Positions, m_NeighborRadii);
+    const std::vector<BodyPair>& pairs = m_BroadPhase.GetPairs();
+
+    m_NeighborOffsets.assign(count + 1, 0);
+    for (const BodyPair& pair : pairs) {
+        m_NeighborOffsets[pair.first + 1]++;
+        m_NeighborOffsets[pair.second + 1]++;
+    }
+    for (size_t i = 0; i < count; i++) {
+        m_NeighborOffsets[i + 1] += m_NeighborOffsets[i];
+    }
+
+    m_Neighbors.resize(m_NeighborOffsets[count]);
+    std::vector<uint32_t> cursor(m_NeighborOffsets.begin(), m_NeighborOffsets.end() - 1);
+    for (const BodyPair& pair : pairs) {
+        m_Neighbors[cursor[pair.first]++] = pair.second;
+        m_Neighbors[cursor[pair.second]++] = pair.first;
+    }
+
+    m_NeighborPositions = m_Positions;
+    m_NeighborsDirty = false;
+    m_Stats.neighborRebuilds++;
+    m_Stats.averageNeighbors = static_cast<float>(m_Neighbors.size()) / static_cast<float>(count);
+}
+
+void SPHSolver::ComputeDensity()
+{
+    const size_t count = m_Positions.size();
+    const SPHKernel kernel = m_Settings.kernel;
+    const float sigma = KernelNormalization(kernel);
+    const float gammaMinusOne = m_Settings.adiabaticIndex - 1.0f;
+
+    ThreadPool::Get().ParallelFor(count, 64, [&](size_t begin, size_t end) {
+        SPHGatherBuffers& buffers = t_GatherBuffers;
+
+        for (size_t i = begin; i < end; i++) {
+            const uint32_t first = m_NeighborOffsets[i];
+            const uint32_t neighborCount = m_NeighborOffsets[i + 1] - first;
+            const size_t padded = (neighborCount + Lanes::Width - 1) / Lanes::Width * Lanes::Width;
+
+            buffers.dx.assign(padded, 0.0f);
+            buffers.dy.assign(padded, 0.0f);
+            buffers.dz.assign(padded, 0.0f);
+            buffers.mass.assign(padded, 0.0f);
+            buffers.smoothingLength.assign(padded, 1.0f);
+
+            const glm::vec3 position = m_Positions[i];
+            for (uint32_t k = 0; k < neighborCount; k++) {
+                const uint32_t j = m_Neighbors[first + k];
+                glm::vec3 delta = m_Positions[j] - position;
+                buffers.dx[k] = delta.x;
+                buffers.dy[k] = delta.y;
+                buffers.dz[k] = delta.z;
+                buffers.mass[k] = m_Masses[j];
+                buffers.smoothingLength[k] = m_SmoothingLengths[j];
+            }
+
+            const float h = m_SmoothingLengths[i];
+            const Lanes ownH = Lanes::Broadcast(h);
+            const Lanes half = Lanes::Broadcast(0.5f);
+            Lanes density = Lanes::Broadcast(0.0f);
+            for (size_t k = 0; k < padded; k += Lanes::Width) {
+                Lanes dx = Lanes::Load(&buffers.dx[k]);
+                Lanes dy = Lanes::Load(&buffers.dy[k]);
+                Lanes dz = Lanes::Load(&buffers.dz[k]);
+                Lanes pairH = (Lanes::Load(&buffers.smoothingLength[k]) + ownH) * half;
+                Lanes q = Sqrt(dx * dx + dy * dy + dz * dz) / pairH;
+                Lanes norm = Lanes::Broadcast(sigma) / (pairH * pairH * pairH);
+                density = density + Lanes::Load(&buffers.mass[k]) * KernelValue(kernel, q) * norm;
+            }
+
+            // Both kernels are normalized so that W(0) = sigma / h^3.
+            float rho = m_Masses[i] * sigma / (h * h * h) + ReduceAdd(density);
+            float pressure = gammaMinusOne * rho * m_InternalEnergies[i];
+            m_Densities[i] = rho;
+            m_Pressures[i] = pressure;
+            m_SoundSpeeds[i] = std::sqrt(m_Settings.adiabaticIndex * pressure / rho);
+        }
+    });
+}
+
+void SPHSolver::ComputeHydroForces()
+{
+    const size_t count = m_Positions.size();
+    const SPHKernel kernel = m_Settings.kernel;
+    const float sigma = KernelNormalization(kernel);
+    const float alpha = m_Settings.viscosityAlpha;
+    const float beta = m_Settings.viscosityBeta;
+
+    ThreadPool::Get().ParallelFor(count, 64, [&](size_t begin, size_t end) {
+        SPHGatherBuffers& buffers = t_GatherBuffers;
+
+        for (size_t i = begin; i < end; i++) {
+            const uint32_t first = m_NeighborOffsets[i];
+            const uint32_t neighborCount = m_NeighborOffsets[i + 1] - first;
+            const size_t padded = (neighborCount + Lanes::Width - 1) / Lanes::Width * Lanes::Width;
+
+            buffers.dx.assign(padded, 0.0f);
+            buffers.dy.assign(padded, 0.0f);
+            buffers.dz.assign(padded, 0.0f);
+            buffers.dvx.assign(padded, 0.0f);
+            buffers.dvy.assign(padded, 0.0f);
+            buffers.dvz.assign(padded, 0.0f);
+            buffers.mass.assign(padded, 0.0f);
+            buffers.smoothingLength.assign(padded, 1.0f);
+            buffers.pressureTerm.assign(padded, 0.0f);
+            buffers.soundSpeed.assign(padded, 0.0f);
+            buffers.density.assign(padded, 1.0f);
+
+            const glm::vec3 position = m_Positions[i];
+            const glm::vec3 velocity = m_Velocities[i];
+            for (uint32_t k = 0; k < neighborCount; k++) {
+                const uint32_t j = m_Neighbors[first + k];
+                glm::vec3 delta = m_Positions[j] - position;
+                glm::vec3 deltaVelocity = m_Velocities[j] - velocity;
+                buffers.dx[k] = delta.x;
+                buffers.dy[k] = delta.y;
+                buffers.dz[k] = delta.z;
+                buffers.dvx[k] = deltaVelocity.x;
+                buffers.dvy[k] = deltaVelocity.y;
+                buffers.dvz[k] = deltaVelocity.z;
+                buffers.mass[k] = m_Masses[j];
+                buffers.smoothingLength[k] = m_SmoothingLengths[j];
+                buffers.pressureTerm[k] = m_Pressures[j] / (m_Densities[j] * m_Densities[j]);
+                buffers.soundSpeed[k] = m_SoundSpeeds[j];
+                buffers.density[k] = m_Densities[j];
+            }
+
+            const float ownPressureTerm = m_Pressures[i] / (m_Densities[i] * m_Densities[i]);
+            const Lanes zero = Lanes::Broadcast(0.0f);
+            const Lanes half = Lanes::Broadcast(0.5f);
+            const Lanes ownH = Lanes::Broadcast(m_SmoothingLengths[i]);
+            const Lanes ownPressure = Lanes::Broadcast(ownPressureTerm);
+            const Lanes ownSoundSpeed = Lanes::Broadcast(m_SoundSpeeds[i]);
+            const Lanes ownDensity = Lanes::Broadcast(m_Densities[i]);
+            const Lanes minR2 = Lanes::Broadcast(1e-12f);
+
+            Lanes accX = zero, accY = zero, accZ = zero, energyRate = zero;
+            for (size_t k = 0; k < padded; k += Lanes::Width) {
+                Lanes dx = Lanes::Load(&buffers.dx[k]);
+                Lanes dy = Lanes::Load(&buffers.dy[k]);
+                Lanes dz = Lanes::Load(&buffers.dz[k]);
+                Lanes dvx = Lanes::Load(&buffers.dvx[k]);
+                Lanes dvy = Lanes::Load(&buffers.dvy[k]);
+                Lanes dvz = Lanes::Load(&buffers.dvz[k]);
+                Lanes mass = Lanes::Load(&buffers.mass[k]);
+
+                Lanes pairH = (Lanes::Load(&buffers.smoothingLength[k]) + ownH) * half;
+                Lanes r2 = dx * dx + dy * dy + dz * dz;
+                Lanes r = Sqrt(r2);
+                Lanes q = r / pairH;
+
+                // gradW = F * (x_i - x_j)
+                Lanes norm = Lanes::Broadcast(sigma) / (pairH * pairH * pairH * pairH);
+                Lanes gradientFactor = SelectIfGreaterEqual(r2, minR2, KernelDerivative(kernel, q) * norm / r);
+
+                // Monaghan viscosity, active only for approaching pairs. (x_i - x_j).(v_i - v_j) == dx.dv
+                Lanes approach = dx * dvx + dy * dvy + dz * dvz;
+                Lanes mu = pairH * approach / (r2 + Lanes::Broadcast(0.01f) * pairH * pairH);
+                Lanes meanSoundSpeed = (Lanes::Load(&buffers.soundSpeed[k]) + ownSoundSpeed) * half;
+                Lanes meanDensity = (Lanes::Load(&buffers.density[k]) + ownDensity) * half;
+                Lanes viscosity = SelectIfLess(approach, zero,
+                    (Lanes::Broadcast(beta) * mu * mu - Lanes::Broadcast(alpha) * meanSoundSpeed * mu) / meanDensity);
+
+                Lanes term = mass * (ownPressure + Lanes::Load(&buffers.pressureTerm[k]) + viscosity) * gradientFactor;
+                accX = accX + term * dx;
+                accY = accY + term * dy;
+                accZ = accZ + term * dz;
+
+                energyRate = energyRate + mass * (ownPressure + half * viscosity) * approach * gradientFactor;
+            }
+
+            m_Accelerations[i] += glm::vec3(ReduceAdd(accX), ReduceAdd(accY), ReduceAdd(accZ));
+            m_EnergyRates[i] = ReduceAdd(energyRate);
+        }
+    });
+}
+
+void SPHSolver::GatherGravitySources(const std::vector<glm::vec3>& bodyPositions, const std::vector<float>& bodyMasses)
+{
+    const size_t bodyCount = bodyPositions.size();
+    m_GravityPositions.resize(bodyCount + m_Positions.size());
+    m_GravityMasses.resize(bodyCount + m_Positions.size());
+    std::copy(bodyPositions.begin(), bodyPositions.end(), m_GravityPositions.begin());
+    std::copy(m_Positions.begin(), m_Positions.end(), m_GravityPositions.begin() + bodyCount);
+    std::copy(bodyMasses.begin(), bodyMasses.end(), m_GravityMasses.begin());
+    std::copy(m_Masses.begin(), m_Masses.end(), m_GravityMasses.begin() + bodyCount);
+}
+
+void SPHSolver::RemapGravityTree(GravitySolver& solver, size_t bodyCount)
+{
+    // The bodies keep their place in front of the gas, so the shared tree follows the gas order.
+    const std::vector<uint32_t>& order = m_SpatialSort.GetSortedIndices();
+    m_GravityOrder.resize(bodyCount + order.size());
+    for (size_t b = 0; b < bodyCount; b++) {
+        m_GravityOrder[b] = static_cast<uint32_t>(b);
+    }
+    for (size_t i = 0; i < order.size(); i++) {
+        m_GravityOrder[bodyCount + i] = static_cast<uint32_t>(bodyCount) + order[i];
+    }
+    solver.OnBodiesPermuted(m_GravityOrder);
+}
+
+void SPHSolver::ComputeGravity(GravitySolver& solver, float gravityStrength, const std::vector<glm::vec3>& bodyPositions,
+                               const std::vector<float>& bodyMasses, std::vector<glm::vec3>& bodyAccelerations)
+{
+    const size_t count = m_Positions.size();
+    const size_t bodyCount = bodyPositions.size();
+    GatherGravitySources(bodyPositions, bodyMasses);
+    if (m_SharedBounds)
+        m_GravitySort.Merge(m_GravityPositions, m_SpatialSort, bodyCount);
+    else
+        m_GravitySort.Update(m_GravityPositions);
+
+    // Direct summation is picked for a handful of bodies; over the gas as well it would be quadratic.
+    const SolverSettings settings = solver.GetSettings();
+    if (settings.type == SolverType::DirectSum)
+    {
+        SolverSettings tree = settings;
+        tree.type = SolverType::GroupWalk;
+        solver.SetSettings(tree);
+    }
+
+    if (!m_Settings.selfGravity)
+    {
+        // Without self-gravity the gas only feels the bodies, so its own masses are left out of the pass it
+        // takes its accelerations from. The bodies still feel the gas in the pass below.
+        std::fill(m_GravityMasses.begin() + bodyCount, m_GravityMasses.end(), 0.0f);
+        solver.ComputeAccelerations(m_GravityPositions, m_GravityMasses, m_GravitySort, gravityStrength, m_GravityAccelerations);
+        AddGasGravity(bodyCount);
+        std::copy(m_Masses.begin(), m_Masses.end(), m_GravityMasses.begin() + bodyCount);
+    }
+
+    // Bodies and gas pull on each other through one tree. The external field comes with the same pass.
+    solver.ComputeAccelerations(m_GravityPositions, m_GravityMasses, m_GravitySort, gravityStrength, m_GravityAccelerations,
+                                m_Settings.selfGravity ? count + bodyCount : bodyCount);
+    solver.SetSettings(settings);
+
+    if (m_Settings.selfGravity)
+        AddGasGravity(bodyCount);
+    bodyAccelerations.assign(m_GravityAccelerations.begin(), m_GravityAccelerations.begin() + bodyCount);
+}
+
+void SPHSolver::AddGasGravity(size_t bodyCount)
+{
+    ThreadPool::Get().ParallelFor(m_Positions.size(), 8192, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            m_Accelerations[i] += m_GravityAccelerations[bodyCount + i];
+        }
+    });
+}
+
+void SPHSolver::Integrate(float deltaTime)
+{
+    const float minEnergy = m_Settings.minInternalEnergy;
+    const float factor = m_Settings.smoothingFactor;
+    const float minH = m_Settings.minSmoothingLength;
+    const float maxH = m_Settings.maxSmoothingLength;
+
+    ThreadPool::Get().ParallelFor(m_Positions.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            m_Velocities[i] += m_Accelerations[i] * deltaTime;
+            m_Positions[i] += m_Velocities[i] * deltaTime;
+            m_InternalEnergies[i] = std::max(minEnergy, m_InternalEnergies[i] + m_EnergyRates[i] * deltaTime);
+
+            if (m_Densities[i] > 0.0f)
+                m_SmoothingLengths[i] = glm::clamp(factor * std::cbrt(m_Masses[i] / m_Densities[i]), minH, maxH);
+        }
+    });
+}
+
+float SPHSolver::GetMaxStableTimestep() const
+{
+    float timestep = std::numeric_limits<float>::max();
+    for (size_t i = 0; i < m_Positions.size(); i++) {
+        float signalSpeed = m_SoundSpeeds[i] * (1.0f + 1.2f * m_Settings.viscosityAlpha);
+        if (signalSpeed > 0.0f)
+            timestep = std::min(timestep, 0.3f * m_SmoothingLengths[i] / signalSpeed);
+    }
+    return timestep;
+}
+
+}
\ No newline at end of file
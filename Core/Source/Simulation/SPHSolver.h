@@ -0,0 +1,138 @@
+#ifndef SPH_SOLVER_H
+#define SPH_SOLVER_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+#include "SpatialSort.h"
+#include "BroadPhase.h"
+#include "GravitySolver.h"
+#include "Random.h"
+
+namespace SpaceSim {
+
+enum class SPHKernel {
+    CubicSpline,
+    WendlandC2
+};
+
+struct SPHSettings {
+    SPHKernel kernel = SPHKernel::CubicSpline;
+    float adiabaticIndex = 5.0f / 3.0f;
+    float viscosityAlpha = 1.0f;
+    float viscosityBeta = 2.0f;
+    float smoothingFactor = 1.2f;
+    float minSmoothingLength = 0.02f;
+    float maxSmoothingLength = 4.0f;
+    float minInternalEnergy = 1e-4f;
+    float neighborSkin = 0.2f;
+    bool selfGravity = true;
+};
+
+struct GasParticle {
+    glm::vec3 position;
+    glm::vec3 velocity;
+    float mass;
+    float internalEnergy;
+    float smoothingLength;
+};
+
+// Fills in one spawned gas particle, as BodyGenerator does for bodies.
+using GasGenerator = std::function<void(size_t index, RandomStream& random, GasParticle& particle)>;
+
+struct SPHStats {
+    double neighborMs = 0.0;
+    double densityMs = 0.0;
+    double forceMs = 0.0;
+    double gravityMs = 0.0;
+    uint64_t neighborRebuilds = 0;
+    float averageNeighbors = 0.0f;
+};
+
+// Gas particles evolved with smoothed particle hydrodynamics. Pairs use the symmetrized smoothing length
+// (h_i + h_j) / 2 with kernel support 2h, and neighbor lists are cached with a skin until particles have
+// moved or grown far enough to invalidate them. Gravity goes through the caller's GravitySolver with the
+// point masses and the gas in one set, bodies first, so both pull on each other through a single tree and
+// the solver's external field acts on the gas too.
+class SPHSolver {
+public:
+    void Clear();
+    size_t AddParticles(size_t count);
+    // Appends count particles; particle i draws from stream firstStream + i. Returns the index of the first.
+    size_t SpawnParticles(size_t count, uint64_t seed, uint64_t firstStream, const GasGenerator& generator);
+    size_t GetParticleCount() const { return m_Positions.size(); }
+
+    // Replaces bodyAccelerations with the bodies' full gravity, from each other and from the gas.
+    void ComputeAccelerations(GravitySolver& solver, float gravityStrength, const std::vector<glm::vec3>& bodyPositions,
+                              const std::vector<float>& bodyMasses, std::vector<glm::vec3>& bodyAccelerations);
+    void Integrate(float deltaTime);
+    float GetMaxStableTimestep() const;
+
+    std::vector<glm::vec3>& GetPositions() { return m_Positions; }
+    std::vector<glm::vec3>& GetVelocities() { return m_Velocities; }
+    std::vector<float>& GetMasses() { return m_Masses; }
+    std::vector<float>& GetInternalEnergies() { return m_InternalEnergies; }
+    std::vector<float>& GetSmoothingLengths() { return m_SmoothingLengths; }
+
+    const std::vector<glm::vec3>& GetPositions() const { return m_Positions; }
+    const std::vector<glm::vec3>& GetVelocities() const { return m_Velocities; }
+    const std::vector<float>& GetMasses() const { return m_Masses; }
+    const std::vector<float>& GetInternalEnergies() const { return m_InternalEnergies; }
+    const std::vector<float>& GetSmoothingLengths() const { return m_SmoothingLengths; }
+    const std::vector<float>& GetDensities() const { return m_Densities; }
+    const std::vector<float>& GetPressures() const { return m_Pressures; }
+
+    // The bodies followed by the gas, in the order the solver's tree holds them after ComputeAccelerations.
+    void GatherGravitySources(const std::vector<glm::vec3>& bodyPositions, const std::vector<float>& bodyMasses);
+    const std::vector<glm::vec3>& GetGravityPositions() const { return m_GravityPositions; }
+    const std::vector<float>& GetGravityMasses() const { return m_GravityMasses; }
+
+    const SPHSettings& GetSettings() const { return m_Settings; }
+    void SetSettings(const SPHSettings& settings) { m_Settings = settings; }
+    const SPHStats& GetStats() const { return m_Stats; }
+
+private:
+    void UpdateNeighbors();
+    bool NeighborsValid() const;
+    void ComputeDensity();
+    void ComputeHydroForces();
+    void RemapGravityTree(GravitySolver& solver, size_t bodyCount);
+    void ComputeGravity(GravitySolver& solver, float gravityStrength, const std::vector<glm::vec3>& bodyPositions,
+                        const std::vector<float>& bodyMasses, std::vector<glm::vec3>& bodyAccelerations);
+    void AddGasGravity(size_t bodyCount);
+
+    SPHSettings m_Settings;
+    SPHStats m_Stats;
+
+    std::vector<glm::vec3> m_Positions;
+    std::vector<glm::vec3> m_Velocities;
+    std::vector<float> m_Masses;
+    std::vector<float> m_InternalEnergies;
+    std::vector<float> m_SmoothingLengths;
+    std::vector<float> m_Densities;
+    std::vector<float> m_Pressures;
+    std::vector<float> m_SoundSpeeds;
+    std::vector<glm::vec3> m_Accelerations;
+    std::vector<float> m_EnergyRates;
+
+    std::vector<uint32_t> m_NeighborOffsets;
+    std::vector<uint32_t> m_Neighbors;
+    std::vector<glm::vec3> m_NeighborPositions;
+    std::vector<float> m_NeighborRadii;
+    bool m_NeighborsDirty = true;
+
+    SpatialSort m_SpatialSort;
+    BroadPhase m_BroadPhase;
+    // Set when m_SpatialSort's bounds hold the bodies too, so the gravity sort merges them into the gas order.
+    bool m_SharedBounds = false;
+    SpatialSort m_GravitySort;
+    std::vector<glm::vec3> m_GravityPositions;
+    std::vector<float> m_GravityMasses;
+    std::vector<glm::vec3> m_GravityAccelerations;
+    std::vector<uint32_t> m_GravityOrder;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,163 @@
+#ifndef SIMD_LANES_H
+#define SIMD_LANES_H
+
+#include <cstdint>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SPACESIM_LANES_SSE
+#else
+#include <cmath>
+#endif
+
+namespace SpaceSim {
+
+#if defined(__AVX__) || defined(SPACESIM_LANES_SSE)
+// Natural log of positive normal floats, accurate to about one ulp. The mantissa is folded into
+// [sqrt(1/2), sqrt(2)) and expanded as 2 atanh((m - 1) / (m + 1)).
+inline __m128 Log4(__m128 x)
+{
+    const __m128i bits = _mm_castps_si128(x);
+    __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    __m128 mantissa = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+
+    const __m128 large = _mm_cmpge_ps(mantissa, _mm_set1_ps(1.41421356f));
+    mantissa = _mm_sub_ps(mantissa, _mm_and_ps(large, _mm_mul_ps(mantissa, _mm_set1_ps(0.5f))));
+    exponent = _mm_add_ps(exponent, _mm_and_ps(large, _mm_set1_ps(1.0f)));
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 s = _mm_div_ps(_mm_sub_ps(mantissa, one), _mm_add_ps(mantissa, one));
+    const __m128 s2 = _mm_mul_ps(s, s);
+    __m128 series = _mm_add_ps(_mm_mul_ps(s2, _mm_set1_ps(1.0f / 9.0f)), _mm_set1_ps(1.0f / 7.0f));
+    series = _mm_add_ps(_mm_mul_ps(series, s2), _mm_set1_ps(1.0f / 5.0f));
+    series = _mm_add_ps(_mm_mul_ps(series, s2), _mm_set1_ps(1.0f / 3.0f));
+    series = _mm_add_ps(_mm_mul_ps(series, s2), one);
+    series = _mm_mul_ps(series, _mm_add_ps(s, s));
+    return _mm_add_ps(_mm_mul_ps(exponent, _mm_set1_ps(0.693147181f)), series);
+}
+#endif
+
+// Thin wrapper over the widest float vector the build targets: AVX, the x64 SSE baseline, or scalar.
+#if defined(__AVX__)
+
+struct Lanes {
+    static constexpr uint32_t Width = 8;
+    __m256 v;
+
+    static Lanes Load(const float* p) { return { _mm256_loadu_ps(p) }; }
+    static Lanes Broadcast(float value) { return { _mm256_set1_ps(value) }; }
+    void Store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline Lanes operator/(Lanes a, Lanes b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline Lanes Sqrt(Lanes a) { return { _mm256_sqrt_ps(a.v) }; }
+inline Lanes Min(Lanes a, Lanes b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline Lanes Max(Lanes a, Lanes b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline Lanes SelectIfGreaterEqual(Lanes a, Lanes b, Lanes value) { return { _mm256_and_ps(_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ), value.v) }; }
+inline Lanes SelectIfLess(Lanes a, Lanes b, Lanes value) { return { _mm256_and_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ), value.v) }; }
+
+inline Lanes Log(Lanes a)
+{
+    const __m128 low = Log4(_mm256_castps256_ps128(a.v));
+    const __m128 high = Log4(_mm256_extractf128_ps(a.v, 1));
+    return { _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1) };
+}
+
+inline float ReduceAdd(Lanes a)
+{
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+#elif defined(SPACESIM_LANES_SSE)
+
+struct Lanes {
+    static constexpr uint32_t Width = 4;
+    __m128 v;
+
+    static Lanes Load(const float* p) { return { _mm_loadu_ps(p) }; }
+    static Lanes Broadcast(float value) { return { _mm_set1_ps(value) }; }
+    void Store(float* p) const { _mm_storeu_ps(p, v); }
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline Lanes operator/(Lanes a, Lanes b) { return { _mm_div_ps(a.v, b.v) }; }
+inline Lanes Sqrt(Lanes a) { return { _mm_sqrt_ps(a.v) }; }
+inline Lanes Min(Lanes a, Lanes b) { return { _mm_min_ps(a.v, b.v) }; }
+inline Lanes Max(Lanes a, Lanes b) { return { _mm_max_ps(a.v, b.v) }; }
+inline Lanes SelectIfGreaterEqual(Lanes a, Lanes b, Lanes value) { return { _mm_and_ps(_mm_cmpge_ps(a.v, b.v), value.v) }; }
+inline Lanes SelectIfLess(Lanes a, Lanes b, Lanes value) { return { _mm_and_ps(_mm_cmplt_ps(a.v, b.v), value.v) }; }
+inline Lanes Log(Lanes a) { return { Log4(a.v) }; }
+
+inline float ReduceAdd(Lanes a)
+{
+    __m128 sum = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+#else
+
+struct Lanes {
+    static constexpr uint32_t Width = 1;
+    float v;
+
+    static Lanes Load(const float* p) { return { *p }; }
+    static Lanes Broadcast(float value) { return { value }; }
+    void Store(float* p) const { *p = v; }
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return { a.v + b.v }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { a.v - b.v }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { a.v * b.v }; }
+inline Lanes operator/(Lanes a, Lanes b) { return { a.v / b.v }; }
+inline Lanes Sqrt(Lanes a) { return { std::sqrt(a.v) }; }
+inline Lanes Min(Lanes a, Lanes b) { return { a.v < b.v ? a.v : b.v }; }
+inline Lanes Max(Lanes a, Lanes b) { return { a.v > b.v ? a.v : b.v }; }
+inline Lanes SelectIfGreaterEqual(Lanes a, Lanes b, Lanes value) { return { a.v >= b.v ? value.v : 0.0f }; }
+inline Lanes SelectIfLess(Lanes a, Lanes b, Lanes value) { return { a.v < b.v ? value.v : 0.0f }; }
+inline Lanes Log(Lanes a) { return { std::log(a.v) }; }
+
+inline float ReduceAdd(Lanes a) { return a.v; }
+
+#endif
+
+inline Lanes Abs(Lanes a) { return Max(a, Lanes::Broadcast(0.0f) - a); }
+
+// Four-quadrant arctangent, within 1e-7 rad. The octant is folded onto [0, 1] and expanded with
+// Abramowitz & Stegun 4.4.49; atan2(0, 0) is 0.
+inline Lanes Atan2(Lanes y, Lanes x)
+{
+    const Lanes zero = Lanes::Broadcast(0.0f);
+    const Lanes absX = Abs(x);
+    const Lanes absY = Abs(y);
+    const Lanes ratio = Min(absX, absY) / Max(Max(absX, absY), Lanes::Broadcast(1e-30f));
+    const Lanes s = ratio * ratio;
+
+    Lanes poly = Lanes::Broadcast(-0.0040540580f);
+    poly = poly * s + Lanes::Broadcast(0.0218612288f);
+    poly = poly * s + Lanes::Broadcast(-0.0559098861f);
+    poly = poly * s + Lanes::Broadcast(0.0964200441f);
+    poly = poly * s + Lanes::Broadcast(-0.1390853351f);
+    poly = poly * s + Lanes::Broadcast(0.1994653599f);
+    poly = poly * s + Lanes::Broadcast(-0.3332985605f);
+    poly = poly * s + Lanes::Broadcast(0.9999993329f);
+    Lanes angle = poly * ratio;
+
+    angle = angle + SelectIfLess(absX, absY, Lanes::Broadcast(1.57079632679f) - angle - angle);
+    angle = angle + SelectIfLess(x, zero, Lanes::Broadcast(3.14159265359f) - angle - angle);
+    return angle - SelectIfLess(y, zero, angle + angle);
+}
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,508 @@
+#include "SimulationCommands.h"
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+namespace SpaceSim {
+
+// Larger attachment sizes in a command log mean the log is damaged.
+constexpr uint64_t MaxAttachmentSize = 1ull << 24;
+
+// Attachments are the raw bytes of trivially copyable values, strings as a 32-bit length and the characters.
+template <typename T>
+static void Append(CommandAttachment& attachment, const T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "Only plain values are attached as bytes");
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    attachment.insert(attachment.end(), bytes, bytes + sizeof(T));
+}
+
+static void AppendString(CommandAttachment& attachment, const std::string& text)
+{
+    Append(attachment, static_cast<uint32_t>(text.size()));
+    attachment.insert(attachment.end(), text.begin(), text.end());
+}
+
+template <typename T>
+static bool Extract(const CommandAttachment& attachment, size_t& offset, T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "Only plain values are attached as bytes");
+    if (attachment.size() - offset < sizeof(T))
+        return false;
+    std::memcpy(&value, attachment.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+static bool ExtractString(const CommandAttachment& attachment, size_t& offset, std::string& text)
+{
+    uint32_t length = 0;
+    if (!Extract(attachment, offset, length) || attachment.size() - offset < length)
+        return false;
+    text.assign(reinterpret_cast<const char*>(attachment.data() + offset), length);
+    offset += length;
+    return true;
+}
+
+template <typename T>
+static bool ReadValue(const CommandAttachment& attachment, T& value)
+{
+    size_t offset = 0;
+    return Extract(attachment, offset, value) && offset == attachment.size();
+}
+
+// A bool copied in from the bytes at offset only holds a value when the byte is 0 or 1.
+static bool IsFlag(const CommandAttachment& attachment, size_t offset)
+{
+    return attachment[offset] <= 1;
+}
+
+static bool IsPositive(float value)
+{
+    return std::isfinite(value) && value > 0.0f;
+}
+
+static bool IsNonNegative(float value)
+{
+    return std::isfinite(value) && value >= 0.0f;
+}
+
+// Settings go into the simulation as they are, so attachments from a damaged log are checked first.
+static bool IsValid(const TrajectorySettings& settings)
+{
+    return static_cast<uint32_t>(settings.encoding) <= static_cast<uint32_t>(TrajectoryEncoding::Quantized) &&
+           IsPositive(settings.quantizationError);
+}
+
+static bool IsValid(const SolverSettings& settings)
+{
+    return static_cast<uint32_t>(settings.type) <= static_cast<uint32_t>(SolverType::GroupWalk) && IsPositive(settings.openingAngle) &&
+           settings.leafSize > 0 && IsPositive(settings.rebuildThreshold);
+}
+
+static bool IsValid(const AutotuneSettings& settings)
+{
+    return IsPositive(settings.forceErrorTolerance) && IsPositive(settings.retuneFactor) && settings.errorSamples > 0;
+}
+
+static bool IsValid(const PotentialComponent& component)
+{
+    return static_cast<uint32_t>(component.type) <= static_cast<uint32_t>(PotentialType::RotatingBar) && IsNonNegative(component.mass) &&
+           IsPositive(component.scaleRadius) && IsPositive(component.scaleHeight) && std::isfinite(component.patternSpeed) &&
+           std::isfinite(component.phase) && std::isfinite(component.center.x) && std::isfinite(component.center.y) &&
+           std::isfinite(component.center.z);
+}
+
+static bool IsValid(const SPHSettings& settings)
+{
+    return static_cast<uint32_t>(settings.kernel) <= static_cast<uint32_t>(SPHKernel::WendlandC2) && IsPositive(settings.adiabaticIndex - 1.0f) &&
+           IsNonNegative(settings.viscosityAlpha) && IsNonNegative(settings.viscosityBeta) && IsPositive(settings.smoothingFactor) &&
+           IsPositive(settings.minSmoothingLength) && IsPositive(settings.maxSmoothingLength) &&
+           settings.minSmoothingLength <= settings.maxSmoothingLength && IsNonNegative(settings.minInternalEnergy) &&
+           IsNonNegative(settings.neighborSkin);
+}
+
+static bool IsValid(const SchedulerSettings& settings)
+{
+    return std::isfinite(settings.warp) && settings.warp >= 0.0 && IsPositive(settings.maxSubstep) && IsPositive(settings.frameBudgetMs) &&
+           IsPositive(settings.maxFrameDelta);
+}
+
+static AttachedCommand MakeAttached(CommandType type)
+{
+    AttachedCommand attached;
+    attached.command.type = type;
+    return attached;
+}
+
+template <typename T>
+static AttachedCommand MakeAttachedValue(CommandType type, const T& value)
+{
+    AttachedCommand attached = MakeAttached(type);
+    Append(attached.attachment, value);
+    return attached;
+}
+
+static AttachedCommand MakeAttachedPath(CommandType type, const std::string& path)
+{
+    AttachedCommand attached = MakeAttached(type);
+    AppendString(attached.attachment, path);
+    return attached;
+}
+
+static SimulationCommand MakeCommand(CommandType type)
+{
+    SimulationCommand command;
+    command.type = type;
+    return command;
+}
+
+bool HasAttachment(CommandType type)
+{
+    switch (type)
+    {
+    case CommandType::LoadCheckpoint:
+    case CommandType::SaveCheckpoint:
+    case CommandType::SetSolverSettings:
+    case CommandType::SetAutotuneSettings:
+    case CommandType::SetExternalPotentials:
+    case CommandType::SetEncounterSettings:
+    case CommandType::SetOrbitSettings:
+    case CommandType::SetHistorySettings:
+    case CommandType::SetGasSettings:
+    case CommandType::SetSchedulerSettings:
+    case CommandType::SetAutosave:
+    case CommandType::OpenTrajectory:
+    case CommandType::StartRecording:
+    case CommandType::StartReplay:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool IsRecorded(CommandType type)
+{
+    // Saving writes a file but leaves the run as it is, so a replay has no reason to repeat it.
+    return type < CommandType::SetAutosave && type != CommandType::SaveCheckpoint;
+}
+
+SimulationCommand SimulationCommand::MakeReset()
+{
+    return SimulationCommand();
+}
+
+SimulationCommand SimulationCommand::MakeLoadScene(uint32_t scene, uint64_t bodyCount, float gravityStrength)
+{
+    SimulationCommand command;
+    command.type = CommandType::LoadScene;
+    command.scene = scene;
+    command.count = bodyCount;
+    command.value = gravityStrength;
+    return command;
+}
+
+SimulationCommand SimulationCommand::MakeAddRandomPlanet()
+{
+    SimulationCommand command;
+    command.type = CommandType::AddRandomPlanet;
+    return command;
+}
+
+SimulationCommand SimulationCommand::MakeSpawnRandomPlanets(uint64_t count)
+{
+    SimulationCommand command;
+    command.type = CommandType::SpawnRandomPlanets;
+    command.count = count;
+    return command;
+}
+
+SimulationCommand SimulationCommand::MakeAddPlanet(float distance, float angle, float radius, const glm::vec4& color)
+{
+    SimulationCommand command;
+    command.type = CommandType::AddPlanet;
+    command.distance = distance;
+    command.angle = angle;
+    command.radius = radius;
+    command.color = color;
+    return command;
+}
+
+SimulationCommand SimulationCommand::MakeRemoveBody(BodyHandle handle)
+{
+    SimulationCommand command;
+    command.type = CommandType::RemoveBody;
+    command.handle = handle;
+    return command;
+}
+
+SimulationCommand SimulationCommand::MakeAddGasDisk(uint64_t particleCount, float innerRadius, float outerRadius, float totalMass)
+{
+    SimulationCommand command;
+    command.type = CommandType::AddGasDisk;
+    command.count = particleCount;
+    command.distance = innerRadius;
+    command.radius = outerRadius;
+    command.mass = totalMass;
+    return command;
+}
+
+SimulationCommand SimulationCommand::MakeClearGas()
+{
+    SimulationCommand command;
+    command.type = CommandType::ClearGas;
+    return command;
+}
+
+SimulationCommand SimulationCommand::MakeSetParameter(SimulationParameter parameter, double value)
+{
+    SimulationCommand command;
+    command.type = CommandType::SetParameter;
+    command.parameter = parameter;
+    command.value = value;
+    return command;
+}
+
+SimulationCommand SimulationCommand::MakeSetParameter(SimulationParameter parameter, uint64_t value)
+{
+    SimulationCommand command;
+    command.type = CommandType::SetParameter;
+    command.parameter = parameter;
+    command.count = value;
+    return command;
+}
+
+SimulationCommand SimulationCommand::MakeRestoreHistory(uint64_t step)
+{
+    SimulationCommand command;
+    command.type = CommandType::RestoreHistory;
+    command.count = step;
+    return command;
+}
+
+AttachedCommand SimulationCommand::MakeLoadCheckpoint(const std::string& path)
+{
+    return MakeAttachedPath(CommandType::LoadCheckpoint, path);
+}
+
+AttachedCommand SimulationCommand::MakeSaveCheckpoint(const std::string& path)
+{
+    return MakeAttachedPath(CommandType::SaveCheckpoint, path);
+}
+
+AttachedCommand SimulationCommand::MakeSetSolverSettings(const SolverSettings& settings)
+{
+    return MakeAttachedValue(CommandType::SetSolverSettings, settings);
+}
+
+AttachedCommand SimulationCommand::MakeSetAutotuneSettings(const AutotuneSettings& settings)
+{
+    return MakeAttachedValue(CommandType::SetAutotuneSettings, settings);
+}
+
+SimulationCommand SimulationCommand::MakeRequestAutotune()
+{
+    return MakeCommand(CommandType::RequestAutotune);
+}
+
+AttachedCommand SimulationCommand::MakeSetExternalPotentials(const std::vector<PotentialComponent>& components)
+{
+    AttachedCommand attached = MakeAttached(CommandType::SetExternalPotentials);
+    Append(attached.attachment, static_cast<uint32_t>(components.size()));
+    for (const PotentialComponent& component : components) {
+        Append(attached.attachment, component);
+    }
+    return attached;
+}
+
+AttachedCommand SimulationCommand::MakeSetEncounterSettings(const EncounterSettings& settings)
+{
+    AttachedCommand attached = MakeAttached(CommandType::SetEncounterSettings);
+    Append(attached.attachment, static_cast<uint8_t>(settings.enabled));
+    Append(attached.attachment, settings.threshold);
+    AppendString(attached.attachment, settings.logPath);
+    return attached;
+}
+
+AttachedCommand SimulationCommand::MakeSetOrbitSettings(const OrbitTrackerSettings& settings)
+{
+    AttachedCommand attached = MakeAttached(CommandType::SetOrbitSettings);
+    Append(attached.attachment, static_cast<uint8_t>(settings.enabled));
+    Append(attached.attachment, settings.interval);
+    Append(attached.attachment, settings.primary);
+    Append(attached.attachment, static_cast<uint8_t>(settings.streamToDisk));
+    AppendString(attached.attachment, settings.logPath);
+    return attached;
+}
+
+AttachedCommand SimulationCommand::MakeSetHistorySettings(const HistorySettings& settings)
+{
+    return MakeAttachedValue(CommandType::SetHistorySettings, settings);
+}
+
+AttachedCommand SimulationCommand::MakeSetGasSettings(const SPHSettings& settings)
+{
+    return MakeAttachedValue(CommandType::SetGasSettings, settings);
+}
+
+AttachedCommand SimulationCommand::MakeSetSchedulerSettings(const SchedulerSettings& settings)
+{
+    return MakeAttachedValue(CommandType::SetSchedulerSettings, settings);
+}
+
+AttachedCommand SimulationCommand::MakeSetAutosave(uint64_t interval, const std::string& path)
+{
+    AttachedCommand attached = MakeAttached(CommandType::SetAutosave);
+    Append(attached.attachment, interval);
+    AppendString(attached.attachment, path);
+    return attached;
+}
+
+SimulationCommand SimulationCommand::MakeSetCheckpointMode(CheckpointMode mode)
+{
+    SimulationCommand command = MakeCommand(CommandType::SetCheckpointMode);
+    command.count = static_cast<uint64_t>(mode);
+    return command;
+}
+
+AttachedCommand SimulationCommand::MakeOpenTrajectory(const std::string& path, const TrajectorySettings& settings)
+{
+    AttachedCommand attached = MakeAttachedPath(CommandType::OpenTrajectory, path);
+    Append(attached.attachment, settings);
+    return attached;
+}
+
+SimulationCommand SimulationCommand::MakeCloseTrajectory()
+{
+    return MakeCommand(CommandType::CloseTrajectory);
+}
+
+AttachedCommand SimulationCommand::MakeStartRecording(const std::string& path)
+{
+    return MakeAttachedPath(CommandType::StartRecording, path);
+}
+
+SimulationCommand SimulationCommand::MakeStopRecording()
+{
+    return MakeCommand(CommandType::StopRecording);
+}
+
+AttachedCommand SimulationCommand::MakeStartReplay(const std::string& path)
+{
+    return MakeAttachedPath(CommandType::StartReplay, path);
+}
+
+SimulationCommand SimulationCommand::MakeStopReplay()
+{
+    return MakeCommand(CommandType::StopReplay);
+}
+
+bool ReadAttachment(const CommandAttachment& attachment, std::string& path)
+{
+    size_t offset = 0;
+    return ExtractString(attachment, offset, path) && offset == attachment.size();
+}
+
+bool ReadAttachment(const CommandAttachment& attachment, uint64_t& value, std::string& path)
+{
+    size_t offset = 0;
+    return Extract(attachment, offset, value) && ExtractString(attachment, offset, path) && offset == attachment.size();
+}
+
+bool ReadAttachment(const CommandAttachment& attachment, std::string& path, TrajectorySettings& settings)
+{
+    size_t offset = 0;
+    if (!ExtractString(attachment, offset, path))
+        return false;
+    const size_t start = offset;
+    return Extract(attachment, offset, settings) && offset == attachment.size() &&
+           IsFlag(attachment, start + offsetof(TrajectorySettings, useRing)) && IsValid(settings);
+}
+
+bool ReadAttachment(const CommandAttachment& attachment, SolverSettings& settings)
+{
+    return ReadValue(attachment, settings) && IsValid(settings);
+}
+
+bool ReadAttachment(const CommandAttachment& attachment, AutotuneSettings& settings)
+{
+    return ReadValue(attachment, settings) && IsFlag(attachment, offsetof(AutotuneSettings, enabled)) && IsValid(settings);
+}
+
+bool ReadAttachment(const CommandAttachment& attachment, std::vector<PotentialComponent>& components)
+{
+    size_t offset = 0;
+    uint32_t count = 0;
+    if (!Extract(attachment, offset, count) || (attachment.size() - offset) / sizeof(PotentialComponent) < count)
+        return false;
+    components.resize(count);
+    for (PotentialComponent& component : components) {
+        Extract(attachment, offset, component);
+        if (!IsValid(component))
+            return false;
+    }
+    return offset == attachment.size();
+}
+
+bool ReadAttachment(const CommandAttachment& attachment, EncounterSettings& settings)
+{
+    size_t offset = 0;
+    uint8_t enabled = 0;
+    if (!Extract(attachment, offset, enabled) || !Extract(attachment, offset, settings.threshold) ||
+        !ExtractString(attachment, offset, settings.logPath) || !IsNonNegative(settings.threshold))
+        return false;
+    settings.enabled = enabled != 0;
+    return offset == attachment.size();
+}
+
+bool ReadAttachment(const CommandAttachment& attachment, OrbitTrackerSettings& settings)
+{
+    size_t offset = 0;
+    uint8_t enabled = 0;
+    uint8_t streamToDisk = 0;
+    if (!Extract(attachment, offset, enabled) || !Extract(attachment, offset, settings.interval) || !Extract(attachment, offset, settings.primary) ||
+        !Extract(attachment, offset, streamToDisk) || !ExtractString(attachment, offset, settings.logPath) || settings.interval == 0)
+        return false;
+    settings.enabled = enabled != 0;
+    settings.streamToDisk = streamToDisk != 0;
+    return offset == attachment.size();
+}
+
+bool ReadAttachment(const CommandAttachment& attachment, HistorySettings& settings)
+{
+    // Zero intervals and budgets are raised to one by StateHistory::SetSettings.
+    return ReadValue(attachment, settings) && IsFlag(attachment, offsetof(HistorySettings, enabled));
+}
+
+bool ReadAttachment(const CommandAttachment& attachment, SPHSettings& settings)
+{
+    return ReadValue(attachment, settings) && IsFlag(attachment, offsetof(SPHSettings, selfGravity)) && IsValid(settings);
+}
+
+bool ReadAttachment(const CommandAttachment& attachment, SchedulerSettings& settings)
+{
+    return ReadValue(attachment, settings) && IsValid(settings);
+}
+
+void WriteCommandLogHeader(std::ostream& stream)
+{
+    CommandLogHeader header = { CommandLogMagic, CommandLogVersion, sizeof(RecordedCommand), 0 };
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void WriteCommand(std::ostream& stream, uint64_t step, const SimulationCommand& command, const CommandAttachment& attachment)
+{
+    RecordedCommand record = { step, attachment.size(), command };
+    stream.write(reinterpret_cast<const char*>(&record), sizeof(record));
+    stream.write(reinterpret_cast<const char*>(attachment.data()), static_cast<std::streamsize>(attachment.size()));
+}
+
+bool ReadCommandLog(std::istream& stream, std::vector<RecordedCommand>& commands, std::vector<CommandAttachment>& attachments)
+{
+    CommandLogHeader header;
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != CommandLogMagic ||
+        header.version < 1 || header.version > CommandLogVersion || header.recordSize != sizeof(RecordedCommand))
+        return false;
+
+    commands.clear();
+    attachments.clear();
+    RecordedCommand record;
+    while (stream.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        // The size field was reserved and zero in version 1.
+        if (header.version < 2)
+            record.attachmentSize = 0;
+        if (record.attachmentSize > MaxAttachmentSize)
+            break;
+        CommandAttachment attachment(record.attachmentSize);
+        if (!stream.read(reinterpret_cast<char*>(attachment.data()), static_cast<std::streamsize>(attachment.size())))
+            break;
+        if (header.version < 3 && record.command.type == CommandType::RestoreHistory)
+            continue;
+        commands.push_back(record);
+        attachments.push_back(std::move(attachment));
+    }
+    return true;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,237 @@
+#ifndef SIMULATION_COMMANDS_H
+#define SIMULATION_COMMANDS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "AsyncCheckpoint.h"
+#include "Autotuner.h"
+#include "BodyStorage.h"
+#include "EncounterCatalog.h"
+#include "ExternalField.h"
+#include "GravitySolver.h"
+#include "OrbitalElements.h"
+#include "SPHSolver.h"
+#include "StateHistory.h"
+#include "StepScheduler.h"
+#include "Trajectory.h"
+
+namespace SpaceSim {
+
+enum class CommandType : uint32_t {
+    Reset,
+    LoadScene,
+    AddRandomPlanet,
+    SpawnRandomPlanets,
+    AddPlanet,
+    RemoveBody,
+    AddGasDisk,
+    ClearGas,
+    SetParameter,
+    RestoreHistory,
+    LoadCheckpoint,
+    SaveCheckpoint,
+    SetSolverSettings,
+    SetAutotuneSettings,
+    RequestAutotune,
+    SetExternalPotentials,
+    SetEncounterSettings,
+    SetOrbitSettings,
+    SetHistorySettings,
+    SetGasSettings,
+    SetSchedulerSettings,
+    // Controls of the simulation thread itself rather than changes to the run; never written to command logs.
+    SetAutosave,
+    SetCheckpointMode,
+    OpenTrajectory,
+    CloseTrajectory,
+    StartRecording,
+    StopRecording,
+    StartReplay,
+    StopReplay
+};
+
+// Paths and settings structs do not fit a SimulationCommand, so commands that need them carry an attachment
+// out of band; the command's count then identifies the attachment until it is applied.
+using CommandAttachment = std::vector<uint8_t>;
+
+bool HasAttachment(CommandType type);
+bool IsRecorded(CommandType type);
+
+struct AttachedCommand;
+
+// GravityStrength takes the real value, the others the integer one.
+enum class SimulationParameter : uint32_t {
+    GravityStrength,
+    CollisionsEnabled,
+    Seed,
+    ReductionMode,
+    ReorderInterval
+};
+
+// One change to the simulation, plain data so it can be queued without allocation and written to disk
+// as is. Which fields are used depends on the type; the factories fill in the right ones.
+struct SimulationCommand {
+    CommandType type = CommandType::Reset;
+    SimulationParameter parameter = SimulationParameter::GravityStrength;
+    uint32_t scene = 0;
+    BodyHandle handle = InvalidBodyHandle;
+    uint64_t count = 0;
+    double value = 0.0;
+    float distance = 0.0f;
+    float angle = 0.0f;
+    float radius = 0.0f;
+    float mass = 0.0f;
+    glm::vec4 color = glm::vec4(1.0f);
+
+    static SimulationCommand MakeReset();
+    static SimulationCommand MakeLoadScene(uint32_t scene, uint64_t bodyCount, float gravityStrength);
+    static SimulationCommand MakeAddRandomPlanet();
+    static SimulationCommand MakeSpawnRandomPlanets(uint64_t count);
+    static SimulationCommand MakeAddPlanet(float distance, float angle, float radius, const glm::vec4& color);
+    static SimulationCommand MakeRemoveBody(BodyHandle handle);
+    static SimulationCommand MakeAddGasDisk(uint64_t particleCount, float innerRadius, float outerRadius, float totalMass);
+    static SimulationCommand MakeClearGas();
+    static SimulationCommand MakeSetParameter(SimulationParameter parameter, double value);
+    static SimulationCommand MakeSetParameter(SimulationParameter parameter, uint64_t value);
+    // Rewinds to the history snapshot taken at step, which stays the same while older snapshots are dropped.
+    static SimulationCommand MakeRestoreHistory(uint64_t step);
+    static AttachedCommand MakeLoadCheckpoint(const std::string& path);
+    static AttachedCommand MakeSaveCheckpoint(const std::string& path);
+    static AttachedCommand MakeSetSolverSettings(const SolverSettings& settings);
+    static AttachedCommand MakeSetAutotuneSettings(const AutotuneSettings& settings);
+    static SimulationCommand MakeRequestAutotune();
+    static AttachedCommand MakeSetExternalPotentials(const std::vector<PotentialComponent>& components);
+    static AttachedCommand MakeSetEncounterSettings(const EncounterSettings& settings);
+    static AttachedCommand MakeSetOrbitSettings(const OrbitTrackerSettings& settings);
+    static AttachedCommand MakeSetHistorySettings(const HistorySettings& settings);
+    static AttachedCommand MakeSetGasSettings(const SPHSettings& settings);
+    static AttachedCommand MakeSetSchedulerSettings(const SchedulerSettings& settings);
+    static AttachedCommand MakeSetAutosave(uint64_t interval, const std::string& path);
+    static SimulationCommand MakeSetCheckpointMode(CheckpointMode mode);
+    static AttachedCommand MakeOpenTrajectory(const std::string& path, const TrajectorySettings& settings);
+    static SimulationCommand MakeCloseTrajectory();
+    static AttachedCommand MakeStartRecording(const std::string& path);
+    static SimulationCommand MakeStopRecording();
+    static AttachedCommand MakeStartReplay(const std::string& path);
+    static SimulationCommand MakeStopReplay();
+};
+
+static_assert(sizeof(SimulationCommand) == 64, "SimulationCommand is written to command logs as is");
+
+struct AttachedCommand {
+    SimulationCommand command;
+    CommandAttachment attachment;
+};
+
+// Read an attachment back into what its factory took. Return false when it is malformed or holds an enum or
+// setting out of range.
+bool ReadAttachment(const CommandAttachment& attachment, std::string& path);
+bool ReadAttachment(const CommandAttachment& attachment, uint64_t& value, std::string& path);
+bool ReadAttachment(const CommandAttachment& attachment, std::string& path, TrajectorySettings& settings);
+bool ReadAttachment(const CommandAttachment& attachment, SolverSettings& settings);
+bool ReadAttachment(const CommandAttachment& attachment, AutotuneSettings& settings);
+bool ReadAttachment(const CommandAttachment& attachment, std::vector<PotentialComponent>& components);
+bool ReadAttachment(const CommandAttachment& attachment, EncounterSettings& settings);
+bool ReadAttachment(const CommandAttachment& attachment, OrbitTrackerSettings& settings);
+bool ReadAttachment(const CommandAttachment& attachment, HistorySettings& settings);
+bool ReadAttachment(const CommandAttachment& attachment, SPHSettings& settings);
+bool ReadAttachment(const CommandAttachment& attachment, SchedulerSettings& settings);
+
+// Command log layout: CommandLogHeader followed by RecordedCommand records, each followed by its attachment.
+// step counts the simulation steps taken since recording started, so a replay applies each command at the
+// same step boundary. Version 1 logs have no attachments. Version 2 logs recorded RestoreHistory by snapshot
+// index, which does not reproduce, so those commands are skipped.
+constexpr uint32_t CommandLogMagic = 0x4D435353u; // "SSCM"
+constexpr uint32_t CommandLogVersion = 3;
+
+struct CommandLogHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+
+struct RecordedCommand {
+    uint64_t step;
+    uint64_t attachmentSize;
+    SimulationCommand command;
+};
+
+void WriteCommandLogHeader(std::ostream& stream);
+void WriteCommand(std::ostream& stream, uint64_t step, const SimulationCommand& command, const CommandAttachment& attachment);
+// attachments holds one entry per command, empty for those without.
+bool ReadCommandLog(std::istream& stream, std::vector<RecordedCommand>& commands, std::vector<CommandAttachment>& attachments);
+
+// Bounded multi-producer single-consumer queue (Vyukov). Producers claim a cell with one CAS on the tail
+// and publish it through the cell's sequence number; the consumer never blocks them. Push fails when full.
+template <typename T, size_t Capacity>
+class MpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpscQueue()
+    {
+        for (size_t i = 0; i < Capacity; i++) {
+            m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool Push(const T& value)
+    {
+        size_t position = m_Tail.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell = m_Cells[position & (Capacity - 1)];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0)
+            {
+                if (m_Tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = m_Tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool Pop(T& value)
+    {
+        Cell& cell = m_Cells[m_Head & (Capacity - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != m_Head + 1)
+            return false;
+        value = cell.value;
+        cell.sequence.store(m_Head + Capacity, std::memory_order_release);
+        m_Head++;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    Cell m_Cells[Capacity];
+    alignas(64) std::atomic<size_t> m_Tail{ 0 };
+    alignas(64) size_t m_Head = 0;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef SIMULATION_STATE_H
+#define SIMULATION_STATE_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "BodyStorage.h"
+
+namespace SpaceSim {
+
+// Everything that evolves while the simulation runs: bodies, gas and the clocks and random streams,
+// so restoring it continues the run exactly. Settings, solvers and the scene's external field are not part of it.
+struct SimulationState {
+    uint64_t stepCount = 0;
+    double simulationTime = 0.0;
+    float renderTime = 0.0f;
+    uint64_t seed = 0;
+    uint64_t nextStream = 0;
+    BodyHandle sunHandle = InvalidBodyHandle;
+    uint64_t handleCapacity = 0;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> velocities;
+    std::vector<float> masses;
+    std::vector<float> radii;
+    std::vector<glm::vec4> colors;
+    std::vector<BodyHandle> handles;
+
+    std::vector<glm::vec3> gasPositions;
+    std::vector<glm::vec3> gasVelocities;
+    std::vector<float> gasMasses;
+    std::vector<float> gasInternalEnergies;
+    std::vector<float> gasSmoothingLengths;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,512 @@
+#include "SimulationThread.h"
+#include <chrono>
+#include <iostream>
+
+namespace SpaceSim {
+
+// Publishing copies every body, so at high warps only every few milliseconds' worth of steps is published.
+constexpr double MinPublishInterval = 1.0 / 240.0;
+// The panels are read by a person, so the status does not need to keep up with the steps.
+constexpr double MinStatusInterval = 1.0 / 60.0;
+
+SimulationThread::SimulationThread(GravitySimulation& simulation)
+    : m_Simulation(simulation)
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+    Stop();
+}
+
+void SimulationThread::Start()
+{
+    if (m_Thread.joinable())
+        return;
+
+    m_Simulation.PublishRenderState();
+    PublishStatus();
+    m_Stop.store(false);
+    m_Thread = std::thread(&SimulationThread::Run, this);
+}
+
+void SimulationThread::Stop()
+{
+    if (!m_Thread.joinable())
+        return;
+
+    m_Stop.store(true);
+    m_Thread.join();
+}
+
+bool SimulationThread::Post(const SimulationCommand& command)
+{
+    if (m_Commands.Push(command))
+        return true;
+
+    std::cerr << "Simulation command queue is full, dropping command" << std::endl;
+    return false;
+}
+
+bool SimulationThread::Post(AttachedCommand command)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_AttachmentMutex);
+        command.command.count = m_NextAttachment++;
+        m_Attachments.emplace(command.command.count, std::move(command.attachment));
+    }
+    if (Post(command.command))
+        return true;
+
+    std::lock_guard<std::mutex> lock(m_AttachmentMutex);
+    m_Attachments.erase(command.command.count);
+    return false;
+}
+
+bool SimulationThread::StartRecording(const std::string& path)
+{
+    StopRecording();
+    m_Recording.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_Recording)
+    {
+        std::cerr << "Failed to open command log: " << path << std::endl;
+        return false;
+    }
+
+    WriteCommandLogHeader(m_Recording);
+    m_RecordingStart = m_StepsTaken;
+    return true;
+}
+
+void SimulationThread::StopRecording()
+{
+    if (m_Recording.is_open())
+        m_Recording.close();
+}
+
+bool SimulationThread::StartReplay(const std::string& path)
+{
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream || !ReadCommandLog(stream, m_Replay, m_ReplayAttachments))
+    {
+        std::cerr << "Failed to read command log: " << path << std::endl;
+        m_Replay.clear();
+        m_ReplayAttachments.clear();
+        return false;
+    }
+
+    m_ReplayIndex = 0;
+    m_ReplayStart = m_StepsTaken;
+    return true;
+}
+
+void SimulationThread::SetAutosave(uint64_t interval, const std::string& path)
+{
+    m_AutosaveInterval = interval;
+    m_AutosavePath = path;
+}
+
+std::unique_lock<std::mutex> SimulationThread::Lock()
+{
+    m_LockRequests.fetch_add(1, std::memory_order_acq_rel);
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_LockRequests.fetch_sub(1, std::memory_order_acq_rel);
+    return lock;
+}
+
+void SimulationThread::WaitForLockRequests() const
+{
+    while (m_LockRequests.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+}
+
+bool SimulationThread::ApplyCommands()
+{
+    bool applied = false;
+    SimulationCommand command;
+    CommandAttachment attachment;
+    while (m_Commands.Pop(command)) {
+        attachment.clear();
+        if (HasAttachment(command.type))
+        {
+            std::lock_guard<std::mutex> lock(m_AttachmentMutex);
+            auto found = m_Attachments.find(command.count);
+            if (found != m_Attachments.end())
+            {
+                attachment = std::move(found->second);
+                m_Attachments.erase(found);
+            }
+        }
+        Apply(command, attachment);
+        applied = true;
+    }
+    return applied;
+}
+
+bool SimulationThread::ApplyReplay()
+{
+    bool applied = false;
+    while (m_ReplayIndex < m_Replay.size() && m_Replay[m_ReplayIndex].step <= m_StepsTaken - m_ReplayStart) {
+        const size_t index = m_ReplayIndex++;
+        // Thread controls are never recorded; one in a damaged log could replace the replay under us.
+        if (!IsRecorded(m_Replay[index].command.type))
+            continue;
+        Apply(m_Replay[index].command, m_ReplayAttachments[index]);
+        applied = true;
+    }
+    return applied;
+}
+
+void SimulationThread::ResetSchedulerIfRequested()
+{
+    if (!m_ResetScheduler)
+        return;
+    m_Scheduler.Reset();
+    m_ResetScheduler = false;
+}
+
+void SimulationThread::PublishStatus()
+{
+    SimulationStatus& status = m_Status.GetWriteBuffer();
+    status.bodyCount = m_Simulation.GetBodyCount();
+    status.collisionsEnabled = m_Simulation.GetCollisionsEnabled();
+    status.seed = m_Simulation.GetSeed();
+    status.reductionMode = m_Simulation.GetReductionMode();
+    status.recording = IsRecording();
+    status.replaying = IsReplaying();
+
+    status.schedulerSettings = m_Scheduler.GetSettings();
+    status.schedulerStats = m_Scheduler.GetStats();
+    status.solverSettings = m_Simulation.GetSolverSettings();
+    status.solverStats = m_Simulation.GetSolverStats();
+    status.autotuneSettings = m_Simulation.GetAutotuneSettings();
+    status.hasAutotuneResult = m_Simulation.GetAutotuner().HasResult();
+    if (status.hasAutotuneResult)
+        status.autotuneResult = m_Simulation.GetAutotuner().GetResult();
+
+    status.diagnosticsSerial = m_DiagnosticsSerial;
+    status.diagnostics = m_Simulation.GetDiagnostics();
+
+    status.externalPotentials = m_Simulation.GetExternalPotentials();
+    status.encounterSettings = m_Simulation.GetEncounterSettings();
+    status.encounterStats = m_Simulation.GetEncounters().GetStats();
+    status.encountersWritten = m_Simulation.GetEncounters().GetWrittenCount();
+
+    const OrbitTracker& orbits = m_Simulation.GetOrbits();
+    status.orbitSettings = orbits.GetSettings();
+    status.orbitStats = orbits.GetStats();
+    if (status.orbitElementsSnapshot != status.orbitStats.snapshots)
+    {
+        const OrbitalElementSet& elements = orbits.GetElements();
+        status.eccentricity = elements.eccentricity;
+        status.semiMajorAxis = elements.semiMajorAxis;
+        status.orbitElementsSnapshot = status.orbitStats.snapshots;
+    }
+
+    status.historySettings = m_Simulation.GetHistorySettings();
+    status.gasParticleCount = m_Simulation.GetGas().GetParticleCount();
+    status.gasSettings = m_Simulation.GetGas().GetSettings();
+    status.gasStats = m_Simulation.GetGas().GetStats();
+    status.checkpointMode = m_Checkpointer.GetMode();
+    status.checkpointStats = m_Checkpointer.GetStats();
+    status.trajectoryOpen = m_Trajectory.IsOpen();
+    status.trajectoryStats = m_Trajectory.GetStats();
+    m_Status.Publish();
+}
+
+void SimulationThread::Apply(const SimulationCommand& command, const CommandAttachment& attachment)
+{
+    if (m_Recording.is_open() && IsRecorded(command.type))
+        WriteCommand(m_Recording, m_StepsTaken - m_RecordingStart, command, attachment);
+
+    switch (command.type)
+    {
+    case CommandType::Reset:
+        m_Simulation.Reset();
+        m_ResetScheduler = true;
+        break;
+    case CommandType::LoadScene:
+        if (command.scene > static_cast<uint32_t>(Scene::ClusterInGalaxy))
+        {
+            std::cerr << "Ignoring unknown scene " << command.scene << std::endl;
+            break;
+        }
+        m_Simulation.LoadScene(static_cast<Scene>(command.scene), command.count, static_cast<float>(command.value));
+        m_ResetScheduler = true;
+        break;
+    case CommandType::AddRandomPlanet: m_Simulation.AddRandomPlanet(); break;
+    case CommandType::SpawnRandomPlanets: m_Simulation.SpawnRandomPlanets(command.count); break;
+    case CommandType::AddPlanet: m_Simulation.AddPlanetWithParams(command.distance, command.angle, command.radius, command.color); break;
+    case CommandType::RemoveBody: m_Simulation.RemoveBody(command.handle); break;
+    case CommandType::AddGasDisk: m_Simulation.AddGasDisk(command.count, command.distance, command.radius, command.mass); break;
+    case CommandType::ClearGas: m_Simulation.ClearGas(); break;
+    case CommandType::SetParameter:
+        switch (command.parameter)
+        {
+        case SimulationParameter::GravityStrength: m_GravityStrength = static_cast<float>(command.value); break;
+        case SimulationParameter::CollisionsEnabled: m_Simulation.SetCollisionsEnabled(command.count != 0); break;
+        case SimulationParameter::Seed: m_Simulation.SetSeed(command.count); break;
+        case SimulationParameter::ReductionMode:
+            if (command.count <= static_cast<uint64_t>(ReductionMode::Deterministic))
+                m_Simulation.SetReductionMode(static_cast<ReductionMode>(command.count));
+            else
+                std::cerr << "Ignoring unknown reduction mode " << command.count << std::endl;
+            break;
+        case SimulationParameter::ReorderInterval: m_Simulation.SetReorderInterval(static_cast<uint32_t>(command.count)); break;
+        }
+        break;
+    case CommandType::RestoreHistory:
+        if (m_Simulation.RestoreHistory(command.count))
+            m_ResetScheduler = true;
+        else
+            std::cerr << "No history snapshot at step " << command.count << std::endl;
+        break;
+    case CommandType::LoadCheckpoint:
+    {
+        std::string path;
+        if (ReadAttachment(attachment, path) && m_Simulation.LoadCheckpoint(path))
+            m_ResetScheduler = true;
+        break;
+    }
+    case CommandType::RequestAutotune: m_Simulation.RequestAutotune(); break;
+    case CommandType::SetSolverSettings:
+    case CommandType::SetAutotuneSettings:
+    case CommandType::SetExternalPotentials:
+    case CommandType::SetEncounterSettings:
+    case CommandType::SetOrbitSettings:
+    case CommandType::SetHistorySettings:
+    case CommandType::SetGasSettings:
+    case CommandType::SetSchedulerSettings:
+        ApplySettings(command, attachment);
+        break;
+    default:
+        ApplyControl(command, attachment);
+        break;
+    }
+}
+
+void SimulationThread::ApplySettings(const SimulationCommand& command, const CommandAttachment& attachment)
+{
+    bool read = false;
+    switch (command.type)
+    {
+    case CommandType::SetSolverSettings:
+    {
+        SolverSettings settings;
+        read = ReadAttachment(attachment, settings);
+        if (read)
+            m_Simulation.SetSolverSettings(settings);
+        break;
+    }
+    case CommandType::SetAutotuneSettings:
+    {
+        AutotuneSettings settings;
+        read = ReadAttachment(attachment, settings);
+        if (read)
+            m_Simulation.SetAutotuneSettings(settings);
+        break;
+    }
+    case CommandType::SetExternalPotentials:
+    {
+        std::vector<PotentialComponent> components;
+        read = ReadAttachment(attachment, components);
+        if (read)
+            m_Simulation.SetExternalPotentials(components);
+        break;
+    }
+    case CommandType::SetEncounterSettings:
+    {
+        EncounterSettings settings;
+        read = ReadAttachment(attachment, settings);
+        if (read)
+            m_Simulation.SetEncounterSettings(settings);
+        break;
+    }
+    case CommandType::SetOrbitSettings:
+    {
+        OrbitTrackerSettings settings;
+        read = ReadAttachment(attachment, settings);
+        if (read)
+            m_Simulation.SetOrbitSettings(settings);
+        break;
+    }
+    case CommandType::SetHistorySettings:
+    {
+        HistorySettings settings;
+        read = ReadAttachment(attachment, settings);
+        if (read)
+            m_Simulation.SetHistorySettings(settings);
+        break;
+    }
+    case CommandType::SetGasSettings:
+    {
+        SPHSettings settings;
+        read = ReadAttachment(attachment, settings);
+        if (read)
+            m_Simulation.GetGas().SetSettings(settings);
+        break;
+    }
+    case CommandType::SetSchedulerSettings:
+    {
+        SchedulerSettings settings;
+        read = ReadAttachment(attachment, settings);
+        if (read)
+            m_Scheduler.SetSettings(settings);
+        break;
+    }
+    default:
+        break;
+    }
+
+    if (!read)
+        std::cerr << "Ignoring settings command " << static_cast<uint32_t>(command.type) << " with a malformed or invalid attachment" << std::endl;
+}
+
+void SimulationThread::ApplyControl(const SimulationCommand& command, const CommandAttachment& attachment)
+{
+    std::string path;
+    switch (command.type)
+    {
+    case CommandType::SaveCheckpoint:
+        // Written in the background like an autosave, so neither the UI nor the steps wait for the disk.
+        if (ReadAttachment(attachment, path) && !m_Checkpointer.Start(m_Simulation, path))
+            std::cerr << "A checkpoint is still being written, not saving " << path << std::endl;
+        break;
+    case CommandType::SetAutosave:
+    {
+        uint64_t interval = 0;
+        if (ReadAttachment(attachment, interval, path))
+            SetAutosave(interval, path);
+        break;
+    }
+    case CommandType::SetCheckpointMode:
+        if (command.count <= static_cast<uint64_t>(CheckpointMode::Thread))
+            m_Checkpointer.SetMode(static_cast<CheckpointMode>(command.count));
+        else
+            std::cerr << "Ignoring unknown checkpoint mode " << command.count << std::endl;
+        break;
+    case CommandType::OpenTrajectory:
+    {
+        TrajectorySettings settings;
+        if (ReadAttachment(attachment, path, settings))
+            m_Trajectory.Open(path, settings);
+        else
+            std::cerr << "Ignoring trajectory command with invalid settings" << std::endl;
+        break;
+    }
+    case CommandType::CloseTrajectory: m_Trajectory.Close(); break;
+    case CommandType::StartRecording:
+        if (ReadAttachment(attachment, path))
+            StartRecording(path);
+        break;
+    case CommandType::StopRecording: StopRecording(); break;
+    case CommandType::StartReplay:
+        if (ReadAttachment(attachment, path))
+            StartReplay(path);
+        break;
+    case CommandType::StopReplay:
+        m_Replay.clear();
+        m_ReplayAttachments.clear();
+        m_ReplayIndex = 0;
+        break;
+    default:
+        break;
+    }
+}
+
+void SimulationThread::Run()
+{
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point lastTime = Clock::now();
+    Clock::time_point lastPublish = lastTime;
+    Clock::time_point lastStatus = lastTime;
+
+    while (!m_Stop.load())
+    {
+        const Clock::time_point now = Clock::now();
+        const float realDelta = std::chrono::duration<float>(now - lastTime).count();
+        lastTime = now;
+
+        WaitForLockRequests();
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Checkpointer.Poll();
+
+        const bool replayed = ApplyReplay();
+        const bool applied = ApplyCommands() || replayed;
+        if (applied || m_RenderStateRequested.exchange(false, std::memory_order_relaxed))
+        {
+            ResetSchedulerIfRequested();
+            m_Simulation.PublishRenderState();
+            lastPublish = Clock::now();
+        }
+
+        uint32_t substeps = 0;
+        bool unpublished = false;
+        double stepInterval = 0.0;
+        if (!IsPaused())
+        {
+            m_Scheduler.Advance(realDelta, m_Simulation.GetMaxStableTimestep(), [&](float step) {
+                // Let a waiting UI in between steps; mutexes are not fair, so it would otherwise starve.
+                if (m_LockRequests.load(std::memory_order_acquire) > 0)
+                {
+                    lock.unlock();
+                    WaitForLockRequests();
+                    lock.lock();
+                }
+
+                ApplyReplay();
+                m_Simulation.Update(step, m_GravityStrength);
+                m_StepsTaken++;
+                substeps++;
+                if (m_AutosaveInterval > 0 && m_StepsTaken % m_AutosaveInterval == 0)
+                    m_Checkpointer.Start(m_Simulation, m_AutosavePath);
+                if (m_Trajectory.IsOpen())
+                    m_Trajectory.Record(m_Simulation);
+
+                stepInterval = step / m_Scheduler.GetSettings().warp;
+                const Clock::time_point stepEnd = Clock::now();
+                unpublished = std::chrono::duration<double>(stepEnd - lastPublish).count() < MinPublishInterval;
+                if (!unpublished)
+                {
+                    m_Simulation.PublishRenderState(stepInterval);
+                    lastPublish = stepEnd;
+                }
+            });
+            // A replayed command that replaced the state restarts the scheduler now that it is idle.
+            ResetSchedulerIfRequested();
+        }
+
+        if (unpublished)
+        {
+            m_Simulation.PublishRenderState(stepInterval);
+            lastPublish = Clock::now();
+        }
+
+        // Diagnostics are only recomputed when the state may have changed, or tracking was just turned on.
+        if (!m_TrackEnergy.load(std::memory_order_relaxed))
+        {
+            m_DiagnosticsCurrent = false;
+        }
+        else if (substeps > 0 || applied || !m_DiagnosticsCurrent)
+        {
+            m_Simulation.ComputeDiagnostics(m_GravityStrength);
+            m_DiagnosticsSerial++;
+            m_DiagnosticsCurrent = true;
+        }
+
+        const Clock::time_point end = Clock::now();
+        if (applied || std::chrono::duration<double>(end - lastStatus).count() >= MinStatusInterval)
+        {
+            PublishStatus();
+            lastStatus = end;
+        }
+
+        lock.unlock();
+
+        if (substeps == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+}
\ No newline at end of file
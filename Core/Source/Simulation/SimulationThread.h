@@ -0,0 +1,161 @@
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "AsyncCheckpoint.h"
+#include "GravitySimulation.h"
+#include "SimulationCommands.h"
+#include "StepScheduler.h"
+#include "Trajectory.h"
+#include "TripleBuffer.h"
+
+namespace SpaceSim {
+
+// Everything the UI shows about the simulation, copied between steps and handed over like the render
+// states, so drawing the panels never waits for a step.
+struct SimulationStatus {
+    size_t bodyCount = 0;
+    bool collisionsEnabled = true;
+    uint64_t seed = 0;
+    ReductionMode reductionMode = ReductionMode::Fast;
+    bool recording = false;
+    bool replaying = false;
+
+    SchedulerSettings schedulerSettings;
+    SchedulerStats schedulerStats;
+    SolverSettings solverSettings;
+    SolverStats solverStats;
+    AutotuneSettings autotuneSettings;
+    bool hasAutotuneResult = false;
+    AutotuneResult autotuneResult;
+
+    // Counts diagnostics computations, so a result can be told apart from one taken before a change.
+    uint64_t diagnosticsSerial = 0;
+    EnergyDiagnostics diagnostics;
+
+    std::vector<PotentialComponent> externalPotentials;
+    EncounterSettings encounterSettings;
+    EncounterStats encounterStats;
+    uint64_t encountersWritten = 0;
+
+    OrbitTrackerSettings orbitSettings;
+    OrbitTrackerStats orbitStats;
+    // Elements of orbit snapshot orbitElementsSnapshot; only copied when a new snapshot was taken.
+    uint64_t orbitElementsSnapshot = 0;
+    std::vector<float> eccentricity;
+    std::vector<float> semiMajorAxis;
+
+    HistorySettings historySettings;
+    size_t gasParticleCount = 0;
+    SPHSettings gasSettings;
+    SPHStats gasStats;
+    CheckpointMode checkpointMode = CheckpointMode::Fork;
+    AsyncCheckpointStats checkpointStats;
+    bool trajectoryOpen = false;
+    TrajectoryStats trajectoryStats;
+};
+
+// Steps a GravitySimulation on its own thread, paced by a StepScheduler against real time, and publishes
+// render states as steps complete. Changes to the simulation are posted to a lock-free queue from any
+// thread and applied together at the next step boundary, so the main thread never runs physics and the
+// buffer swap never holds up a step. Applied commands can be recorded and replayed at the same steps.
+class SimulationThread {
+public:
+    explicit SimulationThread(GravitySimulation& simulation);
+    ~SimulationThread();
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    void Start();
+    void Stop();
+
+    // Returns false when the queue is full and the command was dropped.
+    bool Post(const SimulationCommand& command);
+    bool Post(AttachedCommand command);
+
+    // Waits for the step in progress and holds the simulation until the lock is released, for the rare UI
+    // action that must touch the simulation directly. Rendering and the panels do not need it.
+    std::unique_lock<std::mutex> Lock();
+
+    // The newest status, published after commands are applied and at most every few frames while stepping.
+    // UI thread only; the reference stays valid until the next call.
+    const SimulationStatus& AcquireStatus() { return m_Status.Acquire(); }
+    // Publishes the simulated bodies again at the next step boundary, e.g. after a playback replaced them.
+    void RequestRenderState() { m_RenderStateRequested.store(true, std::memory_order_relaxed); }
+
+    // Only valid under Lock().
+    StepScheduler& GetScheduler() { return m_Scheduler; }
+    bool IsRecording() const { return m_Recording.is_open(); }
+    bool IsReplaying() const { return m_ReplayIndex < m_Replay.size(); }
+    uint64_t GetAutosaveInterval() const { return m_AutosaveInterval; }
+    AsyncCheckpointer& GetCheckpointer() { return m_Checkpointer; }
+    // Records a frame after every step while open. Only valid under Lock().
+    TrajectoryRecorder& GetTrajectoryRecorder() { return m_Trajectory; }
+
+    bool IsPaused() const { return m_Paused.load(std::memory_order_relaxed); }
+    void SetPaused(bool paused) { m_Paused.store(paused, std::memory_order_relaxed); }
+
+    // Recomputes the energy diagnostics after every batch of steps and every applied command.
+    void SetTrackEnergy(bool track) { m_TrackEnergy.store(track, std::memory_order_relaxed); }
+
+private:
+    void Run();
+    bool ApplyCommands();
+    bool ApplyReplay();
+    void Apply(const SimulationCommand& command, const CommandAttachment& attachment);
+    void ApplySettings(const SimulationCommand& command, const CommandAttachment& attachment);
+    void ApplyControl(const SimulationCommand& command, const CommandAttachment& attachment);
+    void ResetSchedulerIfRequested();
+    void PublishStatus();
+    void WaitForLockRequests() const;
+
+    bool StartRecording(const std::string& path);
+    void StopRecording();
+    // Applies a recorded command stream from the current state, each command after as many steps as
+    // when it was recorded. Replaying from the state the recording started in reproduces the run.
+    bool StartReplay(const std::string& path);
+    // Starts an asynchronous checkpoint to path every interval steps; 0 turns it off.
+    void SetAutosave(uint64_t interval, const std::string& path);
+
+    GravitySimulation& m_Simulation;
+    StepScheduler m_Scheduler;
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    std::atomic<int> m_LockRequests{ 0 };
+    std::atomic<bool> m_Stop{ false };
+    std::atomic<bool> m_Paused{ false };
+    float m_GravityStrength = 1.0f;
+    std::atomic<bool> m_TrackEnergy{ false };
+    bool m_DiagnosticsCurrent = false;
+    uint64_t m_DiagnosticsSerial = 0;
+    std::atomic<bool> m_RenderStateRequested{ false };
+    TripleBuffer<SimulationStatus> m_Status;
+
+    MpscQueue<SimulationCommand, 1024> m_Commands;
+    std::mutex m_AttachmentMutex;
+    std::unordered_map<uint64_t, CommandAttachment> m_Attachments;
+    uint64_t m_NextAttachment = 0;
+    // Commands that replace the state restart the scheduler, but only once Advance() has returned.
+    bool m_ResetScheduler = false;
+    uint64_t m_StepsTaken = 0;
+    uint64_t m_RecordingStart = 0;
+    std::ofstream m_Recording;
+    std::vector<RecordedCommand> m_Replay;
+    std::vector<CommandAttachment> m_ReplayAttachments;
+    size_t m_ReplayIndex = 0;
+    uint64_t m_ReplayStart = 0;
+    AsyncCheckpointer m_Checkpointer;
+    uint64_t m_AutosaveInterval = 0;
+    std::string m_AutosavePath;
+    TrajectoryRecorder m_Trajectory;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,411 @@
+#include "SpatialIndex.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace SpaceSim {
+
+// Rebuild once a refit has grown the summed node extents this far past the last build.
+constexpr float RebuildThreshold = 1.5f;
+// Depth-first traversal pushes at most seven siblings per level below the root.
+constexpr uint32_t TraversalStackSize = 8 * (MortonBitsPerAxis + 2);
+
+struct TraversalEntry {
+    uint32_t node;
+    float distance;
+};
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static float BoxDistanceSquared(const glm::vec3& point, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    glm::vec3 outside = glm::max(glm::max(boundsMin - point, point - boundsMax), glm::vec3(0.0f));
+    return glm::dot(outside, outside);
+}
+
+// Slab test. Returns the entry distance, or infinity when the ray misses the box within maxDistance.
+static float IntersectBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boundsMin,
+                          const glm::vec3& boundsMax, float maxDistance)
+{
+    glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+    glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+    glm::vec3 entries = glm::min(t0, t1);
+    glm::vec3 exits = glm::max(t0, t1);
+    float enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+    float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, maxDistance));
+    return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+}
+
+static bool CompareHits(const QueryHit& a, const QueryHit& b)
+{
+    return a.distance < b.distance;
+}
+
+// Farthest first. An insertion sort over at most eight children; std::sort on the fixed array trips
+// GCC's -Warray-bounds at -O2.
+static void SortEntries(TraversalEntry* entries, uint32_t count)
+{
+    for (uint32_t i = 1; i < count; i++) {
+        const TraversalEntry entry = entries[i];
+        uint32_t j = i;
+        for (; j > 0 && entries[j - 1].distance < entry.distance; j--) {
+            entries[j] = entries[j - 1];
+        }
+        entries[j] = entry;
+    }
+}
+
+void SpatialIndex::OnBodiesPermuted(const std::vector<uint32_t>& order)
+{
+    // The tree keeps the same bodies in the same places; only their indices change.
+    if (m_Octree.IsBuilt())
+        m_Octree.RemapBodies(order);
+}
+
+void SpatialIndex::Update(const BodyStorage& bodies)
+{
+    if (!IsStale() && m_Points.size() == bodies.Size() && m_Octree.GetBodyCount() == bodies.Size())
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    if (m_Invalid || !m_Octree.IsBuilt() || m_Octree.GetBodyCount() != bodies.Size())
+    {
+        Rebuild(bodies);
+    }
+    else
+    {
+        m_Octree.Refit(bodies.GetPositions(), bodies.GetMasses());
+        m_Stats.refitCount++;
+        if (m_Octree.GetQualityRatio() > RebuildThreshold)
+            Rebuild(bodies);
+    }
+
+    Gather(bodies);
+    m_Moved = false;
+    m_Invalid = false;
+    m_Stats.updateMs = ElapsedMs(start);
+}
+
+void SpatialIndex::Rebuild(const BodyStorage& bodies)
+{
+    m_Sort.Update(bodies.GetPositions());
+    m_Octree.Build(m_Sort, LeafSize);
+    m_Octree.Refit(bodies.GetPositions(), bodies.GetMasses());
+    m_Stats.rebuildCount++;
+}
+
+void SpatialIndex::Gather(const BodyStorage& bodies)
+{
+    const std::vector<glm::vec3>& positions = bodies.GetPositions();
+    const std::vector<float>& radii = bodies.GetRadii();
+    const std::vector<uint32_t>& order = m_Octree.GetBodyOrder();
+    const std::vector<OctreeNode>& nodes = m_Octree.GetNodes();
+    const std::vector<uint32_t>& leaves = m_Octree.GetLeaves();
+
+    m_Points.resize(order.size());
+    m_Radii.resize(order.size());
+    ThreadPool::Get().ParallelFor(order.size(), 8192, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            m_Points[k] = positions[order[k]];
+            m_Radii[k] = radii[order[k]];
+        }
+    });
+
+    m_NodeReach.assign(nodes.size(), 0.0f);
+    ThreadPool::Get().ParallelFor(leaves.size(), 1024, [&](size_t begin, size_t end) {
+        for (size_t l = begin; l < end; l++) {
+            const OctreeNode& leaf = nodes[leaves[l]];
+            float reach = 0.0f;
+            for (uint32_t k = leaf.firstBody; k < leaf.firstBody + leaf.bodyCount; k++) {
+                reach = std::max(reach, m_Radii[k]);
+            }
+            m_NodeReach[leaves[l]] = reach;
+        }
+    });
+
+    // Children always follow their parent, so a reverse sweep sees every child first.
+    for (size_t n = nodes.size(); n-- > 0;) {
+        const OctreeNode& node = nodes[n];
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+            m_NodeReach[n] = std::max(m_NodeReach[n], m_NodeReach[c]);
+        }
+    }
+}
+
+uint32_t SpatialIndex::Nearest(const glm::vec3& point, uint32_t k, QueryHit* hits) const
+{
+    const std::vector<OctreeNode>& nodes = m_Octree.GetNodes();
+    const std::vector<uint32_t>& order = m_Octree.GetBodyOrder();
+    if (nodes.empty() || k == 0)
+        return 0;
+
+    // Max-heap on squared distance, so hits[0] is the worst candidate kept.
+    uint32_t count = 0;
+    TraversalEntry stack[TraversalStackSize];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = { 0, BoxDistanceSquared(point, nodes[0].boundsMin, nodes[0].boundsMax) };
+
+    while (stackSize > 0) {
+        const TraversalEntry entry = stack[--stackSize];
+        if (count == k && entry.distance >= hits[0].distance)
+            continue;
+
+        const OctreeNode& node = nodes[entry.node];
+        if (node.childCount == 0)
+        {
+            for (uint32_t b = node.firstBody; b < node.firstBody + node.bodyCount; b++) {
+                const glm::vec3 delta = m_Points[b] - point;
+                const float distanceSquared = glm::dot(delta, delta);
+                if (count < k)
+                {
+                    hits[count++] = { order[b], distanceSquared };
+                    std::push_heap(hits, hits + count, CompareHits);
+                }
+                else if (distanceSquared < hits[0].distance)
+                {
+                    std::pop_heap(hits, hits + count, CompareHits);
+                    hits[count - 1] = { order[b], distanceSquared };
+                    std::push_heap(hits, hits + count, CompareHits);
+                }
+            }
+            continue;
+        }
+
+        // Farthest child pushed first so the nearest is searched first and tightens the bound soonest.
+        TraversalEntry children[8];
+        uint32_t childCount = 0;
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+            const float distance = BoxDistanceSquared(point, nodes[c].boundsMin, nodes[c].boundsMax);
+            if (count < k || distance < hits[0].distance)
+                children[childCount++] = { c, distance };
+        }
+        SortEntries(children, childCount);
+        for (uint32_t c = 0; c < childCount; c++) {
+            stack[stackSize++] = children[c];
+        }
+    }
+
+    std::sort_heap(hits, hits + count, CompareHits);
+    for (uint32_t i = 0; i < count; i++) {
+        hits[i].distance = std::sqrt(hits[i].distance);
+    }
+    return count;
+}
+
+template<typename Visit>
+void SpatialIndex::VisitInRadius(const glm::vec3& point, float radius, Visit&& visit) const
+{
+    const std::vector<OctreeNode>& nodes = m_Octree.GetNodes();
+    const std::vector<uint32_t>& order = m_Octree.GetBodyOrder();
+    if (nodes.empty() || radius < 0.0f)
+        return;
+
+    const float radiusSquared = radius * radius;
+    uint32_t stack[TraversalStackSize];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const OctreeNode& node = nodes[stack[--stackSize]];
+        if (BoxDistanceSquared(point, node.boundsMin, node.boundsMax) > radiusSquared)
+            continue;
+
+        if (node.childCount == 0)
+        {
+            for (uint32_t b = node.firstBody; b < node.firstBody + node.bodyCount; b++) {
+                const glm::vec3 delta = m_Points[b] - point;
+                const float distanceSquared = glm::dot(delta, delta);
+                if (distanceSquared <= radiusSquared)
+                    visit(QueryHit{ order[b], std::sqrt(distanceSquared) });
+            }
+            continue;
+        }
+
+        // Pushed in reverse so bodies come out in tree order.
+        for (uint32_t c = node.firstChild + node.childCount; c-- > node.firstChild;) {
+            stack[stackSize++] = c;
+        }
+    }
+}
+
+QueryHit SpatialIndex::CastRay(const QueryRay& ray) const
+{
+    QueryHit best;
+    const std::vector<OctreeNode>& nodes = m_Octree.GetNodes();
+    const float length = glm::length(ray.direction);
+    if (nodes.empty() || !(length > 0.0f))
+        return best;
+
+    const glm::vec3 direction = ray.direction / length;
+    const glm::vec3 inverseDirection = 1.0f / direction;
+    best.distance = ray.maxDistance;
+
+    auto enterNode = [&](uint32_t n) {
+        const glm::vec3 reach(m_NodeReach[n]);
+        return IntersectBox(ray.origin, inverseDirection, nodes[n].boundsMin - reach, nodes[n].boundsMax + reach, best.distance);
+    };
+
+    TraversalEntry stack[TraversalStackSize];
+    uint32_t stackSize = 0;
+    const float rootEnter = enterNode(0);
+    if (rootEnter != std::numeric_limits<float>::infinity())
+        stack[stackSize++] = { 0, rootEnter };
+
+    while (stackSize > 0) {
+        const TraversalEntry entry = stack[--stackSize];
+        if (entry.distance > best.distance)
+            continue;
+
+        const OctreeNode& node = nodes[entry.node];
+        if (node.childCount == 0)
+        {
+            for (uint32_t b = node.firstBody; b < node.firstBody + node.bodyCount; b++) {
+                const glm::vec3 offset = ray.origin - m_Points[b];
+                const float c = glm::dot(offset, offset) - m_Radii[b] * m_Radii[b];
+                const float halfB = glm::dot(offset, direction);
+                float distance = 0.0f;
+                if (c > 0.0f)
+                {
+                    const float discriminant = halfB * halfB - c;
+                    if (halfB > 0.0f || discriminant < 0.0f)
+                        continue;
+                    distance = -halfB - std::sqrt(discriminant);
+                }
+                if (distance <= best.distance)
+                    best = { m_Octree.GetBodyOrder()[b], distance };
+            }
+            continue;
+        }
+
+        TraversalEntry children[8];
+        uint32_t childCount = 0;
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+            const float enter = enterNode(c);
+            if (enter != std::numeric_limits<float>::infinity())
+                children[childCount++] = { c, enter };
+        }
+        SortEntries(children, childCount);
+        for (uint32_t c = 0; c < childCount; c++) {
+            stack[stackSize++] = children[c];
+        }
+    }
+
+    if (best.body == InvalidBodyIndex)
+        best.distance = std::numeric_limits<float>::infinity();
+    return best;
+}
+
+void SpatialIndex::FindNearest(const glm::vec3& point, uint32_t k, std::vector<QueryHit>& hits) const
+{
+    hits.resize(std::min<size_t>(k, m_Points.size()));
+    hits.resize(Nearest(point, static_cast<uint32_t>(hits.size()), hits.data()));
+}
+
+void SpatialIndex::FindInRadius(const glm::vec3& point, float radius, std::vector<QueryHit>& hits) const
+{
+    hits.clear();
+    VisitInRadius(point, radius, [&](const QueryHit& hit) { hits.push_back(hit); });
+}
+
+void SpatialIndex::FindInBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<uint32_t>& bodies) const
+{
+    bodies.clear();
+    const std::vector<OctreeNode>& nodes = m_Octree.GetNodes();
+    const std::vector<uint32_t>& order = m_Octree.GetBodyOrder();
+    if (nodes.empty())
+        return;
+
+    uint32_t stack[TraversalStackSize];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const OctreeNode& node = nodes[stack[--stackSize]];
+        if (glm::any(glm::lessThan(node.boundsMax, boundsMin)) || glm::any(glm::greaterThan(node.boundsMin, boundsMax)))
+            continue;
+
+        const bool contained = glm::all(glm::greaterThanEqual(node.boundsMin, boundsMin)) &&
+                               glm::all(glm::lessThanEqual(node.boundsMax, boundsMax));
+        if (contained)
+        {
+            bodies.insert(bodies.end(), order.begin() + node.firstBody, order.begin() + node.firstBody + node.bodyCount);
+            continue;
+        }
+
+        if (node.childCount == 0)
+        {
+            for (uint32_t b = node.firstBody; b < node.firstBody + node.bodyCount; b++) {
+                if (glm::all(glm::greaterThanEqual(m_Points[b], boundsMin)) && glm::all(glm::lessThanEqual(m_Points[b], boundsMax)))
+                    bodies.push_back(order[b]);
+            }
+            continue;
+        }
+
+        for (uint32_t c = node.firstChild + node.childCount; c-- > node.firstChild;) {
+            stack[stackSize++] = c;
+        }
+    }
+}
+
+bool SpatialIndex::RayCast(const QueryRay& ray, QueryHit& hit) const
+{
+    hit = CastRay(ray);
+    return hit.body != InvalidBodyIndex;
+}
+
+void SpatialIndex::FindNearest(const std::vector<glm::vec3>& points, uint32_t k, std::vector<QueryHit>& hits) const
+{
+    hits.assign(points.size() * k, QueryHit());
+    const uint32_t available = static_cast<uint32_t>(std::min<size_t>(k, m_Points.size()));
+    ThreadPool::Get().ParallelFor(points.size(), 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Nearest(points[i], available, hits.data() + i * k);
+        }
+    });
+}
+
+void SpatialIndex::FindInRadius(const std::vector<glm::vec3>& points, float radius, std::vector<uint32_t>& offsets,
+                                std::vector<QueryHit>& hits) const
+{
+    const size_t count = points.size();
+    offsets.assign(count + 1, 0);
+    hits.clear();
+
+    ThreadPool& pool = ThreadPool::Get();
+    const uint32_t taskCount = static_cast<uint32_t>(std::clamp<size_t>(count / 64, 1, pool.GetThreadCount() * 4));
+    std::vector<std::vector<QueryHit>> taskHits(taskCount);
+
+    pool.Dispatch(taskCount, [&](uint32_t task) {
+        const size_t begin = count * task / taskCount;
+        const size_t end = count * (task + 1) / taskCount;
+        for (size_t i = begin; i < end; i++) {
+            const size_t before = taskHits[task].size();
+            VisitInRadius(points[i], radius, [&](const QueryHit& hit) { taskHits[task].push_back(hit); });
+            offsets[i + 1] = static_cast<uint32_t>(taskHits[task].size() - before);
+        }
+    });
+
+    for (size_t i = 0; i < count; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    hits.reserve(offsets[count]);
+    for (const auto& task : taskHits) {
+        hits.insert(hits.end(), task.begin(), task.end());
+    }
+}
+
+void SpatialIndex::RayCast(const std::vector<QueryRay>& rays, std::vector<QueryHit>& hits) const
+{
+    hits.resize(rays.size());
+    ThreadPool::Get().ParallelFor(rays.size(), 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            hits[i] = CastRay(rays[i]);
+        }
+    });
+}
+
+}
\ No newline at end of file
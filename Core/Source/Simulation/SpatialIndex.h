@@ -0,0 +1,91 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <glm/glm.hpp>
+#include "BodyStorage.h"
+#include "Octree.h"
+#include "SpatialSort.h"
+
+namespace SpaceSim {
+
+// distance is from the query point to the body centre, or along the ray to the body's surface.
+struct QueryHit {
+    uint32_t body = InvalidBodyIndex;
+    float distance = std::numeric_limits<float>::infinity();
+};
+
+struct QueryRay {
+    glm::vec3 origin = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+    float maxDistance = std::numeric_limits<float>::infinity();
+};
+
+struct SpatialIndexStats {
+    uint64_t rebuildCount = 0;
+    uint64_t refitCount = 0;
+    double updateMs = 0.0;
+};
+
+// Octree over the bodies for neighbour, range and ray queries. Body positions and radii are copied in tree
+// order so queries read leaves contiguously. Owners mark the index stale with MarkMoved() or Invalidate()
+// and Update() brings it up to date only when it is next queried: a refit keeps the body assignment, a
+// rebuild re-sorts. Queries are const and safe to run concurrently once the index is up to date.
+class SpatialIndex {
+public:
+    static constexpr uint32_t LeafSize = 8;
+
+    // Positions, masses or radii changed.
+    void MarkMoved() { m_Moved = true; }
+    // Bodies were added, removed or replaced.
+    void Invalidate() { m_Invalid = true; }
+    void OnBodiesPermuted(const std::vector<uint32_t>& order);
+    void Update(const BodyStorage& bodies);
+    bool IsStale() const { return m_Moved || m_Invalid; }
+
+    size_t GetBodyCount() const { return m_Points.size(); }
+    const Octree& GetOctree() const { return m_Octree; }
+    const SpatialIndexStats& GetStats() const { return m_Stats; }
+
+    // The k bodies nearest to point, closest first.
+    void FindNearest(const glm::vec3& point, uint32_t k, std::vector<QueryHit>& hits) const;
+    // Bodies whose centres lie within radius of point, in tree order.
+    void FindInRadius(const glm::vec3& point, float radius, std::vector<QueryHit>& hits) const;
+    // Bodies whose centres lie inside the box, in tree order.
+    void FindInBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<uint32_t>& bodies) const;
+    // Nearest body sphere the ray enters. A ray starting inside a body hits it at distance 0.
+    bool RayCast(const QueryRay& ray, QueryHit& hit) const;
+
+    // Batch variants answer every query in parallel. FindNearest writes k hits per point, padding with
+    // empty hits when there are fewer bodies. FindInRadius writes the hits of point i to
+    // hits[offsets[i], offsets[i + 1]). RayCast writes one hit per ray, empty on a miss.
+    void FindNearest(const std::vector<glm::vec3>& points, uint32_t k, std::vector<QueryHit>& hits) const;
+    void FindInRadius(const std::vector<glm::vec3>& points, float radius, std::vector<uint32_t>& offsets,
+                      std::vector<QueryHit>& hits) const;
+    void RayCast(const std::vector<QueryRay>& rays, std::vector<QueryHit>& hits) const;
+
+private:
+    void Rebuild(const BodyStorage& bodies);
+    void Gather(const BodyStorage& bodies);
+    uint32_t Nearest(const glm::vec3& point, uint32_t k, QueryHit* hits) const;
+    template<typename Visit>
+    void VisitInRadius(const glm::vec3& point, float radius, Visit&& visit) const;
+    QueryHit CastRay(const QueryRay& ray) const;
+
+    SpatialSort m_Sort;
+    Octree m_Octree;
+    // Tree order, matching m_Octree.GetBodyOrder().
+    std::vector<glm::vec3> m_Points;
+    std::vector<float> m_Radii;
+    // Largest body radius under each node, which pads the node bounds for ray casts.
+    std::vector<float> m_NodeReach;
+    SpatialIndexStats m_Stats;
+    bool m_Moved = false;
+    bool m_Invalid = true;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include "SpatialSort.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace SpaceSim {
+
+static uint64_t SpreadBits(uint32_t value)
+{
+    uint64_t x = value & 0x1FFFFF;
+    x = (x | (x << 32)) & 0x1F00000000FFFFull;
+    x = (x | (x << 16)) & 0x1F0000FF0000FFull;
+    x = (x | (x << 8)) & 0x100F00F00F00F00Full;
+    x = (x | (x << 4)) & 0x10C30C30C30C30C3ull;
+    x = (x | (x << 2)) & 0x1249249249249249ull;
+    return x;
+}
+
+static uint32_t CompactBits(uint64_t x)
+{
+    x &= 0x1249249249249249ull;
+    x = (x ^ (x >> 2)) & 0x10C30C30C30C30C3ull;
+    x = (x ^ (x >> 4)) & 0x100F00F00F00F00Full;
+    x = (x ^ (x >> 8)) & 0x1F0000FF0000FFull;
+    x = (x ^ (x >> 16)) & 0x1F00000000FFFFull;
+    x = (x ^ (x >> 32)) & 0x1FFFFF;
+    return static_cast<uint32_t>(x);
+}
+
+uint64_t EncodeMorton(uint32_t x, uint32_t y, uint32_t z)
+{
+    return SpreadBits(x) | (SpreadBits(y) << 1) | (SpreadBits(z) << 2);
+}
+
+glm::uvec3 DecodeMorton(uint64_t key)
+{
+    return glm::uvec3(CompactBits(key), CompactBits(key >> 1), CompactBits(key >> 2));
+}
+
+SpatialBounds ComputeBounds(const std::vector<glm::vec3>& positions)
+{
+    SpatialBounds bounds;
+    if (positions.empty())
+        return bounds;
+
+    ThreadPool& pool = ThreadPool::Get();
+    uint32_t taskCount = static_cast<uint32_t>(std::clamp<size_t>(positions.size() / 8192, 1, pool.GetThreadCount()));
+    std::vector<glm::vec3> minimums(taskCount, glm::vec3(std::numeric_limits<float>::max()));
+    std::vector<glm::vec3> maximums(taskCount, glm::vec3(std::numeric_limits<float>::lowest()));
+
+    pool.Dispatch(taskCount, [&](uint32_t task) {
+        size_t begin = positions.size() * task / taskCount;
+        size_t end = positions.size() * (task + 1) / taskCount;
+        glm::vec3 lo = minimums[task];
+        glm::vec3 hi = maximums[task];
+        for (size_t i = begin; i < end; i++) {
+            lo = glm::min(lo, positions[i]);
+            hi = glm::max(hi, positions[i]);
+        }
+        minimums[task] = lo;
+        maximums[task] = hi;
+    });
+
+    glm::vec3 lo = minimums[0];
+    glm::vec3 hi = maximums[0];
+    for (uint32_t task = 1; task < taskCount; task++) {
+        lo = glm::min(lo, minimums[task]);
+        hi = glm::max(hi, maximums[task]);
+    }
+
+    glm::vec3 extent = hi - lo;
+    float size = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-3f));
+
+    // Pad slightly so the maximum corner still quantizes inside the grid.
+    bounds.size = size * 1.001f;
+    bounds.min = lo - glm::vec3(size * 0.0005f);
+    return bounds;
+}
+
+void RadixSortPairs(std::vector<uint64_t>& keys, std::vector<uint32_t>& values,
+                    std::vector<uint64_t>& keyScratch, std::vector<uint32_t>& valueScratch,
+                    uint32_t keyBits)
+{
+    const size_t count = keys.size();
+    if (count < 2)
+        return;
+
+    keyScratch.resize(count);
+    valueScratch.resize(count);
+
+    ThreadPool& pool = ThreadPool::Get();
+    const uint32_t taskCount = static_cast<uint32_t>(std::clamp<size_t>(count / 16384, 1, pool.GetThreadCount()));
+    std::vector<std::array<size_t, 256>> histograms(taskCount);
+
+    uint64_t* srcKeys = keys.data();
+    uint32_t* srcValues = values.data();
+    uint64_t* dstKeys = keyScratch.data();
+    uint32_t* dstValues = valueScratch.data();
+
+    for (uint32_t shift = 0; shift < keyBits; shift += 8)
+    {
+        pool.Dispatch(taskCount, [&](uint32_t task) {
+            auto& histogram = histograms[task];
+            histogram.fill(0);
+            size_t begin = count * task / taskCount;
+            size_t end = count * (task + 1) / taskCount;
+            for (size_t i = begin; i < end; i++) {
+                histogram[(srcKeys[i] >> shift) & 0xFF]++;
+            }
+        });
+
+        bool trivialPass = false;
+        size_t offset = 0;
+        for (uint32_t digit = 0; digit < 256; digit++) {
+            size_t digitTotal = 0;
+            for (uint32_t task = 0; task < taskCount; task++) {
+                size_t taskCountForDigit = histograms[task][digit];
+                histograms[task][digit] = offset;
+                offset += taskCountForDigit;
+                digitTotal += taskCountForDigit;
+            }
+            if (digitTotal == count)
+                trivialPass = true;
+        }
+
+        if (trivialPass)
+            continue;
+
+        pool.Dispatch(taskCount, [&](uint32_t task) {
+            auto& offsets = histograms[task];
+            size_t begin = count * task / taskCount;
+            size_t end = count * (task + 1) / taskCount;
+            for (size_t i = begin; i < end; i++) {
+                size_t destination = offsets[(srcKeys[i] >> shift) & 0xFF]++;
+                dstKeys[destination] = srcKeys[i];
+                dstValues[destination] = srcValues[i];
+            }
+        });
+
+        std::swap(srcKeys, dstKeys);
+        std::swap(srcValues, dstValues);
+    }
+
+    if (srcKeys != keys.data())
+    {
+        keys.swap(keyScratch);
+        values.swap(valueScratch);
+    }
+}
+
+SpatialBounds CombineBounds(const SpatialBounds& a, const SpatialBounds& b)
+{
+    SpatialBounds bounds;
+    bounds.min = glm::min(a.min, b.min);
+    const glm::vec3 extent = glm::max(a.min + glm::vec3(a.size), b.min + glm::vec3(b.size)) - bounds.min;
+    bounds.size = std::max(std::max(extent.x, extent.y), extent.z);
+    return bounds;
+}
+
+void SpatialSort::Update(const std::vector<glm::vec3>& positions)
+{
+    Update(positions, ComputeBounds(positions));
+}
+
+void SpatialSort::Update(const std::vector<glm::vec3>& positions, const SpatialBounds& bounds)
+{
+    const size_t count = positions.size();
+    m_Bounds = bounds;
+    m_Keys.resize(count);
+    m_Indices.resize(count);
+
+    ThreadPool::Get().ParallelFor(count, 8192, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            glm::uvec3 cell = GetCell(positions[i]);
+            m_Keys[i] = EncodeMorton(cell.x, cell.y, cell.z);
+            m_Indices[i] = static_cast<uint32_t>(i);
+        }
+    });
+
+    RadixSortPairs(m_Keys, m_Indices, m_KeyScratch, m_IndexScratch, MortonKeyBits);
+}
+
+void SpatialSort::Merge(const std::vector<glm::vec3>& positions, const SpatialSort& sorted, size_t offset)
+{
+    m_Bounds = sorted.m_Bounds;
+    m_KeyScratch.resize(offset);
+    m_IndexScratch.resize(offset);
+    for (size_t i = 0; i < offset; i++) {
+        glm::uvec3 cell = GetCell(positions[i]);
+        m_KeyScratch[i] = EncodeMorton(cell.x, cell.y, cell.z);
+        m_IndexScratch[i] = static_cast<uint32_t>(i);
+    }
+    std::vector<uint64_t> keyScratch;
+    std::vector<uint32_t> indexScratch;
+    RadixSortPairs(m_KeyScratch, m_IndexScratch, keyScratch, indexScratch, MortonKeyBits);
+
+    // On equal keys the first entries go first, as their lower indices would in a stable sort of everything.
+    const size_t count = offset + sorted.Size();
+    m_Keys.resize(count);
+    m_Indices.resize(count);
+    size_t extra = 0;
+    size_t next = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (next == sorted.Size() || (extra < offset && m_KeyScratch[extra] <= sorted.m_Keys[next]))
+        {
+            m_Keys[i] = m_KeyScratch[extra];
+            m_Indices[i] = m_IndexScratch[extra++];
+        }
+        else
+        {
+            m_Keys[i] = sorted.m_Keys[next];
+            m_Indices[i] = static_cast<uint32_t>(offset) + sorted.m_Indices[next++];
+        }
+    }
+}
+
+void SpatialSort::OnBodiesPermuted()
+{
+    for (size_t i = 0; i < m_Indices.size(); i++) {
+        m_Indices[i] = static_cast<uint32_t>(i);
+    }
+}
+
+glm::uvec3 SpatialSort::GetCell(const glm::vec3& position) const
+{
+    const float scale = static_cast<float>(1u << MortonBitsPerAxis) / m_Bounds.size;
+    glm::vec3 cell = glm::clamp((position - m_Bounds.min) * scale, glm::vec3(0.0f),
+                                glm::vec3(static_cast<float>((1u << MortonBitsPerAxis) - 1)));
+    return glm::uvec3(cell);
+}
+
+float SpatialSort::GetCellSize(uint32_t level) const
+{
+    return m_Bounds.size / static_cast<float>(1u << level);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef SPATIAL_SORT_H
+#define SPATIAL_SORT_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace SpaceSim {
+
+constexpr uint32_t MortonBitsPerAxis = 21;
+constexpr uint32_t MortonKeyBits = MortonBitsPerAxis * 3;
+
+// Cubic region quantized into 2^21 cells per axis.
+struct SpatialBounds {
+    glm::vec3 min = glm::vec3(0.0f);
+    float size = 1.0f;
+};
+
+uint64_t EncodeMorton(uint32_t x, uint32_t y, uint32_t z);
+glm::uvec3 DecodeMorton(uint64_t key);
+
+SpatialBounds ComputeBounds(const std::vector<glm::vec3>& positions);
+// Smallest cube holding both.
+SpatialBounds CombineBounds(const SpatialBounds& a, const SpatialBounds& b);
+
+// Stable parallel LSD radix sort on 8-bit digits. Passes whose digit is equal for every key are skipped.
+void RadixSortPairs(std::vector<uint64_t>& keys, std::vector<uint32_t>& values,
+                    std::vector<uint64_t>& keyScratch, std::vector<uint32_t>& valueScratch,
+                    uint32_t keyBits = 64);
+
+// Body indices ordered along a Morton curve. Consumers walk GetSortedIndices() for locality
+// and can derive coarser cells by shifting the sorted keys, which keeps them sorted.
+class SpatialSort {
+public:
+    void Update(const std::vector<glm::vec3>& positions);
+    // Sorts within bounds that must hold every position, so another set keyed the same way can be merged in.
+    void Update(const std::vector<glm::vec3>& positions, const SpatialBounds& bounds);
+    // Sorts positions whose entries from offset on are, in order, the ones sorted was last updated with. Only the
+    // first offset entries are keyed, in sorted's bounds, and merged into its order; the result is what Update
+    // with those bounds gives.
+    void Merge(const std::vector<glm::vec3>& positions, const SpatialSort& sorted, size_t offset);
+    void OnBodiesPermuted();
+
+    size_t Size() const { return m_Keys.size(); }
+    const SpatialBounds& GetBounds() const { return m_Bounds; }
+    const std::vector<uint64_t>& GetSortedKeys() const { return m_Keys; }
+    const std::vector<uint32_t>& GetSortedIndices() const { return m_Indices; }
+
+    glm::uvec3 GetCell(const glm::vec3& position) const;
+    float GetCellSize(uint32_t level) const;
+
+private:
+    SpatialBounds m_Bounds;
+    std::vector<uint64_t> m_Keys;
+    std::vector<uint32_t> m_Indices;
+    std::vector<uint64_t> m_KeyScratch;
+    std::vector<uint32_t> m_IndexScratch;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,384 @@
+#include "StateHistory.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace SpaceSim {
+
+// Words per body: position, velocity, mass, radius, color, handle. Per gas particle: position, velocity,
+// mass, internal energy, smoothing length.
+constexpr size_t WordsPerBody = 13;
+constexpr size_t WordsPerGasParticle = 9;
+
+template <typename T>
+static void StoreWords(const std::vector<T>& values, uint32_t* words, size_t& offset)
+{
+    std::memcpy(words + offset, values.data(), values.size() * sizeof(T));
+    offset += values.size() * sizeof(T) / sizeof(uint32_t);
+}
+
+template <typename T>
+static void LoadWords(const uint32_t* words, size_t& offset, size_t count, std::vector<T>& values)
+{
+    values.resize(count);
+    std::memcpy(values.data(), words + offset, count * sizeof(T));
+    offset += count * sizeof(T) / sizeof(uint32_t);
+}
+
+static void Flatten(const SimulationState& state, std::vector<uint32_t>& words)
+{
+    words.resize(state.positions.size() * WordsPerBody + state.gasPositions.size() * WordsPerGasParticle);
+    size_t offset = 0;
+    StoreWords(state.positions, words.data(), offset);
+    StoreWords(state.velocities, words.data(), offset);
+    StoreWords(state.masses, words.data(), offset);
+    StoreWords(state.radii, words.data(), offset);
+    StoreWords(state.colors, words.data(), offset);
+    StoreWords(state.handles, words.data(), offset);
+    StoreWords(state.gasPositions, words.data(), offset);
+    StoreWords(state.gasVelocities, words.data(), offset);
+    StoreWords(state.gasMasses, words.data(), offset);
+    StoreWords(state.gasInternalEnergies, words.data(), offset);
+    StoreWords(state.gasSmoothingLengths, words.data(), offset);
+}
+
+static void Unflatten(const std::vector<uint32_t>& words, size_t bodyCount, size_t gasCount, SimulationState& state)
+{
+    size_t offset = 0;
+    LoadWords(words.data(), offset, bodyCount, state.positions);
+    LoadWords(words.data(), offset, bodyCount, state.velocities);
+    LoadWords(words.data(), offset, bodyCount, state.masses);
+    LoadWords(words.data(), offset, bodyCount, state.radii);
+    LoadWords(words.data(), offset, bodyCount, state.colors);
+    LoadWords(words.data(), offset, bodyCount, state.handles);
+    LoadWords(words.data(), offset, gasCount, state.gasPositions);
+    LoadWords(words.data(), offset, gasCount, state.gasVelocities);
+    LoadWords(words.data(), offset, gasCount, state.gasMasses);
+    LoadWords(words.data(), offset, gasCount, state.gasInternalEnergies);
+    LoadWords(words.data(), offset, gasCount, state.gasSmoothingLengths);
+}
+
+// XORs the words with the previous state (when given) and writes the four byte planes one after another
+// as tokens: 0..127 is a literal run of token + 1 bytes, 128..255 a run of token - 127 zero bytes. Floats
+// that change slowly keep their sign, exponent and top mantissa bits, so the high planes are mostly zero.
+static void EncodeWords(const uint32_t* words, const uint32_t* previous, size_t count, std::vector<uint8_t>& out)
+{
+    out.clear();
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+        auto byteAt = [&](size_t i) {
+            const uint32_t word = previous ? words[i] ^ previous[i] : words[i];
+            return static_cast<uint8_t>(word >> shift);
+        };
+
+        size_t i = 0;
+        while (i < count)
+        {
+            if (byteAt(i) == 0)
+            {
+                size_t run = 1;
+                while (run < 128 && i + run < count && byteAt(i + run) == 0)
+                    run++;
+                out.push_back(static_cast<uint8_t>(127 + run));
+                i += run;
+                continue;
+            }
+
+            // A single zero inside a literal is cheaper to keep than to split the run.
+            const size_t token = out.size();
+            out.push_back(0);
+            size_t run = 0;
+            while (run < 128 && i < count)
+            {
+                const uint8_t value = byteAt(i);
+                if (value == 0 && (i + 1 == count || byteAt(i + 1) == 0))
+                    break;
+                out.push_back(value);
+                i++;
+                run++;
+            }
+            out[token] = static_cast<uint8_t>(run - 1);
+        }
+    }
+}
+
+// XORs a coded stream into words, which hold the previous state for a delta or zeros for a keyframe.
+static void DecodeWords(const std::vector<uint8_t>& data, uint32_t* words, size_t count)
+{
+    const uint8_t* in = data.data();
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+        size_t i = 0;
+        while (i < count)
+        {
+            const uint8_t token = *in++;
+            if (token >= 128)
+            {
+                i += token - 127;
+                continue;
+            }
+
+            const size_t run = token + 1u;
+            for (size_t k = 0; k < run; k++) {
+                words[i + k] ^= static_cast<uint32_t>(in[k]) << shift;
+            }
+            in += run;
+            i += run;
+        }
+    }
+}
+
+StateHistory::~StateHistory()
+{
+    Stop();
+}
+
+void StateHistory::SetSettings(const HistorySettings& settings)
+{
+    const bool wasEnabled = m_Settings.enabled;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Settings = settings;
+        m_Settings.interval = std::max(m_Settings.interval, 1u);
+        m_Settings.keyframeInterval = std::max(m_Settings.keyframeInterval, 1u);
+        m_Settings.memoryBudgetMB = std::max(m_Settings.memoryBudgetMB, 1u);
+    }
+
+    if (settings.enabled && !wasEnabled)
+    {
+        Start();
+    }
+    else if (!settings.enabled && wasEnabled)
+    {
+        Stop();
+        Clear();
+    }
+}
+
+HistoryStats StateHistory::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    HistoryStats stats = m_Stats;
+    stats.entries = m_Entries.size();
+    stats.firstStep = m_Entries.empty() ? 0 : m_Entries.front().step;
+    stats.lastStep = m_Entries.empty() ? 0 : m_Entries.back().step;
+    return stats;
+}
+
+size_t StateHistory::GetEntryCount() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Entries.size();
+}
+
+void StateHistory::GetEntrySteps(std::vector<uint64_t>& steps) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    steps.resize(m_Entries.size());
+    for (size_t i = 0; i < m_Entries.size(); i++) {
+        steps[i] = m_Entries[i].step;
+    }
+}
+
+SimulationState* StateHistory::BeginCapture(uint64_t step)
+{
+    if (!m_Settings.enabled || step % m_Settings.interval != 0)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_PendingReady)
+    {
+        m_Stats.skipped++;
+        return nullptr;
+    }
+    return &m_Pending;
+}
+
+void StateHistory::EndCapture()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_PendingReady = true;
+        m_PendingGeneration = m_Generation;
+    }
+    m_Condition.notify_one();
+}
+
+void StateHistory::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Entries.clear();
+    m_Generation++;
+    m_PendingReady = false;
+    m_CacheId = UINT64_MAX;
+    m_Stats.compressedBytes = 0;
+    m_Stats.rawBytes = 0;
+}
+
+bool StateHistory::Restore(uint64_t step, SimulationState& state)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    // Entries are in step order; a restore drops every later one, so steps never repeat.
+    auto found = std::lower_bound(m_Entries.begin(), m_Entries.end(), step, [](const Entry& entry, uint64_t value) {
+        return entry.step < value;
+    });
+    if (found == m_Entries.end() || found->step != step)
+        return false;
+    const size_t index = static_cast<size_t>(found - m_Entries.begin());
+
+    size_t keyframe = index;
+    while (!m_Entries[keyframe].keyframe)
+        keyframe--;
+
+    // Scrubbing forward within a keyframe group continues from the last decoded state.
+    const uint64_t firstId = m_Entries.front().id;
+    size_t next = keyframe;
+    const Entry& target = m_Entries[index];
+    const size_t wordCount = target.bodyCount * WordsPerBody + target.gasCount * WordsPerGasParticle;
+    if (m_CacheId != UINT64_MAX && m_CacheId >= firstId + keyframe && m_CacheId <= firstId + index && m_CacheWords.size() == wordCount)
+        next = static_cast<size_t>(m_CacheId - firstId) + 1;
+
+    if (next == keyframe)
+        m_CacheWords.assign(wordCount, 0);
+    for (size_t i = next; i <= index; i++) {
+        DecodeWords(m_Entries[i].data, m_CacheWords.data(), wordCount);
+    }
+    m_CacheId = target.id;
+
+    Unflatten(m_CacheWords, target.bodyCount, target.gasCount, state);
+    state.stepCount = target.step;
+    state.simulationTime = target.simulationTime;
+    state.renderTime = target.renderTime;
+    state.seed = target.seed;
+    state.nextStream = target.nextStream;
+    state.sunHandle = target.sunHandle;
+    state.handleCapacity = target.handleCapacity;
+
+    // The run continues from here, so later entries and any capture in flight belong to a discarded future.
+    while (m_Entries.size() > index + 1)
+    {
+        m_Stats.compressedBytes -= m_Entries.back().data.size();
+        m_Stats.rawBytes -= (m_Entries.back().bodyCount * WordsPerBody + m_Entries.back().gasCount * WordsPerGasParticle) * sizeof(uint32_t);
+        m_Entries.pop_back();
+    }
+    // Ids stay consecutive, since the cache finds entries by id. The restored entry is the cached one, so the
+    // cache stays valid.
+    m_NextId = m_Entries.back().id + 1;
+    m_Generation++;
+    m_PendingReady = false;
+
+    m_Stats.restoreMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return true;
+}
+
+void StateHistory::Start()
+{
+    if (m_Compressor.joinable())
+        return;
+
+    m_StopCompressor = false;
+    m_Compressor = std::thread(&StateHistory::CompressLoop, this);
+}
+
+void StateHistory::Stop()
+{
+    if (!m_Compressor.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_StopCompressor = true;
+    }
+    m_Condition.notify_one();
+    m_Compressor.join();
+}
+
+void StateHistory::CompressLoop()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (true)
+    {
+        m_Condition.wait(lock, [this] { return m_PendingReady || m_StopCompressor; });
+        if (m_StopCompressor)
+            break;
+
+        std::swap(m_Working, m_Pending);
+        const uint64_t generation = m_PendingGeneration;
+        m_PendingReady = false;
+
+        lock.unlock();
+        Compress(m_Working, generation);
+        lock.lock();
+    }
+}
+
+void StateHistory::Compress(const SimulationState& state, uint64_t generation)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    Flatten(state, m_Words);
+
+    bool keyframe = m_PreviousGeneration != generation || m_PreviousWords.size() != m_Words.size();
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        keyframe = keyframe || m_Entries.empty() || m_SinceKeyframe >= m_Settings.keyframeInterval;
+    }
+
+    EncodeWords(m_Words.data(), keyframe ? nullptr : m_PreviousWords.data(), m_Words.size(), m_Encoded);
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (generation != m_Generation)
+        {
+            m_PreviousGeneration = UINT64_MAX;
+            return;
+        }
+
+        Entry entry;
+        entry.id = m_NextId++;
+        entry.step = state.stepCount;
+        entry.simulationTime = state.simulationTime;
+        entry.renderTime = state.renderTime;
+        entry.seed = state.seed;
+        entry.nextStream = state.nextStream;
+        entry.sunHandle = state.sunHandle;
+        entry.handleCapacity = state.handleCapacity;
+        entry.bodyCount = state.positions.size();
+        entry.gasCount = state.gasPositions.size();
+        entry.keyframe = keyframe;
+        entry.data.assign(m_Encoded.begin(), m_Encoded.end());
+        m_Stats.compressedBytes += entry.data.size();
+        m_Stats.rawBytes += m_Words.size() * sizeof(uint32_t);
+        m_Entries.push_back(std::move(entry));
+
+        DropOldest();
+        m_Stats.compressMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    m_PreviousWords.swap(m_Words);
+    m_PreviousGeneration = generation;
+    m_SinceKeyframe = keyframe ? 1 : m_SinceKeyframe + 1;
+}
+
+void StateHistory::DropOldest()
+{
+    const uint64_t budget = static_cast<uint64_t>(m_Settings.memoryBudgetMB) << 20;
+    while (m_Stats.compressedBytes > budget)
+    {
+        // Only whole keyframe groups can go, and never the one still being appended to.
+        size_t groupEnd = 1;
+        while (groupEnd < m_Entries.size() && !m_Entries[groupEnd].keyframe)
+            groupEnd++;
+        if (groupEnd == m_Entries.size())
+            break;
+
+        for (size_t i = 0; i < groupEnd; i++) {
+            const Entry& entry = m_Entries.front();
+            m_Stats.compressedBytes -= entry.data.size();
+            m_Stats.rawBytes -= (entry.bodyCount * WordsPerBody + entry.gasCount * WordsPerGasParticle) * sizeof(uint32_t);
+            m_Entries.pop_front();
+        }
+    }
+}
+
+}
\ No newline at end of file
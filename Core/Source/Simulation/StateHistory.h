@@ -0,0 +1,112 @@
+#ifndef STATE_HISTORY_H
+#define STATE_HISTORY_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "SimulationState.h"
+
+namespace SpaceSim {
+
+struct HistorySettings {
+    bool enabled = false;
+    uint32_t interval = 10;
+    uint32_t keyframeInterval = 16;
+    uint32_t memoryBudgetMB = 256;
+};
+
+struct HistoryStats {
+    size_t entries = 0;
+    uint64_t compressedBytes = 0;
+    uint64_t rawBytes = 0;
+    uint64_t skipped = 0;
+    uint64_t firstStep = 0;
+    uint64_t lastStep = 0;
+    float compressMs = 0.0f;
+    float restoreMs = 0.0f;
+};
+
+// Rewind buffer of simulation states taken every interval steps. Each state is stored losslessly as the
+// XOR against the previous one, split into byte planes and zero-run coded, with a full keyframe every
+// keyframeInterval states or whenever the body or gas count changes. Compression runs on a background
+// thread; a capture arriving while it is busy is skipped. When the budget is exceeded the oldest
+// keyframe and its deltas are dropped.
+class StateHistory {
+public:
+    StateHistory() = default;
+    ~StateHistory();
+    StateHistory(const StateHistory&) = delete;
+    StateHistory& operator=(const StateHistory&) = delete;
+
+    const HistorySettings& GetSettings() const { return m_Settings; }
+    void SetSettings(const HistorySettings& settings);
+    HistoryStats GetStats() const;
+
+    // Returns a buffer to capture into when a snapshot is due at this step, then EndCapture hands it over.
+    SimulationState* BeginCapture(uint64_t step);
+    void EndCapture();
+
+    size_t GetEntryCount() const;
+    // Copies the step of every entry, oldest first, in one consistent view.
+    void GetEntrySteps(std::vector<uint64_t>& steps) const;
+
+    // Decodes the entry taken at step into state and drops every later entry, since the run continues from
+    // there. Returns false when no entry was taken at step.
+    bool Restore(uint64_t step, SimulationState& state);
+    void Clear();
+
+private:
+    struct Entry {
+        uint64_t id;
+        uint64_t step;
+        double simulationTime;
+        float renderTime;
+        uint64_t seed;
+        uint64_t nextStream;
+        BodyHandle sunHandle;
+        uint64_t handleCapacity;
+        size_t bodyCount;
+        size_t gasCount;
+        bool keyframe;
+        std::vector<uint8_t> data;
+    };
+
+    void Start();
+    void Stop();
+    void CompressLoop();
+    void Compress(const SimulationState& state, uint64_t generation);
+    void DropOldest();
+
+    HistorySettings m_Settings;
+    HistoryStats m_Stats;
+
+    std::thread m_Compressor;
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_StopCompressor = false;
+    bool m_PendingReady = false;
+    uint64_t m_Generation = 0;
+    uint64_t m_PendingGeneration = 0;
+    SimulationState m_Pending;
+
+    // Compressor thread only.
+    SimulationState m_Working;
+    std::vector<uint32_t> m_Words;
+    std::vector<uint32_t> m_PreviousWords;
+    std::vector<uint8_t> m_Encoded;
+    uint64_t m_PreviousGeneration = UINT64_MAX;
+    size_t m_SinceKeyframe = 0;
+
+    // Guarded by m_Mutex.
+    std::deque<Entry> m_Entries;
+    uint64_t m_NextId = 0;
+    uint64_t m_CacheId = UINT64_MAX;
+    std::vector<uint32_t> m_CacheWords;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "StepScheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace SpaceSim {
+
+void StepScheduler::Reset()
+{
+    m_PendingTime = 0.0;
+    m_Stats = SchedulerStats();
+}
+
+float StepScheduler::GetRemainderFraction() const
+{
+    if (m_Stats.substepSize <= 0.0f)
+        return 0.0f;
+    return static_cast<float>(std::clamp(m_PendingTime / m_Stats.substepSize, 0.0, 1.0));
+}
+
+void StepScheduler::Advance(float realDelta, float maxStableStep, const std::function<void(float)>& step)
+{
+    using Clock = std::chrono::steady_clock;
+
+    realDelta = std::clamp(realDelta, 0.0f, m_Settings.maxFrameDelta);
+    float substep = m_Settings.maxSubstep;
+    if (maxStableStep > 0.0f)
+        substep = std::min(substep, maxStableStep);
+    substep = std::max(substep, 1e-7f);
+
+    m_PendingTime += static_cast<double>(realDelta) * m_Settings.warp;
+    m_Stats.substepSize = substep;
+
+    const auto frameStart = Clock::now();
+    uint32_t substeps = 0;
+    double advanced = 0.0;
+
+    while (m_PendingTime >= substep)
+    {
+        double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+        if (substeps > 0 && elapsedMs + m_Stats.averageSubstepMs > m_Settings.frameBudgetMs)
+            break;
+
+        const auto substepStart = Clock::now();
+        step(substep);
+        double substepMs = std::chrono::duration<double, std::milli>(Clock::now() - substepStart).count();
+        m_Stats.averageSubstepMs = m_Stats.averageSubstepMs == 0.0 ? substepMs : m_Stats.averageSubstepMs * 0.9 + substepMs * 0.1;
+
+        m_PendingTime -= substep;
+        advanced += substep;
+        substeps++;
+    }
+
+    m_Stats.fallingBehind = m_PendingTime >= substep;
+    if (m_Stats.fallingBehind)
+    {
+        double kept = std::fmod(m_PendingTime, static_cast<double>(substep));
+        m_Stats.droppedTime += m_PendingTime - kept;
+        m_PendingTime = kept;
+    }
+
+    m_Stats.substepsLastFrame = substeps;
+    m_Stats.simulatedTime += advanced;
+    if (realDelta > 0.0f)
+    {
+        double warp = advanced / realDelta;
+        m_Stats.achievedWarp = m_Stats.achievedWarp == 0.0 ? warp : m_Stats.achievedWarp * 0.9 + warp * 0.1;
+    }
+}
+
+}
\ No newline at end of file
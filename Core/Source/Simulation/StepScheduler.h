@@ -0,0 +1,51 @@
+#ifndef STEP_SCHEDULER_H
+#define STEP_SCHEDULER_H
+
+#include <cstdint>
+#include <functional>
+
+namespace SpaceSim {
+
+struct SchedulerSettings {
+    double warp = 1.0;
+    float maxSubstep = 1.0f / 120.0f;
+    float frameBudgetMs = 12.0f;
+    float maxFrameDelta = 0.1f;
+};
+
+struct SchedulerStats {
+    double achievedWarp = 0.0;
+    double averageSubstepMs = 0.0;
+    double simulatedTime = 0.0;
+    double droppedTime = 0.0;
+    uint32_t substepsLastFrame = 0;
+    float substepSize = 0.0f;
+    bool fallingBehind = false;
+};
+
+// Turns real frame time times the warp factor into fixed-size substeps. Each frame runs as many substeps
+// as fit in the frame budget, judged by the measured cost of recent substeps. Any time still owed
+// beyond one substep is dropped instead of carried over, so a slow frame never makes later steps larger.
+// The achieved warp then reports how fast simulated time really advances.
+class StepScheduler {
+public:
+    // maxStableStep lets the caller tighten the substep, e.g. for a CFL limit; pass 0 for none.
+    void Advance(float realDelta, float maxStableStep, const std::function<void(float)>& step);
+    void Reset();
+
+    const SchedulerSettings& GetSettings() const { return m_Settings; }
+    void SetSettings(const SchedulerSettings& settings) { m_Settings = settings; }
+    const SchedulerStats& GetStats() const { return m_Stats; }
+
+    // Simulated time owed that is smaller than one substep, as a fraction of the substep.
+    float GetRemainderFraction() const;
+
+private:
+    SchedulerSettings m_Settings;
+    SchedulerStats m_Stats;
+    double m_PendingTime = 0.0;
+};
+
+}
+
+#endif
\ No newline at end of file
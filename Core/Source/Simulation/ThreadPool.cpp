@@ -0,0 +1,161 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace SpaceSim {
+
+static thread_local bool t_InsideTask = false;
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    StartWorkers(threadCount - 1);
+}
+
+ThreadPool::~ThreadPool()
+{
+    StopWorkers();
+}
+
+ThreadPool& ThreadPool::Get()
+{
+    static ThreadPool s_Pool;
+    return s_Pool;
+}
+
+void ThreadPool::SetThreadCount(uint32_t threadCount)
+{
+    std::lock_guard<std::mutex> dispatchLock(m_DispatchMutex);
+
+    threadCount = std::max(1u, threadCount);
+    if (threadCount == GetThreadCount())
+        return;
+
+    StopWorkers();
+    StartWorkers(threadCount - 1);
+}
+
+void ThreadPool::StartWorkers(uint32_t workerCount)
+{
+    // New workers start at the current generation; otherwise a restart after a dispatch would wake them
+    // for a task that has already finished.
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = false;
+        generation = m_Generation;
+    }
+    m_Workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; i++) {
+        m_Workers.emplace_back([this, generation]() { WorkerLoop(generation); });
+    }
+}
+
+void ThreadPool::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_WakeCondition.notify_all();
+
+    for (auto& worker : m_Workers) {
+        worker.join();
+    }
+    m_Workers.clear();
+}
+
+void ThreadPool::WorkerLoop(uint64_t seenGeneration)
+{
+    t_InsideTask = true;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_WakeCondition.wait(lock, [&]() { return m_Stopping || m_Generation != seenGeneration; });
+            if (m_Stopping)
+                return;
+            seenGeneration = m_Generation;
+        }
+
+        RunTasks();
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_BusyWorkers--;
+        }
+        m_DoneCondition.notify_one();
+    }
+}
+
+void ThreadPool::RunTasks()
+{
+    uint32_t taskIndex;
+    while ((taskIndex = m_NextTask.fetch_add(1, std::memory_order_relaxed)) < m_TaskCount) {
+        (*m_Task)(taskIndex);
+    }
+}
+
+void ThreadPool::Dispatch(uint32_t taskCount, const std::function<void(uint32_t)>& task)
+{
+    if (taskCount == 0)
+        return;
+
+    if (taskCount == 1 || t_InsideTask)
+    {
+        for (uint32_t i = 0; i < taskCount; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> dispatchLock(m_DispatchMutex);
+
+    if (m_Workers.empty())
+    {
+        t_InsideTask = true;
+        for (uint32_t i = 0; i < taskCount; i++) {
+            task(i);
+        }
+        t_InsideTask = false;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Task = &task;
+        m_TaskCount = taskCount;
+        m_NextTask.store(0, std::memory_order_relaxed);
+        m_BusyWorkers = static_cast<uint32_t>(m_Workers.size());
+        m_Generation++;
+    }
+    m_WakeCondition.notify_all();
+
+    t_InsideTask = true;
+    RunTasks();
+    t_InsideTask = false;
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_DoneCondition.wait(lock, [this]() { return m_BusyWorkers == 0; });
+    m_Task = nullptr;
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t minRange, const std::function<void(size_t, size_t)>& body)
+{
+    if (count == 0)
+        return;
+
+    size_t maxTasks = static_cast<size_t>(GetThreadCount()) * 4;
+    size_t taskCount = std::min(maxTasks, (count + minRange - 1) / std::max<size_t>(1, minRange));
+    taskCount = std::max<size_t>(1, taskCount);
+
+    Dispatch(static_cast<uint32_t>(taskCount), [&](uint32_t task) {
+        size_t begin = count * task / taskCount;
+        size_t end = count * (task + 1) / taskCount;
+        body(begin, end);
+    });
+}
+
+}
\ No newline at end of file
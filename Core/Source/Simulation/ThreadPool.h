@@ -0,0 +1,56 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SpaceSim {
+
+class ThreadPool {
+public:
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Runs task(0..taskCount-1) on the workers and the calling thread, returns when all are done.
+    // Calls made from inside a task run inline on the current thread.
+    void Dispatch(uint32_t taskCount, const std::function<void(uint32_t)>& task);
+
+    // Splits [0, count) into contiguous ranges of at least minRange items.
+    void ParallelFor(size_t count, size_t minRange, const std::function<void(size_t, size_t)>& body);
+
+    uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()) + 1; }
+    void SetThreadCount(uint32_t threadCount);
+
+    static ThreadPool& Get();
+
+private:
+    void StartWorkers(uint32_t workerCount);
+    void StopWorkers();
+    void WorkerLoop(uint64_t seenGeneration);
+    void RunTasks();
+
+    std::vector<std::thread> m_Workers;
+    std::mutex m_DispatchMutex;
+    std::mutex m_Mutex;
+    std::condition_variable m_WakeCondition;
+    std::condition_variable m_DoneCondition;
+
+    const std::function<void(uint32_t)>* m_Task = nullptr;
+    uint32_t m_TaskCount = 0;
+    std::atomic<uint32_t> m_NextTask{ 0 };
+    uint32_t m_BusyWorkers = 0;
+    uint64_t m_Generation = 0;
+    bool m_Stopping = false;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,642 @@
+#include "Trajectory.h"
+#include "GravitySimulation.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace SpaceSim {
+
+// Tag of writes that belong to no staged frame.
+constexpr uint64_t UnstagedWrite = ~0ull;
+const uint8_t ZeroPadding[TrajectoryAlignment] = {};
+
+static uint64_t AlignUp(uint64_t offset)
+{
+    return (offset + TrajectoryAlignment - 1) & ~(TrajectoryAlignment - 1);
+}
+
+TrajectoryRecorder::~TrajectoryRecorder()
+{
+    Close();
+}
+
+bool TrajectoryRecorder::Open(const std::string& path, const TrajectorySettings& settings)
+{
+    Close();
+    m_Settings = settings;
+    m_Settings.frameInterval = std::max(m_Settings.frameInterval, 1u);
+    m_Settings.chunkFrames = std::max(m_Settings.chunkFrames, 1u);
+    m_Settings.stagingFrames = std::max(m_Settings.stagingFrames, 1u);
+
+    // A frame that starts a chunk takes five writes; the header takes one more.
+    if (!m_File.Create(path, m_Settings.stagingFrames * 5 + 1, m_Settings.useRing))
+        return false;
+
+    m_Path = path;
+    m_Staging.assign(m_Settings.stagingFrames, StagedFrame{});
+    m_FreeSlots.clear();
+    for (uint32_t i = m_Settings.stagingFrames; i > 0; i--) {
+        m_FreeSlots.push_back(i - 1);
+    }
+    m_ReadySlots.clear();
+    m_Stats = TrajectoryStats{};
+    m_StopWriter = false;
+    m_ChunkBodyCount = 0;
+    m_ChunkFramesLeft = 0;
+    m_NextFrame = 0;
+
+    m_Chunks.clear();
+    m_Frames.clear();
+    m_WriteFailed = false;
+    m_Header = TrajectoryHeader{};
+    m_Header.magic = TrajectoryMagic;
+    m_Header.version = TrajectoryVersion;
+    m_Header.headerSize = sizeof(TrajectoryHeader);
+    m_Header.encoding = static_cast<uint32_t>(m_Settings.encoding);
+    m_Header.frameInterval = m_Settings.frameInterval;
+    m_Header.chunkFrames = m_Settings.chunkFrames;
+    // Rewritten with the counts and index offset on close.
+    m_File.Write(&m_Header, sizeof(m_Header), 0, UnstagedWrite);
+    m_File.Write(ZeroPadding, AlignUp(sizeof(m_Header)) - sizeof(m_Header), sizeof(m_Header), UnstagedWrite);
+    m_FileSize = AlignUp(sizeof(m_Header));
+
+    m_Writer = std::thread(&TrajectoryRecorder::WriterLoop, this);
+    return true;
+}
+
+bool TrajectoryRecorder::Close()
+{
+    if (!IsOpen())
+        return true;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_StopWriter = true;
+    }
+    m_Condition.notify_one();
+    m_Writer.join();
+    m_File.Close();
+    return !m_WriteFailed;
+}
+
+TrajectoryStats TrajectoryRecorder::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Stats;
+}
+
+bool TrajectoryRecorder::Record(const GravitySimulation& simulation)
+{
+    if (!IsOpen() || simulation.GetStepCount() % m_Settings.frameInterval != 0)
+        return false;
+
+    const auto start = std::chrono::steady_clock::now();
+    uint32_t slot = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_FreeSlots.empty())
+        {
+            m_Stats.dropped++;
+            return false;
+        }
+        slot = m_FreeSlots.back();
+        m_FreeSlots.pop_back();
+    }
+
+    const BodyStorage& bodies = simulation.GetBodies();
+    const uint32_t bodyCount = static_cast<uint32_t>(bodies.GetHandleCapacity());
+    StagedFrame& staged = m_Staging[slot];
+    staged.startsChunk = m_ChunkFramesLeft == 0 || bodyCount != m_ChunkBodyCount;
+    if (staged.startsChunk)
+    {
+        m_ChunkFramesLeft = m_Settings.chunkFrames;
+        m_ChunkBodyCount = bodyCount;
+        staged.chunk = TrajectoryChunkHeader{ TrajectoryChunkMagic, bodyCount, simulation.GetSunHandle(), 0, m_NextFrame,
+                                              AlignUp(static_cast<uint64_t>(bodyCount) * sizeof(float)) + static_cast<uint64_t>(bodyCount) * sizeof(glm::vec4) };
+    }
+    m_ChunkFramesLeft--;
+    staged.frame = TrajectoryFrameHeader{ TrajectoryFrameMagic, bodyCount, static_cast<uint64_t>(bodyCount) * sizeof(glm::vec3),
+                                          simulation.GetStepCount(), simulation.GetSimulationTime() };
+    m_NextFrame++;
+
+    // Gather in handle order, so the staging buffers are written once and sequentially even with gaps.
+    const std::vector<uint32_t>& indices = bodies.GetHandleIndices();
+    const std::vector<glm::vec3>& positions = bodies.GetPositions();
+    const glm::vec3 missing(std::numeric_limits<float>::quiet_NaN());
+    staged.positions.resize(bodyCount);
+    ThreadPool& pool = ThreadPool::Get();
+    pool.ParallelFor(bodyCount, 16384, [&](size_t begin, size_t end) {
+        for (size_t handle = begin; handle < end; handle++) {
+            const uint32_t index = indices[handle];
+            staged.positions[handle] = index == InvalidBodyIndex ? missing : positions[index];
+        }
+    });
+    if (staged.startsChunk)
+    {
+        const std::vector<float>& radii = bodies.GetRadii();
+        const std::vector<glm::vec4>& colors = bodies.GetColors();
+        staged.radii.resize(bodyCount);
+        staged.colors.resize(bodyCount);
+        pool.ParallelFor(bodyCount, 16384, [&](size_t begin, size_t end) {
+            for (size_t handle = begin; handle < end; handle++) {
+                const uint32_t index = indices[handle];
+                staged.radii[handle] = index == InvalidBodyIndex ? 0.0f : radii[index];
+                staged.colors[handle] = index == InvalidBodyIndex ? glm::vec4(0.0f) : colors[index];
+            }
+        });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_ReadySlots.push_back(slot);
+        m_Stats.captureMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    m_Condition.notify_one();
+    return true;
+}
+
+void TrajectoryRecorder::WriterLoop()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (true)
+    {
+        if (m_ReadySlots.empty())
+        {
+            if (m_StopWriter)
+                break;
+            if (m_File.GetInFlight() > 0)
+            {
+                lock.unlock();
+                FinishWrites(true);
+                lock.lock();
+                continue;
+            }
+            m_Condition.wait(lock, [this] { return !m_ReadySlots.empty() || m_StopWriter; });
+            continue;
+        }
+
+        const uint32_t slot = m_ReadySlots.front();
+        m_ReadySlots.pop_front();
+        lock.unlock();
+        WriteFrame(slot);
+        FinishWrites(false);
+        lock.lock();
+    }
+    lock.unlock();
+
+    while (m_File.GetInFlight() > 0 && !m_WriteFailed) {
+        FinishWrites(true);
+    }
+    if (!m_WriteFailed && !WriteIndex())
+        m_WriteFailed = true;
+}
+
+bool TrajectoryRecorder::WriteFrame(uint32_t slot)
+{
+    StagedFrame& staged = m_Staging[slot];
+    if (m_WriteFailed)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stats.dropped++;
+        m_FreeSlots.push_back(slot);
+        return false;
+    }
+
+    const uint64_t start = m_FileSize;
+    bool queued = true;
+    auto append = [&](const void* data, uint64_t size) {
+        staged.pendingWrites++;
+        queued = queued && m_File.Write(data, size, m_FileSize, slot);
+        m_FileSize += size;
+    };
+    auto pad = [&]() {
+        if (AlignUp(m_FileSize) != m_FileSize)
+            append(ZeroPadding, AlignUp(m_FileSize) - m_FileSize);
+    };
+
+    // The writer encodes on its own rather than take the pool from the simulation.
+    const uint64_t positionBytes = staged.frame.payloadSize;
+    const void* payload = staged.positions.data();
+    if (m_Settings.encoding == TrajectoryEncoding::Quantized)
+    {
+        if (staged.startsChunk)
+            m_Encoder.BeginChunk(staged.positions.data(), staged.frame.bodyCount, m_Settings.quantizationError, false);
+        m_Encoder.Encode(staged.positions.data(), staged.frame.bodyCount, staged.encoded, false);
+        staged.frame.payloadSize = staged.encoded.size();
+        payload = staged.encoded.data();
+    }
+
+    staged.pendingWrites = 0;
+    if (staged.startsChunk)
+    {
+        m_Chunks.push_back(TrajectoryChunkEntry{ m_FileSize, staged.chunk.firstFrame, 0, staged.chunk.bodyCount });
+        append(&staged.chunk, sizeof(staged.chunk));
+        append(staged.radii.data(), staged.radii.size() * sizeof(float));
+        pad();
+        append(staged.colors.data(), staged.colors.size() * sizeof(glm::vec4));
+    }
+    append(&staged.frame, sizeof(staged.frame));
+    m_Frames.push_back(TrajectoryFrameEntry{ m_FileSize, staged.frame.payloadSize, staged.frame.step, staged.frame.time,
+                                             static_cast<uint32_t>(m_Chunks.size() - 1), 0 });
+    m_Chunks.back().frameCount++;
+    append(payload, staged.frame.payloadSize);
+    pad();
+
+    // A failed write never completes, so its frame stays out of the free list for the rest of the recording.
+    if (!queued)
+        m_WriteFailed = true;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stats.frames++;
+    m_Stats.chunks += staged.startsChunk ? 1 : 0;
+    m_Stats.bytesWritten += m_FileSize - start;
+    m_Stats.positionBytes += positionBytes;
+    m_Stats.payloadBytes += staged.frame.payloadSize;
+    return queued;
+}
+
+void TrajectoryRecorder::FinishWrites(bool wait)
+{
+    m_Completed.clear();
+    if (!m_File.Complete(m_Completed, wait))
+        m_WriteFailed = true;
+
+    for (uint64_t tag : m_Completed) {
+        if (tag == UnstagedWrite)
+            continue;
+
+        const uint32_t slot = static_cast<uint32_t>(tag);
+        if (--m_Staging[slot].pendingWrites == 0)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_FreeSlots.push_back(slot);
+        }
+    }
+}
+
+bool TrajectoryRecorder::WriteIndex()
+{
+    m_Header.frameCount = m_Frames.size();
+    m_Header.chunkCount = m_Chunks.size();
+    m_Header.indexOffset = m_FileSize;
+
+    const uint64_t chunkBytes = m_Chunks.size() * sizeof(TrajectoryChunkEntry);
+    bool written = m_File.Write(m_Chunks.data(), chunkBytes, m_FileSize, UnstagedWrite);
+    written = written && m_File.Write(m_Frames.data(), m_Frames.size() * sizeof(TrajectoryFrameEntry), m_FileSize + chunkBytes, UnstagedWrite);
+    // The header goes last so a reader never finds an index offset whose index is not yet written.
+    written = written && m_File.Sync();
+    written = written && m_File.Write(&m_Header, sizeof(m_Header), 0, UnstagedWrite);
+    written = written && m_File.Sync();
+    if (!written)
+        std::cerr << "Failed to write the trajectory index of " << m_Path << std::endl;
+    return written;
+}
+
+bool TrajectoryReader::Open(const std::string& path)
+{
+    Close();
+    if (!m_File.Open(path, MappedAccess::ReadOnly))
+        return false;
+
+    const uint64_t size = m_File.GetSize();
+    if (size >= sizeof(TrajectoryHeader))
+        std::memcpy(&m_Header, m_File.GetData(), sizeof(TrajectoryHeader));
+    if (size < sizeof(TrajectoryHeader) || m_Header.magic != TrajectoryMagic)
+    {
+        std::cerr << "Not a trajectory: " << path << std::endl;
+        Close();
+        return false;
+    }
+    if (m_Header.version < 1 || m_Header.version > TrajectoryVersion || m_Header.headerSize < sizeof(TrajectoryHeader) || m_Header.headerSize > size ||
+        m_Header.encoding > static_cast<uint32_t>(TrajectoryEncoding::Quantized))
+    {
+        std::cerr << "Unsupported trajectory version " << m_Header.version << " or encoding " << m_Header.encoding << ": " << path << std::endl;
+        Close();
+        return false;
+    }
+
+    // A recording that is still open, or was cut short, has no index yet.
+    const bool indexed = m_Header.indexOffset != 0 ? ReadIndex() : WalkRecords();
+    if (!indexed)
+    {
+        std::cerr << "Damaged trajectory index: " << path << std::endl;
+        Close();
+        return false;
+    }
+
+    // Radii, colours and raw positions are read in place; version 1 quantized payloads left them unaligned.
+    if (!IsAligned())
+    {
+        std::cerr << "Misaligned trajectory records, record it again: " << path << std::endl;
+        Close();
+        return false;
+    }
+
+    BuildTimeline();
+    return true;
+}
+
+void TrajectoryReader::Close()
+{
+    m_File.Close();
+    m_Header = TrajectoryHeader{};
+    m_Chunks.clear();
+    m_Frames.clear();
+    m_Timeline.clear();
+    m_TimelineCells.clear();
+    m_DecoderFrame = SIZE_MAX;
+    for (DecodedFrame& decoded : m_Decoded) {
+        decoded.frame = SIZE_MAX;
+        decoded.positions = std::vector<glm::vec3>();
+    }
+}
+
+bool TrajectoryReader::ReadIndex()
+{
+    const uint64_t size = m_File.GetSize();
+    const uint64_t chunkBytes = m_Header.chunkCount * sizeof(TrajectoryChunkEntry);
+    const uint64_t frameBytes = m_Header.frameCount * sizeof(TrajectoryFrameEntry);
+    if (m_Header.indexOffset > size || chunkBytes > size || frameBytes > size || size - m_Header.indexOffset < chunkBytes + frameBytes)
+        return false;
+
+    const uint8_t* index = m_File.GetData() + m_Header.indexOffset;
+    m_Chunks.resize(m_Header.chunkCount);
+    m_Frames.resize(m_Header.frameCount);
+    std::memcpy(m_Chunks.data(), index, chunkBytes);
+    std::memcpy(m_Frames.data(), index + chunkBytes, frameBytes);
+
+    for (const TrajectoryChunkEntry& chunk : m_Chunks) {
+        const uint64_t attributes = GetRadiiBytes(chunk.bodyCount) + static_cast<uint64_t>(chunk.bodyCount) * sizeof(glm::vec4);
+        if (chunk.offset > size || size - chunk.offset < sizeof(TrajectoryChunkHeader) + attributes)
+            return false;
+    }
+    for (size_t i = 0; i < m_Frames.size(); i++) {
+        const TrajectoryFrameEntry& frame = m_Frames[i];
+        if (frame.chunk >= m_Chunks.size() || frame.offset > size || size - frame.offset < frame.payloadSize ||
+            !IsPayloadValid(frame.payloadSize, m_Chunks[frame.chunk].bodyCount))
+            return false;
+        // Quantized frames are decoded from the first frame of their chunk.
+        const TrajectoryChunkEntry& chunk = m_Chunks[frame.chunk];
+        if (i < chunk.firstFrame || i - chunk.firstFrame >= chunk.frameCount)
+            return false;
+    }
+    return true;
+}
+
+bool TrajectoryReader::IsPayloadValid(uint64_t payloadSize, uint32_t bodyCount) const
+{
+    if (m_Header.encoding == static_cast<uint32_t>(TrajectoryEncoding::Quantized))
+        return payloadSize >= sizeof(QuantizedFrameHeader);
+    return payloadSize == static_cast<uint64_t>(bodyCount) * sizeof(glm::vec3);
+}
+
+bool TrajectoryReader::IsAligned() const
+{
+    for (const TrajectoryChunkEntry& chunk : m_Chunks) {
+        const uint64_t radii = chunk.offset + sizeof(TrajectoryChunkHeader);
+        if (radii % alignof(float) != 0 || (radii + GetRadiiBytes(chunk.bodyCount)) % alignof(glm::vec4) != 0)
+            return false;
+    }
+    if (m_Header.encoding != static_cast<uint32_t>(TrajectoryEncoding::Raw))
+        return true;
+    for (const TrajectoryFrameEntry& frame : m_Frames) {
+        if (frame.offset % alignof(glm::vec3) != 0)
+            return false;
+    }
+    return true;
+}
+
+uint64_t TrajectoryReader::AlignRecord(uint64_t end) const
+{
+    return m_Header.version >= 2 ? AlignUp(end) : end;
+}
+
+uint64_t TrajectoryReader::GetRadiiBytes(uint32_t bodyCount) const
+{
+    return AlignRecord(static_cast<uint64_t>(bodyCount) * sizeof(float));
+}
+
+bool TrajectoryReader::WalkRecords()
+{
+    const uint8_t* data = m_File.GetData();
+    const uint64_t size = m_File.GetSize();
+    uint64_t offset = AlignRecord(m_Header.headerSize);
+    while (size - offset >= sizeof(uint32_t))
+    {
+        uint32_t magic = 0;
+        std::memcpy(&magic, data + offset, sizeof(magic));
+        if (magic == TrajectoryChunkMagic && size - offset >= sizeof(TrajectoryChunkHeader))
+        {
+            TrajectoryChunkHeader chunk;
+            std::memcpy(&chunk, data + offset, sizeof(chunk));
+            const uint64_t end = offset + sizeof(chunk) + chunk.attributeSize;
+            if (chunk.attributeSize != GetRadiiBytes(chunk.bodyCount) + static_cast<uint64_t>(chunk.bodyCount) * sizeof(glm::vec4) || end > size)
+                break;
+            m_Chunks.push_back(TrajectoryChunkEntry{ offset, m_Frames.size(), 0, chunk.bodyCount });
+            offset = end;
+        }
+        else if (magic == TrajectoryFrameMagic && size - offset >= sizeof(TrajectoryFrameHeader) && !m_Chunks.empty())
+        {
+            TrajectoryFrameHeader frame;
+            std::memcpy(&frame, data + offset, sizeof(frame));
+            const uint64_t end = offset + sizeof(frame) + frame.payloadSize;
+            if (!IsPayloadValid(frame.payloadSize, m_Chunks.back().bodyCount) || end > size)
+                break;
+            m_Frames.push_back(TrajectoryFrameEntry{ offset + sizeof(frame), frame.payloadSize, frame.step, frame.time,
+                                                     static_cast<uint32_t>(m_Chunks.size() - 1), 0 });
+            m_Chunks.back().frameCount++;
+            // The padding of the last record may not be written yet.
+            offset = std::min(AlignRecord(end), size);
+        }
+        else
+        {
+            // Zeros past the last complete record, or a record still being written.
+            break;
+        }
+    }
+    return true;
+}
+
+void TrajectoryReader::BuildTimeline()
+{
+    m_Timeline.resize(m_Frames.size());
+    for (size_t i = 0; i < m_Frames.size(); i++) {
+        m_Timeline[i] = i == 0 ? m_Frames[0].time : m_Timeline[i - 1] + std::max(m_Frames[i].time - m_Frames[i - 1].time, 0.0);
+    }
+
+    m_TimelineCells.clear();
+    m_CellWidth = 0.0;
+    if (m_Frames.size() < 2 || GetEndTime() <= GetStartTime())
+        return;
+
+    m_CellWidth = (GetEndTime() - GetStartTime()) / static_cast<double>(m_Frames.size());
+    m_TimelineCells.resize(m_Frames.size());
+    uint32_t frame = 0;
+    for (size_t cell = 0; cell < m_TimelineCells.size(); cell++) {
+        const double cellStart = GetStartTime() + static_cast<double>(cell) * m_CellWidth;
+        while (frame + 1 < m_Frames.size() && m_Timeline[frame + 1] <= cellStart) {
+            frame++;
+        }
+        m_TimelineCells[cell] = frame;
+    }
+}
+
+size_t TrajectoryReader::FindFrame(double time, float& blend) const
+{
+    blend = 0.0f;
+    if (m_TimelineCells.empty())
+        return 0;
+
+    const double cell = std::floor((time - GetStartTime()) / m_CellWidth);
+    size_t frame = m_TimelineCells[static_cast<size_t>(std::clamp(cell, 0.0, static_cast<double>(m_TimelineCells.size() - 1)))];
+    while (frame + 1 < m_Frames.size() && m_Timeline[frame + 1] <= time) {
+        frame++;
+    }
+
+    if (frame + 1 < m_Frames.size())
+    {
+        const double span = m_Timeline[frame + 1] - m_Timeline[frame];
+        if (span > 0.0)
+            blend = static_cast<float>(std::clamp((time - m_Timeline[frame]) / span, 0.0, 1.0));
+    }
+    return frame;
+}
+
+const glm::vec3* TrajectoryReader::GetPositions(size_t frame)
+{
+    if (m_Header.encoding == static_cast<uint32_t>(TrajectoryEncoding::Raw))
+        return reinterpret_cast<const glm::vec3*>(m_File.GetData() + m_Frames[frame].offset);
+
+    for (uint32_t slot = 0; slot < 2; slot++) {
+        if (m_Decoded[slot].frame == frame)
+        {
+            m_LastDecoded = slot;
+            return m_Decoded[slot].positions.data();
+        }
+    }
+
+    m_LastDecoded ^= 1;
+    DecodedFrame& decoded = m_Decoded[m_LastDecoded];
+    decoded.frame = frame;
+    DecodeFrame(frame, decoded.positions);
+    return decoded.positions.data();
+}
+
+void TrajectoryReader::DecodeFrame(size_t frame, std::vector<glm::vec3>& positions)
+{
+    const uint32_t chunk = m_Frames[frame].chunk;
+    const uint32_t bodyCount = m_Chunks[chunk].bodyCount;
+    positions.resize(bodyCount);
+
+    // Carry on from the last decoded frame when it is earlier in the same chunk; otherwise start the chunk over.
+    size_t first = m_Chunks[chunk].firstFrame;
+    if (m_DecoderFrame != SIZE_MAX && m_Frames[m_DecoderFrame].chunk == chunk && m_DecoderFrame < frame)
+        first = m_DecoderFrame + 1;
+    else
+        m_Decoder.BeginChunk();
+
+    for (size_t i = first; i <= frame; i++) {
+        const TrajectoryFrameEntry& entry = m_Frames[i];
+        if (!m_Decoder.Decode(m_File.GetData() + entry.offset, entry.payloadSize, bodyCount, i == frame ? positions.data() : nullptr))
+        {
+            std::cerr << "Failed to decode trajectory frame " << i << std::endl;
+            std::fill(positions.begin(), positions.end(), glm::vec3(std::numeric_limits<float>::quiet_NaN()));
+            m_DecoderFrame = SIZE_MAX;
+            return;
+        }
+    }
+    m_DecoderFrame = frame;
+}
+
+const float* TrajectoryReader::GetRadii(size_t chunk) const
+{
+    return reinterpret_cast<const float*>(m_File.GetData() + m_Chunks[chunk].offset + sizeof(TrajectoryChunkHeader));
+}
+
+const glm::vec4* TrajectoryReader::GetColors(size_t chunk) const
+{
+    return reinterpret_cast<const glm::vec4*>(m_File.GetData() + m_Chunks[chunk].offset + sizeof(TrajectoryChunkHeader) +
+                                              GetRadiiBytes(m_Chunks[chunk].bodyCount));
+}
+
+BodyHandle TrajectoryReader::GetSunHandle(size_t chunk) const
+{
+    TrajectoryChunkHeader header;
+    std::memcpy(&header, m_File.GetData() + m_Chunks[chunk].offset, sizeof(header));
+    return header.sunHandle;
+}
+
+bool TrajectoryReader::Sample(double time, std::vector<glm::vec3>& positions, std::vector<float>& radii, std::vector<glm::vec4>& colors,
+                              uint32_t& sunIndex)
+{
+    sunIndex = InvalidBodyIndex;
+    if (m_Frames.empty())
+        return false;
+
+    float blend = 0.0f;
+    const size_t frame = FindFrame(time, blend);
+    const size_t next = std::min(frame + 1, m_Frames.size() - 1);
+    const size_t chunk = m_Frames[frame].chunk;
+    const uint32_t bodyCount = m_Chunks[chunk].bodyCount;
+    const uint32_t nextCount = m_Chunks[m_Frames[next].chunk].bodyCount;
+    const float* chunkRadii = GetRadii(chunk);
+    const glm::vec4* chunkColors = GetColors(chunk);
+    const BodyHandle sunHandle = GetSunHandle(chunk);
+
+    // Ask for both frames in one go rather than a page fault at a time, and start reading the frame after
+    // them for playback that moves forward.
+    m_File.Advise(m_Frames[frame].offset, m_Frames[frame].payloadSize, MappedHint::WillNeed);
+    m_File.Advise(m_Frames[next].offset, m_Frames[next].payloadSize, MappedHint::WillNeed);
+    if (next + 1 < m_Frames.size())
+        m_File.Advise(m_Frames[next + 1].offset, m_Frames[next + 1].payloadSize, MappedHint::WillNeed);
+
+    const glm::vec3* from = GetPositions(frame);
+    const glm::vec3* to = GetPositions(next);
+
+    // Drop removed bodies in two passes over fixed blocks: count the live ones, then write them at their
+    // block's offset. A body removed in the next frame stays where it was.
+    constexpr uint32_t BlockSize = 16384;
+    const uint32_t blockCount = (bodyCount + BlockSize - 1) / BlockSize;
+    m_BlockCounts.assign(blockCount + 1, 0);
+    ThreadPool& pool = ThreadPool::Get();
+    pool.Dispatch(blockCount, [&](uint32_t block) {
+        const uint32_t end = std::min(bodyCount, (block + 1) * BlockSize);
+        uint32_t live = 0;
+        for (uint32_t handle = block * BlockSize; handle < end; handle++) {
+            live += std::isnan(from[handle].x) ? 0 : 1;
+        }
+        m_BlockCounts[block + 1] = live;
+    });
+    for (uint32_t block = 0; block < blockCount; block++) {
+        m_BlockCounts[block + 1] += m_BlockCounts[block];
+    }
+
+    const uint32_t liveCount = m_BlockCounts[blockCount];
+    positions.resize(liveCount);
+    radii.resize(liveCount);
+    colors.resize(liveCount);
+    pool.Dispatch(blockCount, [&](uint32_t block) {
+        const uint32_t end = std::min(bodyCount, (block + 1) * BlockSize);
+        uint32_t out = m_BlockCounts[block];
+        for (uint32_t handle = block * BlockSize; handle < end; handle++) {
+            const glm::vec3 position = from[handle];
+            if (std::isnan(position.x))
+                continue;
+
+            const bool moves = handle < nextCount && !std::isnan(to[handle].x);
+            positions[out] = moves ? glm::mix(position, to[handle], blend) : position;
+            radii[out] = chunkRadii[handle];
+            colors[out] = chunkColors[handle];
+            if (handle == sunHandle)
+                sunIndex = out;
+            out++;
+        }
+    });
+    return true;
+}
+
+}
\ No newline at end of file
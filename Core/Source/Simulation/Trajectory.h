@@ -0,0 +1,259 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "AsyncFile.h"
+#include "BodyStorage.h"
+#include "MappedFile.h"
+#include "TrajectoryCodec.h"
+
+namespace SpaceSim {
+
+class GravitySimulation;
+
+// Trajectory layout: TrajectoryHeader, then chunks in recording order, then the index. A chunk is a
+// TrajectoryChunkHeader with every body's radius and colour followed by its frames, each a
+// TrajectoryFrameHeader and its payload. Bodies are stored by handle, so a body keeps its slot across
+// reorders; slots of removed bodies hold NaN positions. A chunk ends when it is full or the handle count
+// changes. The index at indexOffset lists every chunk and then every frame; a file whose recording never
+// closed has no index but can still be read by walking the records. The header's encoding applies to every
+// frame payload. Since version 2 the records, the colours and the payloads start on TrajectoryAlignment
+// boundaries, zero padded, so they can be read in place from the mapping whatever the payload sizes.
+constexpr uint64_t TrajectoryMagic = 0x4A4152544D495353ull; // "SSIMTRAJ"
+constexpr uint32_t TrajectoryVersion = 2;
+constexpr uint64_t TrajectoryAlignment = 16;
+constexpr uint32_t TrajectoryChunkMagic = 0x4B4E4843u; // "CHNK"
+constexpr uint32_t TrajectoryFrameMagic = 0x4D415246u; // "FRAM"
+
+enum class TrajectoryEncoding : uint32_t {
+    // float32 x, y, z per slot.
+    Raw,
+    // Lossy, see TrajectoryCodec.h. A frame is decoded from the start of its chunk.
+    Quantized
+};
+
+struct TrajectoryHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t encoding;
+    uint32_t frameInterval;
+    uint32_t chunkFrames;
+    uint32_t reserved;
+    uint64_t frameCount;
+    uint64_t chunkCount;
+    // 0 while recording.
+    uint64_t indexOffset;
+};
+
+struct TrajectoryChunkHeader {
+    uint32_t magic;
+    uint32_t bodyCount;
+    uint32_t sunHandle;
+    uint32_t reserved;
+    uint64_t firstFrame;
+    // Radii and colours that follow, with the padding after the radii.
+    uint64_t attributeSize;
+};
+
+struct TrajectoryFrameHeader {
+    uint32_t magic;
+    uint32_t bodyCount;
+    uint64_t payloadSize;
+    uint64_t step;
+    double time;
+};
+
+struct TrajectoryChunkEntry {
+    uint64_t offset;
+    uint64_t firstFrame;
+    uint32_t frameCount;
+    uint32_t bodyCount;
+};
+
+struct TrajectoryFrameEntry {
+    // Of the payload, past the frame header.
+    uint64_t offset;
+    uint64_t payloadSize;
+    uint64_t step;
+    double time;
+    uint32_t chunk;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TrajectoryHeader) == 56, "TrajectoryHeader is written to trajectories as is");
+static_assert(sizeof(TrajectoryChunkHeader) == 32, "TrajectoryChunkHeader is written to trajectories as is");
+static_assert(sizeof(TrajectoryFrameHeader) == 32, "TrajectoryFrameHeader is written to trajectories as is");
+static_assert(sizeof(TrajectoryChunkEntry) == 24, "TrajectoryChunkEntry is written to trajectories as is");
+static_assert(sizeof(TrajectoryFrameEntry) == 40, "TrajectoryFrameEntry is written to trajectories as is");
+
+struct TrajectorySettings {
+    // Steps between recorded frames.
+    uint32_t frameInterval = 1;
+    uint32_t chunkFrames = 64;
+    // Frames staged for the writer. When all are waiting to be written, new frames are dropped.
+    uint32_t stagingFrames = 4;
+    bool useRing = true;
+    TrajectoryEncoding encoding = TrajectoryEncoding::Raw;
+    // Largest position error of the quantized encoding, relative to the longest side of each chunk's first
+    // frame's bounding box.
+    float quantizationError = 1.0e-4f;
+};
+
+struct TrajectoryStats {
+    uint64_t frames = 0;
+    uint64_t dropped = 0;
+    uint64_t chunks = 0;
+    uint64_t bytesWritten = 0;
+    // Positions as raw float32 and as written, for the compression ratio.
+    uint64_t positionBytes = 0;
+    uint64_t payloadBytes = 0;
+    // Time the last Record() held up the caller.
+    double captureMs = 0.0;
+};
+
+// Records every body's position every few steps. Record() only gathers positions into a preallocated
+// staging frame; a writer thread encodes staged frames, appends them to the file with writes left in flight
+// through AsyncFile and hands the frames back as they complete.
+class TrajectoryRecorder {
+public:
+    TrajectoryRecorder() = default;
+    ~TrajectoryRecorder();
+    TrajectoryRecorder(const TrajectoryRecorder&) = delete;
+    TrajectoryRecorder& operator=(const TrajectoryRecorder&) = delete;
+
+    bool Open(const std::string& path, const TrajectorySettings& settings);
+    // Writes the frames still staged and the index. Returns false when any write failed.
+    bool Close();
+    bool IsOpen() const { return m_Writer.joinable(); }
+    const TrajectorySettings& GetSettings() const { return m_Settings; }
+    const std::string& GetPath() const { return m_Path; }
+
+    // Call after every step from the thread that steps the simulation. Records a frame on steps that are a
+    // multiple of the frame interval; returns false when none was recorded.
+    bool Record(const GravitySimulation& simulation);
+    TrajectoryStats GetStats() const;
+
+private:
+    struct StagedFrame {
+        TrajectoryChunkHeader chunk = {};
+        TrajectoryFrameHeader frame = {};
+        bool startsChunk = false;
+        std::vector<glm::vec3> positions;
+        std::vector<float> radii;
+        std::vector<glm::vec4> colors;
+        std::vector<uint8_t> encoded;
+        uint32_t pendingWrites = 0;
+    };
+
+    void WriterLoop();
+    bool WriteFrame(uint32_t slot);
+    void FinishWrites(bool wait);
+    bool WriteIndex();
+
+    TrajectorySettings m_Settings;
+    std::string m_Path;
+    std::vector<StagedFrame> m_Staging;
+    std::thread m_Writer;
+
+    // Recording thread only.
+    uint32_t m_ChunkBodyCount = 0;
+    uint32_t m_ChunkFramesLeft = 0;
+    uint64_t m_NextFrame = 0;
+
+    // Writer thread only.
+    AsyncFile m_File;
+    TrajectoryEncoder m_Encoder;
+    TrajectoryHeader m_Header = {};
+    uint64_t m_FileSize = 0;
+    std::vector<TrajectoryChunkEntry> m_Chunks;
+    std::vector<TrajectoryFrameEntry> m_Frames;
+    std::vector<uint64_t> m_Completed;
+    bool m_WriteFailed = false;
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_StopWriter = false;
+    std::vector<uint32_t> m_FreeSlots;
+    std::deque<uint32_t> m_ReadySlots;
+    // Guarded by m_Mutex.
+    TrajectoryStats m_Stats;
+};
+
+// Maps a recorded trajectory for playback. Frames are read straight out of the page cache, so recordings far
+// larger than memory can be scrubbed. Open() reads the index, or walks the records of a recording that was
+// never closed, and builds a timeline grid with about one frame per cell, so finding the frames around a
+// time takes constant time. Times that go backwards, as after a rewind, are held flat on the timeline.
+// Quantized frames are decoded on demand into a cache of the last two, which is what playback moving forward
+// through a chunk needs.
+class TrajectoryReader {
+public:
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return m_File.IsOpen(); }
+
+    size_t GetFrameCount() const { return m_Frames.size(); }
+    size_t GetChunkCount() const { return m_Chunks.size(); }
+    const TrajectoryFrameEntry& GetFrame(size_t frame) const { return m_Frames[frame]; }
+    const TrajectoryChunkEntry& GetChunk(size_t chunk) const { return m_Chunks[chunk]; }
+    double GetStartTime() const { return m_Timeline.empty() ? 0.0 : m_Timeline.front(); }
+    double GetEndTime() const { return m_Timeline.empty() ? 0.0 : m_Timeline.back(); }
+    double GetFrameTime(size_t frame) const { return m_Timeline[frame]; }
+
+    // Last frame at or before time, clamped to the recording, and how far time is towards the next frame.
+    size_t FindFrame(double time, float& blend) const;
+    // Positions of a frame in handle order, NaN for bodies that were removed. Valid until two other frames
+    // have been asked for.
+    const glm::vec3* GetPositions(size_t frame);
+    const float* GetRadii(size_t chunk) const;
+    const glm::vec4* GetColors(size_t chunk) const;
+    BodyHandle GetSunHandle(size_t chunk) const;
+
+    // The bodies alive at time, blended between the two frames around it. radii and colours are those at the
+    // start of the chunk; sunIndex is InvalidBodyIndex when the sun is gone.
+    bool Sample(double time, std::vector<glm::vec3>& positions, std::vector<float>& radii, std::vector<glm::vec4>& colors,
+                uint32_t& sunIndex);
+
+private:
+    bool ReadIndex();
+    bool WalkRecords();
+    void BuildTimeline();
+    bool IsPayloadValid(uint64_t payloadSize, uint32_t bodyCount) const;
+    bool IsAligned() const;
+    // Offset of the next record past end; version 1 files have no padding.
+    uint64_t AlignRecord(uint64_t end) const;
+    uint64_t GetRadiiBytes(uint32_t bodyCount) const;
+    void DecodeFrame(size_t frame, std::vector<glm::vec3>& positions);
+
+    struct DecodedFrame {
+        size_t frame = SIZE_MAX;
+        std::vector<glm::vec3> positions;
+    };
+
+    MappedFile m_File;
+    TrajectoryHeader m_Header = {};
+    std::vector<TrajectoryChunkEntry> m_Chunks;
+    std::vector<TrajectoryFrameEntry> m_Frames;
+    std::vector<double> m_Timeline;
+    // Last frame at or before the start of each cell.
+    std::vector<uint32_t> m_TimelineCells;
+    double m_CellWidth = 0.0;
+    std::vector<uint32_t> m_BlockCounts;
+
+    TrajectoryDecoder m_Decoder;
+    // Last frame fed to m_Decoder.
+    size_t m_DecoderFrame = SIZE_MAX;
+    DecodedFrame m_Decoded[2];
+    uint32_t m_LastDecoded = 0;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,323 @@
+#include "TrajectoryCodec.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+namespace SpaceSim {
+
+// Grid coordinates saturate here, far outside any chunk's box.
+constexpr float MaxCode = 2.0e9f;
+// Below this the float rounding of positions is a large part of the error.
+constexpr float MinRelativeError = 1.0e-6f;
+// A block of residuals at the widest (32 bits) is this many words per axis.
+constexpr uint32_t MaxBlockWords = QuantizedBlockSize * 32 / 64;
+
+static void ForEachBlockRange(uint32_t blockCount, bool parallel, const std::function<void(uint32_t, uint32_t)>& visit)
+{
+    if (parallel)
+    {
+        ThreadPool::Get().ParallelFor(blockCount, 4, [&](size_t begin, size_t end) {
+            visit(static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+        });
+    }
+    else
+    {
+        visit(0, blockCount);
+    }
+}
+
+static uint32_t ZigZag(uint32_t value)
+{
+    return (value << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(value) >> 31);
+}
+
+static uint32_t UnZigZag(uint32_t value)
+{
+    return (value >> 1) ^ (0u - (value & 1u));
+}
+
+// Wrapping arithmetic, so a residual always restores its code exactly whatever the codes are.
+static uint32_t Predict(uint32_t order, int32_t previous, int32_t beforePrevious)
+{
+    if (order == 0)
+        return 0;
+    if (order == 1)
+        return static_cast<uint32_t>(previous);
+    return 2u * static_cast<uint32_t>(previous) - static_cast<uint32_t>(beforePrevious);
+}
+
+static uint32_t GetWidth(uint32_t widths, uint32_t axis)
+{
+    return (widths >> (8 * axis)) & 0xFFu;
+}
+
+static uint64_t GetPackedBytes(uint32_t width)
+{
+    return static_cast<uint64_t>(width) * QuantizedBlockSize / 8;
+}
+
+static void Pack(const uint32_t* values, uint32_t width, uint64_t* words)
+{
+    std::fill(words, words + QuantizedBlockSize * width / 64, 0ull);
+    for (uint32_t i = 0; i < QuantizedBlockSize; i++) {
+        const uint32_t bit = i * width;
+        const uint32_t word = bit >> 6;
+        const uint32_t shift = bit & 63;
+        words[word] |= static_cast<uint64_t>(values[i]) << shift;
+        if (shift + width > 64)
+            words[word + 1] |= static_cast<uint64_t>(values[i]) >> (64 - shift);
+    }
+}
+
+static void Unpack(const uint64_t* words, uint32_t width, uint32_t* values)
+{
+    const uint64_t mask = (1ull << width) - 1;
+    for (uint32_t i = 0; i < QuantizedBlockSize; i++) {
+        const uint32_t bit = i * width;
+        const uint32_t word = bit >> 6;
+        const uint32_t shift = bit & 63;
+        uint64_t value = words[word] >> shift;
+        if (shift + width > 64)
+            value |= words[word + 1] << (64 - shift);
+        values[i] = static_cast<uint32_t>(value & mask);
+    }
+}
+
+// Header, then the width words padded to whole 64-bit words, then the bitmap.
+static uint64_t GetBlockDataOffset(uint32_t blockCount, bool hasGaps)
+{
+    const uint64_t widthBytes = (static_cast<uint64_t>(blockCount) * sizeof(uint32_t) + 7) & ~7ull;
+    const uint64_t gapBytes = hasGaps ? static_cast<uint64_t>(blockCount) * QuantizedBlockSize / 8 : 0;
+    return sizeof(QuantizedFrameHeader) + widthBytes + gapBytes;
+}
+
+void TrajectoryEncoder::BeginChunk(const glm::vec3* positions, uint32_t count, float relativeError, bool parallel)
+{
+    const uint32_t blockCount = (count + QuantizedBlockSize - 1) / QuantizedBlockSize;
+    std::vector<glm::vec3> blockMin(blockCount, glm::vec3(std::numeric_limits<float>::max()));
+    std::vector<glm::vec3> blockMax(blockCount, glm::vec3(-std::numeric_limits<float>::max()));
+    ForEachBlockRange(blockCount, parallel, [&](uint32_t firstBlock, uint32_t lastBlock) {
+        for (uint32_t block = firstBlock; block < lastBlock; block++) {
+            const uint32_t end = std::min(count, (block + 1) * QuantizedBlockSize);
+            for (uint32_t i = block * QuantizedBlockSize; i < end; i++) {
+                if (std::isnan(positions[i].x))
+                    continue;
+                blockMin[block] = glm::min(blockMin[block], positions[i]);
+                blockMax[block] = glm::max(blockMax[block], positions[i]);
+            }
+        }
+    });
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (uint32_t block = 0; block < blockCount; block++) {
+        boundsMin = glm::min(boundsMin, blockMin[block]);
+        boundsMax = glm::max(boundsMax, blockMax[block]);
+    }
+    if (boundsMin.x > boundsMax.x)
+        boundsMin = boundsMax = glm::vec3(0.0f);
+
+    const glm::vec3 extent = boundsMax - boundsMin;
+    const float longest = std::max(extent.x, std::max(extent.y, extent.z));
+    m_Origin = boundsMin;
+    // Rounding to the nearest step is off by at most half a step; the float arithmetic on either side of
+    // the grid adds a few units of rounding at the scale of the box.
+    const float margin = 4.0f * std::numeric_limits<float>::epsilon();
+    m_Step = 2.0f * (std::max(relativeError, MinRelativeError) - margin) * (longest > 0.0f ? longest : 1.0f);
+    m_FrameInChunk = 0;
+}
+
+void TrajectoryEncoder::Encode(const glm::vec3* positions, uint32_t count, std::vector<uint8_t>& payload, bool parallel)
+{
+    const uint32_t blockCount = (count + QuantizedBlockSize - 1) / QuantizedBlockSize;
+    const uint32_t order = std::min(m_FrameInChunk, 2u);
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        m_Codes[0][axis].resize(count);
+        m_Codes[1][axis].resize(count);
+        m_Residuals[axis].resize(static_cast<size_t>(blockCount) * QuantizedBlockSize);
+    }
+    m_Widths.resize(blockCount);
+    m_Missing.resize(static_cast<size_t>(blockCount) * QuantizedBlockSize / 64);
+    m_BlockGaps.resize(blockCount);
+
+    // Quantize, predict and find each block's widths. The codes of the frame before last are replaced by
+    // this frame's as they are read.
+    const float inverseStep = 1.0f / m_Step;
+    ForEachBlockRange(blockCount, parallel, [&](uint32_t firstBlock, uint32_t lastBlock) {
+        float values[3][QuantizedBlockSize];
+        bool missing[QuantizedBlockSize];
+        for (uint32_t block = firstBlock; block < lastBlock; block++) {
+            const uint32_t begin = block * QuantizedBlockSize;
+            const uint32_t length = std::min(count - begin, QuantizedBlockSize);
+            uint64_t* gaps = m_Missing.data() + static_cast<size_t>(block) * QuantizedBlockSize / 64;
+            std::fill(gaps, gaps + QuantizedBlockSize / 64, 0ull);
+            for (uint32_t i = 0; i < length; i++) {
+                const glm::vec3 position = positions[begin + i];
+                missing[i] = std::isnan(position.x) || std::isnan(position.y) || std::isnan(position.z);
+                gaps[i >> 6] |= static_cast<uint64_t>(missing[i]) << (i & 63);
+                values[0][i] = position.x;
+                values[1][i] = position.y;
+                values[2][i] = position.z;
+            }
+            m_BlockGaps[block] = (gaps[0] | gaps[1] | gaps[2] | gaps[3]) != 0;
+
+            uint32_t widths = 0;
+            for (uint32_t axis = 0; axis < 3; axis++) {
+                const int32_t* previous = m_Codes[0][axis].data() + begin;
+                int32_t* codes = m_Codes[1][axis].data() + begin;
+                uint32_t* residuals = m_Residuals[axis].data() + begin;
+                const float origin = m_Origin[axis];
+                uint32_t bits = 0;
+                for (uint32_t i = 0; i < length; i++) {
+                    const uint32_t prediction = Predict(order, previous[i], codes[i]);
+                    // A removed body repeats its prediction so it costs nothing.
+                    const float scaled = missing[i] ? 0.0f : std::clamp((values[axis][i] - origin) * inverseStep, -MaxCode, MaxCode);
+                    const int32_t rounded = static_cast<int32_t>(scaled + (scaled >= 0.0f ? 0.5f : -0.5f));
+                    const uint32_t code = missing[i] ? prediction : static_cast<uint32_t>(rounded);
+                    residuals[i] = ZigZag(code - prediction);
+                    bits |= residuals[i];
+                    codes[i] = static_cast<int32_t>(code);
+                }
+                std::fill(residuals + length, residuals + QuantizedBlockSize, 0u);
+                widths |= static_cast<uint32_t>(std::bit_width(bits)) << (8 * axis);
+            }
+            m_Widths[block] = widths;
+        }
+    });
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        std::swap(m_Codes[0][axis], m_Codes[1][axis]);
+    }
+
+    const bool hasGaps = std::find(m_BlockGaps.begin(), m_BlockGaps.end(), uint8_t(1)) != m_BlockGaps.end();
+    m_Offsets.resize(blockCount);
+    uint64_t size = GetBlockDataOffset(blockCount, hasGaps);
+    for (uint32_t block = 0; block < blockCount; block++) {
+        m_Offsets[block] = size;
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            size += GetPackedBytes(GetWidth(m_Widths[block], axis));
+        }
+    }
+
+    payload.resize(size);
+    const QuantizedFrameHeader header{ m_Origin, m_Step, count, order, hasGaps ? QuantizedHasGaps : 0u, 0 };
+    std::memcpy(payload.data(), &header, sizeof(header));
+    std::memcpy(payload.data() + sizeof(header), m_Widths.data(), m_Widths.size() * sizeof(uint32_t));
+    if (hasGaps)
+        std::memcpy(payload.data() + GetBlockDataOffset(blockCount, false), m_Missing.data(), m_Missing.size() * sizeof(uint64_t));
+
+    ForEachBlockRange(blockCount, parallel, [&](uint32_t firstBlock, uint32_t lastBlock) {
+        uint64_t words[MaxBlockWords];
+        for (uint32_t block = firstBlock; block < lastBlock; block++) {
+            uint64_t offset = m_Offsets[block];
+            for (uint32_t axis = 0; axis < 3; axis++) {
+                const uint32_t width = GetWidth(m_Widths[block], axis);
+                if (width == 0)
+                    continue;
+                Pack(m_Residuals[axis].data() + static_cast<size_t>(block) * QuantizedBlockSize, width, words);
+                std::memcpy(payload.data() + offset, words, GetPackedBytes(width));
+                offset += GetPackedBytes(width);
+            }
+        }
+    });
+    m_FrameInChunk++;
+}
+
+bool TrajectoryDecoder::Decode(const uint8_t* payload, uint64_t size, uint32_t count, glm::vec3* positions, bool parallel)
+{
+    QuantizedFrameHeader header;
+    if (size < sizeof(header))
+        return false;
+    std::memcpy(&header, payload, sizeof(header));
+
+    const uint32_t order = std::min(m_FrameInChunk, 2u);
+    if (header.bodyCount != count || header.predictor != order)
+    {
+        std::cerr << "Quantized frame does not follow the frame decoded before it" << std::endl;
+        return false;
+    }
+
+    const uint32_t blockCount = (count + QuantizedBlockSize - 1) / QuantizedBlockSize;
+    const bool hasGaps = (header.flags & QuantizedHasGaps) != 0;
+    uint64_t end = GetBlockDataOffset(blockCount, hasGaps);
+    if (size < end)
+        return false;
+    m_Widths.resize(blockCount);
+    std::memcpy(m_Widths.data(), payload + sizeof(header), m_Widths.size() * sizeof(uint32_t));
+    m_Offsets.resize(blockCount);
+    for (uint32_t block = 0; block < blockCount; block++) {
+        m_Offsets[block] = end;
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            const uint32_t width = GetWidth(m_Widths[block], axis);
+            if (width > 32)
+                return false;
+            end += GetPackedBytes(width);
+        }
+    }
+    if (size < end)
+        return false;
+
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        m_Codes[0][axis].resize(count);
+        m_Codes[1][axis].resize(count);
+    }
+
+    const uint8_t* gapData = payload + GetBlockDataOffset(blockCount, false);
+    ForEachBlockRange(blockCount, parallel, [&](uint32_t firstBlock, uint32_t lastBlock) {
+        uint64_t words[MaxBlockWords];
+        uint32_t residuals[QuantizedBlockSize];
+        for (uint32_t block = firstBlock; block < lastBlock; block++) {
+            const uint32_t begin = block * QuantizedBlockSize;
+            const uint32_t length = std::min(count - begin, QuantizedBlockSize);
+            uint64_t offset = m_Offsets[block];
+            for (uint32_t axis = 0; axis < 3; axis++) {
+                const uint32_t width = GetWidth(m_Widths[block], axis);
+                if (width > 0)
+                {
+                    std::memcpy(words, payload + offset, GetPackedBytes(width));
+                    Unpack(words, width, residuals);
+                    offset += GetPackedBytes(width);
+                }
+                else
+                {
+                    std::fill(residuals, residuals + QuantizedBlockSize, 0u);
+                }
+
+                const int32_t* previous = m_Codes[0][axis].data() + begin;
+                int32_t* codes = m_Codes[1][axis].data() + begin;
+                for (uint32_t i = 0; i < length; i++) {
+                    codes[i] = static_cast<int32_t>(Predict(order, previous[i], codes[i]) + UnZigZag(residuals[i]));
+                }
+                if (!positions)
+                    continue;
+
+                const float origin = header.origin[axis];
+                for (uint32_t i = 0; i < length; i++) {
+                    positions[begin + i][axis] = origin + static_cast<float>(codes[i]) * header.step;
+                }
+            }
+
+            if (positions && hasGaps)
+            {
+                uint64_t gaps[QuantizedBlockSize / 64];
+                std::memcpy(gaps, gapData + static_cast<size_t>(block) * QuantizedBlockSize / 8, sizeof(gaps));
+                for (uint32_t i = 0; i < length; i++) {
+                    if ((gaps[i >> 6] >> (i & 63)) & 1)
+                        positions[begin + i] = glm::vec3(std::numeric_limits<float>::quiet_NaN());
+                }
+            }
+        }
+    });
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        std::swap(m_Codes[0][axis], m_Codes[1][axis]);
+    }
+    m_FrameInChunk++;
+    return true;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef TRAJECTORY_CODEC_H
+#define TRAJECTORY_CODEC_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace SpaceSim {
+
+// Quantized frame payload: QuantizedFrameHeader, one packed width word per block, the missing-body bitmap
+// when the frame has removed bodies, then the blocks. Positions are rounded to a grid that is fixed for the
+// whole chunk, so every frame's integer codes can be predicted exactly from the frames before it: the first
+// frame of a chunk is stored as is, the second as the change from the first, later ones as the error of a
+// linear extrapolation from the two before. Residuals are zigzag coded and bit-packed per block and axis at
+// the width of the block's largest one.
+constexpr uint32_t QuantizedBlockSize = 256;
+constexpr uint32_t QuantizedHasGaps = 1u << 0;
+
+struct QuantizedFrameHeader {
+    glm::vec3 origin;
+    float step;
+    uint32_t bodyCount;
+    // 0 for the first frame of a chunk, 1 for the second, 2 after that.
+    uint32_t predictor;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(QuantizedFrameHeader) == 32, "QuantizedFrameHeader is written to trajectories as is");
+
+// Encodes the frames of one chunk in order. Blocks are independent once their widths are known, so with
+// parallel set both passes run on the thread pool.
+class TrajectoryEncoder {
+public:
+    // Starts a chunk with a grid over the bounding box of positions (NaN for removed bodies). Positions are
+    // off by at most relativeError (1e-6 or more) times the longest side of the box.
+    void BeginChunk(const glm::vec3* positions, uint32_t count, float relativeError, bool parallel = true);
+    void Encode(const glm::vec3* positions, uint32_t count, std::vector<uint8_t>& payload, bool parallel = true);
+
+private:
+    glm::vec3 m_Origin = glm::vec3(0.0f);
+    float m_Step = 1.0f;
+    uint32_t m_FrameInChunk = 0;
+    // Codes of the last two frames and the residuals of the current one, one array per axis.
+    std::vector<int32_t> m_Codes[2][3];
+    std::vector<uint32_t> m_Residuals[3];
+    std::vector<uint32_t> m_Widths;
+    std::vector<uint64_t> m_Offsets;
+    std::vector<uint64_t> m_Missing;
+    std::vector<uint8_t> m_BlockGaps;
+};
+
+// Decodes the frames of one chunk in order, starting from its first frame.
+class TrajectoryDecoder {
+public:
+    void BeginChunk() { m_FrameInChunk = 0; }
+    // Writes positions, NaN for removed bodies, unless positions is null, which only advances the chunk.
+    bool Decode(const uint8_t* payload, uint64_t size, uint32_t count, glm::vec3* positions, bool parallel = true);
+
+private:
+    uint32_t m_FrameInChunk = 0;
+    std::vector<int32_t> m_Codes[2][3];
+    std::vector<uint32_t> m_Widths;
+    std::vector<uint64_t> m_Offsets;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace SpaceSim {
+
+// Single-writer, single-reader hand-off of the latest value. The writer fills its private slot and swaps
+// it with the shared one; the reader swaps the shared slot for its own when something new was published.
+// Neither side ever waits, and slots are reused, so buffers inside T keep their capacity.
+template <typename T>
+class TripleBuffer {
+public:
+    // Writer side.
+    T& GetWriteBuffer() { return m_Slots[m_WriteSlot]; }
+    void Publish()
+    {
+        m_WriteSlot = m_Shared.exchange(static_cast<uint8_t>(m_WriteSlot | FreshBit), std::memory_order_acq_rel) & SlotMask;
+    }
+
+    // Reader side. The returned value is the newest published one and stays untouched until the next call.
+    const T& Acquire()
+    {
+        if (m_Shared.load(std::memory_order_relaxed) & FreshBit)
+            m_ReadSlot = m_Shared.exchange(m_ReadSlot, std::memory_order_acq_rel) & SlotMask;
+        return m_Slots[m_ReadSlot];
+    }
+
+private:
+    static constexpr uint8_t FreshBit = 0x4;
+    static constexpr uint8_t SlotMask = 0x3;
+
+    T m_Slots[3]{};
+    uint8_t m_WriteSlot = 0;
+    uint8_t m_ReadSlot = 1;
+    std::atomic<uint8_t> m_Shared{ 2 };
+};
+
+}
+
+#endif
\ No newline at end of file
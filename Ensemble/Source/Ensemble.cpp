@@ -0,0 +1,112 @@
+#include "Simulation/Ensemble.h"
+#include "Simulation/ThreadPool.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace SpaceSim;
+
+static void PrintUsage()
+{
+    std::cout << "Usage: Ensemble [options]\n"
+                 "  --systems N        ensemble members (1000)\n"
+                 "  --planets N        planets per system (5)\n"
+                 "  --duration T       simulated time per system (100)\n"
+                 "  --timestep DT      leapfrog step (0.002)\n"
+                 "  --spacing R        semi-major axis ratio between neighbouring planets (1.35)\n"
+                 "  --eccentricity E   Rayleigh scale of the initial eccentricities (0.05)\n"
+                 "  --planet-mass M    mean planet mass, star mass 1000 (0.5)\n"
+                 "  --ejection R       ejection radius around the star (200)\n"
+                 "  --seed S           ensemble seed; system i uses stream i\n"
+                 "  --threads N        worker threads, 0 for all cores (0)\n"
+                 "  --output PATH      per-system results as CSV\n";
+}
+
+int main(int argc, char** argv)
+{
+    EnsembleSettings settings;
+    PlanetarySystemParams system;
+    uint32_t threads = 0;
+    std::string outputPath;
+
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        if (std::strcmp(option, "--help") == 0)
+        {
+            PrintUsage();
+            return 0;
+        }
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << option << std::endl;
+            PrintUsage();
+            return 1;
+        }
+
+        const char* value = argv[++i];
+        if (std::strcmp(option, "--systems") == 0) settings.systemCount = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(option, "--planets") == 0) system.planetCount = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(option, "--duration") == 0) settings.duration = std::atof(value);
+        else if (std::strcmp(option, "--timestep") == 0) settings.timestep = static_cast<float>(std::atof(value));
+        else if (std::strcmp(option, "--spacing") == 0) system.spacing = static_cast<float>(std::atof(value));
+        else if (std::strcmp(option, "--eccentricity") == 0) system.eccentricityScale = static_cast<float>(std::atof(value));
+        else if (std::strcmp(option, "--planet-mass") == 0) system.planetMass = static_cast<float>(std::atof(value));
+        else if (std::strcmp(option, "--ejection") == 0) settings.ejectionRadius = static_cast<float>(std::atof(value));
+        else if (std::strcmp(option, "--seed") == 0) settings.seed = std::strtoull(value, nullptr, 0);
+        else if (std::strcmp(option, "--threads") == 0) threads = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (std::strcmp(option, "--output") == 0) outputPath = value;
+        else
+        {
+            std::cerr << "Unknown option " << option << std::endl;
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (settings.timestep <= 0.0f || settings.duration <= 0.0)
+    {
+        std::cerr << "Timestep and duration must be positive" << std::endl;
+        return 1;
+    }
+
+    if (threads > 0)
+        ThreadPool::Get().SetThreadCount(threads);
+    system.gravityStrength = settings.gravityStrength;
+
+    std::cout << "Running " << settings.systemCount << " systems of " << system.planetCount + 1 << " bodies for "
+              << settings.duration << " time units on " << ThreadPool::Get().GetThreadCount() << " threads" << std::endl;
+
+    std::vector<EnsembleResult> results;
+    const EnsembleStats stats = RunEnsemble(settings, PlanetarySystem(system), results);
+
+    const double systems = static_cast<double>(std::max<size_t>(stats.systems, 1));
+    std::cout << "Survived:  " << stats.survived << " (" << 100.0 * stats.survived / systems << "%)\n"
+              << "Ejected:   " << stats.ejected << " (" << 100.0 * stats.ejected / systems << "%)\n"
+              << "Collided:  " << stats.collided << " (" << 100.0 * stats.collided / systems << "%)\n"
+              << "Invalid:   " << stats.invalid << " (" << 100.0 * stats.invalid / systems << "%)\n"
+              << "Mean time to instability: " << stats.meanTerminationTime << "\n"
+              << "Energy error of survivors: mean " << stats.meanEnergyError << ", max " << stats.maxEnergyError << "\n"
+              << "Wall time: " << stats.wallSeconds << " s, " << stats.systemsPerSecond << " systems/s, "
+              << stats.steps / std::max(stats.wallSeconds, 1e-9) << " system steps/s" << std::endl;
+
+    if (!outputPath.empty())
+    {
+        std::ofstream output(outputPath);
+        if (!output)
+        {
+            std::cerr << "Failed to open results file: " << outputPath << std::endl;
+            return 1;
+        }
+
+        const char* outcomeNames[] = { "survived", "ejected", "collided", "invalid" };
+        output << "system,outcome,time,first,second,energy_error\n";
+        for (const EnsembleResult& result : results) {
+            output << result.system << ',' << outcomeNames[static_cast<uint32_t>(result.outcome)] << ',' << result.time << ','
+                   << result.first << ',' << result.second << ',' << result.energyError << '\n';
+        }
+    }
+
+    return 0;
+}
\ No newline at end of file
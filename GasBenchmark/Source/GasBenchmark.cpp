@@ -0,0 +1,248 @@
+#include "Simulation/GravityKernels.h"
+#include "Simulation/GravitySolver.h"
+#include "Simulation/InitialConditions.h"
+#include "Simulation/Random.h"
+#include "Simulation/SPHSolver.h"
+#include "Simulation/ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glm/ext/scalar_constants.hpp>
+
+using namespace SpaceSim;
+
+struct BenchmarkOptions {
+    std::vector<uint64_t> particleCounts;
+    uint64_t bodyCount = 100;
+    uint32_t steps = 5;
+    float timestep = 0.001f;
+    SolverType solver = SolverType::GroupWalk;
+    float openingAngle = 0.5f;
+    SPHKernel kernel = SPHKernel::CubicSpline;
+    bool selfGravity = true;
+    uint32_t threads = 0;
+    uint64_t seed = 0x5EED5EEDull;
+    size_t verifySamples = 0;
+};
+
+static void PrintUsage()
+{
+    std::cout << "Usage: GasBenchmark [options]\n"
+                 "  --particles N      gas particles; repeat for several runs (100000, 300000 and 1000000)\n"
+                 "  --bodies N         point masses orbiting in the disk besides the central star (100)\n"
+                 "  --steps N          timed steps per run after one warm-up step (5)\n"
+                 "  --timestep DT      (0.001)\n"
+                 "  --solver NAME      direct, barneshut or groupwalk (groupwalk)\n"
+                 "  --theta T          opening angle (0.5)\n"
+                 "  --kernel NAME      cubic or wendland (cubic)\n"
+                 "  --no-self-gravity  the gas only feels the bodies\n"
+                 "  --seed S\n"
+                 "  --threads N        worker threads, 0 for all cores (0)\n"
+                 "  --verify N         compare N sampled gravity accelerations against direct summation first\n";
+}
+
+// The disk GravitySimulation::AddGasDisk lays out, around a central star of mass 1000, with bodies on
+// circular orbits through it.
+static void SpawnDisk(SPHSolver& gas, std::vector<glm::vec3>& bodyPositions, std::vector<float>& bodyMasses,
+                      const BenchmarkOptions& options, uint64_t particleCount)
+{
+    GasDiskParams disk;
+    disk.count = particleCount;
+    gas.Clear();
+    gas.SpawnParticles(particleCount, options.seed, 0, GasDisk(disk, gas.GetSettings()));
+
+    bodyPositions.assign(1, glm::vec3(0.0f));
+    bodyMasses.assign(1, disk.centralMass);
+    for (uint64_t b = 0; b < options.bodyCount; b++) {
+        RandomStream random(options.seed, particleCount + b);
+        float radius = random.NextFloat(disk.innerRadius, disk.outerRadius);
+        float angle = random.NextFloat(0.0f, 2.0f * glm::pi<float>());
+        bodyPositions.push_back(glm::vec3(radius * std::cos(angle), 0.0f, radius * std::sin(angle)));
+        bodyMasses.push_back(1.0f);
+    }
+}
+
+// Gravity alone is what a step with it adds over the same step without it; a kick of one time unit leaves
+// the acceleration in the velocity.
+static void VerifyGravity(const SPHSolver& gas, const std::vector<glm::vec3>& bodyPositions, const std::vector<float>& bodyMasses,
+                          GravitySolver& solver, size_t samples)
+{
+    SPHSolver with = gas;
+    SPHSolver without = gas;
+    std::vector<glm::vec3> bodyAccelerations;
+    std::vector<glm::vec3> ignored;
+    without.ComputeAccelerations(solver, 0.0f, bodyPositions, bodyMasses, ignored);
+    with.ComputeAccelerations(solver, 1.0f, bodyPositions, bodyMasses, bodyAccelerations);
+    const std::vector<glm::vec3> positions = with.GetPositions();
+    with.Integrate(1.0f);
+    without.Integrate(1.0f);
+
+    // Targets are sampled gas particles followed by every body; sources are the bodies and, with
+    // self-gravity, the gas.
+    const size_t count = positions.size();
+    const size_t stride = std::max<size_t>(1, count / std::max<size_t>(1, samples));
+    std::vector<glm::vec3> targets;
+    std::vector<glm::vec3> accelerations;
+    for (size_t i = 0; i < count && targets.size() < samples; i += stride) {
+        targets.push_back(positions[i]);
+        accelerations.push_back(with.GetVelocities()[i] - without.GetVelocities()[i]);
+    }
+    const size_t gasTargets = targets.size();
+    targets.insert(targets.end(), bodyPositions.begin(), bodyPositions.end());
+    accelerations.insert(accelerations.end(), bodyAccelerations.begin(), bodyAccelerations.end());
+
+    const bool selfGravity = gas.GetSettings().selfGravity;
+    std::vector<glm::dvec3> references(targets.size(), glm::dvec3(0.0));
+    ThreadPool::Get().ParallelFor(targets.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t s = begin; s < end; s++) {
+            const glm::dvec3 target(targets[s]);
+            glm::dvec3 reference(0.0);
+            auto accumulate = [&](const glm::vec3& source, float mass) {
+                const glm::dvec3 direction = glm::dvec3(source) - target;
+                const double distanceSquared = glm::dot(direction, direction);
+                if (distanceSquared >= MinInteractionDistanceSquared)
+                    reference += direction * (mass / (distanceSquared * std::sqrt(distanceSquared)));
+            };
+            for (size_t b = 0; b < bodyPositions.size(); b++) {
+                accumulate(bodyPositions[b], bodyMasses[b]);
+            }
+            if (selfGravity || s >= gasTargets)
+            {
+                for (size_t j = 0; j < count; j++) {
+                    accumulate(positions[j], with.GetMasses()[j]);
+                }
+            }
+            references[s] = reference;
+        }
+    });
+
+    auto report = [&](const char* name, size_t first, size_t last) {
+        std::vector<double> errors;
+        double meanSquare = 0.0;
+        for (size_t s = first; s < last; s++) {
+            errors.push_back(glm::length(glm::dvec3(accelerations[s]) - references[s]));
+            meanSquare += glm::dot(references[s], references[s]);
+        }
+        if (errors.empty())
+            return;
+
+        const double rms = std::sqrt(meanSquare / errors.size());
+        std::sort(errors.begin(), errors.end());
+        std::cout << "Force error on " << errors.size() << " " << name << " relative to RMS: median " << errors[errors.size() / 2] / rms
+                  << ", 99% " << errors[errors.size() * 99 / 100] / rms << ", max " << errors.back() / rms << std::endl;
+    };
+    report("gas particles", 0, gasTargets);
+    report("bodies", gasTargets, targets.size());
+}
+
+static void RunBenchmark(const BenchmarkOptions& options, uint64_t particleCount)
+{
+    SPHSolver gas;
+    SPHSettings settings = gas.GetSettings();
+    settings.kernel = options.kernel;
+    settings.selfGravity = options.selfGravity;
+    gas.SetSettings(settings);
+
+    GravitySolver solver;
+    SolverSettings solverSettings;
+    solverSettings.type = options.solver;
+    solverSettings.openingAngle = options.openingAngle;
+    solver.SetSettings(solverSettings);
+
+    std::vector<glm::vec3> bodyPositions;
+    std::vector<float> bodyMasses;
+    std::vector<glm::vec3> bodyAccelerations;
+    SpawnDisk(gas, bodyPositions, bodyMasses, options, particleCount);
+
+    if (options.verifySamples > 0)
+        VerifyGravity(gas, bodyPositions, bodyMasses, solver, options.verifySamples);
+
+    // The first step builds the neighbor lists and the tree from scratch.
+    gas.ComputeAccelerations(solver, 1.0f, bodyPositions, bodyMasses, bodyAccelerations);
+    gas.Integrate(options.timestep);
+    std::cout << particleCount << " particles, " << bodyPositions.size() << " bodies: first step " << gas.GetStats().neighborMs
+              << " ms neighbors, " << gas.GetStats().gravityMs << " ms gravity" << std::endl;
+
+    SPHStats totals;
+    const uint64_t rebuildsBefore = gas.GetStats().neighborRebuilds;
+    for (uint32_t step = 0; step < options.steps; step++) {
+        gas.ComputeAccelerations(solver, 1.0f, bodyPositions, bodyMasses, bodyAccelerations);
+        gas.Integrate(options.timestep);
+        const SPHStats& stats = gas.GetStats();
+        totals.neighborMs += stats.neighborMs;
+        totals.densityMs += stats.densityMs;
+        totals.forceMs += stats.forceMs;
+        totals.gravityMs += stats.gravityMs;
+        totals.averageNeighbors += stats.averageNeighbors;
+    }
+
+    const double steps = std::max<uint32_t>(options.steps, 1);
+    const double total = (totals.neighborMs + totals.densityMs + totals.forceMs + totals.gravityMs) / steps;
+    std::cout << std::fixed << std::setprecision(2) << "  per step: neighbors " << totals.neighborMs / steps << " ms, density "
+              << totals.densityMs / steps << " ms, forces " << totals.forceMs / steps << " ms, gravity " << totals.gravityMs / steps
+              << " ms, total " << total << " ms (" << particleCount / total / 1000.0 << " M particles/s)" << std::endl;
+    std::cout << "  " << totals.averageNeighbors / steps << " neighbors on average, "
+              << gas.GetStats().neighborRebuilds - rebuildsBefore << " neighbor list rebuilds, tree maintenance "
+              << solver.GetStats().maintenanceMs << " ms" << std::defaultfloat << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        if (std::strcmp(option, "--help") == 0)
+        {
+            PrintUsage();
+            return 0;
+        }
+        if (std::strcmp(option, "--no-self-gravity") == 0)
+        {
+            options.selfGravity = false;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << option << std::endl;
+            PrintUsage();
+            return 1;
+        }
+
+        const char* value = argv[++i];
+        if (std::strcmp(option, "--particles") == 0) options.particleCounts.push_back(std::strtoull(value, nullptr, 10));
+        else if (std::strcmp(option, "--bodies") == 0) options.bodyCount = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(option, "--steps") == 0) options.steps = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (std::strcmp(option, "--timestep") == 0) options.timestep = static_cast<float>(std::atof(value));
+        else if (std::strcmp(option, "--theta") == 0) options.openingAngle = static_cast<float>(std::atof(value));
+        else if (std::strcmp(option, "--seed") == 0) options.seed = std::strtoull(value, nullptr, 0);
+        else if (std::strcmp(option, "--threads") == 0) options.threads = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (std::strcmp(option, "--verify") == 0) options.verifySamples = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(option, "--solver") == 0 && std::strcmp(value, "direct") == 0) options.solver = SolverType::DirectSum;
+        else if (std::strcmp(option, "--solver") == 0 && std::strcmp(value, "barneshut") == 0) options.solver = SolverType::BarnesHut;
+        else if (std::strcmp(option, "--solver") == 0 && std::strcmp(value, "groupwalk") == 0) options.solver = SolverType::GroupWalk;
+        else if (std::strcmp(option, "--kernel") == 0 && std::strcmp(value, "cubic") == 0) options.kernel = SPHKernel::CubicSpline;
+        else if (std::strcmp(option, "--kernel") == 0 && std::strcmp(value, "wendland") == 0) options.kernel = SPHKernel::WendlandC2;
+        else
+        {
+            std::cerr << "Unknown option " << option << " " << value << std::endl;
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (options.particleCounts.empty())
+        options.particleCounts = { 100000, 300000, 1000000 };
+    if (options.threads > 0)
+        ThreadPool::Get().SetThreadCount(options.threads);
+
+    std::cout << GetSolverName(options.solver) << ", " << ThreadPool::Get().GetThreadCount() << " threads" << std::endl;
+    for (uint64_t particleCount : options.particleCounts) {
+        RunBenchmark(options, particleCount);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "Simulation/GravityKernels.h"
+#include "Simulation/InitialConditions.h"
+#include "Simulation/MappedBodyStore.h"
+#include "Simulation/ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace SpaceSim;
+
+struct OutOfCoreOptions {
+    std::string path = "Bodies.ssb";
+    uint64_t bodyCount = 0;
+    uint32_t steps = 10;
+    float timestep = 0.001f;
+    float openingAngle = 0.5f;
+    uint32_t prefetchTiles = 2;
+    uint32_t threads = 0;
+    uint64_t seed = 0x5EED5EEDull;
+    size_t verifySamples = 0;
+};
+
+static void PrintUsage()
+{
+    std::cout << "Usage: OutOfCore [options]\n"
+                 "  --path PATH        body store file (Bodies.ssb)\n"
+                 "  --bodies N         create the store with an N body Plummer sphere; without it PATH is opened\n"
+                 "  --steps N          steps to run (10)\n"
+                 "  --timestep DT      (0.001)\n"
+                 "  --theta T          opening angle (0.5)\n"
+                 "  --prefetch N       tiles prefetched ahead of the force pass (2)\n"
+                 "  --seed S\n"
+                 "  --threads N        worker threads, 0 for all cores (0)\n"
+                 "  --verify N         compare N sampled accelerations against direct summation first\n";
+}
+
+static void SpawnPlummerSphere(MappedBodyStore& store, const OutOfCoreOptions& options)
+{
+    PlummerParams params;
+    params.count = options.bodyCount;
+    const BodyGenerator generator = PlummerSphere(params);
+
+    double moments[7] = {};
+    for (uint64_t chunk = 0; chunk < store.GetChunkCount(); chunk++) {
+        const uint64_t first = chunk * MappedBodyStore::ChunkSize;
+        ThreadPool::Get().ParallelFor(store.GetChunkBodyCount(chunk), 1024, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                RandomStream random(options.seed, first + k);
+                CelestialBody body;
+                generator(first + k, random, body);
+                store.SetBody(first + k, body);
+            }
+        });
+
+        const float* masses = store.GetField(chunk, MappedBodyStore::Mass);
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            const float* positions = store.GetField(chunk, static_cast<MappedBodyStore::Field>(MappedBodyStore::PositionX + axis));
+            const float* velocities = store.GetField(chunk, static_cast<MappedBodyStore::Field>(MappedBodyStore::VelocityX + axis));
+            for (uint32_t k = 0; k < store.GetChunkBodyCount(chunk); k++) {
+                moments[axis] += static_cast<double>(positions[k]) * masses[k];
+                moments[axis + 3] += static_cast<double>(velocities[k]) * masses[k];
+            }
+        }
+        for (uint32_t k = 0; k < store.GetChunkBodyCount(chunk); k++) {
+            moments[6] += masses[k];
+        }
+    }
+
+    for (uint64_t chunk = 0; chunk < store.GetChunkCount(); chunk++) {
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            float* positions = store.GetField(chunk, static_cast<MappedBodyStore::Field>(MappedBodyStore::PositionX + axis));
+            float* velocities = store.GetField(chunk, static_cast<MappedBodyStore::Field>(MappedBodyStore::VelocityX + axis));
+            for (uint32_t k = 0; k < store.GetChunkBodyCount(chunk); k++) {
+                positions[k] -= static_cast<float>(moments[axis] / moments[6]);
+                velocities[k] -= static_cast<float>(moments[axis + 3] / moments[6]);
+            }
+        }
+    }
+}
+
+// A kick of one time unit leaves the acceleration in the velocity change; a second kick backwards undoes it.
+static void VerifyAccelerations(MappedBodyStore& store, size_t samples)
+{
+    const uint64_t count = store.GetBodyCount();
+    const uint64_t stride = std::max<uint64_t>(1, count / std::max<size_t>(1, samples));
+    std::vector<uint64_t> indices;
+    for (uint64_t i = 0; i < count && indices.size() < samples; i += stride) {
+        indices.push_back(i);
+    }
+
+    std::vector<glm::vec3> before(indices.size());
+    for (size_t s = 0; s < indices.size(); s++) {
+        before[s] = store.GetBody(indices[s]).velocity;
+    }
+    store.Kick(1.0f, 1.0f);
+    std::vector<glm::vec3> accelerations(indices.size());
+    for (size_t s = 0; s < indices.size(); s++) {
+        accelerations[s] = store.GetBody(indices[s]).velocity - before[s];
+    }
+    store.Kick(-1.0f, 1.0f);
+
+    std::vector<glm::dvec3> references(indices.size(), glm::dvec3(0.0));
+    for (uint64_t chunk = 0; chunk < store.GetChunkCount(); chunk++) {
+        const float* px = store.GetField(chunk, MappedBodyStore::PositionX);
+        const float* py = store.GetField(chunk, MappedBodyStore::PositionY);
+        const float* pz = store.GetField(chunk, MappedBodyStore::PositionZ);
+        const float* masses = store.GetField(chunk, MappedBodyStore::Mass);
+        const uint32_t chunkCount = store.GetChunkBodyCount(chunk);
+        ThreadPool::Get().ParallelFor(indices.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t s = begin; s < end; s++) {
+                const glm::dvec3 target(store.GetBody(indices[s]).position);
+                glm::dvec3 reference(0.0);
+                for (uint32_t k = 0; k < chunkCount; k++) {
+                    const glm::dvec3 direction = glm::dvec3(px[k], py[k], pz[k]) - target;
+                    const double distanceSquared = glm::dot(direction, direction);
+                    if (distanceSquared < MinInteractionDistanceSquared)
+                        continue;
+                    reference += direction * (masses[k] / (distanceSquared * std::sqrt(distanceSquared)));
+                }
+                references[s] += reference;
+            }
+        });
+    }
+
+    std::vector<double> errors;
+    double meanSquare = 0.0;
+    for (size_t s = 0; s < indices.size(); s++) {
+        errors.push_back(glm::length(glm::dvec3(accelerations[s]) - references[s]));
+        meanSquare += glm::dot(references[s], references[s]);
+    }
+    if (errors.empty())
+        return;
+
+    const double rms = std::sqrt(meanSquare / errors.size());
+    std::sort(errors.begin(), errors.end());
+    std::cout << "Force error over " << errors.size() << " bodies relative to RMS: median " << errors[errors.size() / 2] / rms
+              << ", 99% " << errors[errors.size() * 99 / 100] / rms << ", max " << errors.back() / rms << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    OutOfCoreOptions options;
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        if (std::strcmp(option, "--help") == 0)
+        {
+            PrintUsage();
+            return 0;
+        }
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << option << std::endl;
+            PrintUsage();
+            return 1;
+        }
+
+        const char* value = argv[++i];
+        if (std::strcmp(option, "--path") == 0) options.path = value;
+        else if (std::strcmp(option, "--bodies") == 0) options.bodyCount = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(option, "--steps") == 0) options.steps = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (std::strcmp(option, "--timestep") == 0) options.timestep = static_cast<float>(std::atof(value));
+        else if (std::strcmp(option, "--theta") == 0) options.openingAngle = static_cast<float>(std::atof(value));
+        else if (std::strcmp(option, "--prefetch") == 0) options.prefetchTiles = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (std::strcmp(option, "--seed") == 0) options.seed = std::strtoull(value, nullptr, 0);
+        else if (std::strcmp(option, "--threads") == 0) options.threads = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (std::strcmp(option, "--verify") == 0) options.verifySamples = std::strtoull(value, nullptr, 10);
+        else
+        {
+            std::cerr << "Unknown option " << option << std::endl;
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (options.threads > 0)
+        ThreadPool::Get().SetThreadCount(options.threads);
+
+    MappedBodyStore store;
+    MappedStoreSettings settings;
+    settings.openingAngle = options.openingAngle;
+    settings.prefetchTiles = options.prefetchTiles;
+    store.SetSettings(settings);
+
+    if (options.bodyCount > 0)
+    {
+        if (!store.Create(options.path, options.bodyCount))
+            return 1;
+        SpawnPlummerSphere(store, options);
+        store.Sort();
+        std::cout << "Created " << options.path << ": sorted in " << store.GetStats().sortMs << " ms" << std::endl;
+    }
+    else if (!store.Open(options.path))
+    {
+        return 1;
+    }
+
+    const double gigabytes = store.GetFileSize() / 1e9;
+    std::cout << store.GetBodyCount() << " bodies, " << gigabytes << " GB, " << store.GetLeafCount() << " leaves, "
+              << store.GetSummaryBytes() / 1e6 << " MB of tree in memory, t = " << store.GetTime() << std::endl;
+
+    if (options.verifySamples > 0)
+        VerifyAccelerations(store, options.verifySamples);
+
+    const uint64_t leaves = std::max<uint64_t>(store.GetLeafCount(), 1);
+    for (uint32_t step = 0; step < options.steps; step++) {
+        store.Step(options.timestep, 1.0f);
+        const MappedStoreStats& stats = store.GetStats();
+        std::cout << "Step " << store.GetStepCount() << ": kick " << stats.kickMs << " ms (" << stats.sourceBodies / leaves << " bodies and "
+                  << stats.sourceCells / leaves << " cells per leaf, " << stats.prefetchedChunks << " chunks prefetched), drift "
+                  << stats.driftMs << " ms (" << gigabytes / std::max(stats.driftMs / 1000.0, 1e-9) << " GB/s), work ratio "
+                  << stats.workRatio << ", sorts " << stats.sorts << std::endl;
+    }
+
+    store.Flush();
+    return 0;
+}
\ No newline at end of file
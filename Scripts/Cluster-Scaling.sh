@@ -0,0 +1,12 @@
+#!/bin/bash
+# Strong scaling of the MPI runner: same body count, 1 to 64 ranks.
+# Usage: Scripts/Cluster-Scaling.sh path/to/Cluster [bodies] [steps]
+
+CLUSTER=${1:?path to the Cluster binary}
+BODIES=${2:-1000000}
+STEPS=${3:-10}
+
+for RANKS in 1 2 4 8 16 32 64; do
+    mpirun --oversubscribe -np $RANKS "$CLUSTER" --bodies $BODIES --steps $STEPS | grep -E "Ranks|Step|Imported|Imbalance"
+    echo
+done
@@ -0,0 +1,14 @@
+#version 460 core
+uniform vec4 u_Color;
+
+out vec4 FragColor;
+
+void main()
+{
+    vec2 offset = gl_PointCoord * 2.0 - 1.0;
+    float distanceSquared = dot(offset, offset);
+    if (distanceSquared > 1.0)
+        discard;
+    
+    FragColor = vec4(u_Color.rgb * (1.0 - 0.5 * distanceSquared), u_Color.a);
+}
\ No newline at end of file
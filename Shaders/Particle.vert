@@ -0,0 +1,13 @@
+#version 460 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 u_View;
+uniform mat4 u_Projection;
+uniform float u_PointSize;
+
+void main()
+{
+    vec4 viewPos = u_View * vec4(aPos, 1.0);
+    gl_Position = u_Projection * viewPos;
+    gl_PointSize = max(1.0, u_PointSize / -viewPos.z);
+}
\ No newline at end of file